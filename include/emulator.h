@@ -0,0 +1,110 @@
+#ifndef EMULATOR_H
+#define EMULATOR_H
+
+#include <cstdint>
+#include "i960.h"
+#include "memory.h"
+
+struct TGP;
+
+// One emulated Model 2 board.
+// An Emulator owns everything a running game touches: the i960, the memory
+// bus, the TGP and the input and audio registers, with no state outside the
+// instance. Any number of them can run side by side in one process, one per
+// thread, as long as each instance is driven by a single thread at a time.
+// The window, host audio device and SDL event handling belong to the
+// frontend (main.cpp), which only reads and writes the instance.
+
+// The Model 2 main CPU is an i960 clocked at 25 MHz; each frame runs one
+// frame's worth of CPU time in a single batch
+const uint64_t CPU_CLOCK_HZ = 25000000;
+const uint64_t CPU_CYCLES_PER_FRAME = CPU_CLOCK_HZ / 60;
+
+// Player controls, read by the game through the input registers
+struct InputState
+{
+    // Digital inputs (buttons)
+    bool start_button = false;
+    bool service_button = false;
+    bool test_button = false;
+    bool coin_button = false;
+
+    // Action buttons
+    bool button1 = false;
+    bool button2 = false;
+    bool button3 = false;
+    bool button4 = false;
+
+    // Directional inputs
+    bool up = false;
+    bool down = false;
+    bool left = false;
+    bool right = false;
+
+    // Analog inputs (for steering/wheel)
+    int16_t steering = 0; // -32768 to 32767
+    int16_t throttle = 0; // -32768 to 32767
+};
+
+// Sound registers written by the game, mixed by emulator_render_audio
+struct AudioState
+{
+    void *stream = nullptr; // Host audio stream (SDL_AudioStream), owned by the frontend
+    bool enabled = true;
+    float master_volume = 1.0f;
+
+    // Sega Model 2 audio channels (simplified)
+    struct
+    {
+        bool enabled = false;
+        uint16_t frequency = 0;
+        uint8_t volume = 0;
+        uint8_t waveform = 0; // 0=sine, 1=square, 2=triangle, 3=sawtooth
+    } channels[8];            // 8 audio channels
+};
+
+// How a new instance runs
+struct EmulatorConfig
+{
+    i960_engine engine = I960_ENGINE_INTERPRETER;
+    i960_isa isa = I960_ISA_KB;
+    bool idle_skip = true; // Fast-forward through idle loops
+    bool fusion = true;    // Superinstructions in the block engines
+    bool fastmem = false;  // Host view of the guest space (memory_enable_fastmem), when the host supports it
+};
+
+struct Emulator
+{
+    MemoryBus bus;
+    i960_cpu cpu;          // Connected to bus
+    TGP *tgp;              // Mapped at TGP_BASE_ADDRESS (owned)
+    InputState input;      // Mapped at INPUT_BASE_ADDRESS
+    AudioState audio;      // Mapped at AUDIO_BASE_ADDRESS
+    float audio_phase[8];  // Oscillator phase of each audio channel, in periods
+    uint64_t frames;       // Frames run so far
+};
+
+// Creates a board with empty memory and the CPU configured but not booted.
+// The instance refers to itself (the CPU and devices point at its bus), so
+// it lives on the heap and is never copied.
+Emulator *emulator_create(const EmulatorConfig *config);
+
+// Releases the instance and everything it owns
+void emulator_destroy(Emulator *emu);
+
+// Loads a game's ROMs (see load_game_by_name) and resets the CPU
+bool emulator_load_game(Emulator *emu, const char *game_name, const char *rom_directory);
+
+// Restarts the CPU from whatever is in memory: drops decoded code and, for
+// the KB instruction set, boots from the initialization boot record
+void emulator_reset(Emulator *emu);
+
+// Runs one frame: CPU_CYCLES_PER_FRAME cycles (unless the CPU halts), then
+// the TGP. Returns the CPU cycles run.
+uint64_t emulator_run_frame(Emulator *emu);
+
+// Mixes `frames` stereo frames of interleaved 16-bit samples from the
+// audio registers, advancing the channel oscillators
+void emulator_render_audio(Emulator *emu, int16_t *samples, int frames, int sample_rate);
+
+#endif // EMULATOR_H
@@ -4,14 +4,63 @@
 #include <cstdint>
 #include "memory.h" // Include memory bus definition
 
+struct i960_decode_cache;
+struct i960_block_cache;
+struct i960_jit;
+struct Profiler;
+struct i960_pair_stats;
+struct i960_hle;
+
+// Execution engines, selectable at runtime
+enum i960_engine {
+    I960_ENGINE_INTERPRETER, // Decode-cached interpreter, one instruction per dispatch
+    I960_ENGINE_THREADED,    // Basic blocks translated to handler arrays and chained
+    I960_ENGINE_JIT,         // Threaded engine with hot blocks compiled to x86-64 code
+};
+
+// Instruction sets the decoder understands
+enum i960_isa {
+    I960_ISA_LEGACY, // Byte-oriented test encoding (ld_const, add_reg, ...)
+    I960_ISA_KB,     // Real 32-bit i960 KB/CA encoding (REG, COBR, CTRL, MEM)
+};
+
+// Granularity at which instruction fetch resolves guest addresses
+const uint32_t I960_FETCH_PAGE_SIZE = 4096;
+
+// The page the decoders last fetched from, resolved once to a host pointer
+struct i960_fetch_stream {
+    uint32_t page_base;      // Guest address of the resolved page
+    const uint8_t* page;     // Host pointer to it, or nullptr when it is not plain memory
+    uint32_t map_generation; // bus->map_generation when resolved (0 = never)
+};
+
+// Context saved when an interrupt is taken
+struct i960_interrupt_frame {
+    uint32_t ip;
+    uint32_t pc;     // Process controls, including the interrupted priority
+    bool zero_flag;
+};
+
 // The Intel i960 has 16 global 32-bit registers (g0-g15)
 // and 16 local 32-bit registers (r0-r15).
-// For simplicity, we'll start with the global registers.
 
 struct i960_cpu {
     // --- Registers ---
-    uint32_t g[16]; // Global registers
-    // We will add local registers and special function registers later.
+    // One file indexed by decoded register numbers (see I960_REG_*): locals,
+    // globals, then the read-only literal slots 0-31
+    union {
+        uint32_t regs[64];
+        struct {
+            uint32_t r[16];        // Local registers (r0 = pfp, r1 = sp, r2 = rip)
+            uint32_t g[16];        // Global registers (g15 = fp)
+            uint32_t literals[32]; // literals[n] == n, never written
+        };
+    };
+    uint32_t ac; // Arithmetic controls (condition code in bits 0-2)
+    uint32_t pc; // Process controls
+    uint32_t tc; // Trace controls
+    uint32_t sat;  // System address table (from the boot record)
+    uint32_t prcb; // Processor control block (from the boot record)
 
     // --- Program Counter ---
     uint32_t ip; // Instruction Pointer
@@ -27,27 +76,138 @@ struct i960_cpu {
 
     // --- CPU State ---
     bool halted; // True when CPU is halted and should not execute further
-
-    // --- Interrupt System ---
-    bool interrupt_mode;        // True when processing an interrupt
-    uint32_t interrupt_stack[32]; // Stack for interrupt context (IP, flags, etc.)
-    uint32_t interrupt_sp;      // Interrupt stack pointer
+    uint64_t cycles; // Cycles executed since init (see I960_OP_CYCLES)
+    bool idle_skip;        // Fast-forward through idle loops (threaded and JIT engines)
+    bool fusion;           // Dispatch fusable pairs as superinstructions (blocks translated from now on)
+    uint64_t idle_cycles;  // Cycles fast-forwarded instead of executed
+
+    // --- Interrupt Controller ---
+    // Vector v has priority v / 8 and is taken when it is pending, enabled
+    // and outranks the processor priority in pc bits 16-20. Priority 0
+    // (vectors 0-7) is never delivered, as on the real part.
+    uint32_t ipnd[8];           // Pending vectors, one bit each (IPND)
+    uint32_t imsk[8];           // Enabled vectors, one bit each (IMSK); all set at init
+    bool interrupt_ready;       // Cached "an interrupt can be taken now", see i960_update_interrupts
+    uint64_t run_end;           // Cycle count the current i960_run stops at; pulled in when an interrupt becomes ready
+    i960_interrupt_frame interrupt_frames[32]; // Interrupted contexts, innermost last
+    uint32_t interrupt_depth;   // Handlers currently active (nested by priority)
     uint32_t interrupt_vectors[256]; // Interrupt vector table (addresses of handlers)
 
-    // We will add other state like Arithmetic Controls, etc. later
+    // --- Decoded Instruction Cache ---
+    i960_decode_cache* decode_cache; // Instructions decoded once and reused by IP (owned)
+
+    // --- Execution Engine ---
+    i960_engine engine;              // Engine used by i960_run
+    i960_block_cache* block_cache;   // Translated basic blocks for the threaded engine (owned)
+    i960_jit* jit;                   // Native code buffer for the JIT engine (owned)
+    i960_isa isa;                    // Instruction set code is decoded as
+    i960_fetch_stream fetch;         // Code page instructions are decoded from
+    i960_hle* hle;                   // ROM routines replaced by native code, or nullptr (not owned, see i960_hle.h)
+
+    // --- Profiling ---
+    Profiler* profiler;              // Guest IP sampler fed by every engine, or nullptr (not owned)
+    i960_pair_stats* pair_stats;     // Adjacent-pair counts from the block engines, or nullptr (not owned)
 };
 
 // Initializes the CPU to a default power-on state
 void i960_init(i960_cpu* cpu, MemoryBus* bus);
 
-// Executes a single instruction cycle (fetch-decode-execute)
+// Releases resources owned by the CPU (decode cache, translations, JIT code)
+void i960_destroy(i960_cpu* cpu);
+
+// Selects the instruction set and drops everything decoded so far
+void i960_set_isa(i960_cpu* cpu, i960_isa isa);
+
+// Parses an instruction set name ("legacy", "kb"); returns false if unknown
+bool i960_parse_isa(const char* name, i960_isa* isa);
+
+// Returns the short name of an instruction set
+const char* i960_isa_name(i960_isa isa);
+
+// KB reset: reads the initialization boot record at address 0 (SAT pointer,
+// PRCB pointer, first IP at offset 12) and sets up the first frame from
+// the PRCB's interrupt stack pointer
+void i960_boot(i960_cpu* cpu);
+
+// Points the fetch stream at the page holding address
+void i960_fetch_resolve(i960_cpu* cpu, uint32_t address);
+
+// Host pointer to the `size` bytes at address when they lie in one plain
+// memory page, otherwise nullptr. Resolves again only when the address
+// leaves the current page or the bus mapping changes.
+inline const uint8_t* i960_fetch_pointer(i960_cpu* cpu, uint32_t address, uint32_t size) {
+    if (address - cpu->fetch.page_base > I960_FETCH_PAGE_SIZE - size ||
+        cpu->fetch.map_generation != cpu->bus->map_generation) {
+        i960_fetch_resolve(cpu, address);
+    }
+    uint32_t offset = address - cpu->fetch.page_base;
+    return cpu->fetch.page != nullptr && offset <= I960_FETCH_PAGE_SIZE - size ? cpu->fetch.page + offset : nullptr;
+}
+
+// Fetches the little-endian instruction word at address
+inline uint32_t i960_fetch_word(i960_cpu* cpu, uint32_t address) {
+    const uint8_t* p = i960_fetch_pointer(cpu, address, 4);
+    return p != nullptr ? memory_load_le32(p) : memory_read_dword(cpu->bus, address);
+}
+
+// Fetches count instruction bytes at address
+inline void i960_fetch_bytes(i960_cpu* cpu, uint32_t address, uint8_t* out, uint32_t count) {
+    const uint8_t* p = i960_fetch_pointer(cpu, address, count);
+    if (p != nullptr) {
+        memcpy(out, p, count);
+        return;
+    }
+    for (uint32_t i = 0; i < count; ++i) {
+        out[i] = memory_read_byte(cpu->bus, address + i);
+    }
+}
+
+// Executes a single instruction (fetch-decode-execute) and adds its cost to cpu->cycles
 void i960_step(i960_cpu* cpu);
 
+// Selects the engine used by i960_run. Falls back to the threaded
+// engine if the JIT is requested but unavailable on this host.
+void i960_set_engine(i960_cpu* cpu, i960_engine engine);
+
+// Parses an engine name ("interp", "threaded", "jit"); returns false if unknown
+bool i960_parse_engine(const char* name, i960_engine* engine);
+
+// Returns the short name of an engine
+const char* i960_engine_name(i960_engine engine);
+
+// Runs the selected engine until `cycles` cycles have been used, the CPU
+// halts or an interrupt becomes deliverable. Pending interrupts that can
+// be taken are delivered before the first instruction. Returns the number of cycles
+// consumed, which may exceed the budget by part of the last instruction.
+uint64_t i960_run(i960_cpu* cpu, uint64_t cycles);
+
 // --- Interrupt Management ---
-// Triggers a software interrupt
+// Takes an interrupt now if its priority outranks the processor's,
+// otherwise leaves it pending
 void i960_interrupt(i960_cpu* cpu, uint8_t vector);
 
-// Returns from interrupt handler
+// Sets the vector's IPND bit; it is delivered by the next i960_run (or
+// ends the current one at the next block boundary) once it can be taken
+void i960_request_interrupt(i960_cpu* cpu, uint8_t vector);
+
+// Sets or clears the vector's IMSK bit
+void i960_set_interrupt_enabled(i960_cpu* cpu, uint8_t vector, bool enabled);
+
+// Recomputes cpu->interrupt_ready after IPND, IMSK or the processor
+// priority changed. The run loops only ever test that one flag.
+void i960_update_interrupts(i960_cpu* cpu);
+
+// True when a pending, enabled interrupt outranks the processor priority
+inline bool i960_interrupt_ready(const i960_cpu* cpu) {
+    return cpu->interrupt_ready;
+}
+
+// Processor priority (pc bits 16-20)
+inline uint32_t i960_priority(const i960_cpu* cpu) {
+    return (cpu->pc >> 16) & 0x1F;
+}
+
+// Returns from the innermost interrupt handler
 void i960_return_from_interrupt(i960_cpu* cpu);
 
 // Sets an interrupt vector (handler address)
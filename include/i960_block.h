@@ -0,0 +1,65 @@
+#ifndef I960_BLOCK_H
+#define I960_BLOCK_H
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include "i960_decode.h"
+#include "i960_fuse.h"
+#include "i960_jit.h"
+
+// Threaded-code execution engine.
+// Guest code is translated one basic block at a time into an array of
+// decoded instructions whose handlers are called back to back. A block ends
+// at the first branch (beq/bne/jmp; b, bcc, cmpob, call, ret, bx...) or stop
+// (halt, undefined opcode) instruction. Finished blocks remember their successors so that hot loops
+// chain from block to block without going back through the block map.
+// With the JIT engine, hot blocks are additionally compiled to native code
+// (see i960_jit.h).
+//
+// Idle loops: a block that branches back to itself, stores nothing and
+// recomputes the same register values on every pass (a spin on a status
+// register, a branch-to-self) cannot make progress until something outside
+// the CPU changes. Once such a loop repeats, the remaining budget is
+// consumed in whole iterations without executing them; the resulting state
+// and cycle count are exactly those of running the loop.
+//
+// ops always holds one entry per guest instruction (analyses, profiling and
+// the JIT work on it); code is what the threaded loop dispatches, with
+// fusable pairs merged into superinstructions (see i960_fuse.h).
+
+// Longest run of straight-line instructions translated into one block
+const uint32_t I960_BLOCK_MAX_INSNS = 64;
+
+// Translations kept before the whole cache is flushed and rebuilt
+const uint32_t I960_BLOCK_CACHE_LIMIT = 65536;
+
+struct i960_block {
+    uint32_t start_ip;              // Guest address of the first instruction
+    uint32_t end_ip;                // Address just past the last instruction
+    uint32_t taken_ip;              // Target of the terminating branch (end_ip if none)
+    std::vector<i960_decoded> ops;  // Decoded instructions: handler + operands per instruction
+    std::vector<i960_thread_op> code; // Dispatch list over ops, adjacent pairs fused
+    uint32_t cycles;                // Cost of the whole block, excluding a taken branch
+    uint32_t max_cycles;            // Upper bound with run-time wait states (computed addresses) included
+    bool idle;                      // Side-effect-free loop back to start_ip
+    i960_block* taken;              // Chained successor at taken_ip
+    i960_block* fallthrough;        // Chained successor at end_ip
+    uint32_t exec_count;            // Threaded runs so far, for JIT hotness
+    i960_native_block native;       // Compiled code for the leading instructions (JIT engine)
+};
+
+struct i960_block_cache {
+    std::unordered_map<uint32_t, i960_block> blocks; // Translations keyed by start IP
+    uint32_t generation;            // Bus code generation the translations belong to
+};
+
+i960_block_cache* i960_block_cache_create();
+void i960_block_cache_destroy(i960_block_cache* cache);
+
+// Runs translated blocks until cpu->cycles reaches cpu->run_end (pulled in
+// when an interrupt becomes deliverable) or the CPU halts. Returns the
+// cycles consumed.
+uint64_t i960_block_execute(i960_cpu* cpu);
+
+#endif // I960_BLOCK_H
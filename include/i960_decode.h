@@ -0,0 +1,357 @@
+#ifndef I960_DECODE_H
+#define I960_DECODE_H
+
+#include <cstdint>
+
+struct i960_cpu;
+struct i960_decoded;
+
+// Execute routine for one decoded instruction. The handler is responsible
+// for advancing (or redirecting) cpu->ip.
+typedef void (*i960_handler)(i960_cpu* cpu, const i960_decoded* insn);
+
+// Register file indices used by decoded instructions. Indices 0-15 are the
+// local registers r0-r15 and 16-31 the globals g0-g15, as in the REG/COBR/MEM
+// register fields. Indices 32-63 are read-only slots holding the literals
+// 0-31, so a literal operand is read exactly like a register.
+const uint8_t I960_REG_PFP = 0;      // r0: previous frame pointer
+const uint8_t I960_REG_SP = 1;       // r1: stack pointer
+const uint8_t I960_REG_RIP = 2;      // r2: return instruction pointer
+const uint8_t I960_REG_G0 = 16;
+const uint8_t I960_REG_G14 = 30;     // Link register of bal
+const uint8_t I960_REG_FP = 31;      // g15: frame pointer
+const uint8_t I960_REG_LITERAL = 32; // Literal n lives at I960_REG_LITERAL + n
+const uint8_t I960_REG_COUNT = 64;
+
+// Operation performed by a decoded instruction, independent of how it was
+// encoded. The first group is the legacy byte-oriented encoding used by the
+// test programs; the rest are the i960 KB/CA core instructions.
+enum i960_op : uint8_t {
+    I960_OP_UNDEFINED, // Unimplemented opcode: does not advance ip
+    I960_OP_SKIP,      // Invalid operands: no effect, ip advances
+    I960_OP_UNKNOWN,   // Placeholder opcode seen in ROMs: logged and skipped
+    I960_OP_HALT,
+    I960_OP_LD_CONST,
+    I960_OP_ADD_REG,
+    I960_OP_SUB_REG,
+    I960_OP_MUL_REG,
+    I960_OP_DIV_REG,
+    I960_OP_AND_REG,
+    I960_OP_OR_REG,
+    I960_OP_XOR_REG,
+    I960_OP_NOT_REG,
+    I960_OP_LD_ABS,
+    I960_OP_ST_ABS,
+    I960_OP_LD_BYTE,
+    I960_OP_ST_BYTE,
+    I960_OP_CMP_REG,
+    I960_OP_BEQ,
+    I960_OP_BNE,
+    I960_OP_JMP,
+
+    // --- i960 KB/CA: REG format ---
+    I960_OP_NOP,       // mark, fmark, flushreg, syncf: no architectural effect here
+    I960_OP_NOTBIT,
+    I960_OP_AND,
+    I960_OP_ANDNOT,
+    I960_OP_SETBIT,
+    I960_OP_NOTAND,
+    I960_OP_XOR,
+    I960_OP_OR,
+    I960_OP_NOR,
+    I960_OP_XNOR,
+    I960_OP_NOT,
+    I960_OP_ORNOT,
+    I960_OP_CLRBIT,
+    I960_OP_NOTOR,
+    I960_OP_NAND,
+    I960_OP_ALTERBIT,
+    I960_OP_ADDO,
+    I960_OP_ADDI,
+    I960_OP_SUBO,
+    I960_OP_SUBI,
+    I960_OP_SHRO,
+    I960_OP_SHRDI,
+    I960_OP_SHRI,
+    I960_OP_SHLO,
+    I960_OP_ROTATE,
+    I960_OP_SHLI,
+    I960_OP_CMPO,
+    I960_OP_CMPI,
+    I960_OP_CONCMPO,
+    I960_OP_CONCMPI,
+    I960_OP_CMPINCO,
+    I960_OP_CMPINCI,
+    I960_OP_CMPDECO,
+    I960_OP_CMPDECI,
+    I960_OP_SCANBYTE,
+    I960_OP_CHKBIT,
+    I960_OP_ADDC,
+    I960_OP_SUBC,
+    I960_OP_MOV,
+    I960_OP_MOVL,
+    I960_OP_MOVT,
+    I960_OP_MOVQ,
+    I960_OP_SCANBIT,
+    I960_OP_SPANBIT,
+    I960_OP_MODAC,
+    I960_OP_MODIFY,
+    I960_OP_EXTRACT,
+    I960_OP_MODTC,
+    I960_OP_MODPC,
+    I960_OP_EMUL,
+    I960_OP_EDIV,
+    I960_OP_MULO,
+    I960_OP_REMO,
+    I960_OP_DIVO,
+    I960_OP_MULI,
+    I960_OP_REMI,
+    I960_OP_MODI,
+    I960_OP_DIVI,
+
+    // --- i960 KB/CA: CTRL format ---
+    I960_OP_B,
+    I960_OP_CALL,
+    I960_OP_RET,
+    I960_OP_BAL,
+    I960_OP_BCC,       // bno..bo: condition mask in aux
+
+    // --- i960 KB/CA: COBR format ---
+    I960_OP_TEST,      // testno..testo: condition mask in aux
+    I960_OP_BBC,
+    I960_OP_CMPOB,     // cmpobg..cmpoble: condition mask in aux
+    I960_OP_BBS,
+    I960_OP_CMPIB,     // cmpibno..cmpibo: condition mask in aux
+
+    // --- i960 KB/CA: MEM format ---
+    I960_OP_LDOB,
+    I960_OP_STOB,
+    I960_OP_BX,
+    I960_OP_BALX,
+    I960_OP_CALLX,
+    I960_OP_LDOS,
+    I960_OP_STOS,
+    I960_OP_LDA,
+    I960_OP_LD,
+    I960_OP_ST,
+    I960_OP_LDL,
+    I960_OP_STL,
+    I960_OP_LDT,
+    I960_OP_STT,
+    I960_OP_LDQ,
+    I960_OP_STQ,
+    I960_OP_LDIB,
+    I960_OP_STIB,
+    I960_OP_LDIS,
+    I960_OP_STIS,
+
+    // --- High-level emulation ---
+    I960_OP_HLE,       // Hooked ROM routine run natively (see i960_hle.h)
+
+    I960_OP_COUNT
+};
+
+// State an operation reads or writes besides ip, for analyses that must
+// not depend on the encoding (see i960_op_info::uses)
+const uint16_t I960_USE_SRC1      = 0x0001; // Reads src1
+const uint16_t I960_USE_SRC2      = 0x0002; // Reads src2
+const uint16_t I960_USE_DST_IN    = 0x0004; // Reads the dst register group
+const uint16_t I960_USE_DST_OUT   = 0x0008; // Writes the dst register group
+const uint16_t I960_USE_ZF_IN     = 0x0010; // Reads the legacy zero flag
+const uint16_t I960_USE_ZF_OUT    = 0x0020; // Writes the legacy zero flag
+const uint16_t I960_USE_CC_IN     = 0x0040; // Reads the condition code
+const uint16_t I960_USE_CC_OUT    = 0x0080; // Writes the condition code
+const uint16_t I960_USE_STORE     = 0x0100; // Writes memory
+const uint16_t I960_USE_SIDE      = 0x0200; // Anything else: frames, control registers, halting
+const uint16_t I960_USE_WIDE_SRC1 = 0x0400; // src1 is a register group like dst
+const uint16_t I960_USE_WIDE_SRC2 = 0x0800; // src2 is a register pair
+const uint16_t I960_USE_MEMORY    = 0x1000; // Load or store at a computed address: adds its wait states at run time
+
+// Static description of an operation
+struct i960_op_info {
+    const char* name;  // Mnemonic, for traces and reports
+    uint8_t cycles;    // Base cycle cost
+    uint8_t regs;      // Registers in the dst group (movl, ldq, emul...)
+    uint16_t uses;     // I960_USE_* flags
+};
+
+// Per-operation table, indexed by i960_op. Register operations issue in one
+// cycle; multiply, divide, calls and returns use approximate i960KB
+// microcoded timings. Loads and stores add memory_access_cycles().
+constexpr uint16_t I960_ALU = I960_USE_SRC1 | I960_USE_SRC2 | I960_USE_DST_OUT;
+constexpr uint16_t I960_CMP = I960_USE_SRC1 | I960_USE_SRC2 | I960_USE_CC_OUT;
+constexpr uint16_t I960_LOAD = I960_USE_SRC1 | I960_USE_SRC2 | I960_USE_DST_OUT | I960_USE_MEMORY;
+constexpr uint16_t I960_STORE = I960_USE_SRC1 | I960_USE_SRC2 | I960_USE_DST_IN | I960_USE_STORE | I960_USE_MEMORY;
+
+constexpr i960_op_info I960_OP_INFO[] = {
+    {"undefined", 1, 1, I960_USE_SIDE},
+    {"skip", 1, 1, 0},
+    {"unknown", 1, 1, 0},
+    {"halt", 1, 1, I960_USE_SIDE},
+    {"ld_const", 1, 1, I960_USE_DST_OUT},
+    {"add_reg", 1, 1, I960_ALU | I960_USE_ZF_OUT},
+    {"sub_reg", 1, 1, I960_ALU | I960_USE_ZF_OUT},
+    {"mul_reg", 5, 1, I960_ALU | I960_USE_ZF_OUT},
+    {"div_reg", 35, 1, I960_ALU | I960_USE_ZF_OUT},
+    {"and_reg", 1, 1, I960_ALU | I960_USE_ZF_OUT},
+    {"or_reg", 1, 1, I960_ALU | I960_USE_ZF_OUT},
+    {"xor_reg", 1, 1, I960_ALU | I960_USE_ZF_OUT},
+    {"not_reg", 1, 1, I960_USE_SRC1 | I960_USE_DST_OUT | I960_USE_ZF_OUT},
+    {"ld_abs", 1, 1, I960_USE_DST_OUT},
+    {"st_abs", 1, 1, I960_USE_SRC1 | I960_USE_STORE},
+    {"ld_byte", 1, 1, I960_USE_DST_OUT},
+    {"st_byte", 1, 1, I960_USE_SRC1 | I960_USE_STORE},
+    {"cmp_reg", 1, 1, I960_USE_SRC1 | I960_USE_SRC2 | I960_USE_ZF_OUT},
+    {"beq", 1, 1, I960_USE_ZF_IN},
+    {"bne", 1, 1, I960_USE_ZF_IN},
+    {"jmp", 1, 1, 0},
+
+    {"nop", 1, 1, 0},
+    {"notbit", 1, 1, I960_ALU},
+    {"and", 1, 1, I960_ALU},
+    {"andnot", 1, 1, I960_ALU},
+    {"setbit", 1, 1, I960_ALU},
+    {"notand", 1, 1, I960_ALU},
+    {"xor", 1, 1, I960_ALU},
+    {"or", 1, 1, I960_ALU},
+    {"nor", 1, 1, I960_ALU},
+    {"xnor", 1, 1, I960_ALU},
+    {"not", 1, 1, I960_USE_SRC1 | I960_USE_DST_OUT},
+    {"ornot", 1, 1, I960_ALU},
+    {"clrbit", 1, 1, I960_ALU},
+    {"notor", 1, 1, I960_ALU},
+    {"nand", 1, 1, I960_ALU},
+    {"alterbit", 1, 1, I960_ALU | I960_USE_CC_IN},
+    {"addo", 1, 1, I960_ALU},
+    {"addi", 1, 1, I960_ALU},
+    {"subo", 1, 1, I960_ALU},
+    {"subi", 1, 1, I960_ALU},
+    {"shro", 1, 1, I960_ALU},
+    {"shrdi", 1, 1, I960_ALU},
+    {"shri", 1, 1, I960_ALU},
+    {"shlo", 1, 1, I960_ALU},
+    {"rotate", 1, 1, I960_ALU},
+    {"shli", 1, 1, I960_ALU},
+    {"cmpo", 1, 1, I960_CMP},
+    {"cmpi", 1, 1, I960_CMP},
+    {"concmpo", 1, 1, I960_CMP | I960_USE_CC_IN},
+    {"concmpi", 1, 1, I960_CMP | I960_USE_CC_IN},
+    {"cmpinco", 1, 1, I960_CMP | I960_USE_DST_OUT},
+    {"cmpinci", 1, 1, I960_CMP | I960_USE_DST_OUT},
+    {"cmpdeco", 1, 1, I960_CMP | I960_USE_DST_OUT},
+    {"cmpdeci", 1, 1, I960_CMP | I960_USE_DST_OUT},
+    {"scanbyte", 1, 1, I960_CMP},
+    {"chkbit", 1, 1, I960_CMP},
+    {"addc", 1, 1, I960_ALU | I960_USE_CC_IN | I960_USE_CC_OUT},
+    {"subc", 1, 1, I960_ALU | I960_USE_CC_IN | I960_USE_CC_OUT},
+    {"mov", 1, 1, I960_USE_SRC1 | I960_USE_DST_OUT},
+    {"movl", 2, 2, I960_USE_SRC1 | I960_USE_WIDE_SRC1 | I960_USE_DST_OUT},
+    {"movt", 3, 3, I960_USE_SRC1 | I960_USE_WIDE_SRC1 | I960_USE_DST_OUT},
+    {"movq", 4, 4, I960_USE_SRC1 | I960_USE_WIDE_SRC1 | I960_USE_DST_OUT},
+    {"scanbit", 2, 1, I960_USE_SRC1 | I960_USE_DST_OUT | I960_USE_CC_OUT},
+    {"spanbit", 2, 1, I960_USE_SRC1 | I960_USE_DST_OUT | I960_USE_CC_OUT},
+    {"modac", 5, 1, I960_ALU | I960_USE_SIDE},
+    {"modify", 2, 1, I960_ALU | I960_USE_DST_IN},
+    {"extract", 2, 1, I960_ALU | I960_USE_DST_IN},
+    {"modtc", 5, 1, I960_ALU | I960_USE_SIDE},
+    {"modpc", 5, 1, I960_ALU | I960_USE_SIDE},
+    {"emul", 20, 2, I960_ALU},
+    {"ediv", 37, 2, I960_ALU | I960_USE_WIDE_SRC2},
+    {"mulo", 5, 1, I960_ALU},
+    {"remo", 35, 1, I960_ALU},
+    {"divo", 35, 1, I960_ALU},
+    {"muli", 5, 1, I960_ALU},
+    {"remi", 35, 1, I960_ALU},
+    {"modi", 35, 1, I960_ALU},
+    {"divi", 35, 1, I960_ALU},
+
+    {"b", 1, 1, 0},
+    {"call", 9, 1, I960_USE_SIDE | I960_USE_STORE},
+    {"ret", 7, 1, I960_USE_SIDE},
+    {"bal", 1, 1, I960_USE_DST_OUT},
+    {"bcc", 1, 1, I960_USE_CC_IN},
+
+    {"test", 1, 1, I960_USE_DST_OUT | I960_USE_CC_IN},
+    {"bbc", 1, 1, I960_CMP},
+    {"cmpob", 1, 1, I960_CMP},
+    {"bbs", 1, 1, I960_CMP},
+    {"cmpib", 1, 1, I960_CMP},
+
+    {"ldob", 1, 1, I960_LOAD},
+    {"stob", 1, 1, I960_STORE},
+    {"bx", 1, 1, I960_USE_SRC1 | I960_USE_SRC2},
+    {"balx", 1, 1, I960_USE_SRC1 | I960_USE_SRC2 | I960_USE_DST_OUT},
+    {"callx", 9, 1, I960_USE_SRC1 | I960_USE_SRC2 | I960_USE_SIDE | I960_USE_STORE},
+    {"ldos", 1, 1, I960_LOAD},
+    {"stos", 1, 1, I960_STORE},
+    {"lda", 1, 1, I960_USE_SRC1 | I960_USE_SRC2 | I960_USE_DST_OUT},
+    {"ld", 1, 1, I960_LOAD},
+    {"st", 1, 1, I960_STORE},
+    {"ldl", 2, 2, I960_LOAD},
+    {"stl", 2, 2, I960_STORE},
+    {"ldt", 3, 3, I960_LOAD},
+    {"stt", 3, 3, I960_STORE},
+    {"ldq", 4, 4, I960_LOAD},
+    {"stq", 4, 4, I960_STORE},
+    {"ldib", 1, 1, I960_LOAD},
+    {"stib", 1, 1, I960_STORE},
+    {"ldis", 1, 1, I960_LOAD},
+    {"stis", 1, 1, I960_STORE},
+
+    {"hle", 1, 1, I960_USE_SIDE | I960_USE_STORE},
+};
+static_assert(sizeof(I960_OP_INFO) / sizeof(I960_OP_INFO[0]) == I960_OP_COUNT,
+              "I960_OP_INFO must cover every i960_op");
+
+// Extra cycles when a branch is taken (pipeline refill)
+const uint32_t I960_TAKEN_BRANCH_CYCLES = 2;
+
+// Decoded instruction flags
+const uint8_t I960_INSN_BRANCH = 0x01; // May transfer control somewhere other than ip + length
+const uint8_t I960_INSN_STOP   = 0x02; // Halts the CPU or does not advance ip
+const uint8_t I960_INSN_INDIRECT = 0x04; // Branch target computed at run time (imm is not the target)
+
+// A fully decoded instruction: everything i960_step needs to execute it
+// without touching the instruction bytes in memory again.
+struct i960_decoded {
+    uint32_t ip;           // Tag: address this entry was decoded from
+    uint32_t generation;   // Bus code generation at decode time (0 = empty slot)
+    i960_handler handler;  // Opcode handler
+    uint32_t imm;          // Immediate value, memory address/displacement or branch target
+    uint8_t opcode;        // Raw opcode byte
+    i960_op op;            // Decoded operation
+    uint8_t length;        // Instruction length in bytes
+    uint8_t flags;         // I960_INSN_* flags
+    uint8_t dst;           // Destination register index (already range-checked)
+    uint8_t src1;          // First source register (or literal slot); MEM: abase
+    uint8_t src2;          // Second source register (or literal slot); MEM: index
+    uint8_t cycles;        // Cost when not a taken branch, wait states of immediate addresses included
+    uint8_t aux;           // Branch condition mask (bcc, test, cmpob/cmpib) or MEM index scale
+};
+
+// Direct-mapped cache of decoded instructions, indexed by the low IP bits.
+// Must stay a power of two.
+const uint32_t I960_DECODE_CACHE_SIZE = 16384;
+
+struct i960_decode_cache {
+    i960_decoded entries[I960_DECODE_CACHE_SIZE];
+};
+
+// Decodes the instruction at ip into insn, in the CPU's instruction set,
+// and marks its code page(s) on the bus
+void i960_decode(i960_cpu* cpu, uint32_t ip, i960_decoded* insn);
+
+// Decodes one i960 KB/CA instruction (REG, COBR, CTRL or MEM format) at ip.
+// Fills every field except generation; i960_decode does the bookkeeping.
+void i960_decode_kb(i960_cpu* cpu, uint32_t ip, i960_decoded* insn);
+
+// Returns the mnemonic of an operation (for traces and reports)
+const char* i960_op_name(i960_op op);
+
+// Returns the assembler name of a register index ("r3", "g15", "lit 7")
+const char* i960_register_name(uint8_t index);
+
+// Returns the cached decode for ip, decoding it first on a miss
+const i960_decoded* i960_lookup(i960_cpu* cpu, uint32_t ip);
+
+#endif // I960_DECODE_H
@@ -0,0 +1,66 @@
+#ifndef I960_FUSE_H
+#define I960_FUSE_H
+
+#include <cstdint>
+#include "i960_decode.h"
+
+struct i960_block;
+
+// Superinstructions for the threaded engine.
+// When a block is translated, adjacent instruction pairs listed in the
+// fusion tables (compare then branch, load then compare, decrement then
+// branch...) are dispatched through one handler instead of two. A fused
+// handler runs the two original handlers back to back on their own decoded
+// instructions (insn and insn + 1), inlined into one function, so results,
+// traces and cycle counts are exactly those of the unfused pair.
+//
+// The pair statistics mode counts which adjacent operations actually run
+// inside translated blocks, so the tables can be tuned on a real ROM.
+
+// Runs First on insn and Second on the instruction after it
+template <i960_handler First, i960_handler Second>
+void i960_fused(i960_cpu* cpu, const i960_decoded* insn) {
+    First(cpu, insn);
+    Second(cpu, insn + 1);
+}
+
+// One fusable pair, matched on the decoded handlers
+struct i960_fusion {
+    i960_handler first;
+    i960_handler second;
+    i960_handler fused;
+};
+
+// Fusion tables of each instruction set (defined next to their handlers)
+const i960_fusion* i960_legacy_fusions(uint32_t* count);
+const i960_fusion* i960_kb_fusions(uint32_t* count);
+
+// Returns the handler running first and first + 1 together, or nullptr
+// if the pair is not in a fusion table
+i960_handler i960_fuse_pair(const i960_decoded* first);
+
+// One dispatch of threaded code: a handler and the first decoded
+// instruction it executes (two for a fused handler)
+struct i960_thread_op {
+    i960_handler handler;
+    const i960_decoded* insn;
+};
+
+// Executions of adjacent operation pairs inside translated blocks
+struct i960_pair_stats {
+    uint64_t counts[I960_OP_COUNT][I960_OP_COUNT];
+    bool fused[I960_OP_COUNT][I960_OP_COUNT];  // Pair was dispatched through a superinstruction
+    uint64_t pairs;                            // Total of counts
+    uint64_t fused_pairs;                      // Part of pairs that ran fused
+};
+
+i960_pair_stats* i960_pair_stats_create();
+void i960_pair_stats_destroy(i960_pair_stats* stats);
+
+// Counts the pairs of a block about to run repeat times
+void i960_pair_stats_record(i960_pair_stats* stats, const i960_block* block, uint64_t repeat = 1);
+
+// Writes the most frequent pairs, hottest first
+bool i960_pair_stats_write(const i960_pair_stats* stats, const char* path, uint32_t top = 50);
+
+#endif // I960_FUSE_H
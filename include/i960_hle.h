@@ -0,0 +1,88 @@
+#ifndef I960_HLE_H
+#define I960_HLE_H
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include "memory.h"
+
+struct i960_cpu;
+
+// High-level emulation of ROM library routines.
+// Model 2 program ROMs carry hand-written memcpy, memset and checksum loops
+// that burn many emulated cycles one byte or word at a time. A hook names
+// such a routine by the ROM it lives in and its entry address, and replaces
+// it with a native implementation working directly on MemoryBus::ram.
+//
+// When the KB decoder reaches a hooked entry it emits one "hle" operation
+// instead of the routine's first instruction. Running it calls the native
+// routine (arguments in g0..., result in g0, as in the i960 C calling
+// convention), charges the cycles the guest loop would have taken and
+// returns to the caller the way the routine does (bx (g14) after bal, or
+// ret after call). Scratch registers other than g0 are left untouched,
+// which callers cannot rely on either way.
+//
+// Hooks are registered per ROM and only become active once attached to a
+// CPU running that ROM, so addresses from one ROM never patch another.
+
+// ROMs are identified by the CRC-32 of the first 512KB of the address
+// space: the main program ROM (epr-*) as loaded at address 0, which is
+// the same CRC ROM set listings give for that file.
+const uint32_t I960_HLE_ROM_HASH_SIZE = 0x80000;
+
+// How a replaced routine returns to its caller
+enum i960_hle_return {
+    I960_HLE_RETURN_BX,  // Leaf routine reached with bal/balx: bx (g14)
+    I960_HLE_RETURN_RET, // Routine reached with call/callx: ret
+};
+
+// Native routine: does the work of the guest routine on cpu's registers
+// and bus, and returns the cycles its guest version would have spent
+// beyond its first instruction and return branch
+typedef uint64_t (*i960_hle_routine)(i960_cpu* cpu);
+
+struct i960_hle_hook {
+    uint32_t rom_hash;       // ROM the entry address belongs to
+    uint32_t entry;          // Guest address of the routine's first instruction
+    i960_hle_return ret;     // How the routine returns
+    i960_hle_routine routine;
+    const char* name;        // Routine name, for reports
+    uint64_t calls;          // Times the hook replaced the routine
+};
+
+struct i960_hle {
+    std::vector<i960_hle_hook> hooks;            // Every registered hook
+    std::unordered_map<uint32_t, size_t> active; // Hooks of the attached ROM: entry address -> index into hooks
+    uint32_t rom_hash;                           // ROM the active hooks were selected for
+    uint64_t calls;                              // Routine calls replaced so far
+    uint64_t cycles;                             // Guest cycles charged for them
+};
+
+i960_hle* i960_hle_create();
+void i960_hle_destroy(i960_hle* hle);
+
+// Registers a hook for a native routine ("memcpy", "memset",
+// "checksum32"); returns false if the routine name is unknown
+bool i960_hle_register(i960_hle* hle, uint32_t rom_hash, uint32_t entry, const char* routine, i960_hle_return ret);
+
+// Registers the hooks listed in a text file, one per line:
+//   <rom crc32> <entry address> <routine> <bal|call>
+// with hexadecimal numbers; '#' starts a comment. Returns false if the
+// file cannot be read or a line is malformed.
+bool i960_hle_load(i960_hle* hle, const char* path);
+
+// CRC-32 identifying the ROM loaded on the bus (see I960_HLE_ROM_HASH_SIZE)
+uint32_t i960_hle_rom_hash(const MemoryBus* bus);
+
+// Activates the hooks registered for rom_hash and makes cpu use them,
+// dropping everything decoded so far. Returns the number of active hooks.
+uint32_t i960_hle_attach(i960_cpu* cpu, i960_hle* hle, uint32_t rom_hash);
+
+// Active hook at entry address ip, or nullptr (also when hle is nullptr)
+i960_hle_hook* i960_hle_lookup(i960_hle* hle, uint32_t ip);
+
+// Runs a hook's native routine and returns the cycles to charge on top of
+// the hle instruction itself. The caller performs the return.
+uint64_t i960_hle_invoke(i960_cpu* cpu, i960_hle_hook* hook);
+
+#endif // I960_HLE_H
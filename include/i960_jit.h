@@ -0,0 +1,58 @@
+#ifndef I960_JIT_H
+#define I960_JIT_H
+
+#include <cstdint>
+
+struct i960_cpu;
+struct i960_block;
+
+// x86-64 dynamic recompiler.
+// Basic blocks that the threaded engine has run I960_JIT_HOT_THRESHOLD
+// times are compiled to native code. Compiled code keeps the most used
+// guest registers in host registers for the length of the block and
+// accesses RAM directly, calling the memory bus only for MMIO, the last
+// bytes of RAM and stores to pages holding decoded code. Compilation stops
+// at the first instruction the JIT does not support; the rest of the block
+// runs through the interpreter handlers.
+//
+// Of the KB/CA instruction set, the core integer subset is compiled: addo,
+// subo, mulo, and, or, xor, mov, lda, cmpo, cmpob*, b, b* and ld, st, ldob,
+// stob. Their addresses are computed at run time, so those loads and
+// stores are single bus calls rather than inline RAM accesses.
+//
+// Available on x86-64 System V hosts (Linux, macOS). Elsewhere
+// i960_jit_available() returns false and the JIT engine is not offered.
+
+// Times a block runs through the threaded engine before it is compiled
+const uint32_t I960_JIT_HOT_THRESHOLD = 8;
+
+// Executable memory reserved for compiled blocks
+const uint32_t I960_JIT_CODE_SIZE = 16 * 1024 * 1024;
+
+// Compiled block: executes the block's leading instructions and returns how
+// many it executed. cpu->ip is left on the next instruction to run.
+typedef uint32_t (*i960_native_block)(i960_cpu* cpu);
+
+struct i960_jit;
+
+// True when native code generation is supported on this host
+bool i960_jit_available();
+
+i960_jit* i960_jit_create();
+void i960_jit_destroy(i960_jit* jit);
+
+// Discards all compiled code
+void i960_jit_reset(i960_jit* jit);
+
+// True once the code buffer ran out of space; the caller should flush
+// every translation and reset the JIT
+bool i960_jit_full(const i960_jit* jit);
+
+// Bytes of native code compiled since the last reset
+uint32_t i960_jit_code_used(const i960_jit* jit);
+
+// Compiles a translated block. Returns nullptr if the block starts with
+// an unsupported instruction or the code buffer is full.
+i960_native_block i960_jit_compile(i960_cpu* cpu, const i960_block* block);
+
+#endif // I960_JIT_H
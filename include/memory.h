@@ -2,15 +2,19 @@
 #define MEMORY_H
 
 #include <cstdint>
+#include <cstring>
 #include <string>
 #include <map>
+#include <type_traits>
 #include <vector>
 
 // Forward declaration to avoid circular dependency
 struct TGP;
+struct TraceBuffer;
 
-// Let's define a simple memory size for now. 16MB.
-const uint32_t MEMORY_SIZE = 64 * 1024 * 1024; // 64MB for Model 2 games
+// The RAM window: guest addresses [0, MEMORY_SIZE) are backed by bus->ram.
+// Board memory maps place their ROM and RAM regions inside it.
+const uint32_t MEMORY_SIZE = 64 * 1024 * 1024;
 
 // TGP registers are memory-mapped starting at this address
 const uint32_t TGP_BASE_ADDRESS = 0xC0000000;
@@ -21,6 +25,66 @@ const uint32_t INPUT_BASE_ADDRESS = 0xD0000000;
 // Audio registers are memory-mapped starting at this address
 const uint32_t AUDIO_BASE_ADDRESS = 0xE0000000;
 
+// Wait states added to a CPU access, by region
+const uint32_t MEMORY_RAM_ACCESS_CYCLES = 2;   // Work RAM / ROM
+const uint32_t MEMORY_MMIO_ACCESS_CYCLES = 6;  // Device registers (TGP, inputs, audio)
+
+// Cycles a CPU load or store to address costs on top of the instruction itself
+inline uint32_t memory_access_cycles(uint32_t address) {
+    return address < MEMORY_SIZE ? MEMORY_RAM_ACCESS_CYCLES : MEMORY_MMIO_ACCESS_CYCLES;
+}
+
+// Granularity at which the bus tracks which pages hold decoded CPU code
+const uint32_t CODE_PAGE_SHIFT = 12; // 4KB pages
+const uint32_t CODE_PAGE_COUNT = MEMORY_SIZE >> CODE_PAGE_SHIFT;
+
+// The dirty bitmap has one bit per code page (see memory_take_dirty_pages)
+const uint32_t MEMORY_DIRTY_WORDS = CODE_PAGE_COUNT / 64;
+
+// Granularity of the bus page table: every guest address decodes through
+// the entry of its 64KB page
+const uint32_t MEMORY_PAGE_SHIFT = 16;
+const uint32_t MEMORY_PAGE_SIZE = 1u << MEMORY_PAGE_SHIFT;
+const uint32_t MEMORY_PAGE_COUNT = 1u << (32 - MEMORY_PAGE_SHIFT); // Covers the 4GB guest space
+
+// A memory-mapped device: the bus decodes [base, base + size) to it and
+// calls its handlers with offsets from base. Missing handlers read 0 and
+// ignore writes, so a device only provides the access widths it decodes.
+// Whole pages of the range can instead be backed by host memory (direct),
+// which the bus then accesses like RAM without calling the device.
+struct MmioDevice {
+    const char* name;
+    uint32_t base;   // Must be MEMORY_PAGE_SIZE aligned
+    uint32_t size;   // Bytes of register space; the rest of the last page reads 0
+    void* context;   // Passed to every handler (the device's own state)
+    uint32_t (*read32)(void* context, uint32_t offset);
+    void (*write32)(void* context, uint32_t offset, uint32_t value);
+    uint8_t (*read8)(void* context, uint32_t offset);
+    void (*write8)(void* context, uint32_t offset, uint8_t value);
+
+    // Optional direct region: [direct_offset, direct_offset + direct_size)
+    // of the device is the host memory at direct (page aligned)
+    uint8_t* direct;
+    uint32_t direct_offset;
+    uint32_t direct_size;
+};
+
+// Devices one bus can hold
+const uint32_t MEMORY_MAX_DEVICES = 16;
+
+// One page table entry: plain memory behind a host pointer, a device, or
+// neither (unmapped: reads 0, writes ignored)
+struct MemoryPage {
+    uint8_t* host;             // Host memory backing the page, or nullptr
+    const MmioDevice* device;  // Device decoding the page when host is nullptr, or nullptr
+    bool watched;              // Overlaps a watchpoint: every access takes the slow path
+    uint8_t* watched_host;     // Host memory of a watched page (host is nullptr while it is watched)
+    bool read_only;            // ROM: reads come from host, writes are dropped
+};
+
+struct MemoryWatchLog;
+struct MemoryStats;
+
 // ROM configuration structure
 struct RomFile {
     const char* filename;
@@ -28,17 +92,67 @@ struct RomFile {
     uint32_t expected_size; // 0 = don't check size
 };
 
+// --- Board memory maps ---
+// A Model 2 board decodes a few right-sized regions, not one flat array.
+// Board variants differ in region sizes. All regions sit inside the RAM
+// window [0, MEMORY_SIZE), each backed by bus->ram at its own address, so
+// code tracking, dirty pages, fastmem and the JIT cover them as before.
+// Once a map is applied, the rest of the window is unmapped: stray
+// accesses read 0 and their writes are dropped, so nothing outside the
+// regions is ever committed. ROM regions drop writes too. Without a map (as
+// after memory_init), the whole window is RAM.
+
+enum BoardRegionKind : uint32_t {
+    BOARD_PROGRAM_ROM,
+    BOARD_DATA_ROM,
+    BOARD_WORK_RAM,
+    BOARD_POLYGON_RAM,
+    BOARD_TEXTURE_RAM,
+    BOARD_REGION_COUNT,
+};
+
+struct BoardRegion {
+    const char* name;
+    uint32_t base;   // Multiple of MEMORY_PAGE_SIZE
+    uint32_t size;   // Multiple of MEMORY_PAGE_SIZE
+    bool read_only;
+};
+
+struct BoardMap {
+    const char* name;
+    BoardRegion regions[BOARD_REGION_COUNT]; // Indexed by BoardRegionKind
+};
+
 struct GameConfig {
     const char* name;
-    RomFile* roms;
+    const RomFile* roms;
     int num_roms;
+    const BoardMap* board;
 };
 
 struct MemoryBus {
     uint8_t* ram;
     TGP* tgp;  // Pointer to TGP for memory-mapped access
-    void* input_state;  // Pointer to input state for memory-mapped access
-    void* audio_state;  // Pointer to audio state for memory-mapped access
+
+    // Registered devices; page table entries point into this table
+    MmioDevice devices[MEMORY_MAX_DEVICES];
+    uint32_t device_count;
+
+    // Self-modifying code detection for the CPU's decoded instruction cache
+    uint8_t* code_pages;       // One flag per code page: set once the CPU decoded from it
+    uint32_t code_generation;  // Bumped whenever a flagged code page is written
+    uint32_t map_generation;   // Bumped whenever the host memory behind an address changes
+    uint64_t* dirty_pages;     // MEMORY_DIRTY_WORDS words, one bit per code page written since the last snapshot
+
+    MemoryPage* pages;         // MEMORY_PAGE_COUNT entries decoding the whole guest space
+    uint8_t* fastmem;          // Host view of the whole guest space, or nullptr (see memory_enable_fastmem)
+
+    TraceBuffer* trace;  // Execution trace shared by the CPU and devices (not owned, may be null)
+
+    MemoryWatchLog* watch;   // Watchpoints and their hits (owned), or nullptr until one is set
+    const uint32_t* cpu_ip;  // IP of the CPU driving the bus, for attributing accesses (may be null)
+    MemoryStats* stats;      // Access counters (owned), or nullptr until memory_enable_stats
+    const BoardMap* board;   // Applied memory map, or nullptr when the window is flat RAM
 };
 
 // Allocates and initializes the memory bus
@@ -47,6 +161,11 @@ void memory_init(MemoryBus* bus);
 // Frees the allocated memory
 void memory_destroy(MemoryBus* bus);
 
+// Bytes of guest RAM the host actually holds. RAM is allocated untouched
+// and zero-filled by the OS on first write, so this only counts pages
+// written so far (all of RAM where the host cannot tell).
+uint64_t memory_resident_bytes(const MemoryBus* bus);
+
 // Read a single byte from a given address
 uint8_t memory_read_byte(MemoryBus* bus, uint32_t address);
 
@@ -59,14 +178,401 @@ uint32_t memory_read_dword(MemoryBus* bus, uint32_t address);
 // Write a 32-bit word to a given address
 void memory_write_dword(MemoryBus* bus, uint32_t address, uint32_t value);
 
-// Connect TGP to memory bus for memory-mapped register access
-void memory_connect_tgp(MemoryBus* bus, TGP* tgp);
+// Accesses that bus_read/bus_write cannot complete with one host load or
+// store: device registers, unmapped space and values straddling two pages.
+// size is 1, 2, 4 or 8; the value is zero-extended.
+uint64_t memory_read_slow(MemoryBus* bus, uint32_t address, uint32_t size);
+void memory_write_slow(MemoryBus* bus, uint32_t address, uint32_t size, uint64_t value);
+
+// Maps [base, base + size) to the host memory at host. base and size must
+// be multiples of MEMORY_PAGE_SIZE. Decoded code is only tracked in the
+// primary RAM range (below MEMORY_SIZE), so code must not run from mirrors.
+void memory_map_host(MemoryBus* bus, uint32_t base, uint32_t size, uint8_t* host);
+
+// Maps [base, base + size) read-only to host, which must stay valid for the
+// life of the bus: writes there are dropped, as on the real ROM board.
+// Same alignment rules as memory_map_host.
+void memory_map_rom(MemoryBus* bus, uint32_t base, uint32_t size, const uint8_t* host);
+
+// Loads a ROM image at offset. With a board applied, the image must lie in
+// one of its ROM regions and is read-only: page-aligned images are mapped
+// from a copy shared by every instance (and every process) loading the
+// same bytes, so running several boards costs the ROM once, and others are
+// copied into read-only RAM pages. Without a board the image is copied
+// into writable RAM, aligned or not. Returns false when the image does not
+// fit.
+bool memory_load_rom(MemoryBus* bus, uint32_t offset, const uint8_t* data, uint32_t size);
+
+// The board variant called name ("model2", "model2a", "model2b", "model2c"),
+// or nullptr
+const BoardMap* memory_find_board(const char* name);
+
+// Remaps the RAM window to board's regions (see Board memory maps). Their
+// contents are kept, since each region stays at its own place in
+// bus->ram. Returns false, leaving the bus as it was, if a region is
+// misaligned or outside the window.
+bool memory_apply_board(MemoryBus* bus, const BoardMap* board);
+
+// The region of the applied board holding address, or nullptr
+const BoardRegion* memory_board_region(const MemoryBus* bus, uint32_t address);
+
+// Registers a device (copied into bus->devices) and maps its pages.
+// Returns the bus's copy, or nullptr when the device table is full.
+const MmioDevice* memory_register_device(MemoryBus* bus, const MmioDevice* device);
+
+// --- Fastmem ---
+// An optional host view of the 4GB guest space in which RAM sits at its
+// guest address and everything else (device registers, unmapped space) is
+// inaccessible. Loads and stores through the memory_fast_* accessors are a
+// single host instruction; when one touches an inaccessible page, a SIGSEGV
+// handler completes it through the page table (bus_read etc.) and
+// resumes after it. Stores to pages holding decoded code, and the first
+// store to each page after a dirty snapshot, fault as well and drop the
+// decodes or mark the page before retrying. Only available on x86-64 Linux; the
+// accessors fall back to the bus everywhere else.
+#if defined(__linux__) && defined(__x86_64__) && defined(__GNUC__)
+#define MEMORY_FASTMEM_SUPPORTED 1
+#else
+#define MEMORY_FASTMEM_SUPPORTED 0
+#endif
+
+// Creates the fastmem view, moving RAM into memory it shares with the
+// view (bus->ram changes). Returns false, leaving the bus as it was, when
+// the host does not support it.
+bool memory_enable_fastmem(MemoryBus* bus);
+
+#if MEMORY_FASTMEM_SUPPORTED
+// The fault handler recognizes these exact instructions (fixed registers:
+// rsi = view, rdi = guest address, eax = value), so they are written out
+// rather than left to the compiler. Only valid while bus->fastmem is set.
+inline uint32_t memory_fast_read_dword(const MemoryBus* bus, uint32_t address) {
+    uint32_t value;
+    asm volatile("movl (%%rsi,%%rdi), %%eax" : "=a"(value) : "S"(bus->fastmem), "D"((uint64_t)address) : "memory");
+    return value;
+}
+
+inline uint8_t memory_fast_read_byte(const MemoryBus* bus, uint32_t address) {
+    uint32_t value;
+    asm volatile("movzbl (%%rsi,%%rdi), %%eax" : "=a"(value) : "S"(bus->fastmem), "D"((uint64_t)address) : "memory");
+    return (uint8_t)value;
+}
+
+inline void memory_fast_write_dword(MemoryBus* bus, uint32_t address, uint32_t value) {
+    asm volatile("movl %%eax, (%%rsi,%%rdi)" : : "a"(value), "S"(bus->fastmem), "D"((uint64_t)address) : "memory");
+}
+
+inline void memory_fast_write_byte(MemoryBus* bus, uint32_t address, uint8_t value) {
+    asm volatile("movb %%al, (%%rsi,%%rdi)" : : "a"((uint32_t)value), "S"(bus->fastmem), "D"((uint64_t)address) : "memory");
+}
+
+inline uint16_t memory_fast_read_half(const MemoryBus* bus, uint32_t address) {
+    uint32_t value;
+    asm volatile("movzwl (%%rsi,%%rdi), %%eax" : "=a"(value) : "S"(bus->fastmem), "D"((uint64_t)address) : "memory");
+    return (uint16_t)value;
+}
+
+inline void memory_fast_write_half(MemoryBus* bus, uint32_t address, uint16_t value) {
+    asm volatile("movw %%ax, (%%rsi,%%rdi)" : : "a"((uint32_t)value), "S"(bus->fastmem), "D"((uint64_t)address) : "memory");
+}
+#else
+inline uint32_t memory_fast_read_dword(MemoryBus* bus, uint32_t address) { return memory_read_dword(bus, address); }
+inline uint8_t memory_fast_read_byte(MemoryBus* bus, uint32_t address) { return memory_read_byte(bus, address); }
+inline void memory_fast_write_dword(MemoryBus* bus, uint32_t address, uint32_t value) { memory_write_dword(bus, address, value); }
+inline void memory_fast_write_byte(MemoryBus* bus, uint32_t address, uint8_t value) { memory_write_byte(bus, address, value); }
+inline uint16_t memory_fast_read_half(MemoryBus* bus, uint32_t address) { return (uint16_t)memory_read_slow(bus, address, 2); }
+inline void memory_fast_write_half(MemoryBus* bus, uint32_t address, uint16_t value) { memory_write_slow(bus, address, 2, value); }
+#endif
+
+// Page table entry decoding address
+inline const MemoryPage* memory_page(const MemoryBus* bus, uint32_t address) {
+    return &bus->pages[address >> MEMORY_PAGE_SHIFT];
+}
+
+// Host pointer to the byte at address when it is plain memory that can be
+// read directly, otherwise nullptr (device registers, unmapped space).
+// Watched memory included: this serves instruction fetch, which watchpoints
+// ignore. Valid until bus->map_generation changes.
+uint8_t* memory_host_pointer(MemoryBus* bus, uint32_t address);
 
-// Connect input system to memory bus for memory-mapped register access
-void memory_connect_input(MemoryBus* bus, void* input_state);
+// Converts between guest (little-endian) and host byte order
+template <typename T>
+inline T memory_swap_le(T value) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    if (sizeof(T) == 2) return (T)__builtin_bswap16((uint16_t)value);
+    if (sizeof(T) == 4) return (T)__builtin_bswap32((uint32_t)value);
+    if (sizeof(T) == 8) return (T)__builtin_bswap64((uint64_t)value);
+#endif
+    return value;
+}
 
-// Connect audio system to memory bus for memory-mapped register access
-void memory_connect_audio(MemoryBus* bus, void* audio_state);
+// Little-endian load and store of host memory, safe at any alignment
+template <typename T>
+inline T memory_load_le(const uint8_t* p) {
+    T value;
+    memcpy(&value, p, sizeof(value));
+    return memory_swap_le(value);
+}
+
+template <typename T>
+inline void memory_store_le(uint8_t* p, T value) {
+    value = memory_swap_le(value);
+    memcpy(p, &value, sizeof(value));
+}
+
+inline uint32_t memory_load_le32(const uint8_t* p) {
+    return memory_load_le<uint32_t>(p);
+}
+
+// Whether [address, address + length) is plain RAM: below MEMORY_SIZE and
+// writably mapped to bus->ram at the same offset (not ROM, a device or a
+// watched page). Such a range can be read and written through bus->ram
+// directly.
+inline bool memory_is_ram(const MemoryBus* bus, uint32_t address, uint32_t length) {
+    if (length == 0 || address >= MEMORY_SIZE || length > MEMORY_SIZE - address) {
+        return false;
+    }
+    for (uint32_t page = address >> MEMORY_PAGE_SHIFT; page <= (address + length - 1) >> MEMORY_PAGE_SHIFT; ++page) {
+        if (bus->pages[page].host != bus->ram + ((size_t)page << MEMORY_PAGE_SHIFT) || bus->pages[page].read_only) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Host pointer to [address, address + length) when the whole range can be
+// read in place: RAM or ROM pages (not a device or a watched page) that
+// follow on from each other on the host. nullptr otherwise. Valid until
+// bus->map_generation changes.
+inline const uint8_t* memory_read_pointer(const MemoryBus* bus, uint32_t address, uint32_t length) {
+    const uint8_t* start = memory_page(bus, address)->host;
+    if (length == 0 || start == nullptr || length - 1 > 0xFFFFFFFFu - address) {
+        return nullptr;
+    }
+    for (uint32_t page = address >> MEMORY_PAGE_SHIFT; page < (address + length - 1) >> MEMORY_PAGE_SHIFT; ++page) {
+        if (bus->pages[page + 1].host != bus->pages[page].host + MEMORY_PAGE_SIZE) {
+            return nullptr;
+        }
+    }
+    return start + (address & (MEMORY_PAGE_SIZE - 1));
+}
+
+// Marks the code page of a RAM byte about to be written dirty and drops
+// decoded instructions on it
+inline void memory_note_write(MemoryBus* bus, uint32_t address) {
+    if (address < MEMORY_SIZE) {
+        uint32_t page = address >> CODE_PAGE_SHIFT;
+        bus->dirty_pages[page >> 6] |= 1ull << (page & 63);
+        if (bus->code_pages[page]) {
+            // Writing over decoded code: drop every cached decode
+            bus->code_pages[page] = 0;
+            bus->code_generation++;
+        }
+    }
+}
+
+// --- Bus statistics ---
+// Optional counters of guest memory traffic: accesses and bytes per region
+// (RAM, ROM, unmapped space and each registered device), a histogram of
+// device register offsets, and the bytes moved in each frame. Counting is
+// compiled in when PIXEL_BUS_STATS (set from CMake) is non-zero and runs
+// once memory_enable_stats is called; otherwise each counting point is a
+// null check, or nothing at all. While counting, the JIT and the KB fastmem
+// accessors leave their accesses to the bus so none go uncounted. HLE
+// routines count the bytes they move as one access.
+
+#ifndef PIXEL_BUS_STATS
+#define PIXEL_BUS_STATS 1
+#endif
+
+constexpr bool MEMORY_STATS_COMPILED = PIXEL_BUS_STATS != 0;
+
+// Regions counted; device i (in bus->devices) is MEMORY_REGION_DEVICE + i
+enum MemoryRegion : uint32_t {
+    MEMORY_REGION_RAM,       // Host-backed memory: RAM, its mirrors and device memory mapped directly
+    MEMORY_REGION_ROM,
+    MEMORY_REGION_UNMAPPED,
+    MEMORY_REGION_DEVICE,
+};
+const uint32_t MEMORY_REGION_COUNT = MEMORY_REGION_DEVICE + MEMORY_MAX_DEVICES;
+
+struct MemoryAccessCounts {
+    uint64_t reads;
+    uint64_t writes;
+    uint64_t bytes_read;
+    uint64_t bytes_written;
+};
+
+struct MemoryStats {
+    MemoryAccessCounts regions[MEMORY_REGION_COUNT];
+    std::map<uint64_t, MemoryAccessCounts> registers;  // Keyed by device index << 32 | register offset
+    uint64_t frame_bytes;                              // Moved so far in the current frame
+    std::vector<uint64_t> frames;                      // Moved in each finished frame
+};
+
+// Starts counting (a no-op if already counting). Returns false when this
+// build has no bus statistics.
+bool memory_enable_stats(MemoryBus* bus);
+
+// Counts one access of size bytes at address; see memory_stats_count
+void memory_stats_record(MemoryBus* bus, uint32_t address, uint32_t size, bool write);
+
+// Ends the current frame's byte count (called once per emulated frame)
+void memory_stats_end_frame(MemoryBus* bus);
+
+// Writes the region totals, the device registers hottest first (top of
+// them) and the per-frame byte counts as text
+bool memory_write_stats(const MemoryBus* bus, const char* path, uint32_t top = 50);
+
+inline bool memory_stats_active(const MemoryBus* bus) {
+    if constexpr (MEMORY_STATS_COMPILED) {
+        return bus->stats != nullptr;
+    } else {
+        return false;
+    }
+}
+
+inline void memory_stats_count(MemoryBus* bus, uint32_t address, uint32_t size, bool write) {
+    if (memory_stats_active(bus)) {
+        memory_stats_record(bus, address, size, write);
+    }
+}
+
+// --- Width-templated access ---
+// bus_read<T>/bus_write<T> access a 1, 2, 4 or 8 byte little-endian value.
+// A value inside one host-backed page is a single host load or store
+// inlined into the caller; everything else goes through the slow path.
+// memory_read_dword and friends are the out-of-line 8/32-bit instances.
+
+template <typename T>
+inline T bus_read(MemoryBus* bus, uint32_t address) {
+    static_assert(std::is_integral<T>::value && (sizeof(T) == 1 || sizeof(T) == 2 || sizeof(T) == 4 || sizeof(T) == 8),
+                  "bus_read takes an 8, 16, 32 or 64-bit integer");
+    const MemoryPage* page = memory_page(bus, address);
+    uint32_t offset = address & (MEMORY_PAGE_SIZE - 1);
+    if (page->host != nullptr && offset <= MEMORY_PAGE_SIZE - sizeof(T)) {
+        memory_stats_count(bus, address, sizeof(T), false);
+        return memory_load_le<T>(page->host + offset);
+    }
+    return (T)memory_read_slow(bus, address, sizeof(T));
+}
+
+template <typename T>
+inline void bus_write(MemoryBus* bus, uint32_t address, T value) {
+    static_assert(std::is_integral<T>::value && (sizeof(T) == 1 || sizeof(T) == 2 || sizeof(T) == 4 || sizeof(T) == 8),
+                  "bus_write takes an 8, 16, 32 or 64-bit integer");
+    const MemoryPage* page = memory_page(bus, address);
+    uint32_t offset = address & (MEMORY_PAGE_SIZE - 1);
+    if (page->host != nullptr && !page->read_only && offset <= MEMORY_PAGE_SIZE - sizeof(T)) {
+        memory_stats_count(bus, address, sizeof(T), true);
+        memory_note_write(bus, address);
+        if (sizeof(T) > 1) {
+            memory_note_write(bus, address + sizeof(T) - 1);
+        }
+        memory_store_le<T>(page->host + offset, value);
+        return;
+    }
+    memory_write_slow(bus, address, sizeof(T), (uint64_t)value);
+}
+
+// --- Spans ---
+// Bulk reads for devices fetching from guest memory (vertex lists,
+// matrices). A span over plain memory that is contiguous on the host is a
+// pointer straight into it; anything else (device registers, unmapped
+// space, ranges past the end of RAM or over mirrors) is copied through the
+// bus into the caller's scratch buffer. Either way the caller sees exactly
+// length bytes, in guest (little-endian) order.
+struct BusSpan {
+    const uint8_t* data;  // length bytes of guest memory
+    uint32_t length;
+    bool direct;          // data points into guest memory (valid until map_generation changes), not scratch
+};
+
+// Spans [address, address + length). scratch must hold length bytes and is
+// only written when the range cannot be read in place.
+BusSpan bus_span(MemoryBus* bus, uint32_t address, uint32_t length, uint8_t* scratch);
+
+// --- Watchpoints ---
+// A watchpoint logs every access of the chosen kinds overlapping its range.
+// Pages overlapping one are marked watched in the page table and lose their
+// host pointer, so their accesses leave the inlined fast path for the slow
+// path, which checks the watchpoints; every other page runs at full speed.
+// Fastmem makes watched RAM inaccessible in the view and the JIT leaves
+// accesses to watched pages to the handlers or calls the bus with cpu->ip
+// at the accessing instruction, so neither bypasses the check.
+// Instruction fetches and RAM written through bus->ram are not watched.
+
+const uint32_t MEMORY_WATCH_READ = 1;
+const uint32_t MEMORY_WATCH_WRITE = 2;
+const uint32_t MEMORY_MAX_WATCHPOINTS = 16;
+const uint32_t MEMORY_WATCH_LOG_SIZE = 256; // Hits kept; older ones are overwritten
+
+struct MemoryWatchpoint {
+    uint32_t address;
+    uint32_t length;
+    uint32_t kinds;  // MEMORY_WATCH_READ and/or MEMORY_WATCH_WRITE
+};
+
+struct MemoryWatchHit {
+    uint32_t ip;         // Guest IP of the accessing instruction (0 without a CPU)
+    uint32_t address;    // Start of the access, which may begin outside the watched range
+    uint32_t size;       // Access width in bytes
+    bool write;
+    uint64_t old_value;  // Before the access; for writes to device registers, 0
+    uint64_t new_value;  // Written, or for reads the value read
+};
+
+struct MemoryWatchLog {
+    MemoryWatchpoint points[MEMORY_MAX_WATCHPOINTS];
+    uint32_t point_count;
+    MemoryWatchHit hits[MEMORY_WATCH_LOG_SIZE];  // Ring buffer: hit n is at n % MEMORY_WATCH_LOG_SIZE
+    uint64_t hit_count;                          // Hits logged so far
+};
+
+// Watches [address, address + length) for the given kinds. Returns false
+// when every watchpoint is taken.
+bool memory_add_watchpoint(MemoryBus* bus, uint32_t address, uint32_t length, uint32_t kinds);
+
+// Removes every watchpoint, keeping the hits logged so far
+void memory_clear_watchpoints(MemoryBus* bus);
+
+// Copies up to max of the most recent hits to out, oldest first. Returns
+// how many were copied.
+uint32_t memory_watch_hits(const MemoryBus* bus, MemoryWatchHit* out, uint32_t max);
+
+// Parses "<address>[:<length>][:r|w|rw]" (numbers in C notation; 4 bytes
+// and rw by default) as given to --watch
+bool memory_parse_watchpoint(const char* text, MemoryWatchpoint* out);
+
+// Flag the code page holding address as containing decoded instructions
+void memory_mark_code(MemoryBus* bus, uint32_t address);
+
+// Invalidate decoded instructions overlapping [address, address + length)
+// and mark it dirty. Anything writing RAM through bus->ram rather than the
+// bus calls this first.
+void memory_invalidate_code(MemoryBus* bus, uint32_t address, uint32_t length);
+
+// --- Dirty pages ---
+// Every write to RAM sets the bit of its code page in bus->dirty_pages,
+// whichever way it arrives: the bus, fastmem stores (the view write-protects
+// clean pages and the first store to each faults), JIT-compiled stores and
+// ranges announced with memory_invalidate_code. Caches and incremental save
+// states take snapshots to learn which pages changed since their last one
+// without rescanning RAM. Writes through mirrors are not seen.
+
+// Copies the bitmap into out (MEMORY_DIRTY_WORDS words; bit i of word w is
+// code page 64 * w + i) and clears it, with no write landing in between.
+// Returns how many pages were dirty. Like every other bus call, it must
+// come from the thread driving the instance.
+uint32_t memory_take_dirty_pages(MemoryBus* bus, uint64_t* out);
+
+// Whether a snapshot from memory_take_dirty_pages has address's page dirty
+inline bool memory_dirty_page(const uint64_t* snapshot, uint32_t address) {
+    uint32_t page = address >> CODE_PAGE_SHIFT;
+    return address < MEMORY_SIZE && (snapshot[page >> 6] >> (page & 63) & 1) != 0;
+}
+
+// Registers the TGP's registers at TGP_BASE_ADDRESS
+void memory_connect_tgp(MemoryBus* bus, TGP* tgp);
 
 // Load a binary file into memory at a specific offset
 bool load_rom_from_file(MemoryBus* bus, const char* filepath, uint32_t offset);
@@ -0,0 +1,80 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <cstdint>
+#include <chrono>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "i960_decode.h"
+
+// Guest hot-spot profiler.
+// Samples the guest IP either every Nth executed instruction or whenever a
+// host timer period has elapsed, and keeps an IP histogram plus a folded
+// call stack per sample (routines are identified by their call target).
+// The CPU only calls in through cpu->profiler, so a CPU without a profiler
+// pays one predictable null check per instruction (per block in the block
+// engines). Block engines account for whole blocks at once; samples still
+// land on the exact instruction that was due.
+//
+// Both modes share one instruction countdown: in timer mode it only
+// controls how often the host clock is read.
+
+enum ProfileMode : uint8_t {
+    PROFILE_OFF,
+    PROFILE_INSTRUCTIONS, // Sample every `interval` instructions
+    PROFILE_TIMER,        // Sample when `interval` microseconds of host time have passed
+};
+
+// Instructions between host clock reads in timer mode
+const uint32_t PROFILE_CLOCK_CHECK = 256;
+
+// Deepest shadow call stack kept for folded stacks
+const uint32_t PROFILE_MAX_DEPTH = 256;
+
+struct Profiler {
+    ProfileMode mode;
+    uint32_t interval;          // Instructions or microseconds between samples
+    int64_t countdown;          // Instructions until the next sample (or clock read)
+    std::chrono::steady_clock::time_point next_tick; // Timer mode: next sample time
+    uint64_t samples;
+    std::unordered_map<uint32_t, uint64_t> ip_hits; // Samples per guest IP
+    std::map<std::string, uint64_t> stacks;          // Samples per folded call stack
+    std::vector<uint32_t> call_stack;                // Call targets of the active guest routines
+    std::string stack_key;      // call_stack folded as "guest;0x...;0x..."
+    uint32_t overflow_depth;    // Calls deeper than PROFILE_MAX_DEPTH not on call_stack
+};
+
+void profiler_init(Profiler* profiler, ProfileMode mode, uint32_t interval);
+void profiler_destroy(Profiler* profiler);
+
+// Parses "insn:<N>" or "timer:<microseconds>"; returns false if malformed
+bool profiler_parse(const char* spec, ProfileMode* mode, uint32_t* interval);
+
+// Records one sample at ip (or, in timer mode, checks the clock first)
+void profiler_sample(Profiler* profiler, uint32_t ip);
+
+// One instruction at ip is about to execute
+inline void profiler_step(Profiler* profiler, uint32_t ip) {
+    if (--profiler->countdown <= 0) {
+        profiler_sample(profiler, ip);
+    }
+}
+
+// The count instructions of ops are about to execute, repeat times over
+// (a translated block, or an idle loop being skipped)
+void profiler_block(Profiler* profiler, const i960_decoded* ops, uint32_t count, uint64_t repeat = 1);
+
+// Shadow call stack maintenance (call/callx and ret)
+void profiler_call(Profiler* profiler, uint32_t target);
+void profiler_return(Profiler* profiler);
+
+// Writes the IP histogram and per-routine totals, hottest first
+bool profiler_write_report(const Profiler* profiler, const char* path, uint32_t top = 50);
+
+// Writes one "frame;frame;frame count" line per distinct stack, the format
+// flame graph tools read
+bool profiler_write_folded(const Profiler* profiler, const char* path);
+
+#endif // PROFILER_H
@@ -0,0 +1,96 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <cstdint>
+#include <vector>
+
+// Execution tracing.
+// Trace points write fixed-size binary records into a ring buffer instead of
+// formatting text, so tracing every instruction stays cheap. The buffer is
+// saved to a file and turned into text offline (PixelModel2TraceDecode).
+//
+// A trace point is emitted only if its level is both compiled in
+// (PIXEL_TRACE_LEVEL, set from CMake) and enabled at runtime on the buffer.
+// Levels above PIXEL_TRACE_LEVEL compile to nothing.
+
+enum TraceLevel : uint8_t {
+    TRACE_OFF = 0,
+    TRACE_DEVICE = 1, // Device activity: TGP commands and register accesses
+    TRACE_CPU = 2,    // Every executed CPU instruction
+};
+
+#ifndef PIXEL_TRACE_LEVEL
+#define PIXEL_TRACE_LEVEL 2
+#endif
+
+// Highest level compiled into this build
+constexpr TraceLevel TRACE_COMPILED_LEVEL = (TraceLevel)PIXEL_TRACE_LEVEL;
+
+enum TraceEvent : uint8_t {
+    TRACE_EVENT_INSN,         // code = i960_op, arg = {register, opcode}, address = IP, value = {result, immediate}
+    TRACE_EVENT_TGP_COMMAND,  // code = command, arg[0] = 1 on matrix stack over/underflow, address = operand address (0 if none), value[0] = matrix stack pointer after the command
+    TRACE_EVENT_TGP_COMPLETE, // Pending TGP command retired by tgp_step
+    TRACE_EVENT_TGP_WRITE,    // address = register offset, value[0] = value written
+    TRACE_EVENT_TGP_READ,     // address = unknown register offset read
+};
+
+struct TraceRecord {
+    uint8_t event;      // TraceEvent
+    uint8_t code;       // Event-specific operation code
+    uint8_t arg[2];     // Small event-specific operands
+    uint32_t address;   // Guest IP or device register offset
+    uint32_t value[2];  // Event-specific values
+};
+
+// Records kept when no capacity is given (16MB)
+const uint32_t TRACE_DEFAULT_CAPACITY = 1u << 20;
+
+struct TraceBuffer {
+    TraceRecord* records; // Ring storage, capacity is a power of two
+    uint32_t mask;        // capacity - 1
+    uint64_t count;       // Records written since init (older ones are overwritten)
+    TraceLevel level;     // Runtime level
+};
+
+// Allocates the ring buffer; capacity is rounded up to a power of two
+void trace_init(TraceBuffer* trace, TraceLevel level, uint32_t capacity = TRACE_DEFAULT_CAPACITY);
+void trace_destroy(TraceBuffer* trace);
+
+// Parses "off", "device" or "cpu"; returns false if unknown
+bool trace_parse_level(const char* name, TraceLevel* level);
+
+// Writes the buffered records, oldest first, to a binary trace file
+bool trace_save(const TraceBuffer* trace, const char* path);
+
+// Reads a trace file written by trace_save. total receives the number of
+// records that were traced, which exceeds records->size() if the ring wrapped.
+bool trace_load(const char* path, std::vector<TraceRecord>* records, uint64_t* total);
+
+// True when trace points of level L are compiled in and enabled
+template <TraceLevel L>
+inline bool trace_enabled(const TraceBuffer* trace) {
+    if constexpr (L > TRACE_COMPILED_LEVEL) {
+        return false;
+    } else {
+        return trace != nullptr && trace->level >= L;
+    }
+}
+
+template <TraceLevel L>
+inline void trace_record(TraceBuffer* trace, TraceEvent event, uint8_t code, uint8_t arg0, uint8_t arg1,
+                         uint32_t address, uint32_t value0, uint32_t value1) {
+    if constexpr (L <= TRACE_COMPILED_LEVEL) {
+        if (trace_enabled<L>(trace)) {
+            TraceRecord& record = trace->records[trace->count++ & trace->mask];
+            record.event = event;
+            record.code = code;
+            record.arg[0] = arg0;
+            record.arg[1] = arg1;
+            record.address = address;
+            record.value[0] = value0;
+            record.value[1] = value1;
+        }
+    }
+}
+
+#endif // TRACE_H
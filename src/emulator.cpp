@@ -0,0 +1,238 @@
+#define _USE_MATH_DEFINES
+#include "emulator.h"
+#include "tgp.h"
+#include <algorithm>
+#include <cmath>
+
+// --- Input and Audio Registers ---
+// Decoded from the instance's own InputState and AudioState
+
+const uint32_t INPUT_REGISTER_SPACE = 0x100;
+const uint32_t AUDIO_REGISTER_SPACE = 0x200;
+
+static uint32_t input_read32(void *context, uint32_t offset)
+{
+    const InputState *input = static_cast<const InputState *>(context);
+    switch (offset)
+    {
+    case 0x00: return input->start_button ? 1 : 0;
+    case 0x04: return input->service_button ? 1 : 0;
+    case 0x08: return input->test_button ? 1 : 0;
+    case 0x0C: return input->coin_button ? 1 : 0;
+    case 0x10: return input->button1 ? 1 : 0;
+    case 0x14: return input->button2 ? 1 : 0;
+    case 0x18: return input->button3 ? 1 : 0;
+    case 0x1C: return input->button4 ? 1 : 0;
+    case 0x20: return (input->up ? 1 : 0) | (input->down ? 2 : 0) | (input->left ? 4 : 0) | (input->right ? 8 : 0);
+    case 0x24: return (uint32_t)(int32_t)input->steering;
+    case 0x28: return (uint32_t)(int32_t)input->throttle;
+    default: return 0;
+    }
+}
+
+static uint32_t audio_read32(void *context, uint32_t offset)
+{
+    const AudioState *audio = static_cast<const AudioState *>(context);
+    switch (offset)
+    {
+    case 0x00: return audio->enabled ? 1 : 0;
+    case 0x04: return (uint32_t)(audio->master_volume * 255.0f);
+    // Channel registers (0x10 + channel*0x10 + register)
+    default:
+    {
+        uint32_t channel = (offset - 0x10) / 0x10;
+        uint32_t reg = (offset - 0x10) % 0x10;
+        if (channel < 8)
+        {
+            switch (reg)
+            {
+            case 0x00: return audio->channels[channel].enabled ? 1 : 0;
+            case 0x04: return audio->channels[channel].frequency;
+            case 0x08: return audio->channels[channel].volume;
+            case 0x0C: return audio->channels[channel].waveform;
+            }
+        }
+        return 0;
+    }
+    }
+}
+
+static void audio_write32(void *context, uint32_t offset, uint32_t value)
+{
+    AudioState *audio = static_cast<AudioState *>(context);
+    switch (offset)
+    {
+    case 0x00: audio->enabled = (value != 0); break;
+    case 0x04: audio->master_volume = (float)value / 255.0f; break;
+    // Channel registers (0x10 + channel*0x10 + register)
+    default:
+    {
+        uint32_t channel = (offset - 0x10) / 0x10;
+        uint32_t reg = (offset - 0x10) % 0x10;
+        if (channel < 8)
+        {
+            switch (reg)
+            {
+            case 0x00: audio->channels[channel].enabled = (value != 0); break;
+            case 0x04: audio->channels[channel].frequency = (uint16_t)value; break;
+            case 0x08: audio->channels[channel].volume = (uint8_t)value; break;
+            case 0x0C: audio->channels[channel].waveform = (uint8_t)value; break;
+            }
+        }
+        break;
+    }
+    }
+}
+
+static void emulator_register_devices(Emulator *emu)
+{
+    memory_connect_tgp(&emu->bus, emu->tgp);
+
+    MmioDevice input = {};
+    input.name = "input";
+    input.base = INPUT_BASE_ADDRESS;
+    input.size = INPUT_REGISTER_SPACE;
+    input.context = &emu->input;
+    input.read32 = input_read32; // Read-only
+    memory_register_device(&emu->bus, &input);
+
+    MmioDevice audio = {};
+    audio.name = "audio";
+    audio.base = AUDIO_BASE_ADDRESS;
+    audio.size = AUDIO_REGISTER_SPACE;
+    audio.context = &emu->audio;
+    audio.read32 = audio_read32;
+    audio.write32 = audio_write32;
+    memory_register_device(&emu->bus, &audio);
+}
+
+Emulator *emulator_create(const EmulatorConfig *config)
+{
+    Emulator *emu = new Emulator();
+    memory_init(&emu->bus);
+    if (config->fastmem) {
+        memory_enable_fastmem(&emu->bus);
+    }
+
+    i960_init(&emu->cpu, &emu->bus);
+    i960_set_engine(&emu->cpu, config->engine);
+    i960_set_isa(&emu->cpu, config->isa);
+    emu->cpu.idle_skip = config->idle_skip;
+    emu->cpu.fusion = config->fusion;
+
+    emu->tgp = new TGP();
+    tgp_init(emu->tgp, &emu->bus);
+    emulator_register_devices(emu);
+
+    std::fill(emu->audio_phase, emu->audio_phase + 8, 0.0f);
+    emu->frames = 0;
+    return emu;
+}
+
+void emulator_destroy(Emulator *emu)
+{
+    delete emu->tgp;
+    i960_destroy(&emu->cpu);
+    memory_destroy(&emu->bus);
+    delete emu;
+}
+
+bool emulator_load_game(Emulator *emu, const char *game_name, const char *rom_directory)
+{
+    if (!load_game_by_name(&emu->bus, game_name, rom_directory))
+    {
+        return false;
+    }
+    emulator_reset(emu);
+    return true;
+}
+
+void emulator_reset(Emulator *emu)
+{
+    i960_set_isa(&emu->cpu, emu->cpu.isa);
+    if (emu->cpu.isa == I960_ISA_KB)
+    {
+        i960_boot(&emu->cpu);
+    }
+}
+
+uint64_t emulator_run_frame(Emulator *emu)
+{
+    // i960_run returns early to deliver interrupts, so keep going until
+    // the frame's budget is spent
+    uint64_t frame_cycles = 0;
+    while (frame_cycles < CPU_CYCLES_PER_FRAME && !emu->cpu.halted)
+    {
+        frame_cycles += i960_run(&emu->cpu, CPU_CYCLES_PER_FRAME - frame_cycles);
+    }
+    tgp_step(emu->tgp);
+    memory_stats_end_frame(&emu->bus);
+    emu->frames++;
+    return frame_cycles;
+}
+
+void emulator_render_audio(Emulator *emu, int16_t *samples, int frames, int sample_rate)
+{
+    const AudioState &audio = emu->audio;
+    float *phase = emu->audio_phase;
+
+    for (int i = 0; i < frames; i++)
+    {
+        float left_sample = 0.0f;
+        float right_sample = 0.0f;
+
+        for (int ch = 0; ch < 8; ch++)
+        {
+            if (audio.channels[ch].enabled && audio.channels[ch].frequency > 0)
+            {
+                float freq = audio.channels[ch].frequency;
+                float vol = audio.channels[ch].volume / 255.0f;
+                uint8_t waveform = audio.channels[ch].waveform;
+
+                // Generate waveform
+                float sample = 0.0f;
+                switch (waveform)
+                {
+                case 0: // Sine wave
+                    sample = sinf(phase[ch] * 2.0f * (float)M_PI);
+                    break;
+                case 1: // Square wave
+                    sample = (phase[ch] < 0.5f) ? 1.0f : -1.0f;
+                    break;
+                case 2: // Triangle wave
+                    sample = (phase[ch] < 0.5f) ? (4.0f * phase[ch] - 1.0f) : (3.0f - 4.0f * phase[ch]);
+                    break;
+                case 3: // Sawtooth wave
+                    sample = 2.0f * phase[ch] - 1.0f;
+                    break;
+                }
+
+                // Mix channels (simple stereo panning)
+                if (ch % 2 == 0)
+                { // Even channels to left
+                    left_sample += sample * vol;
+                }
+                else
+                { // Odd channels to right
+                    right_sample += sample * vol;
+                }
+
+                // Update phase
+                phase[ch] += freq / sample_rate;
+                if (phase[ch] >= 1.0f)
+                    phase[ch] -= 1.0f;
+            }
+        }
+
+        // Apply master volume and clamp
+        left_sample *= audio.master_volume;
+        right_sample *= audio.master_volume;
+
+        left_sample = std::max(-1.0f, std::min(1.0f, left_sample));
+        right_sample = std::max(-1.0f, std::min(1.0f, right_sample));
+
+        // Convert to 16-bit PCM
+        samples[2 * i] = (int16_t)(left_sample * 32767.0f);
+        samples[2 * i + 1] = (int16_t)(right_sample * 32767.0f);
+    }
+}
@@ -1,17 +1,33 @@
 #include "i960.h"
+#include "i960_decode.h"
+#include "i960_block.h"
+#include "i960_fuse.h"
+#include "i960_jit.h"
+#include "profiler.h"
+#include "trace.h"
+#include <cstring>
 #include <iostream>
 
 void i960_init(i960_cpu* cpu, MemoryBus* bus) {
-    // On power-up, clear all global registers
-    for (int i = 0; i < 16; ++i) {
-        cpu->g[i] = 0;
+    // On power-up, clear all registers; the literal slots hold their value
+    for (int i = 0; i < I960_REG_LITERAL; ++i) {
+        cpu->regs[i] = 0;
     }
+    for (int i = 0; i < 32; ++i) {
+        cpu->literals[i] = i;
+    }
+    cpu->ac = 0;
+    cpu->pc = 0;
+    cpu->tc = 0;
+    cpu->sat = 0;
+    cpu->prcb = 0;
 
     // Set the instruction pointer to the reset vector address.
     // This address will need to be determined from hardware docs,
     // for now, we'll set it to 0.
     cpu->ip = 0x00000000;
     cpu->bus = bus; // Connect to the bus
+    bus->cpu_ip = &cpu->ip; // Watchpoint hits report the instruction doing the access
     cpu->zero_flag = false; // Initialize flags
 
     // Initialize the stack pointer to the top of memory.
@@ -21,497 +37,704 @@ void i960_init(i960_cpu* cpu, MemoryBus* bus) {
     // Initialize CPU state
     cpu->halted = false;
 
-    // Initialize interrupt system
-    cpu->interrupt_mode = false;
-    cpu->interrupt_sp = 0;
+    // Initialize interrupt controller: nothing pending, every vector enabled
+    for (int i = 0; i < 8; ++i) {
+        cpu->ipnd[i] = 0;
+        cpu->imsk[i] = 0xFFFFFFFF;
+    }
+    cpu->interrupt_ready = false;
+    cpu->run_end = 0;
+    cpu->interrupt_depth = 0;
+
+    cpu->cycles = 0;
+    cpu->idle_skip = true;
+    cpu->fusion = true;
+    cpu->idle_cycles = 0;
     for (int i = 0; i < 256; ++i) {
         cpu->interrupt_vectors[i] = 0; // No handlers by default
     }
 
+    // Decoded instruction cache (zeroed slots have generation 0 and never match)
+    cpu->decode_cache = new i960_decode_cache();
+
+    // Default to the interpreter; block translations are created on demand
+    cpu->engine = I960_ENGINE_INTERPRETER;
+    cpu->block_cache = nullptr;
+    cpu->jit = nullptr;
+    cpu->isa = I960_ISA_LEGACY;
+    cpu->fetch.page_base = 0;
+    cpu->fetch.page = nullptr;
+    cpu->fetch.map_generation = 0;
+    cpu->profiler = nullptr;
+    cpu->pair_stats = nullptr;
+    cpu->hle = nullptr;
+
     std::cout << "i960 CPU Initialized and connected to Memory Bus." << std::endl;
 }
 
-void i960_step(i960_cpu* cpu) {
-    // Check if CPU is halted
-    if (cpu->halted) {
-        return; // Do nothing if halted
+void i960_destroy(i960_cpu* cpu) {
+    if (cpu->bus != nullptr && cpu->bus->cpu_ip == &cpu->ip) {
+        cpu->bus->cpu_ip = nullptr;
     }
+    delete cpu->decode_cache;
+    cpu->decode_cache = nullptr;
+    i960_block_cache_destroy(cpu->block_cache);
+    cpu->block_cache = nullptr;
+    i960_jit_destroy(cpu->jit);
+    cpu->jit = nullptr;
+}
 
-    // Fetch the opcode from memory
-    uint8_t opcode = memory_read_byte(cpu->bus, cpu->ip);
+void i960_set_engine(i960_cpu* cpu, i960_engine engine) {
+    if (engine == I960_ENGINE_JIT && cpu->jit == nullptr) {
+        cpu->jit = i960_jit_available() ? i960_jit_create() : nullptr;
+        if (cpu->jit == nullptr) {
+            std::cerr << "JIT not available on this host, using the threaded engine" << std::endl;
+            engine = I960_ENGINE_THREADED;
+        }
+    }
+    cpu->engine = engine;
+    if (engine != I960_ENGINE_INTERPRETER && cpu->block_cache == nullptr) {
+        cpu->block_cache = i960_block_cache_create();
+    }
+    // Translations may carry native code from (or for) the other engine
+    if (cpu->block_cache) {
+        cpu->block_cache->blocks.clear();
+    }
+    i960_jit_reset(cpu->jit);
+}
 
-    // Decode and execute the instruction
-    switch (opcode) {
-        case 0x90: { // Our custom ld_const instruction
-            uint32_t base_ip = cpu->ip;
-            uint8_t dst_reg = memory_read_byte(cpu->bus, base_ip + 1);
-
-            uint32_t val = 0;
-            val |= (uint32_t)memory_read_byte(cpu->bus, base_ip + 2) << 24;
-            val |= (uint32_t)memory_read_byte(cpu->bus, base_ip + 3) << 16;
-            val |= (uint32_t)memory_read_byte(cpu->bus, base_ip + 4) << 8;
-            val |= (uint32_t)memory_read_byte(cpu->bus, base_ip + 5);
-
-            if (dst_reg < 16) {
-                cpu->g[dst_reg] = val;
-                std::cout << "Executing at 0x" << std::hex << base_ip
-                          << ": ld_const -> Loaded 0x" << val << " into g" << std::dec << (int)dst_reg << std::endl;
-            }
+void i960_set_isa(i960_cpu* cpu, i960_isa isa) {
+    cpu->isa = isa;
+    // Cached decodes and translations are tagged with the code generation:
+    // bumping it makes them all stale
+    cpu->bus->code_generation++;
+}
 
-            cpu->ip += 6; // This instruction is 6 bytes long
-            break;
-        }
+bool i960_parse_isa(const char* name, i960_isa* isa) {
+    if (strcmp(name, "legacy") == 0) {
+        *isa = I960_ISA_LEGACY;
+        return true;
+    }
+    if (strcmp(name, "kb") == 0) {
+        *isa = I960_ISA_KB;
+        return true;
+    }
+    return false;
+}
 
-        case 0x58: { // Our custom add_reg instruction
-            uint32_t base_ip = cpu->ip;
-            uint8_t dst_reg = memory_read_byte(cpu->bus, base_ip + 1);
-            uint8_t src1_reg = memory_read_byte(cpu->bus, base_ip + 2);
-            uint8_t src2_reg = memory_read_byte(cpu->bus, base_ip + 3);
+const char* i960_isa_name(i960_isa isa) {
+    switch (isa) {
+        case I960_ISA_LEGACY: return "legacy";
+        case I960_ISA_KB: return "kb";
+    }
+    return "unknown";
+}
 
-            if (dst_reg < 16 && src1_reg < 16 && src2_reg < 16) {
-                uint32_t val1 = cpu->g[src1_reg];
-                uint32_t val2 = cpu->g[src2_reg];
-                cpu->g[dst_reg] = val1 + val2;
+void i960_boot(i960_cpu* cpu) {
+    MemoryBus* bus = cpu->bus;
+    cpu->sat = memory_read_dword(bus, 0);
+    cpu->prcb = memory_read_dword(bus, 4);
+    cpu->ip = memory_read_dword(bus, 12);
 
-                // Update zero flag based on the result
-                cpu->zero_flag = (cpu->g[dst_reg] == 0);
+    for (int i = 0; i < I960_REG_LITERAL; ++i) {
+        cpu->regs[i] = 0;
+    }
+    cpu->ac = 0;
+    cpu->pc = 0x001F2002; // Supervisor mode, priority 31, interrupted state
+    cpu->tc = 0;
+    cpu->halted = false;
 
-                std::cout << "Executing at 0x" << std::hex << base_ip
-                          << ": add_reg -> g" << std::dec << (int)dst_reg << " = 0x" 
-                          << std::hex << val1 << " + 0x" << val2 << " = 0x" << cpu->g[dst_reg] << std::endl;
-            }
+    // The first frame lives on the interrupt stack named by the PRCB
+    cpu->regs[I960_REG_FP] = memory_read_dword(bus, cpu->prcb + 24);
+    cpu->regs[I960_REG_SP] = cpu->regs[I960_REG_FP] + 64;
+    i960_update_interrupts(cpu);
 
-            cpu->ip += 4; // This instruction is 4 bytes long
-            break;
-        }
+    std::cout << "i960 boot: SAT 0x" << std::hex << cpu->sat << ", PRCB 0x" << cpu->prcb
+              << ", IP 0x" << cpu->ip << ", FP 0x" << cpu->regs[I960_REG_FP] << std::dec << std::endl;
+}
 
-        case 0xFF: { // halt
-            std::cout << "Executing at 0x" << std::hex << cpu->ip << ": HALT" << std::endl;
-            cpu->halted = true;
-            break;
-        }
+bool i960_parse_engine(const char* name, i960_engine* engine) {
+    if (strcmp(name, "interp") == 0) {
+        *engine = I960_ENGINE_INTERPRETER;
+        return true;
+    }
+    if (strcmp(name, "threaded") == 0) {
+        *engine = I960_ENGINE_THREADED;
+        return true;
+    }
+    if (strcmp(name, "jit") == 0) {
+        *engine = I960_ENGINE_JIT;
+        return true;
+    }
+    return false;
+}
 
-        // --- Load/Store Instructions ---
-        case 0xC0: { // ld (load word from memory)
-            uint32_t base_ip = cpu->ip;
-            uint8_t dst_reg = memory_read_byte(cpu->bus, base_ip + 1);
-            uint32_t addr = 0;
-            addr |= (uint32_t)memory_read_byte(cpu->bus, base_ip + 2) << 24;
-            addr |= (uint32_t)memory_read_byte(cpu->bus, base_ip + 3) << 16;
-            addr |= (uint32_t)memory_read_byte(cpu->bus, base_ip + 4) << 8;
-            addr |= (uint32_t)memory_read_byte(cpu->bus, base_ip + 5);
-
-            if (dst_reg < 16) {
-                cpu->g[dst_reg] = memory_read_dword(cpu->bus, addr);
-                std::cout << "Executing at 0x" << std::hex << base_ip
-                          << ": ld -> g" << std::dec << (int)dst_reg << " = [0x" << std::hex << addr << "] = 0x" << cpu->g[dst_reg] << std::endl;
-            }
-            cpu->ip += 6;
-            break;
-        }
+const char* i960_engine_name(i960_engine engine) {
+    switch (engine) {
+        case I960_ENGINE_INTERPRETER: return "interp";
+        case I960_ENGINE_THREADED: return "threaded";
+        case I960_ENGINE_JIT: return "jit";
+    }
+    return "unknown";
+}
 
-        case 0xC1: { // st (store word to memory)
-            uint32_t base_ip = cpu->ip;
-            uint8_t src_reg = memory_read_byte(cpu->bus, base_ip + 1);
-            uint32_t addr = 0;
-            addr |= (uint32_t)memory_read_byte(cpu->bus, base_ip + 2) << 24;
-            addr |= (uint32_t)memory_read_byte(cpu->bus, base_ip + 3) << 16;
-            addr |= (uint32_t)memory_read_byte(cpu->bus, base_ip + 4) << 8;
-            addr |= (uint32_t)memory_read_byte(cpu->bus, base_ip + 5);
-
-            if (src_reg < 16) {
-                memory_write_dword(cpu->bus, addr, cpu->g[src_reg]);
-                std::cout << "Executing at 0x" << std::hex << base_ip
-                          << ": st -> [0x" << addr << "] = g" << std::dec << (int)src_reg << " = 0x" << std::hex << cpu->g[src_reg] << std::endl;
-            }
-            cpu->ip += 6;
-            break;
-        }
+// --- Opcode Handlers ---
+// Each handler receives an instruction decoded by i960_decode. Register
+// indices have already been range-checked and mapped onto the register
+// file (g0 is regs[16]), so handlers index regs[] directly.
 
-        case 0xC2: { // ld_byte (load byte from memory)
-            uint32_t base_ip = cpu->ip;
-            uint8_t dst_reg = memory_read_byte(cpu->bus, base_ip + 1);
-            uint32_t addr = 0;
-            addr |= (uint32_t)memory_read_byte(cpu->bus, base_ip + 2) << 24;
-            addr |= (uint32_t)memory_read_byte(cpu->bus, base_ip + 3) << 16;
-            addr |= (uint32_t)memory_read_byte(cpu->bus, base_ip + 4) << 8;
-            addr |= (uint32_t)memory_read_byte(cpu->bus, base_ip + 5);
-
-            if (dst_reg < 16) {
-                cpu->g[dst_reg] = memory_read_byte(cpu->bus, addr);
-                std::cout << "Executing at 0x" << std::hex << base_ip
-                          << ": ld_byte -> g" << std::dec << (int)dst_reg << " = [0x" << std::hex << addr << "] = 0x" << cpu->g[dst_reg] << std::endl;
-            }
-            cpu->ip += 6;
-            break;
-        }
+// Records an executed instruction: reg is the register written (or read,
+// for stores and compares) and value the result
+static inline void trace_insn(i960_cpu* cpu, const i960_decoded* insn, uint8_t reg, uint32_t value) {
+    trace_record<TRACE_CPU>(cpu->bus->trace, TRACE_EVENT_INSN, insn->op, reg, insn->opcode, insn->ip, value, insn->imm);
+}
 
-        case 0xC3: { // st_byte (store byte to memory)
-            uint32_t base_ip = cpu->ip;
-            uint8_t src_reg = memory_read_byte(cpu->bus, base_ip + 1);
-            uint32_t addr = 0;
-            addr |= (uint32_t)memory_read_byte(cpu->bus, base_ip + 2) << 24;
-            addr |= (uint32_t)memory_read_byte(cpu->bus, base_ip + 3) << 16;
-            addr |= (uint32_t)memory_read_byte(cpu->bus, base_ip + 4) << 8;
-            addr |= (uint32_t)memory_read_byte(cpu->bus, base_ip + 5);
-
-            if (src_reg < 16) {
-                memory_write_byte(cpu->bus, addr, cpu->g[src_reg] & 0xFF);
-                std::cout << "Executing at 0x" << std::hex << base_ip
-                          << ": st_byte -> [0x" << addr << "] = g" << std::dec << (int)src_reg << " = 0x" << std::hex << (cpu->g[src_reg] & 0xFF) << std::endl;
-            }
-            cpu->ip += 6;
-            break;
-        }
+static void op_ld_const(i960_cpu* cpu, const i960_decoded* insn) {
+    cpu->regs[insn->dst] = insn->imm;
+    trace_insn(cpu, insn, insn->dst, insn->imm);
+    cpu->ip += insn->length;
+}
 
-        // --- Arithmetic Instructions ---
-        case 0xD0: { // sub_reg (subtract registers)
-            uint32_t base_ip = cpu->ip;
-            uint8_t dst_reg = memory_read_byte(cpu->bus, base_ip + 1);
-            uint8_t src1_reg = memory_read_byte(cpu->bus, base_ip + 2);
-            uint8_t src2_reg = memory_read_byte(cpu->bus, base_ip + 3);
-
-            if (dst_reg < 16 && src1_reg < 16 && src2_reg < 16) {
-                uint32_t val1 = cpu->g[src1_reg];
-                uint32_t val2 = cpu->g[src2_reg];
-                cpu->g[dst_reg] = val1 - val2;
-                cpu->zero_flag = (cpu->g[dst_reg] == 0);
-
-                std::cout << "Executing at 0x" << std::hex << base_ip
-                          << ": sub_reg -> g" << std::dec << (int)dst_reg << " = 0x" 
-                          << std::hex << val1 << " - 0x" << val2 << " = 0x" << cpu->g[dst_reg] << std::endl;
-            }
-            cpu->ip += 4;
-            break;
-        }
+static void op_add_reg(i960_cpu* cpu, const i960_decoded* insn) {
+    uint32_t val1 = cpu->regs[insn->src1];
+    uint32_t val2 = cpu->regs[insn->src2];
+    cpu->regs[insn->dst] = val1 + val2;
 
-        case 0xD1: { // mul_reg (multiply registers)
-            uint32_t base_ip = cpu->ip;
-            uint8_t dst_reg = memory_read_byte(cpu->bus, base_ip + 1);
-            uint8_t src1_reg = memory_read_byte(cpu->bus, base_ip + 2);
-            uint8_t src2_reg = memory_read_byte(cpu->bus, base_ip + 3);
-
-            if (dst_reg < 16 && src1_reg < 16 && src2_reg < 16) {
-                uint32_t val1 = cpu->g[src1_reg];
-                uint32_t val2 = cpu->g[src2_reg];
-                cpu->g[dst_reg] = val1 * val2;
-                cpu->zero_flag = (cpu->g[dst_reg] == 0);
-
-                std::cout << "Executing at 0x" << std::hex << base_ip
-                          << ": mul_reg -> g" << std::dec << (int)dst_reg << " = 0x" 
-                          << std::hex << val1 << " * 0x" << val2 << " = 0x" << cpu->g[dst_reg] << std::endl;
-            }
-            cpu->ip += 4;
-            break;
-        }
+    // Update zero flag based on the result
+    cpu->zero_flag = (cpu->regs[insn->dst] == 0);
 
-        case 0xD2: { // div_reg (divide registers)
-            uint32_t base_ip = cpu->ip;
-            uint8_t dst_reg = memory_read_byte(cpu->bus, base_ip + 1);
-            uint8_t src1_reg = memory_read_byte(cpu->bus, base_ip + 2);
-            uint8_t src2_reg = memory_read_byte(cpu->bus, base_ip + 3);
-
-            if (dst_reg < 16 && src1_reg < 16 && src2_reg < 16 && cpu->g[src2_reg] != 0) {
-                uint32_t val1 = cpu->g[src1_reg];
-                uint32_t val2 = cpu->g[src2_reg];
-                cpu->g[dst_reg] = val1 / val2;
-                cpu->zero_flag = (cpu->g[dst_reg] == 0);
-
-                std::cout << "Executing at 0x" << std::hex << base_ip
-                          << ": div_reg -> g" << std::dec << (int)dst_reg << " = 0x" 
-                          << std::hex << val1 << " / 0x" << val2 << " = 0x" << cpu->g[dst_reg] << std::endl;
-            }
-            cpu->ip += 4;
-            break;
-        }
+    trace_insn(cpu, insn, insn->dst, cpu->regs[insn->dst]);
+    cpu->ip += insn->length;
+}
 
-        // --- Logical Instructions ---
-        case 0xE0: { // and_reg (bitwise AND)
-            uint32_t base_ip = cpu->ip;
-            uint8_t dst_reg = memory_read_byte(cpu->bus, base_ip + 1);
-            uint8_t src1_reg = memory_read_byte(cpu->bus, base_ip + 2);
-            uint8_t src2_reg = memory_read_byte(cpu->bus, base_ip + 3);
-
-            if (dst_reg < 16 && src1_reg < 16 && src2_reg < 16) {
-                uint32_t val1 = cpu->g[src1_reg];
-                uint32_t val2 = cpu->g[src2_reg];
-                cpu->g[dst_reg] = val1 & val2;
-                cpu->zero_flag = (cpu->g[dst_reg] == 0);
-
-                std::cout << "Executing at 0x" << std::hex << base_ip
-                          << ": and_reg -> g" << std::dec << (int)dst_reg << " = 0x" 
-                          << std::hex << val1 << " & 0x" << val2 << " = 0x" << cpu->g[dst_reg] << std::endl;
-            }
-            cpu->ip += 4;
-            break;
-        }
+static void op_halt(i960_cpu* cpu, const i960_decoded* insn) {
+    trace_insn(cpu, insn, 0, 0);
+    cpu->halted = true;
+}
 
-        case 0xE1: { // or_reg (bitwise OR)
-            uint32_t base_ip = cpu->ip;
-            uint8_t dst_reg = memory_read_byte(cpu->bus, base_ip + 1);
-            uint8_t src1_reg = memory_read_byte(cpu->bus, base_ip + 2);
-            uint8_t src2_reg = memory_read_byte(cpu->bus, base_ip + 3);
-
-            if (dst_reg < 16 && src1_reg < 16 && src2_reg < 16) {
-                uint32_t val1 = cpu->g[src1_reg];
-                uint32_t val2 = cpu->g[src2_reg];
-                cpu->g[dst_reg] = val1 | val2;
-                cpu->zero_flag = (cpu->g[dst_reg] == 0);
-
-                std::cout << "Executing at 0x" << std::hex << base_ip
-                          << ": or_reg -> g" << std::dec << (int)dst_reg << " = 0x" 
-                          << std::hex << val1 << " | 0x" << val2 << " = 0x" << cpu->g[dst_reg] << std::endl;
-            }
-            cpu->ip += 4;
-            break;
-        }
+// --- Load/Store Instructions ---
+static void op_ld(i960_cpu* cpu, const i960_decoded* insn) {
+    cpu->regs[insn->dst] = bus_read<uint32_t>(cpu->bus, insn->imm);
+    trace_insn(cpu, insn, insn->dst, cpu->regs[insn->dst]);
+    cpu->ip += insn->length;
+}
 
-        case 0xE2: { // xor_reg (bitwise XOR)
-            uint32_t base_ip = cpu->ip;
-            uint8_t dst_reg = memory_read_byte(cpu->bus, base_ip + 1);
-            uint8_t src1_reg = memory_read_byte(cpu->bus, base_ip + 2);
-            uint8_t src2_reg = memory_read_byte(cpu->bus, base_ip + 3);
-
-            if (dst_reg < 16 && src1_reg < 16 && src2_reg < 16) {
-                uint32_t val1 = cpu->g[src1_reg];
-                uint32_t val2 = cpu->g[src2_reg];
-                cpu->g[dst_reg] = val1 ^ val2;
-                cpu->zero_flag = (cpu->g[dst_reg] == 0);
-
-                std::cout << "Executing at 0x" << std::hex << base_ip
-                          << ": xor_reg -> g" << std::dec << (int)dst_reg << " = 0x" 
-                          << std::hex << val1 << " ^ 0x" << val2 << " = 0x" << cpu->g[dst_reg] << std::endl;
-            }
-            cpu->ip += 4;
-            break;
-        }
+static void op_st(i960_cpu* cpu, const i960_decoded* insn) {
+    bus_write<uint32_t>(cpu->bus, insn->imm, cpu->regs[insn->src1]);
+    trace_insn(cpu, insn, insn->src1, cpu->regs[insn->src1]);
+    cpu->ip += insn->length;
+}
 
-        case 0xE3: { // not_reg (bitwise NOT)
-            uint32_t base_ip = cpu->ip;
-            uint8_t dst_reg = memory_read_byte(cpu->bus, base_ip + 1);
-            uint8_t src_reg = memory_read_byte(cpu->bus, base_ip + 2);
+static void op_ld_byte(i960_cpu* cpu, const i960_decoded* insn) {
+    cpu->regs[insn->dst] = bus_read<uint8_t>(cpu->bus, insn->imm);
+    trace_insn(cpu, insn, insn->dst, cpu->regs[insn->dst]);
+    cpu->ip += insn->length;
+}
 
-            if (dst_reg < 16 && src_reg < 16) {
-                uint32_t val = cpu->g[src_reg];
-                cpu->g[dst_reg] = ~val;
-                cpu->zero_flag = (cpu->g[dst_reg] == 0);
+static void op_st_byte(i960_cpu* cpu, const i960_decoded* insn) {
+    memory_write_byte(cpu->bus, insn->imm, cpu->regs[insn->src1] & 0xFF);
+    trace_insn(cpu, insn, insn->src1, cpu->regs[insn->src1] & 0xFF);
+    cpu->ip += insn->length;
+}
 
-                std::cout << "Executing at 0x" << std::hex << base_ip
-                          << ": not_reg -> g" << std::dec << (int)dst_reg << " = ~g" << (int)src_reg << " = 0x" 
-                          << std::hex << val << " -> 0x" << cpu->g[dst_reg] << std::endl;
-            }
-            cpu->ip += 3;
-            break;
-        }
+// --- Arithmetic Instructions ---
+static void op_sub_reg(i960_cpu* cpu, const i960_decoded* insn) {
+    uint32_t val1 = cpu->regs[insn->src1];
+    uint32_t val2 = cpu->regs[insn->src2];
+    cpu->regs[insn->dst] = val1 - val2;
+    cpu->zero_flag = (cpu->regs[insn->dst] == 0);
 
-        // --- Comparison and Branch Instructions ---
-        case 0xF0: { // cmp_reg (compare registers)
-            uint32_t base_ip = cpu->ip;
-            uint8_t src1_reg = memory_read_byte(cpu->bus, base_ip + 1);
-            uint8_t src2_reg = memory_read_byte(cpu->bus, base_ip + 2);
+    trace_insn(cpu, insn, insn->dst, cpu->regs[insn->dst]);
+    cpu->ip += insn->length;
+}
 
-            if (src1_reg < 16 && src2_reg < 16) {
-                uint32_t val1 = cpu->g[src1_reg];
-                uint32_t val2 = cpu->g[src2_reg];
-                cpu->zero_flag = (val1 == val2);
+static void op_mul_reg(i960_cpu* cpu, const i960_decoded* insn) {
+    uint32_t val1 = cpu->regs[insn->src1];
+    uint32_t val2 = cpu->regs[insn->src2];
+    cpu->regs[insn->dst] = val1 * val2;
+    cpu->zero_flag = (cpu->regs[insn->dst] == 0);
 
-                std::cout << "Executing at 0x" << std::hex << base_ip
-                          << ": cmp_reg -> g" << std::dec << (int)src1_reg << " (0x" << std::hex << val1 
-                          << ") cmp g" << (int)src2_reg << " (0x" << val2 << ") -> zero_flag = " << cpu->zero_flag << std::endl;
-            }
-            cpu->ip += 3;
-            break;
-        }
+    trace_insn(cpu, insn, insn->dst, cpu->regs[insn->dst]);
+    cpu->ip += insn->length;
+}
 
-        case 0xF1: { // beq (branch if equal)
-            uint32_t base_ip = cpu->ip;
-            uint32_t target = 0;
-            target |= (uint32_t)memory_read_byte(cpu->bus, base_ip + 1) << 24;
-            target |= (uint32_t)memory_read_byte(cpu->bus, base_ip + 2) << 16;
-            target |= (uint32_t)memory_read_byte(cpu->bus, base_ip + 3) << 8;
-            target |= (uint32_t)memory_read_byte(cpu->bus, base_ip + 4);
-
-            if (cpu->zero_flag) {
-                cpu->ip = target;
-                std::cout << "Executing at 0x" << std::hex << base_ip
-                          << ": beq -> branching to 0x" << target << " (zero_flag set)" << std::endl;
-            } else {
-                cpu->ip += 5;
-                std::cout << "Executing at 0x" << std::hex << base_ip
-                          << ": beq -> not branching (zero_flag clear)" << std::endl;
-            }
-            break;
-        }
+static void op_div_reg(i960_cpu* cpu, const i960_decoded* insn) {
+    // Division by zero leaves the destination untouched
+    if (cpu->regs[insn->src2] != 0) {
+        uint32_t val1 = cpu->regs[insn->src1];
+        uint32_t val2 = cpu->regs[insn->src2];
+        cpu->regs[insn->dst] = val1 / val2;
+        cpu->zero_flag = (cpu->regs[insn->dst] == 0);
+    }
+    trace_insn(cpu, insn, insn->dst, cpu->regs[insn->dst]);
+    cpu->ip += insn->length;
+}
 
-        case 0xF2: { // bne (branch if not equal)
-            uint32_t base_ip = cpu->ip;
-            uint32_t target = 0;
-            target |= (uint32_t)memory_read_byte(cpu->bus, base_ip + 1) << 24;
-            target |= (uint32_t)memory_read_byte(cpu->bus, base_ip + 2) << 16;
-            target |= (uint32_t)memory_read_byte(cpu->bus, base_ip + 3) << 8;
-            target |= (uint32_t)memory_read_byte(cpu->bus, base_ip + 4);
-
-            if (!cpu->zero_flag) {
-                cpu->ip = target;
-                std::cout << "Executing at 0x" << std::hex << base_ip
-                          << ": bne -> branching to 0x" << target << " (zero_flag clear)" << std::endl;
-            } else {
-                cpu->ip += 5;
-                std::cout << "Executing at 0x" << std::hex << base_ip
-                          << ": bne -> not branching (zero_flag set)" << std::endl;
-            }
-            break;
-        }
+// --- Logical Instructions ---
+static void op_and_reg(i960_cpu* cpu, const i960_decoded* insn) {
+    uint32_t val1 = cpu->regs[insn->src1];
+    uint32_t val2 = cpu->regs[insn->src2];
+    cpu->regs[insn->dst] = val1 & val2;
+    cpu->zero_flag = (cpu->regs[insn->dst] == 0);
 
-        case 0xF3: { // jmp (unconditional jump)
-            uint32_t base_ip = cpu->ip;
-            uint32_t target = 0;
-            target |= (uint32_t)memory_read_byte(cpu->bus, base_ip + 1) << 24;
-            target |= (uint32_t)memory_read_byte(cpu->bus, base_ip + 2) << 16;
-            target |= (uint32_t)memory_read_byte(cpu->bus, base_ip + 3) << 8;
-            target |= (uint32_t)memory_read_byte(cpu->bus, base_ip + 4);
-
-            if (target >= MEMORY_SIZE) {
-                std::cout << "Executing at 0x" << std::hex << base_ip
-                          << ": jmp -> target address 0x" << target << " is out of bounds, halting CPU" << std::endl;
-                cpu->halted = true;
-                break;
-            }
+    trace_insn(cpu, insn, insn->dst, cpu->regs[insn->dst]);
+    cpu->ip += insn->length;
+}
 
-            cpu->ip = target;
-            std::cout << "Executing at 0x" << std::hex << base_ip
-                      << ": jmp -> jumping to 0x" << target << std::endl;
-            break;
-        }
+static void op_or_reg(i960_cpu* cpu, const i960_decoded* insn) {
+    uint32_t val1 = cpu->regs[insn->src1];
+    uint32_t val2 = cpu->regs[insn->src2];
+    cpu->regs[insn->dst] = val1 | val2;
+    cpu->zero_flag = (cpu->regs[insn->dst] == 0);
+
+    trace_insn(cpu, insn, insn->dst, cpu->regs[insn->dst]);
+    cpu->ip += insn->length;
+}
+
+static void op_xor_reg(i960_cpu* cpu, const i960_decoded* insn) {
+    uint32_t val1 = cpu->regs[insn->src1];
+    uint32_t val2 = cpu->regs[insn->src2];
+    cpu->regs[insn->dst] = val1 ^ val2;
+    cpu->zero_flag = (cpu->regs[insn->dst] == 0);
 
-        // --- Additional Instructions ---
-        case 0xDD: { // Unknown instruction, possibly a system call or special operation
-            uint32_t base_ip = cpu->ip;
-            uint8_t param1 = memory_read_byte(cpu->bus, base_ip + 1);
-            uint8_t param2 = memory_read_byte(cpu->bus, base_ip + 2);
+    trace_insn(cpu, insn, insn->dst, cpu->regs[insn->dst]);
+    cpu->ip += insn->length;
+}
 
-            std::cout << "Executing at 0x" << std::hex << base_ip
-                      << ": unknown_0xDD -> params: 0x" << std::hex << (int)param1 << ", 0x" << (int)param2 << std::endl;
-            // For now, just skip this instruction
-            cpu->ip += 3;
+static void op_not_reg(i960_cpu* cpu, const i960_decoded* insn) {
+    uint32_t val = cpu->regs[insn->src1];
+    cpu->regs[insn->dst] = ~val;
+    cpu->zero_flag = (cpu->regs[insn->dst] == 0);
+
+    trace_insn(cpu, insn, insn->dst, cpu->regs[insn->dst]);
+    cpu->ip += insn->length;
+}
+
+// --- Comparison and Branch Instructions ---
+static void op_cmp_reg(i960_cpu* cpu, const i960_decoded* insn) {
+    uint32_t val1 = cpu->regs[insn->src1];
+    uint32_t val2 = cpu->regs[insn->src2];
+    cpu->zero_flag = (val1 == val2);
+
+    trace_insn(cpu, insn, insn->src1, cpu->zero_flag);
+    cpu->ip += insn->length;
+}
+
+// Branches record the IP they continue at
+static void op_beq(i960_cpu* cpu, const i960_decoded* insn) {
+    if (cpu->zero_flag) {
+        cpu->ip = insn->imm;
+    } else {
+        cpu->ip += insn->length;
+    }
+    trace_insn(cpu, insn, 0, cpu->ip);
+}
+
+static void op_bne(i960_cpu* cpu, const i960_decoded* insn) {
+    if (!cpu->zero_flag) {
+        cpu->ip = insn->imm;
+    } else {
+        cpu->ip += insn->length;
+    }
+    trace_insn(cpu, insn, 0, cpu->ip);
+}
+
+static void op_jmp(i960_cpu* cpu, const i960_decoded* insn) {
+    if (insn->imm >= MEMORY_SIZE) {
+        // Out-of-bounds target: halt, recording the IP the CPU stopped at
+        trace_insn(cpu, insn, 0, cpu->ip);
+        cpu->halted = true;
+        return;
+    }
+
+    cpu->ip = insn->imm;
+    trace_insn(cpu, insn, 0, cpu->ip);
+}
+
+// --- Additional Instructions ---
+// Placeholders for opcodes seen in ROMs whose meaning is not known yet:
+// record the operands and skip over them.
+static void op_unknown(i960_cpu* cpu, const i960_decoded* insn) {
+    trace_insn(cpu, insn, insn->src1, insn->src2);
+    cpu->ip += insn->length;
+}
+
+// Instruction with an out-of-range register operand: no effect, just skip it
+static void op_skip(i960_cpu* cpu, const i960_decoded* insn) {
+    cpu->ip += insn->length;
+}
+
+// Opcode not implemented at all: the CPU stays on it without advancing
+static void op_undefined(i960_cpu* cpu, const i960_decoded* insn) {
+    trace_insn(cpu, insn, 0, 0);
+}
+
+// --- Decoder ---
+
+// Immediates and addresses are encoded big-endian after the opcode/register bytes
+static uint32_t fetch_imm32(const uint8_t* bytes) {
+    return (uint32_t)bytes[0] << 24 | (uint32_t)bytes[1] << 16 | (uint32_t)bytes[2] << 8 | bytes[3];
+}
+
+const char* i960_op_name(i960_op op) {
+    if (op < I960_OP_COUNT) {
+        return I960_OP_INFO[op].name;
+    }
+    return "?";
+}
+
+// Assembler name of each register file index
+static const char* const i960_register_names[] = {
+    "r0", "r1", "r2", "r3", "r4", "r5", "r6", "r7", "r8", "r9", "r10", "r11", "r12", "r13", "r14", "r15",
+    "g0", "g1", "g2", "g3", "g4", "g5", "g6", "g7", "g8", "g9", "g10", "g11", "g12", "g13", "g14", "g15",
+    "lit 0", "lit 1", "lit 2", "lit 3", "lit 4", "lit 5", "lit 6", "lit 7",
+    "lit 8", "lit 9", "lit 10", "lit 11", "lit 12", "lit 13", "lit 14", "lit 15",
+    "lit 16", "lit 17", "lit 18", "lit 19", "lit 20", "lit 21", "lit 22", "lit 23",
+    "lit 24", "lit 25", "lit 26", "lit 27", "lit 28", "lit 29", "lit 30", "lit 31",
+};
+static_assert(sizeof(i960_register_names) / sizeof(i960_register_names[0]) == I960_REG_COUNT,
+              "i960_register_names must cover the register file");
+
+const char* i960_register_name(uint8_t index) {
+    return index < I960_REG_COUNT ? i960_register_names[index] : "?";
+}
+
+// Handler for each legacy operation, indexed by i960_op
+static const i960_handler i960_legacy_handlers[] = {
+    op_undefined, // I960_OP_UNDEFINED
+    op_skip,      // I960_OP_SKIP
+    op_unknown,   // I960_OP_UNKNOWN
+    op_halt,      // I960_OP_HALT
+    op_ld_const,  // I960_OP_LD_CONST
+    op_add_reg,   // I960_OP_ADD_REG
+    op_sub_reg,   // I960_OP_SUB_REG
+    op_mul_reg,   // I960_OP_MUL_REG
+    op_div_reg,   // I960_OP_DIV_REG
+    op_and_reg,   // I960_OP_AND_REG
+    op_or_reg,    // I960_OP_OR_REG
+    op_xor_reg,   // I960_OP_XOR_REG
+    op_not_reg,   // I960_OP_NOT_REG
+    op_ld,        // I960_OP_LD_ABS
+    op_st,        // I960_OP_ST_ABS
+    op_ld_byte,   // I960_OP_LD_BYTE
+    op_st_byte,   // I960_OP_ST_BYTE
+    op_cmp_reg,   // I960_OP_CMP_REG
+    op_beq,       // I960_OP_BEQ
+    op_bne,       // I960_OP_BNE
+    op_jmp,       // I960_OP_JMP
+};
+
+static_assert(sizeof(i960_legacy_handlers) / sizeof(i960_legacy_handlers[0]) == I960_OP_JMP + 1,
+              "i960_legacy_handlers must cover every legacy i960_op");
+
+// Legacy superinstructions (see i960_fuse.h): compare or count then
+// branch, and load then operate
+static const i960_fusion i960_legacy_fusion_table[] = {
+    {op_cmp_reg, op_beq, i960_fused<op_cmp_reg, op_beq>},
+    {op_cmp_reg, op_bne, i960_fused<op_cmp_reg, op_bne>},
+    {op_sub_reg, op_bne, i960_fused<op_sub_reg, op_bne>},
+    {op_sub_reg, op_beq, i960_fused<op_sub_reg, op_beq>},
+    {op_ld, op_cmp_reg, i960_fused<op_ld, op_cmp_reg>},
+    {op_ld, op_add_reg, i960_fused<op_ld, op_add_reg>},
+    {op_ld_byte, op_cmp_reg, i960_fused<op_ld_byte, op_cmp_reg>},
+    {op_add_reg, op_jmp, i960_fused<op_add_reg, op_jmp>},
+};
+
+const i960_fusion* i960_legacy_fusions(uint32_t* count) {
+    *count = sizeof(i960_legacy_fusion_table) / sizeof(i960_legacy_fusion_table[0]);
+    return i960_legacy_fusion_table;
+}
+
+// Legacy encoding: register bytes name g0-g15
+static uint8_t legacy_reg(uint8_t n) {
+    return I960_REG_G0 + n;
+}
+
+static void i960_decode_legacy(i960_cpu* cpu, uint32_t ip, i960_decoded* insn) {
+    // Longest legacy instruction, fetched in one go
+    uint8_t bytes[6];
+    i960_fetch_bytes(cpu, ip, bytes, sizeof(bytes));
+    uint8_t opcode = bytes[0];
+
+    insn->opcode = opcode;
+    insn->imm = 0;
+    insn->dst = insn->src1 = insn->src2 = 0;
+    insn->flags = 0;
+    insn->aux = 0;
+
+    switch (opcode) {
+        case 0x90: // ld_const dst, imm32
+        case 0xC0: // ld dst, [addr32]
+        case 0xC2: // ld_byte dst, [addr32]
+            insn->length = 6;
+            insn->dst = bytes[1];
+            insn->imm = fetch_imm32(bytes + 2);
+            insn->op = opcode == 0x90 ? I960_OP_LD_CONST : opcode == 0xC0 ? I960_OP_LD_ABS : I960_OP_LD_BYTE;
+            if (insn->dst >= 16) insn->op = I960_OP_SKIP;
             break;
-        }
 
-        case 0xCD: { // Unknown instruction, possibly a system call or special operation
-            uint32_t base_ip = cpu->ip;
-            uint8_t param1 = memory_read_byte(cpu->bus, base_ip + 1);
-            uint8_t param2 = memory_read_byte(cpu->bus, base_ip + 2);
+        case 0xC1: // st src, [addr32]
+        case 0xC3: // st_byte src, [addr32]
+            insn->length = 6;
+            insn->src1 = bytes[1];
+            insn->imm = fetch_imm32(bytes + 2);
+            insn->op = opcode == 0xC1 ? I960_OP_ST_ABS : I960_OP_ST_BYTE;
+            if (insn->src1 >= 16) insn->op = I960_OP_SKIP;
+            break;
 
-            std::cout << "Executing at 0x" << std::hex << base_ip
-                      << ": unknown_0xCD -> params: 0x" << std::hex << (int)param1 << ", 0x" << (int)param2 << std::endl;
-            // For now, just skip this instruction
-            cpu->ip += 3;
+        case 0x58: // add_reg dst, src1, src2
+        case 0xD0: // sub_reg
+        case 0xD1: // mul_reg
+        case 0xD2: // div_reg
+        case 0xE0: // and_reg
+        case 0xE1: // or_reg
+        case 0xE2: // xor_reg
+            insn->length = 4;
+            insn->dst = bytes[1];
+            insn->src1 = bytes[2];
+            insn->src2 = bytes[3];
+            switch (opcode) {
+                case 0x58: insn->op = I960_OP_ADD_REG; break;
+                case 0xD0: insn->op = I960_OP_SUB_REG; break;
+                case 0xD1: insn->op = I960_OP_MUL_REG; break;
+                case 0xD2: insn->op = I960_OP_DIV_REG; break;
+                case 0xE0: insn->op = I960_OP_AND_REG; break;
+                case 0xE1: insn->op = I960_OP_OR_REG; break;
+                default:   insn->op = I960_OP_XOR_REG; break;
+            }
+            if (insn->dst >= 16 || insn->src1 >= 16 || insn->src2 >= 16) insn->op = I960_OP_SKIP;
             break;
-        }
 
-        case 0xFD: { // Unknown instruction
-            uint32_t base_ip = cpu->ip;
-            uint8_t param = memory_read_byte(cpu->bus, base_ip + 1);
+        case 0xE3: // not_reg dst, src
+            insn->length = 3;
+            insn->dst = bytes[1];
+            insn->src1 = bytes[2];
+            insn->op = (insn->dst < 16 && insn->src1 < 16) ? I960_OP_NOT_REG : I960_OP_SKIP;
+            break;
 
-            std::cout << "Executing at 0x" << std::hex << base_ip
-                      << ": unknown_0xFD -> param: 0x" << std::hex << (int)param << std::endl;
-            cpu->ip += 2;
+        case 0xF0: // cmp_reg src1, src2
+            insn->length = 3;
+            insn->src1 = bytes[1];
+            insn->src2 = bytes[2];
+            insn->op = (insn->src1 < 16 && insn->src2 < 16) ? I960_OP_CMP_REG : I960_OP_SKIP;
             break;
-        }
 
-        case 0xFE: { // Unknown instruction
-            uint32_t base_ip = cpu->ip;
-            uint8_t param = memory_read_byte(cpu->bus, base_ip + 1);
+        case 0xF1: // beq target32
+        case 0xF2: // bne target32
+        case 0xF3: // jmp target32
+            insn->length = 5;
+            insn->imm = fetch_imm32(bytes + 1);
+            insn->op = opcode == 0xF1 ? I960_OP_BEQ : opcode == 0xF2 ? I960_OP_BNE : I960_OP_JMP;
+            insn->flags = I960_INSN_BRANCH;
+            break;
 
-            std::cout << "Executing at 0x" << std::hex << base_ip
-                      << ": unknown_0xFE -> param: 0x" << std::hex << (int)param << std::endl;
-            cpu->ip += 2;
+        case 0xFF: // halt
+            insn->length = 1;
+            insn->op = I960_OP_HALT;
+            insn->flags = I960_INSN_STOP;
             break;
-        }
 
-        case 0x01: { // Unknown instruction, possibly a nop or small immediate
-            uint32_t base_ip = cpu->ip;
-            std::cout << "Executing at 0x" << std::hex << base_ip << ": unknown_0x01" << std::endl;
-            cpu->ip += 1;
+        case 0xDD:
+        case 0xCD: // Unknown, two parameter bytes
+            insn->length = 3;
+            insn->src1 = bytes[1];
+            insn->src2 = bytes[2];
+            insn->op = I960_OP_UNKNOWN;
             break;
-        }
 
-        case 0x02: { // Unknown instruction
-            uint32_t base_ip = cpu->ip;
-            std::cout << "Executing at 0x" << std::hex << base_ip << ": unknown_0x02" << std::endl;
-            cpu->ip += 1;
+        case 0xFD:
+        case 0xFE:
+        case 0x21: // Unknown, one parameter byte
+            insn->length = 2;
+            insn->src1 = bytes[1];
+            insn->op = I960_OP_UNKNOWN;
             break;
-        }
 
-        case 0x03: { // Unknown instruction
-            uint32_t base_ip = cpu->ip;
-            std::cout << "Executing at 0x" << std::hex << base_ip << ": unknown_0x03" << std::endl;
-            cpu->ip += 1;
+        case 0x01:
+        case 0x02:
+        case 0x03: // Unknown, no parameters (possibly nop)
+            insn->length = 1;
+            insn->op = I960_OP_UNKNOWN;
             break;
-        }
 
-        case 0x21: { // Unknown instruction
-            uint32_t base_ip = cpu->ip;
-            uint8_t param = memory_read_byte(cpu->bus, base_ip + 1);
-            std::cout << "Executing at 0x" << std::hex << base_ip
-                      << ": unknown_0x21 -> param: 0x" << std::hex << (int)param << std::endl;
-            cpu->ip += 2;
+        default:
+            insn->length = 1;
+            insn->op = I960_OP_UNDEFINED;
+            insn->flags = I960_INSN_STOP;
             break;
+    }
+    insn->handler = i960_legacy_handlers[insn->op];
+
+    // Register operands name g0-g15 (unknown opcodes keep their raw bytes)
+    if (insn->op != I960_OP_UNKNOWN && insn->op != I960_OP_SKIP) {
+        insn->dst = legacy_reg(insn->dst);
+        insn->src1 = legacy_reg(insn->src1);
+        insn->src2 = legacy_reg(insn->src2);
+    }
+
+    // Addresses are immediate, so the memory region cost is known up front
+    insn->cycles = I960_OP_INFO[insn->op].cycles;
+    if (insn->op >= I960_OP_LD_ABS && insn->op <= I960_OP_ST_BYTE) {
+        insn->cycles += memory_access_cycles(insn->imm);
+    }
+}
+
+void i960_decode(i960_cpu* cpu, uint32_t ip, i960_decoded* insn) {
+    insn->ip = ip;
+    insn->generation = cpu->bus->code_generation;
+    if (cpu->isa == I960_ISA_KB) {
+        i960_decode_kb(cpu, ip, insn);
+    } else {
+        i960_decode_legacy(cpu, ip, insn);
+    }
+
+    // Remember that this code was decoded so writes to it invalidate the cache
+    memory_mark_code(cpu->bus, ip);
+    memory_mark_code(cpu->bus, ip + insn->length - 1);
+}
+
+void i960_fetch_resolve(i960_cpu* cpu, uint32_t address) {
+    uint32_t base = address & ~(I960_FETCH_PAGE_SIZE - 1);
+    cpu->fetch.page_base = base;
+    cpu->fetch.page = memory_host_pointer(cpu->bus, base);
+    cpu->fetch.map_generation = cpu->bus->map_generation;
+}
+
+const i960_decoded* i960_lookup(i960_cpu* cpu, uint32_t ip) {
+    i960_decoded* insn = &cpu->decode_cache->entries[ip & (I960_DECODE_CACHE_SIZE - 1)];
+    if (insn->ip != ip || insn->generation != cpu->bus->code_generation) {
+        i960_decode(cpu, ip, insn);
+    }
+    return insn;
+}
+
+void i960_step(i960_cpu* cpu) {
+    // Check if CPU is halted
+    if (cpu->halted) {
+        return; // Do nothing if halted
+    }
+
+    const i960_decoded* insn = i960_lookup(cpu, cpu->ip);
+    if (cpu->profiler) {
+        profiler_step(cpu->profiler, insn->ip);
+    }
+    insn->handler(cpu, insn);
+    cpu->cycles += insn->cycles;
+    if ((insn->flags & I960_INSN_BRANCH) && cpu->ip != insn->ip + insn->length && !cpu->halted) {
+        cpu->cycles += I960_TAKEN_BRANCH_CYCLES;
+    }
+}
+
+// Highest-numbered (so highest priority) pending, enabled vector, or -1
+static int i960_next_interrupt(const i960_cpu* cpu) {
+    for (int word = 7; word >= 0; --word) {
+        uint32_t bits = cpu->ipnd[word] & cpu->imsk[word];
+        if (bits != 0) {
+            int bit = 31;
+            while ((bits & (1u << bit)) == 0) {
+                --bit;
+            }
+            return word * 32 + bit;
         }
     }
+    return -1;
+}
+
+// Priority 31 is taken even at processor priority 31
+static bool i960_outranks(const i960_cpu* cpu, uint32_t priority) {
+    return priority > 0 && (priority > i960_priority(cpu) || priority == 31) && cpu->interrupt_depth < 32;
+}
+
+uint64_t i960_run(i960_cpu* cpu, uint64_t cycles) {
+    // Each delivery raises the processor priority, so this ends
+    while (i960_interrupt_ready(cpu)) {
+        i960_interrupt(cpu, (uint8_t)i960_next_interrupt(cpu));
+    }
+
+    uint64_t start = cpu->cycles;
+    cpu->run_end = cycles < UINT64_MAX - start ? start + cycles : UINT64_MAX;
+    if (cpu->engine != I960_ENGINE_INTERPRETER) {
+        return i960_block_execute(cpu);
+    }
+
+    // An interrupt becoming ready pulls run_end in, so the budget test
+    // is the only check per instruction
+    while (cpu->cycles < cpu->run_end && !cpu->halted) {
+        i960_step(cpu);
+    }
+    return cpu->cycles - start;
 }
 
 // --- Interrupt Management Functions ---
 
+void i960_update_interrupts(i960_cpu* cpu) {
+    int vector = i960_next_interrupt(cpu);
+    cpu->interrupt_ready = vector >= 0 && i960_outranks(cpu, (uint32_t)vector >> 3);
+    if (cpu->interrupt_ready) {
+        // End the current i960_run at the next block (or instruction) boundary
+        cpu->run_end = cpu->cycles;
+    }
+}
+
 void i960_interrupt(i960_cpu* cpu, uint8_t vector) {
-    if (cpu->interrupt_mode) {
-        std::cerr << "Nested interrupts not supported yet" << std::endl;
+    uint32_t priority = vector >> 3;
+    if (!i960_outranks(cpu, priority)) {
+        i960_request_interrupt(cpu, vector);
         return;
     }
 
-    if (vector >= 256 || cpu->interrupt_vectors[vector] == 0) {
+    cpu->ipnd[vector >> 5] &= ~(1u << (vector & 31));
+    if (cpu->interrupt_vectors[vector] == 0) {
         std::cerr << "Invalid or unhandled interrupt vector: " << (int)vector << std::endl;
+        i960_update_interrupts(cpu);
         return;
     }
 
-    // Save current state on interrupt stack
-    if (cpu->interrupt_sp < 32) {
-        cpu->interrupt_stack[cpu->interrupt_sp++] = cpu->ip;
-        cpu->interrupt_stack[cpu->interrupt_sp++] = cpu->zero_flag ? 1 : 0;
-        // Could save more state here (registers, etc.)
-    }
-
-    // Set interrupt mode
-    cpu->interrupt_mode = true;
-
-    // Jump to interrupt handler
+    // Save the interrupted context and run the handler at the vector's priority
+    i960_interrupt_frame& frame = cpu->interrupt_frames[cpu->interrupt_depth++];
+    frame.ip = cpu->ip;
+    frame.pc = cpu->pc;
+    frame.zero_flag = cpu->zero_flag;
+    cpu->pc = (cpu->pc & ~(0x1Fu << 16)) | priority << 16;
     cpu->ip = cpu->interrupt_vectors[vector];
+    i960_update_interrupts(cpu);
 
     std::cout << "Interrupt triggered: vector " << (int)vector
-              << " -> handler at 0x" << std::hex << cpu->ip << std::endl;
+              << " -> handler at 0x" << std::hex << cpu->ip << std::dec << std::endl;
+}
+
+void i960_request_interrupt(i960_cpu* cpu, uint8_t vector) {
+    cpu->ipnd[vector >> 5] |= 1u << (vector & 31);
+    i960_update_interrupts(cpu);
+}
+
+void i960_set_interrupt_enabled(i960_cpu* cpu, uint8_t vector, bool enabled) {
+    if (enabled) {
+        cpu->imsk[vector >> 5] |= 1u << (vector & 31);
+    } else {
+        cpu->imsk[vector >> 5] &= ~(1u << (vector & 31));
+    }
+    i960_update_interrupts(cpu);
 }
 
 void i960_return_from_interrupt(i960_cpu* cpu) {
-    if (!cpu->interrupt_mode || cpu->interrupt_sp < 2) {
-        std::cerr << "Not in interrupt mode or invalid interrupt stack" << std::endl;
+    if (cpu->interrupt_depth == 0) {
+        std::cerr << "Not in interrupt mode" << std::endl;
         return;
     }
 
-    // Restore state from interrupt stack
-    cpu->zero_flag = (cpu->interrupt_stack[--cpu->interrupt_sp] != 0);
-    cpu->ip = cpu->interrupt_stack[--cpu->interrupt_sp];
-    // Could restore more state here
-
-    // Clear interrupt mode
-    cpu->interrupt_mode = false;
+    // Restore the interrupted context; a lower priority may unmask pending interrupts
+    const i960_interrupt_frame& frame = cpu->interrupt_frames[--cpu->interrupt_depth];
+    cpu->ip = frame.ip;
+    cpu->pc = frame.pc;
+    cpu->zero_flag = frame.zero_flag;
+    i960_update_interrupts(cpu);
 
-    std::cout << "Returned from interrupt, IP = 0x" << std::hex << cpu->ip << std::endl;
+    std::cout << "Returned from interrupt, IP = 0x" << std::hex << cpu->ip << std::dec << std::endl;
 }
 
 void i960_set_interrupt_vector(i960_cpu* cpu, uint8_t vector, uint32_t address) {
-    if (vector < 256) {
-        cpu->interrupt_vectors[vector] = address;
-        std::cout << "Set interrupt vector " << (int)vector
-                  << " to address 0x" << std::hex << address << std::endl;
-    }
+    cpu->interrupt_vectors[vector] = address;
+    std::cout << "Set interrupt vector " << (int)vector
+              << " to address 0x" << std::hex << address << std::dec << std::endl;
 }
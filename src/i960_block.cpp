@@ -0,0 +1,246 @@
+#include "i960_block.h"
+#include "i960.h"
+#include "profiler.h"
+#include "trace.h"
+
+i960_block_cache* i960_block_cache_create() {
+    i960_block_cache* cache = new i960_block_cache();
+    cache->generation = 0;
+    return cache;
+}
+
+void i960_block_cache_destroy(i960_block_cache* cache) {
+    delete cache;
+}
+
+// Bit mask of a group of count registers starting at reg (wrapping within
+// r0-g15); literal slots are constants and contribute nothing
+static uint64_t i960_register_mask(uint8_t reg, uint32_t count) {
+    if (reg >= I960_REG_LITERAL) {
+        return 0;
+    }
+    uint64_t mask = 0;
+    for (uint32_t i = 0; i < count; ++i) {
+        mask |= 1ull << ((reg + i) & 31);
+    }
+    return mask;
+}
+
+// Registers (bits 0-31), the legacy zero flag (bit 32) and the condition
+// code (bit 33) read and written by an instruction
+static void i960_insn_state(const i960_decoded& insn, uint64_t* reads, uint64_t* writes) {
+    const uint64_t ZERO_FLAG = 1ull << 32;
+    const uint64_t CONDITION_CODE = 1ull << 33;
+    const i960_op_info& info = I960_OP_INFO[insn.op];
+    uint16_t uses = info.uses;
+    *reads = 0;
+    *writes = 0;
+    if (uses & I960_USE_SRC1) *reads |= i960_register_mask(insn.src1, (uses & I960_USE_WIDE_SRC1) ? info.regs : 1);
+    if (uses & I960_USE_SRC2) *reads |= i960_register_mask(insn.src2, (uses & I960_USE_WIDE_SRC2) ? 2 : 1);
+    if (uses & I960_USE_DST_IN) *reads |= i960_register_mask(insn.dst, info.regs);
+    if (uses & I960_USE_DST_OUT) *writes |= i960_register_mask(insn.dst, info.regs);
+    if (uses & I960_USE_ZF_IN) *reads |= ZERO_FLAG;
+    if (uses & I960_USE_ZF_OUT) *writes |= ZERO_FLAG;
+    if (uses & I960_USE_CC_IN) *reads |= CONDITION_CODE;
+    if (uses & I960_USE_CC_OUT) *writes |= CONDITION_CODE;
+}
+
+// True if running the block again right after it looped back to itself
+// reproduces exactly the same state: it stores nothing, has no other side
+// effect (halt, call, control registers), and every register or flag value it reads is either never
+// written by the block or was already written earlier in the same pass.
+// Loads are allowed because nothing but the CPU writes memory while it
+// runs, and device register reads do not change what the guest sees. They
+// are still observed by bus statistics, watchpoints and device traces, so
+// i960_idle_skip_allowed keeps skipping off while any of those is active.
+static bool i960_block_is_idle(const i960_block& block) {
+    if (block.taken_ip != block.start_ip || (block.ops.back().flags & (I960_INSN_BRANCH | I960_INSN_INDIRECT)) != I960_INSN_BRANCH) {
+        return false;
+    }
+
+    uint64_t reads, writes;
+    uint64_t all_writes = 0;
+    for (const i960_decoded& insn : block.ops) {
+        if (I960_OP_INFO[insn.op].uses & (I960_USE_STORE | I960_USE_SIDE)) {
+            return false;
+        }
+        i960_insn_state(insn, &reads, &writes);
+        all_writes |= writes;
+    }
+
+    // A value carried over from the previous pass may differ on the next one
+    uint64_t written_before = 0;
+    for (const i960_decoded& insn : block.ops) {
+        i960_insn_state(insn, &reads, &writes);
+        if (reads & all_writes & ~written_before) {
+            return false;
+        }
+        written_before |= writes;
+    }
+    return true;
+}
+
+// Decodes the basic block starting at ip into a new cache entry
+// Whether skipped iterations go unobserved: bus statistics, watchpoints and
+// traces count or log every access a skipped pass would have made
+static bool i960_idle_skip_allowed(const i960_cpu* cpu) {
+    const MemoryBus* bus = cpu->bus;
+    return cpu->idle_skip && !memory_stats_active(bus) && (bus->watch == nullptr || bus->watch->point_count == 0) &&
+           !trace_enabled<TRACE_CPU>(bus->trace) && !trace_enabled<TRACE_DEVICE>(bus->trace);
+}
+
+static i960_block* i960_block_translate(i960_cpu* cpu, uint32_t ip) {
+    i960_block& block = cpu->block_cache->blocks[ip];
+    block.start_ip = ip;
+    block.taken = nullptr;
+    block.fallthrough = nullptr;
+    block.exec_count = 0;
+    block.native = nullptr;
+    block.ops.clear();
+
+    block.cycles = 0;
+    block.max_cycles = 0;
+
+    uint32_t pc = ip;
+    for (;;) {
+        block.ops.emplace_back();
+        i960_decoded& insn = block.ops.back();
+        i960_decode(cpu, pc, &insn);
+        pc += insn.length;
+        block.cycles += insn.cycles;
+        block.max_cycles += insn.cycles;
+        if (I960_OP_INFO[insn.op].uses & I960_USE_MEMORY) {
+            block.max_cycles += I960_OP_INFO[insn.op].regs * MEMORY_MMIO_ACCESS_CYCLES;
+        }
+        if ((insn.flags & (I960_INSN_BRANCH | I960_INSN_STOP)) || block.ops.size() >= I960_BLOCK_MAX_INSNS) {
+            break;
+        }
+    }
+
+    const i960_decoded& last = block.ops.back();
+    block.end_ip = pc;
+    // Computed targets (bx, ret...) are only chained when they fall through
+    block.taken_ip = (last.flags & (I960_INSN_BRANCH | I960_INSN_INDIRECT)) == I960_INSN_BRANCH ? last.imm : pc;
+    block.idle = i960_block_is_idle(block);
+
+    // Peephole pass: fuse adjacent pairs, first match from the left
+    block.code.clear();
+    for (size_t i = 0; i < block.ops.size(); ++i) {
+        i960_handler fused = nullptr;
+        if (cpu->fusion && i + 1 < block.ops.size()) {
+            fused = i960_fuse_pair(&block.ops[i]);
+        }
+        block.code.push_back({fused ? fused : block.ops[i].handler, &block.ops[i]});
+        if (fused) {
+            ++i;
+        }
+    }
+    return &block;
+}
+
+static i960_block* i960_block_lookup(i960_cpu* cpu, uint32_t ip) {
+    auto it = cpu->block_cache->blocks.find(ip);
+    if (it != cpu->block_cache->blocks.end()) {
+        return &it->second;
+    }
+    return i960_block_translate(cpu, ip);
+}
+
+uint64_t i960_block_execute(i960_cpu* cpu) {
+    i960_block_cache* cache = cpu->block_cache;
+    i960_block* block = nullptr;
+    uint64_t start = cpu->cycles;
+
+    // Interrupts are only noticed between blocks, through run_end
+    while (cpu->cycles < cpu->run_end && !cpu->halted) {
+        // Guest code was overwritten (or the cache is full): drop every
+        // translation, and with it every chain pointer and compiled block.
+        // Stores that modify the rest of the block currently executing are
+        // picked up here, at the next block boundary.
+        if (cache->generation != cpu->bus->code_generation || cache->blocks.size() >= I960_BLOCK_CACHE_LIMIT ||
+            i960_jit_full(cpu->jit)) {
+            cache->blocks.clear();
+            cache->generation = cpu->bus->code_generation;
+            i960_jit_reset(cpu->jit);
+            block = nullptr;
+        }
+        if (block == nullptr) {
+            block = i960_block_lookup(cpu, cpu->ip);
+        }
+
+        if (block->max_cycles > cpu->run_end - cpu->cycles) {
+            // Budget ends inside this block: finish one instruction at a time
+            while (cpu->cycles < cpu->run_end && !cpu->halted) {
+                i960_step(cpu);
+            }
+            break;
+        }
+
+        // Threaded dispatch: no halt check or main-loop return between
+        // instructions. Compiled code runs the leading instructions it
+        // supports and the handlers finish the rest of the block.
+        uint64_t block_start = cpu->cycles;
+        if (cpu->profiler) {
+            profiler_block(cpu->profiler, block->ops.data(), (uint32_t)block->ops.size());
+        }
+        if (cpu->pair_stats) {
+            i960_pair_stats_record(cpu->pair_stats, block);
+        }
+        if (block->native) {
+            const i960_decoded* op = block->ops.data() + block->native(cpu);
+            const i960_decoded* end = block->ops.data() + block->ops.size();
+            for (; op != end; ++op) {
+                op->handler(cpu, op);
+            }
+        } else {
+            if (cpu->engine == I960_ENGINE_JIT && ++block->exec_count == I960_JIT_HOT_THRESHOLD &&
+                !trace_enabled<TRACE_CPU>(cpu->bus->trace)) {
+                // Compiled code does not emit instruction traces
+                block->native = i960_jit_compile(cpu, block);
+            }
+            const i960_thread_op* op = block->code.data();
+            const i960_thread_op* end = op + block->code.size();
+            for (; op != end; ++op) {
+                op->handler(cpu, op->insn);
+            }
+        }
+        cpu->cycles += block->cycles;
+        if ((block->ops.back().flags & I960_INSN_BRANCH) && cpu->ip != block->end_ip && !cpu->halted) {
+            cpu->cycles += I960_TAKEN_BRANCH_CYCLES;
+        }
+
+        // Idle loop that just went round: skip whole iterations up to the end
+        // of the budget, the next point where anything else can happen. Every
+        // pass costs what this one did, wait states of computed addresses included.
+        if (block->idle && cpu->ip == block->start_ip && cpu->cycles < cpu->run_end && i960_idle_skip_allowed(cpu)) {
+            uint64_t iteration = cpu->cycles - block_start;
+            uint64_t skipped = (cpu->run_end - cpu->cycles) / iteration * iteration;
+            cpu->cycles += skipped;
+            cpu->idle_cycles += skipped;
+            if (cpu->profiler && skipped > 0) {
+                profiler_block(cpu->profiler, block->ops.data(), (uint32_t)block->ops.size(), skipped / iteration);
+            }
+            if (cpu->pair_stats && skipped > 0) {
+                i960_pair_stats_record(cpu->pair_stats, block, skipped / iteration);
+            }
+        }
+
+        // Follow (or establish) the direct chain to the next block
+        i960_block** next = nullptr;
+        if (cpu->ip == block->end_ip) {
+            next = &block->fallthrough;
+        } else if (cpu->ip == block->taken_ip) {
+            next = &block->taken;
+        }
+        if (next == nullptr) {
+            block = nullptr;
+        } else {
+            if (*next == nullptr) {
+                *next = i960_block_lookup(cpu, cpu->ip);
+            }
+            block = *next;
+        }
+    }
+
+    return cpu->cycles - start;
+}
@@ -0,0 +1,75 @@
+#include "i960_fuse.h"
+#include "i960_block.h"
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <vector>
+
+i960_handler i960_fuse_pair(const i960_decoded* first) {
+    for (const i960_fusion* (*table)(uint32_t*) : {i960_legacy_fusions, i960_kb_fusions}) {
+        uint32_t count;
+        const i960_fusion* fusions = table(&count);
+        for (uint32_t i = 0; i < count; ++i) {
+            if (fusions[i].first == first[0].handler && fusions[i].second == first[1].handler) {
+                return fusions[i].fused;
+            }
+        }
+    }
+    return nullptr;
+}
+
+i960_pair_stats* i960_pair_stats_create() {
+    return new i960_pair_stats();
+}
+
+void i960_pair_stats_destroy(i960_pair_stats* stats) {
+    delete stats;
+}
+
+void i960_pair_stats_record(i960_pair_stats* stats, const i960_block* block, uint64_t repeat) {
+    const std::vector<i960_decoded>& ops = block->ops;
+    if (ops.empty()) {
+        return;
+    }
+    for (size_t i = 0; i + 1 < ops.size(); ++i) {
+        stats->counts[ops[i].op][ops[i + 1].op] += repeat;
+    }
+    stats->pairs += (ops.size() - 1) * repeat;
+    for (const i960_thread_op& dispatch : block->code) {
+        if (dispatch.handler != dispatch.insn->handler) {
+            stats->fused[dispatch.insn[0].op][dispatch.insn[1].op] = true;
+            stats->fused_pairs += repeat;
+        }
+    }
+}
+
+bool i960_pair_stats_write(const i960_pair_stats* stats, const char* path, uint32_t top) {
+    std::ofstream file(path);
+    if (!file) {
+        return false;
+    }
+
+    std::vector<std::pair<uint32_t, uint64_t>> pairs;
+    for (uint32_t first = 0; first < I960_OP_COUNT; ++first) {
+        for (uint32_t second = 0; second < I960_OP_COUNT; ++second) {
+            if (stats->counts[first][second] != 0) {
+                pairs.push_back({first * I960_OP_COUNT + second, stats->counts[first][second]});
+            }
+        }
+    }
+    std::sort(pairs.begin(), pairs.end(), [](const std::pair<uint32_t, uint64_t>& a, const std::pair<uint32_t, uint64_t>& b) {
+        return a.second != b.second ? a.second > b.second : a.first < b.first;
+    });
+
+    double fused = stats->pairs ? 100.0 * (double)stats->fused_pairs / (double)stats->pairs : 0.0;
+    file << "Instruction pairs in translated blocks: " << stats->pairs << ", " << std::fixed << std::setprecision(2)
+         << fused << "% dispatched fused\n\n       count  percent  pair\n";
+    for (size_t i = 0; i < pairs.size() && i < top; ++i) {
+        uint32_t first = pairs[i].first / I960_OP_COUNT;
+        uint32_t second = pairs[i].first % I960_OP_COUNT;
+        file << std::setw(12) << pairs[i].second << "  " << std::setw(6)
+             << 100.0 * (double)pairs[i].second / (double)stats->pairs << "%  " << i960_op_name((i960_op)first) << " + "
+             << i960_op_name((i960_op)second) << (stats->fused[first][second] ? "  (fused)" : "") << "\n";
+    }
+    return (bool)file;
+}
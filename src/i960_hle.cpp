@@ -0,0 +1,227 @@
+#include "i960_hle.h"
+#include "i960.h"
+#include "i960_decode.h"
+#include "miniz.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+// --- Native routines ---
+// Each one reproduces the straightforward guest loop exactly: same memory
+// contents, same result in g0, and the cycles that loop takes, counted as
+// the engines count them (base cost, wait states of every access, taken
+// branches). The reference loops are those of main_test_hle.cpp.
+// Destinations are written in place only when they are plain RAM;
+// sources are also read in place from ROM.
+
+// Wait states of count accesses stride bytes apart from address, as
+// memory_access_cycles charges them one at a time
+static uint64_t hle_access_cycles(uint32_t address, uint32_t count, uint32_t stride) {
+    uint64_t below = address >= MEMORY_SIZE ? 0 : std::min<uint64_t>(count, ((uint64_t)MEMORY_SIZE - address + stride - 1) / stride);
+    return below * MEMORY_RAM_ACCESS_CYCLES + (count - below) * MEMORY_MMIO_ACCESS_CYCLES;
+}
+
+// memcpy(g0 = dst, g1 = src, g2 = bytes), g0 kept. Reference loop, per byte:
+// ldob, stob, three addo/subo, cmpobl taken.
+static uint64_t hle_memcpy(i960_cpu* cpu) {
+    MemoryBus* bus = cpu->bus;
+    uint32_t dst = cpu->regs[I960_REG_G0];
+    uint32_t src = cpu->regs[I960_REG_G0 + 1];
+    uint32_t count = cpu->regs[I960_REG_G0 + 2];
+    if (count == 0) {
+        return 1 + I960_TAKEN_BRANCH_CYCLES;
+    }
+
+    uint64_t cycles = 0;
+    const uint8_t* from = memory_read_pointer(bus, src, count);
+    if (from != nullptr && memory_is_ram(bus, dst, count)) {
+        memory_stats_count(bus, src, count, false);
+        memory_stats_count(bus, dst, count, true);
+        memory_invalidate_code(bus, dst, count);
+        uint8_t* to = bus->ram + dst;
+        if (to > from && (uint64_t)(to - from) < count) {
+            // The byte loop copies forward: an overlapping destination
+            // above the source sees the bytes it already copied
+            for (uint32_t i = 0; i < count; ++i) {
+                to[i] = from[i];
+            }
+        } else {
+            memmove(to, from, count);
+        }
+        cycles = (uint64_t)count * (8 + MEMORY_RAM_ACCESS_CYCLES) + hle_access_cycles(src, count, 1);
+    } else {
+        for (uint32_t i = 0; i < count; ++i) {
+            memory_write_byte(bus, dst + i, memory_read_byte(bus, src + i));
+            cycles += 8 + memory_access_cycles(src + i) + memory_access_cycles(dst + i);
+        }
+    }
+    // cmpobe before the loop, the last cmpobl not taken
+    return cycles + 1 - I960_TAKEN_BRANCH_CYCLES;
+}
+
+// memset(g0 = dst, g1 = byte, g2 = bytes), g0 kept. Reference loop, per
+// byte: stob, addo, subo, cmpobl taken.
+static uint64_t hle_memset(i960_cpu* cpu) {
+    MemoryBus* bus = cpu->bus;
+    uint32_t dst = cpu->regs[I960_REG_G0];
+    uint8_t value = (uint8_t)cpu->regs[I960_REG_G0 + 1];
+    uint32_t count = cpu->regs[I960_REG_G0 + 2];
+    if (count == 0) {
+        return 1 + I960_TAKEN_BRANCH_CYCLES;
+    }
+
+    uint64_t cycles = 0;
+    if (memory_is_ram(bus, dst, count)) {
+        memory_stats_count(bus, dst, count, true);
+        memory_invalidate_code(bus, dst, count);
+        memset(bus->ram + dst, value, count);
+        cycles = (uint64_t)count * (6 + MEMORY_RAM_ACCESS_CYCLES);
+    } else {
+        for (uint32_t i = 0; i < count; ++i) {
+            memory_write_byte(bus, dst + i, value);
+            cycles += 6 + memory_access_cycles(dst + i);
+        }
+    }
+    return cycles + 1 - I960_TAKEN_BRANCH_CYCLES;
+}
+
+// checksum32(g0 = address, g1 = words): g0 = 32-bit sum of the words.
+// Reference loop, per word: ld, two addo, subo, cmpobl taken; then mov.
+static uint64_t hle_checksum32(i960_cpu* cpu) {
+    MemoryBus* bus = cpu->bus;
+    uint32_t address = cpu->regs[I960_REG_G0];
+    uint32_t count = cpu->regs[I960_REG_G0 + 1];
+    if (count == 0) {
+        cpu->regs[I960_REG_G0] = 0;
+        return 2 + I960_TAKEN_BRANCH_CYCLES;
+    }
+
+    uint32_t sum = 0;
+    uint64_t cycles = 0;
+    const uint8_t* words = count < 0x40000000u ? memory_read_pointer(bus, address, count * 4) : nullptr;
+    if (words != nullptr) {
+        memory_stats_count(bus, address, count * 4, false);
+        for (uint32_t i = 0; i < count; ++i) {
+            sum += memory_load_le32(words + 4 * i);
+        }
+        cycles = (uint64_t)count * 7 + hle_access_cycles(address, count, 4);
+    } else {
+        for (uint32_t i = 0; i < count; ++i) {
+            sum += memory_read_dword(bus, address + 4 * i);
+            cycles += 7 + memory_access_cycles(address + 4 * i);
+        }
+    }
+    cpu->regs[I960_REG_G0] = sum;
+    return cycles + 2 - I960_TAKEN_BRANCH_CYCLES;
+}
+
+struct i960_hle_routine_entry {
+    const char* name;
+    i960_hle_routine routine;
+};
+
+static const i960_hle_routine_entry i960_hle_routines[] = {
+    {"memcpy", hle_memcpy},
+    {"memset", hle_memset},
+    {"checksum32", hle_checksum32},
+};
+
+// --- Registry ---
+
+i960_hle* i960_hle_create() {
+    i960_hle* hle = new i960_hle();
+    hle->rom_hash = 0;
+    hle->calls = 0;
+    hle->cycles = 0;
+    return hle;
+}
+
+void i960_hle_destroy(i960_hle* hle) {
+    delete hle;
+}
+
+bool i960_hle_register(i960_hle* hle, uint32_t rom_hash, uint32_t entry, const char* routine, i960_hle_return ret) {
+    for (const i960_hle_routine_entry& known : i960_hle_routines) {
+        if (strcmp(known.name, routine) == 0) {
+            hle->hooks.push_back({rom_hash, entry, ret, known.routine, known.name, 0});
+            return true;
+        }
+    }
+    return false;
+}
+
+bool i960_hle_load(i960_hle* hle, const char* path) {
+    std::ifstream file(path);
+    if (!file) {
+        std::cerr << "Cannot open HLE hook list: " << path << std::endl;
+        return false;
+    }
+
+    std::string line;
+    for (int number = 1; std::getline(file, line); ++number) {
+        line = line.substr(0, line.find('#'));
+        std::istringstream fields(line);
+        std::string hash, entry, routine, convention;
+        if (!(fields >> hash)) {
+            continue; // Blank or comment
+        }
+        fields >> entry >> routine >> convention;
+        bool known_convention = convention == "bal" || convention == "call";
+        if (routine.empty() || !known_convention ||
+            !i960_hle_register(hle, (uint32_t)strtoul(hash.c_str(), nullptr, 16), (uint32_t)strtoul(entry.c_str(), nullptr, 16),
+                               routine.c_str(), convention == "call" ? I960_HLE_RETURN_RET : I960_HLE_RETURN_BX)) {
+            std::cerr << path << ":" << number << ": expected <rom crc32> <entry> <routine> <bal|call>" << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+uint32_t i960_hle_rom_hash(const MemoryBus* bus) {
+    // Page by page, as the ROM may be mapped rather than copied into RAM
+    static const uint8_t unmapped[MEMORY_PAGE_SIZE] = {};
+    mz_ulong crc = MZ_CRC32_INIT;
+    for (uint32_t address = 0; address < I960_HLE_ROM_HASH_SIZE; address += MEMORY_PAGE_SIZE) {
+        const MemoryPage* page = &bus->pages[address >> MEMORY_PAGE_SHIFT];
+        const uint8_t* host = page->watched ? page->watched_host : page->host;
+        crc = mz_crc32(crc, host != nullptr ? host : unmapped, MEMORY_PAGE_SIZE);
+    }
+    return (uint32_t)crc;
+}
+
+uint32_t i960_hle_attach(i960_cpu* cpu, i960_hle* hle, uint32_t rom_hash) {
+    hle->active.clear();
+    hle->rom_hash = rom_hash;
+    for (size_t i = 0; i < hle->hooks.size(); ++i) {
+        if (hle->hooks[i].rom_hash == rom_hash) {
+            hle->active[hle->hooks[i].entry] = i;
+        }
+    }
+    cpu->hle = hle;
+    // Hooked entries decode differently from now on
+    cpu->bus->code_generation++;
+    return (uint32_t)hle->active.size();
+}
+
+i960_hle_hook* i960_hle_lookup(i960_hle* hle, uint32_t ip) {
+    if (hle == nullptr) {
+        return nullptr;
+    }
+    auto it = hle->active.find(ip);
+    return it != hle->active.end() ? &hle->hooks[it->second] : nullptr;
+}
+
+uint64_t i960_hle_invoke(i960_cpu* cpu, i960_hle_hook* hook) {
+    uint64_t cycles = hook->routine(cpu);
+    // The return instruction itself (the hle instruction already pays for
+    // its taken branch)
+    cycles += I960_OP_INFO[hook->ret == I960_HLE_RETURN_RET ? I960_OP_RET : I960_OP_BX].cycles;
+    ++hook->calls;
+    ++cpu->hle->calls;
+    cpu->hle->cycles += cycles;
+    return cycles;
+}
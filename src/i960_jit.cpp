@@ -0,0 +1,860 @@
+#include "i960_jit.h"
+#include "i960.h"
+#include "i960_block.h"
+#include "i960_decode.h"
+#include "memory.h"
+#include <cstddef>
+#include <cstring>
+
+#if defined(__x86_64__) && !defined(_WIN32)
+#define I960_JIT_X64 1
+#include <sys/mman.h>
+#else
+#define I960_JIT_X64 0
+#endif
+
+struct i960_jit {
+    uint8_t* code;  // Executable code buffer
+    uint32_t used;  // Bytes handed out so far
+    bool full;      // A compile ran out of space
+};
+
+#if I960_JIT_X64
+
+namespace {
+
+enum X64Reg {
+    RAX = 0, RCX, RDX, RBX, RSP, RBP, RSI, RDI,
+    R8, R9, R10, R11, R12, R13, R14, R15
+};
+
+// Condition codes for jcc
+const uint8_t CC_B = 0x2;
+const uint8_t CC_E = 0x4;
+const uint8_t CC_NE = 0x5;
+
+// Minimal x86-64 instruction encoder covering what the block compiler emits.
+// All arithmetic is 32-bit; [base + disp32] and [base + index] addressing.
+struct X64Emitter {
+    uint8_t* start;
+    uint32_t size;
+    uint32_t capacity;
+    bool overflow;
+
+    void byte(uint8_t b) {
+        if (size < capacity) {
+            start[size++] = b;
+        } else {
+            overflow = true;
+        }
+    }
+    void dword(uint32_t v) {
+        for (int i = 0; i < 4; ++i) byte((uint8_t)(v >> (8 * i)));
+    }
+    void qword(uint64_t v) {
+        for (int i = 0; i < 8; ++i) byte((uint8_t)(v >> (8 * i)));
+    }
+    void rex(bool w, int reg, int index, int base, bool force = false) {
+        uint8_t r = 0x40 | (w ? 0x08 : 0) | (((reg >> 3) & 1) << 2) | (((index >> 3) & 1) << 1) | ((base >> 3) & 1);
+        if (r != 0x40 || force) byte(r);
+    }
+    // ModRM for [base + disp32]
+    void mem(int reg, int base, int32_t disp) {
+        byte(0x80 | ((reg & 7) << 3) | (base & 7));
+        if ((base & 7) == RSP) byte(0x24);
+        dword((uint32_t)disp);
+    }
+    // ModRM + SIB for [base + index]; base must not be rbp/r13
+    void mem_index(int reg, int base, int index) {
+        byte(0x04 | ((reg & 7) << 3));
+        byte(((index & 7) << 3) | (base & 7));
+    }
+
+    // op r/m32, r32 with a register destination
+    void alu_rr(uint8_t opcode, int dst, int src) {
+        rex(false, src, 0, dst);
+        byte(opcode);
+        byte(0xC0 | ((src & 7) << 3) | (dst & 7));
+    }
+    // opcode with a reg field and a [base + disp32] operand
+    void op_mem(uint8_t opcode, int reg, int base, int32_t disp) {
+        rex(false, reg, 0, base);
+        byte(opcode);
+        mem(reg, base, disp);
+    }
+
+    void mov_rr(int dst, int src) { alu_rr(0x89, dst, src); }
+    void mov_rm(int dst, int base, int32_t disp) { op_mem(0x8B, dst, base, disp); }
+    void mov_mr(int base, int32_t disp, int src) { op_mem(0x89, src, base, disp); }
+    void mov_ri(int dst, uint32_t imm) {
+        rex(false, 0, 0, dst);
+        byte(0xB8 + (dst & 7));
+        dword(imm);
+    }
+    void mov_mi(int base, int32_t disp, uint32_t imm) {
+        op_mem(0xC7, 0, base, disp);
+        dword(imm);
+    }
+    void movzx8_rm(int dst, int base, int32_t disp) {
+        rex(false, dst, 0, base);
+        byte(0x0F);
+        byte(0xB6);
+        mem(dst, base, disp);
+    }
+    void mov8_mr(int base, int32_t disp, int src) {
+        rex(false, src, 0, base, src >= 4);
+        byte(0x88);
+        mem(src, base, disp);
+    }
+    void mov64_ri(int dst, uint64_t imm) {
+        rex(true, 0, 0, dst);
+        byte(0xB8 + (dst & 7));
+        qword(imm);
+    }
+    void mov64_rr(int dst, int src) {
+        rex(true, src, 0, dst);
+        byte(0x89);
+        byte(0xC0 | ((src & 7) << 3) | (dst & 7));
+    }
+    void mov64_rm(int dst, int base, int32_t disp) {
+        rex(true, dst, 0, base);
+        byte(0x8B);
+        mem(dst, base, disp);
+    }
+    void imul_rr(int dst, int src) {
+        rex(false, dst, 0, src);
+        byte(0x0F);
+        byte(0xAF);
+        byte(0xC0 | ((dst & 7) << 3) | (src & 7));
+    }
+    // op r32, imm32 (group 1: /0 add, /4 and)
+    void alu_ri(uint8_t ext, int dst, uint32_t imm) {
+        rex(false, 0, 0, dst);
+        byte(0x81);
+        byte(0xC0 | (ext << 3) | (dst & 7));
+        dword(imm);
+    }
+    void shl_ri(int r, uint8_t n) {
+        rex(false, 0, 0, r);
+        byte(0xC1);
+        byte(0xC0 | (4 << 3) | (r & 7));
+        byte(n);
+    }
+    void test_ri(int r, uint32_t imm) {
+        rex(false, 0, 0, r);
+        byte(0xF7);
+        byte(0xC0 | (r & 7));
+        dword(imm);
+    }
+    void not_r(int r) {
+        rex(false, 0, 0, r);
+        byte(0xF7);
+        byte(0xC0 | (2 << 3) | (r & 7));
+    }
+    void test_rr(int a, int b) { alu_rr(0x85, a, b); }
+    void sete_m(int base, int32_t disp) {
+        rex(false, 0, 0, base);
+        byte(0x0F);
+        byte(0x94);
+        mem(0, base, disp);
+    }
+    void cmp_m8i(int base, int32_t disp, uint8_t imm) {
+        op_mem(0x80, 7, base, disp);
+        byte(imm);
+    }
+    void or_m8i(int base, int32_t disp, uint8_t imm) {
+        op_mem(0x80, 1, base, disp);
+        byte(imm);
+    }
+    void push(int r) {
+        if (r >= 8) byte(0x41);
+        byte(0x50 + (r & 7));
+    }
+    void pop(int r) {
+        if (r >= 8) byte(0x41);
+        byte(0x58 + (r & 7));
+    }
+    void add_rsp(uint8_t n) { byte(0x48); byte(0x83); byte(0xC4); byte(n); }
+    void sub_rsp(uint8_t n) { byte(0x48); byte(0x83); byte(0xEC); byte(n); }
+    void call_abs(const void* fn) {
+        mov64_ri(RAX, (uint64_t)(uintptr_t)fn);
+        byte(0xFF);
+        byte(0xD0);
+    }
+    void ret() { byte(0xC3); }
+
+    // Forward jumps: return the position of the rel32 field for patch()
+    uint32_t jcc(uint8_t cc) {
+        byte(0x0F);
+        byte(0x80 | cc);
+        uint32_t at = size;
+        dword(0);
+        return at;
+    }
+    uint32_t jmp() {
+        byte(0xE9);
+        uint32_t at = size;
+        dword(0);
+        return at;
+    }
+    void patch(uint32_t at, uint32_t target) {
+        if (at + 4 <= size) {
+            int32_t rel = (int32_t)(target - (at + 4));
+            memcpy(start + at, &rel, 4);
+        }
+    }
+};
+
+// Host registers that may hold guest registers, callee-saved first.
+// R8-R11 are caller-saved and get pushed around helper calls.
+const int CACHE_REGS[] = {RBP, R12, R13, R14, R8, R9, R10, R11};
+const int CACHE_REG_COUNT = 8;
+
+const int32_t OFF_REGS = (int32_t)offsetof(i960_cpu, regs);
+const int32_t OFF_IP = (int32_t)offsetof(i960_cpu, ip);
+const int32_t OFF_BUS = (int32_t)offsetof(i960_cpu, bus);
+const int32_t OFF_ZERO_FLAG = (int32_t)offsetof(i960_cpu, zero_flag);
+const int32_t OFF_AC = (int32_t)offsetof(i960_cpu, ac);
+const int32_t OFF_RAM = (int32_t)offsetof(MemoryBus, ram);
+
+// Host address of a load of width bytes that lies within one ROM page, or
+// nullptr
+static const uint8_t* jit_rom_pointer(const MemoryBus* bus, uint32_t addr, uint32_t width) {
+    const MemoryPage* page = memory_page(bus, addr);
+    uint32_t offset = addr & (MEMORY_PAGE_SIZE - 1);
+    return page->read_only && page->host != nullptr && offset <= MEMORY_PAGE_SIZE - width ? page->host + offset : nullptr;
+}
+
+// KB loads and stores at computed addresses: one bus access plus its wait
+// states, like the interpreter's handlers
+template <typename T>
+static uint32_t jit_kb_load(i960_cpu* cpu, uint32_t address) {
+    cpu->cycles += memory_access_cycles(address);
+    return bus_read<T>(cpu->bus, address);
+}
+
+template <typename T>
+static void jit_kb_store(i960_cpu* cpu, uint32_t address, uint32_t value) {
+    cpu->cycles += memory_access_cycles(address);
+    bus_write<T>(cpu->bus, address, (T)value);
+}
+
+struct BlockCompiler {
+    X64Emitter e;
+    i960_cpu* cpu;
+    int host_of[32];       // Host register caching each guest register, or -1
+    uint32_t written;      // Cached guest registers modified by the block
+    uint32_t exits[2 * I960_BLOCK_MAX_INSNS + 2]; // rel32 fields jumping to the epilogue
+    uint32_t exit_count;
+
+    int32_t guest_offset(int g) const { return OFF_REGS + 4 * g; }
+
+    void load_guest(int host, int g) {
+        if (g >= I960_REG_LITERAL) {
+            e.mov_ri(host, cpu->regs[g]); // Literal slots never change
+        } else if (host_of[g] >= 0) {
+            e.mov_rr(host, host_of[g]);
+        } else {
+            e.mov_rm(host, RBX, guest_offset(g));
+        }
+    }
+    void store_guest(int g, int host) {
+        if (host_of[g] >= 0) {
+            e.mov_rr(host_of[g], host);
+            written |= (1u << g);
+        } else {
+            e.mov_mr(RBX, guest_offset(g), host);
+        }
+    }
+
+    // Calls a bus helper: rdi = bus (or the CPU), esi/edx already hold the
+    // other arguments. Cached guest registers living in caller-saved host
+    // registers are preserved.
+    void call_helper(const void* fn, bool pass_cpu = false) {
+        int saved[4];
+        int n = 0;
+        for (int i = 0; i < CACHE_REG_COUNT; ++i) {
+            int r = CACHE_REGS[i];
+            if (r >= R8 && r <= R11) {
+                for (int g = 0; g < 32; ++g) {
+                    if (host_of[g] == r) {
+                        saved[n++] = r;
+                        break;
+                    }
+                }
+            }
+        }
+        for (int i = 0; i < n; ++i) e.push(saved[i]);
+        if (n & 1) e.sub_rsp(8); // Keep the stack 16-byte aligned at the call
+        if (pass_cpu) {
+            e.mov64_rr(RDI, RBX);
+        } else {
+            e.mov64_rm(RDI, RBX, OFF_BUS);
+        }
+        e.call_abs(fn);
+        if (n & 1) e.add_rsp(8);
+        for (int i = n - 1; i >= 0; --i) e.pop(saved[i]);
+    }
+
+    // Points cpu->ip at insn before a call into the bus, which records it
+    // with watchpoint hits; the block otherwise only writes it on exit
+    void publish_ip(const i960_decoded& insn) {
+        e.mov_mi(RBX, OFF_IP, insn.ip);
+    }
+
+    // Leaves the block with cpu->ip = ip, reporting `executed` instructions
+    void exit(uint32_t ip, uint32_t executed) {
+        e.mov_mi(RBX, OFF_IP, ip);
+        e.mov_ri(RAX, executed);
+        exits[exit_count++] = e.jmp();
+    }
+
+    void set_zero_flag_from(int host) {
+        e.test_rr(host, host);
+        e.sete_m(RBX, OFF_ZERO_FLAG);
+    }
+
+    // Replaces ac.cc with the condition code in edx
+    void set_cc_from_rdx() {
+        e.mov_rm(RAX, RBX, OFF_AC);
+        e.alu_ri(4, RAX, ~7u);
+        e.alu_rr(0x09, RAX, RDX);
+        e.mov_mr(RBX, OFF_AC, RAX);
+    }
+
+    // Unsigned compare of src1 with src2 into ac.cc and edx:
+    // 100 less, 010 equal, 001 greater
+    void emit_compare(const i960_decoded& insn) {
+        load_guest(RAX, insn.src1);
+        load_guest(RCX, insn.src2);
+        e.mov_ri(RDX, 4);
+        e.alu_rr(0x39, RAX, RCX);
+        uint32_t to_done1 = e.jcc(CC_B);
+        e.mov_ri(RDX, 2);
+        uint32_t to_done2 = e.jcc(CC_E);
+        e.mov_ri(RDX, 1);
+        e.patch(to_done1, e.size);
+        e.patch(to_done2, e.size);
+        set_cc_from_rdx();
+    }
+
+    // Ends the block on a KB conditional branch whose condition code is in
+    // edx: mask 0 is taken on cc 000, any other mask when cc & mask != 0
+    void emit_branch_on_cc(const i960_decoded& insn, uint32_t executed) {
+        e.test_ri(RDX, insn.aux == 0 ? 7 : insn.aux);
+        uint32_t to_taken = e.jcc(insn.aux == 0 ? CC_E : CC_NE);
+        exit(insn.ip + insn.length, executed);
+        e.patch(to_taken, e.size);
+        exit(insn.imm, executed);
+    }
+
+    // KB effective address abase + (index << scale) + displacement into
+    // host; terms decoded as the literal 0 are left out
+    void emit_address(const i960_decoded& insn, int host) {
+        load_guest(host, insn.src1);
+        if (insn.src2 != I960_REG_LITERAL) {
+            load_guest(RCX, insn.src2);
+            if (insn.aux != 0) e.shl_ri(RCX, insn.aux);
+            e.alu_rr(0x01, host, RCX);
+        }
+        if (insn.imm != 0) e.alu_ri(0, host, insn.imm);
+    }
+
+    void emit_kb_load(const i960_decoded& insn, bool byte_access) {
+        emit_address(insn, RSI);
+        publish_ip(insn);
+        call_helper(byte_access ? (const void*)jit_kb_load<uint8_t> : (const void*)jit_kb_load<uint32_t>, true);
+        store_guest(insn.dst, RAX);
+    }
+
+    void emit_kb_store(const i960_decoded& insn, bool byte_access) {
+        emit_address(insn, RSI);
+        load_guest(RDX, insn.dst);
+        publish_ip(insn);
+        call_helper(byte_access ? (const void*)jit_kb_store<uint8_t> : (const void*)jit_kb_store<uint32_t>, true);
+    }
+
+    void emit_load(const i960_decoded& insn, bool byte_access) {
+        uint32_t addr = insn.imm;
+        uint32_t width = byte_access ? 1 : 4;
+        bool direct = !memory_stats_active(cpu->bus); // Counted accesses go through the bus
+        if (direct && memory_is_ram(cpu->bus, addr, width)) {
+            // Plain RAM: a single host load
+            if (byte_access) {
+                e.movzx8_rm(RAX, R15, (int32_t)addr);
+            } else {
+                e.mov_rm(RAX, R15, (int32_t)addr);
+            }
+        } else if (const uint8_t* rom = direct ? jit_rom_pointer(cpu->bus, addr, width) : nullptr) {
+            // ROM: a host load from its fixed address (remapping it
+            // bumps the code generation, dropping this block)
+            e.mov64_ri(RDI, (uint64_t)(uintptr_t)rom);
+            if (byte_access) {
+                e.movzx8_rm(RAX, RDI, 0);
+            } else {
+                e.mov_rm(RAX, RDI, 0);
+            }
+        } else {
+            // MMIO or the ragged end of RAM: let the bus decide
+            e.mov_ri(RSI, addr);
+            publish_ip(insn);
+            call_helper(byte_access ? (const void*)memory_read_byte : (const void*)memory_read_dword);
+            if (byte_access) {
+                e.byte(0x0F); e.byte(0xB6); e.byte(0xC0); // movzx eax, al
+            }
+        }
+        store_guest(insn.dst, RAX);
+    }
+
+    void emit_store(const i960_decoded& insn, bool byte_access) {
+        uint32_t addr = insn.imm;
+        uint32_t width = byte_access ? 1 : 4;
+        load_guest(RCX, insn.src1);
+        const void* helper = byte_access ? (const void*)memory_write_byte : (const void*)memory_write_dword;
+
+        if (!memory_is_ram(cpu->bus, addr, width) || memory_stats_active(cpu->bus)) {
+            // ROM, MMIO, the ragged end of RAM, or counted by the bus
+            e.mov_rr(RDX, RCX);
+            e.mov_ri(RSI, addr);
+            publish_ip(insn);
+            call_helper(helper);
+            return;
+        }
+
+        // Fast path unless the store lands on a page holding decoded code,
+        // in which case the bus has to invalidate it
+        uint32_t first_page = addr >> CODE_PAGE_SHIFT;
+        uint32_t last_page = (addr + width - 1) >> CODE_PAGE_SHIFT;
+        e.mov64_ri(RDI, (uint64_t)(uintptr_t)cpu->bus->code_pages);
+        e.cmp_m8i(RDI, (int32_t)first_page, 0);
+        uint32_t to_slow1 = e.jcc(CC_NE);
+        uint32_t to_slow2 = 0;
+        if (last_page != first_page) {
+            e.cmp_m8i(RDI, (int32_t)last_page, 0);
+            to_slow2 = e.jcc(CC_NE);
+        }
+        // Mark the page dirty: bit n of the little-endian bitmap is bit
+        // n % 8 of byte n / 8
+        e.mov64_ri(RDI, (uint64_t)(uintptr_t)cpu->bus->dirty_pages);
+        e.or_m8i(RDI, (int32_t)(first_page >> 3), (uint8_t)(1u << (first_page & 7)));
+        if (last_page != first_page) {
+            e.or_m8i(RDI, (int32_t)(last_page >> 3), (uint8_t)(1u << (last_page & 7)));
+        }
+        if (byte_access) {
+            e.mov8_mr(R15, (int32_t)addr, RCX);
+        } else {
+            e.mov_mr(R15, (int32_t)addr, RCX);
+        }
+        uint32_t to_done = e.jmp();
+
+        e.patch(to_slow1, e.size);
+        if (to_slow2) e.patch(to_slow2, e.size);
+        e.mov_rr(RDX, RCX);
+        e.mov_ri(RSI, addr);
+        publish_ip(insn);
+        call_helper(helper);
+        e.patch(to_done, e.size);
+    }
+};
+
+// Whether insn accesses a page with watchpoints, which only the bus checks.
+// KB loads and stores always go through the bus and need no check.
+static bool jit_watched(const MemoryBus* bus, const i960_decoded& insn) {
+    switch (insn.op) {
+        case I960_OP_LD_ABS:
+        case I960_OP_ST_ABS:
+        case I960_OP_LD_BYTE:
+        case I960_OP_ST_BYTE:
+            return bus->watch != nullptr && (memory_page(bus, insn.imm)->watched || memory_page(bus, insn.imm + 3)->watched);
+        default:
+            return false;
+    }
+}
+
+// Whether the JIT can compile this instruction
+bool jit_supports(const i960_decoded& insn) {
+    switch (insn.op) {
+        case I960_OP_LD_CONST:
+        case I960_OP_ADD_REG:
+        case I960_OP_SUB_REG:
+        case I960_OP_MUL_REG:
+        case I960_OP_AND_REG:
+        case I960_OP_OR_REG:
+        case I960_OP_XOR_REG:
+        case I960_OP_NOT_REG:
+        case I960_OP_LD_ABS:
+        case I960_OP_ST_ABS:
+        case I960_OP_LD_BYTE:
+        case I960_OP_ST_BYTE:
+        case I960_OP_CMP_REG:
+        case I960_OP_BEQ:
+        case I960_OP_BNE:
+            return true;
+        case I960_OP_JMP:
+            return insn.imm < MEMORY_SIZE; // Out-of-range targets halt via the interpreter
+        case I960_OP_ADDO:
+        case I960_OP_SUBO:
+        case I960_OP_MULO:
+        case I960_OP_AND:
+        case I960_OP_OR:
+        case I960_OP_XOR:
+        case I960_OP_MOV:
+        case I960_OP_LDA:
+        case I960_OP_CMPO:
+        case I960_OP_CMPOB:
+        case I960_OP_B:
+        case I960_OP_BCC:
+        case I960_OP_LD:
+        case I960_OP_ST:
+        case I960_OP_LDOB:
+        case I960_OP_STOB:
+            return true;
+        default:
+            return false;
+    }
+}
+
+bool writes_zero_flag(i960_op op) {
+    return (op >= I960_OP_ADD_REG && op <= I960_OP_NOT_REG && op != I960_OP_DIV_REG) || op == I960_OP_CMP_REG;
+}
+
+bool reads_zero_flag(i960_op op) {
+    return op == I960_OP_BEQ || op == I960_OP_BNE;
+}
+
+} // namespace
+
+bool i960_jit_available() {
+    return true;
+}
+
+i960_jit* i960_jit_create() {
+    void* code = mmap(nullptr, I960_JIT_CODE_SIZE, PROT_READ | PROT_WRITE | PROT_EXEC,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (code == MAP_FAILED) {
+        return nullptr;
+    }
+    i960_jit* jit = new i960_jit();
+    jit->code = (uint8_t*)code;
+    jit->used = 0;
+    jit->full = false;
+    return jit;
+}
+
+void i960_jit_destroy(i960_jit* jit) {
+    if (jit) {
+        munmap(jit->code, I960_JIT_CODE_SIZE);
+        delete jit;
+    }
+}
+
+i960_native_block i960_jit_compile(i960_cpu* cpu, const i960_block* block) {
+    i960_jit* jit = cpu->jit;
+    const i960_decoded* ops = block->ops.data();
+    uint32_t count = (uint32_t)block->ops.size();
+
+    // Compile the longest supported prefix
+    uint32_t compiled = 0;
+    while (compiled < count && jit_supports(ops[compiled]) && !jit_watched(cpu->bus, ops[compiled])) {
+        compiled++;
+    }
+    if (compiled == 0) {
+        return nullptr;
+    }
+
+    // Pick the most used guest registers to keep in host registers (literal
+    // slots are counted but never cached)
+    int uses[I960_REG_COUNT] = {0};
+    for (uint32_t i = 0; i < compiled; ++i) {
+        const i960_decoded& insn = ops[i];
+        switch (insn.op) {
+            case I960_OP_LD_CONST:
+            case I960_OP_LD_ABS:
+            case I960_OP_LD_BYTE:
+                uses[insn.dst]++;
+                break;
+            case I960_OP_ST_ABS:
+            case I960_OP_ST_BYTE:
+                uses[insn.src1]++;
+                break;
+            case I960_OP_NOT_REG:
+                uses[insn.dst]++;
+                uses[insn.src1]++;
+                break;
+            case I960_OP_CMP_REG:
+            case I960_OP_CMPO:
+            case I960_OP_CMPOB:
+                uses[insn.src1]++;
+                uses[insn.src2]++;
+                break;
+            case I960_OP_BEQ:
+            case I960_OP_BNE:
+            case I960_OP_JMP:
+            case I960_OP_B:
+            case I960_OP_BCC:
+                break;
+            default:
+                uses[insn.dst]++;
+                uses[insn.src1]++;
+                uses[insn.src2]++;
+                break;
+        }
+    }
+
+    BlockCompiler c;
+    c.e.start = jit->code + jit->used;
+    c.e.size = 0;
+    c.e.capacity = I960_JIT_CODE_SIZE - jit->used;
+    c.e.overflow = false;
+    c.cpu = cpu;
+    c.written = 0;
+    c.exit_count = 0;
+    for (int g = 0; g < 32; ++g) c.host_of[g] = -1;
+    for (int slot = 0; slot < CACHE_REG_COUNT; ++slot) {
+        int best = -1;
+        for (int g = 0; g < 32; ++g) {
+            if (c.host_of[g] < 0 && uses[g] >= 2 && (best < 0 || uses[g] > uses[best])) {
+                best = g;
+            }
+        }
+        if (best < 0) break;
+        c.host_of[best] = CACHE_REGS[slot];
+    }
+
+    // A zero_flag update only needs storing if something can observe it
+    // before the next update: a branch in the block, or code after the exit
+    bool flag_needed[I960_BLOCK_MAX_INSNS];
+    bool live = true;
+    for (int i = (int)compiled - 1; i >= 0; --i) {
+        flag_needed[i] = live;
+        if (writes_zero_flag(ops[i].op)) live = false;
+        if (reads_zero_flag(ops[i].op)) live = true;
+    }
+
+    // Prologue: save callee-saved registers, rbx = cpu, r15 = guest RAM
+    X64Emitter& e = c.e;
+    e.push(RBX);
+    e.push(RBP);
+    e.push(R12);
+    e.push(R13);
+    e.push(R14);
+    e.push(R15);
+    e.sub_rsp(8);
+    e.mov64_rr(RBX, RDI);
+    e.mov64_rm(R15, RBX, OFF_BUS);
+    e.mov64_rm(R15, R15, OFF_RAM);
+    for (int g = 0; g < 32; ++g) {
+        if (c.host_of[g] >= 0) e.mov_rm(c.host_of[g], RBX, c.guest_offset(g));
+    }
+
+    bool ended = false;
+    for (uint32_t i = 0; i < compiled; ++i) {
+        const i960_decoded& insn = ops[i];
+        switch (insn.op) {
+            case I960_OP_LD_CONST:
+                if (c.host_of[insn.dst] >= 0) {
+                    e.mov_ri(c.host_of[insn.dst], insn.imm);
+                    c.written |= (1u << insn.dst);
+                } else {
+                    e.mov_mi(RBX, c.guest_offset(insn.dst), insn.imm);
+                }
+                break;
+
+            case I960_OP_ADD_REG:
+            case I960_OP_SUB_REG:
+            case I960_OP_MUL_REG:
+            case I960_OP_AND_REG:
+            case I960_OP_OR_REG:
+            case I960_OP_XOR_REG:
+                c.load_guest(RAX, insn.src1);
+                c.load_guest(RCX, insn.src2);
+                switch (insn.op) {
+                    case I960_OP_ADD_REG: e.alu_rr(0x01, RAX, RCX); break;
+                    case I960_OP_SUB_REG: e.alu_rr(0x29, RAX, RCX); break;
+                    case I960_OP_MUL_REG: e.imul_rr(RAX, RCX); break;
+                    case I960_OP_AND_REG: e.alu_rr(0x21, RAX, RCX); break;
+                    case I960_OP_OR_REG:  e.alu_rr(0x09, RAX, RCX); break;
+                    default:          e.alu_rr(0x31, RAX, RCX); break;
+                }
+                c.store_guest(insn.dst, RAX);
+                if (flag_needed[i]) c.set_zero_flag_from(RAX);
+                break;
+
+            case I960_OP_NOT_REG:
+                c.load_guest(RAX, insn.src1);
+                e.not_r(RAX);
+                c.store_guest(insn.dst, RAX);
+                if (flag_needed[i]) c.set_zero_flag_from(RAX);
+                break;
+
+            case I960_OP_CMP_REG:
+                c.load_guest(RAX, insn.src1);
+                c.load_guest(RCX, insn.src2);
+                e.alu_rr(0x39, RAX, RCX);
+                e.sete_m(RBX, OFF_ZERO_FLAG);
+                break;
+
+            case I960_OP_LD_ABS:
+                c.emit_load(insn, false);
+                break;
+            case I960_OP_LD_BYTE:
+                c.emit_load(insn, true);
+                break;
+            case I960_OP_ST_ABS:
+                c.emit_store(insn, false);
+                break;
+            case I960_OP_ST_BYTE:
+                c.emit_store(insn, true);
+                break;
+
+            case I960_OP_BEQ:
+            case I960_OP_BNE: {
+                e.cmp_m8i(RBX, OFF_ZERO_FLAG, 0);
+                // beq is taken when zero_flag != 0, bne when it is 0
+                uint32_t to_taken = e.jcc(insn.op == I960_OP_BEQ ? CC_NE : CC_E);
+                c.exit(insn.ip + insn.length, i + 1);
+                e.patch(to_taken, e.size);
+                c.exit(insn.imm, i + 1);
+                ended = true;
+                break;
+            }
+
+            case I960_OP_JMP:
+            case I960_OP_B:
+                c.exit(insn.imm, i + 1);
+                ended = true;
+                break;
+
+            // KB register operations: "subo src1, src2, dst" is src2 - src1
+            case I960_OP_ADDO:
+            case I960_OP_SUBO:
+            case I960_OP_MULO:
+            case I960_OP_AND:
+            case I960_OP_OR:
+            case I960_OP_XOR:
+                c.load_guest(RAX, insn.src2);
+                c.load_guest(RCX, insn.src1);
+                switch (insn.op) {
+                    case I960_OP_ADDO: e.alu_rr(0x01, RAX, RCX); break;
+                    case I960_OP_SUBO: e.alu_rr(0x29, RAX, RCX); break;
+                    case I960_OP_MULO: e.imul_rr(RAX, RCX); break;
+                    case I960_OP_AND:  e.alu_rr(0x21, RAX, RCX); break;
+                    case I960_OP_OR:   e.alu_rr(0x09, RAX, RCX); break;
+                    default:           e.alu_rr(0x31, RAX, RCX); break;
+                }
+                c.store_guest(insn.dst, RAX);
+                break;
+
+            case I960_OP_MOV:
+                c.load_guest(RAX, insn.src1);
+                c.store_guest(insn.dst, RAX);
+                break;
+
+            case I960_OP_LDA:
+                c.emit_address(insn, RAX);
+                c.store_guest(insn.dst, RAX);
+                break;
+
+            case I960_OP_CMPO:
+                c.emit_compare(insn);
+                break;
+
+            case I960_OP_CMPOB:
+                c.emit_compare(insn);
+                c.emit_branch_on_cc(insn, i + 1);
+                ended = true;
+                break;
+
+            case I960_OP_BCC:
+                e.mov_rm(RDX, RBX, OFF_AC);
+                c.emit_branch_on_cc(insn, i + 1);
+                ended = true;
+                break;
+
+            case I960_OP_LD:
+                c.emit_kb_load(insn, false);
+                break;
+            case I960_OP_LDOB:
+                c.emit_kb_load(insn, true);
+                break;
+            case I960_OP_ST:
+                c.emit_kb_store(insn, false);
+                break;
+            case I960_OP_STOB:
+                c.emit_kb_store(insn, true);
+                break;
+
+            default:
+                break;
+        }
+    }
+    if (!ended) {
+        // Fell off the compiled prefix: resume at the next instruction
+        uint32_t next_ip = compiled < count ? ops[compiled].ip : block->end_ip;
+        c.exit(next_ip, compiled);
+    }
+
+    // Epilogue: write back modified cached registers and restore host state
+    uint32_t epilogue = e.size;
+    for (uint32_t i = 0; i < c.exit_count; ++i) {
+        e.patch(c.exits[i], epilogue);
+    }
+    for (int g = 0; g < 32; ++g) {
+        if (c.host_of[g] >= 0 && (c.written & (1u << g))) {
+            e.mov_mr(RBX, c.guest_offset(g), c.host_of[g]);
+        }
+    }
+    e.add_rsp(8);
+    e.pop(R15);
+    e.pop(R14);
+    e.pop(R13);
+    e.pop(R12);
+    e.pop(RBP);
+    e.pop(RBX);
+    e.ret();
+
+    if (e.overflow) {
+        jit->full = true;
+        return nullptr;
+    }
+    i960_native_block native = (i960_native_block)(void*)e.start;
+    jit->used += (e.size + 15) & ~15u;
+    return native;
+}
+
+#else // !I960_JIT_X64
+
+bool i960_jit_available() {
+    return false;
+}
+
+i960_jit* i960_jit_create() {
+    return nullptr;
+}
+
+void i960_jit_destroy(i960_jit* jit) {
+    delete jit;
+}
+
+i960_native_block i960_jit_compile(i960_cpu* cpu, const i960_block* block) {
+    (void)cpu;
+    (void)block;
+    return nullptr;
+}
+
+#endif // I960_JIT_X64
+
+void i960_jit_reset(i960_jit* jit) {
+    if (jit) {
+        jit->used = 0;
+        jit->full = false;
+    }
+}
+
+bool i960_jit_full(const i960_jit* jit) {
+    return jit && jit->full;
+}
+
+uint32_t i960_jit_code_used(const i960_jit* jit) {
+    return jit ? jit->used : 0;
+}
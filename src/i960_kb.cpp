@@ -0,0 +1,838 @@
+#include "i960.h"
+#include "i960_decode.h"
+#include "i960_fuse.h"
+#include "i960_hle.h"
+#include "profiler.h"
+#include "trace.h"
+#include <array>
+
+// i960 KB/CA instruction set.
+//
+// Every instruction is one little-endian 32-bit word (MEM instructions with
+// a displacement add a second word). The primary opcode in bits 31-24
+// selects the format:
+//   0x00-0x1F CTRL  opcode | displacement(23-2) | T
+//   0x20-0x3F COBR  opcode | src1(23-19) | src2(18-14) | M1 | displacement(12-2) | T | S2
+//   0x40-0x7F REG   opcode | dst(23-19) | src2(18-14) | M3 M2 M1 | opcode2(10-7) | S2 S1 | src1(4-0)
+//   0x80-0xFF MEM   opcode | dst(23-19) | abase(18-14) | MEMA or MEMB addressing
+//
+// The opcode tables below are built at compile time: decoding an
+// instruction is one lookup (two for REG, whose opcode continues in
+// bits 10-7) followed by the operand extraction of its format.
+
+// Instruction formats
+enum i960_kb_format : uint8_t {
+    KB_FORMAT_CTRL,
+    KB_FORMAT_COBR,
+    KB_FORMAT_REG,
+    KB_FORMAT_MEM,
+};
+
+static inline void trace_insn(i960_cpu* cpu, const i960_decoded* insn, uint8_t reg, uint32_t value) {
+    trace_record<TRACE_CPU>(cpu->bus->trace, TRACE_EVENT_INSN, insn->op, reg, insn->opcode, insn->ip, value, insn->imm);
+}
+
+// --- Condition codes ---
+// Compares set AC.cc to 100 (less), 010 (equal) or 001 (greater); a
+// conditional instruction with mask m is true when cc & m is non-zero, or
+// for m == 0 (the "no" conditions) when cc is 000.
+
+static inline uint32_t kb_cc(const i960_cpu* cpu) {
+    return cpu->ac & 7;
+}
+
+static inline void kb_set_cc(i960_cpu* cpu, uint32_t cc) {
+    cpu->ac = (cpu->ac & ~7u) | cc;
+}
+
+static inline bool kb_condition(const i960_cpu* cpu, uint8_t mask) {
+    return mask == 0 ? kb_cc(cpu) == 0 : (kb_cc(cpu) & mask) != 0;
+}
+
+template <typename T>
+static inline uint32_t kb_compare(uint32_t src1, uint32_t src2) {
+    T a = (T)src1;
+    T b = (T)src2;
+    return a < b ? 4 : a == b ? 2 : 1;
+}
+
+// Register i of the group starting at reg (movl, ldq, emul...). Groups wrap
+// within r0-g15; a literal group is the literal followed by zeros.
+static inline uint32_t kb_group_read(const i960_cpu* cpu, uint8_t reg, uint32_t i) {
+    if (reg >= I960_REG_LITERAL) {
+        return i == 0 ? cpu->regs[reg] : 0;
+    }
+    return cpu->regs[(reg + i) & 31];
+}
+
+static inline void kb_group_write(i960_cpu* cpu, uint8_t reg, uint32_t i, uint32_t value) {
+    cpu->regs[(reg + i) & 31] = value;
+}
+
+// --- REG format ---
+// Operand order follows the assembler: "subo src1, src2, dst" computes
+// dst = src2 - src1.
+
+static uint32_t alu_notbit(uint32_t s1, uint32_t s2) { return s2 ^ (1u << (s1 & 31)); }
+static uint32_t alu_and(uint32_t s1, uint32_t s2) { return s2 & s1; }
+static uint32_t alu_andnot(uint32_t s1, uint32_t s2) { return s2 & ~s1; }
+static uint32_t alu_setbit(uint32_t s1, uint32_t s2) { return s2 | (1u << (s1 & 31)); }
+static uint32_t alu_notand(uint32_t s1, uint32_t s2) { return ~s2 & s1; }
+static uint32_t alu_xor(uint32_t s1, uint32_t s2) { return s2 ^ s1; }
+static uint32_t alu_or(uint32_t s1, uint32_t s2) { return s2 | s1; }
+static uint32_t alu_nor(uint32_t s1, uint32_t s2) { return ~(s2 | s1); }
+static uint32_t alu_xnor(uint32_t s1, uint32_t s2) { return ~(s2 ^ s1); }
+static uint32_t alu_not(uint32_t s1, uint32_t) { return ~s1; }
+static uint32_t alu_ornot(uint32_t s1, uint32_t s2) { return s2 | ~s1; }
+static uint32_t alu_clrbit(uint32_t s1, uint32_t s2) { return s2 & ~(1u << (s1 & 31)); }
+static uint32_t alu_notor(uint32_t s1, uint32_t s2) { return ~s2 | s1; }
+static uint32_t alu_nand(uint32_t s1, uint32_t s2) { return ~(s2 & s1); }
+static uint32_t alu_add(uint32_t s1, uint32_t s2) { return s2 + s1; }
+static uint32_t alu_sub(uint32_t s1, uint32_t s2) { return s2 - s1; }
+static uint32_t alu_mul(uint32_t s1, uint32_t s2) { return s2 * s1; }
+static uint32_t alu_shro(uint32_t s1, uint32_t s2) { return s1 < 32 ? s2 >> s1 : 0; }
+static uint32_t alu_shlo(uint32_t s1, uint32_t s2) { return s1 < 32 ? s2 << s1 : 0; }
+static uint32_t alu_mov(uint32_t s1, uint32_t) { return s1; }
+
+static uint32_t alu_shri(uint32_t s1, uint32_t s2) {
+    return (uint32_t)((int32_t)s2 >> (s1 < 32 ? s1 : 31));
+}
+
+// Arithmetic shift that rounds toward zero, like a signed division by 2^s1
+static uint32_t alu_shrdi(uint32_t s1, uint32_t s2) {
+    int64_t value = (int32_t)s2;
+    int64_t magnitude = (value < 0 ? -value : value) >> (s1 < 32 ? s1 : 32);
+    return (uint32_t)(value < 0 ? -magnitude : magnitude);
+}
+
+static uint32_t alu_rotate(uint32_t s1, uint32_t s2) {
+    uint32_t n = s1 & 31;
+    return n == 0 ? s2 : (s2 << n) | (s2 >> (32 - n));
+}
+
+// Divisions only run with a non-zero divisor (see op_reg_div)
+static uint32_t alu_divo(uint32_t s1, uint32_t s2) { return s2 / s1; }
+static uint32_t alu_remo(uint32_t s1, uint32_t s2) { return s2 % s1; }
+
+static uint32_t alu_divi(uint32_t s1, uint32_t s2) {
+    if ((int32_t)s1 == -1) {
+        return 0u - s2; // Also defined for INT32_MIN
+    }
+    return (uint32_t)((int32_t)s2 / (int32_t)s1);
+}
+
+static uint32_t alu_remi(uint32_t s1, uint32_t s2) {
+    if ((int32_t)s1 == -1) {
+        return 0;
+    }
+    return (uint32_t)((int32_t)s2 % (int32_t)s1);
+}
+
+// Remainder with the sign of the divisor
+static uint32_t alu_modi(uint32_t s1, uint32_t s2) {
+    int32_t rem = (int32_t)alu_remi(s1, s2);
+    if (rem != 0 && ((rem < 0) != ((int32_t)s1 < 0))) {
+        rem += (int32_t)s1;
+    }
+    return (uint32_t)rem;
+}
+
+template <uint32_t (*F)(uint32_t src1, uint32_t src2)>
+static void op_reg(i960_cpu* cpu, const i960_decoded* insn) {
+    uint32_t result = F(cpu->regs[insn->src1], cpu->regs[insn->src2]);
+    cpu->regs[insn->dst] = result;
+    trace_insn(cpu, insn, insn->dst, result);
+    cpu->ip += 4;
+}
+
+// Division by zero (a fault on hardware) leaves the destination untouched
+template <uint32_t (*F)(uint32_t src1, uint32_t src2)>
+static void op_reg_div(i960_cpu* cpu, const i960_decoded* insn) {
+    uint32_t divisor = cpu->regs[insn->src1];
+    if (divisor != 0) {
+        cpu->regs[insn->dst] = F(divisor, cpu->regs[insn->src2]);
+    }
+    trace_insn(cpu, insn, insn->dst, cpu->regs[insn->dst]);
+    cpu->ip += 4;
+}
+
+static void op_nop(i960_cpu* cpu, const i960_decoded* insn) {
+    trace_insn(cpu, insn, 0, 0);
+    cpu->ip += 4;
+}
+
+// Sets the bit if cc bit 1 is set, clears it otherwise
+static void op_alterbit(i960_cpu* cpu, const i960_decoded* insn) {
+    uint32_t bit = 1u << (cpu->regs[insn->src1] & 31);
+    uint32_t value = cpu->regs[insn->src2];
+    cpu->regs[insn->dst] = (cpu->ac & 2) ? (value | bit) : (value & ~bit);
+    trace_insn(cpu, insn, insn->dst, cpu->regs[insn->dst]);
+    cpu->ip += 4;
+}
+
+template <typename T>
+static void op_cmp(i960_cpu* cpu, const i960_decoded* insn) {
+    kb_set_cc(cpu, kb_compare<T>(cpu->regs[insn->src1], cpu->regs[insn->src2]));
+    trace_insn(cpu, insn, insn->src1, kb_cc(cpu));
+    cpu->ip += 4;
+}
+
+// Conditional compare: only when cc does not already say "less"
+template <typename T>
+static void op_concmp(i960_cpu* cpu, const i960_decoded* insn) {
+    if (!(cpu->ac & 4)) {
+        kb_set_cc(cpu, (T)cpu->regs[insn->src1] <= (T)cpu->regs[insn->src2] ? 2 : 1);
+    }
+    trace_insn(cpu, insn, insn->src1, kb_cc(cpu));
+    cpu->ip += 4;
+}
+
+// Compare, then dst = src2 + Step
+template <typename T, int Step>
+static void op_cmpstep(i960_cpu* cpu, const i960_decoded* insn) {
+    uint32_t src2 = cpu->regs[insn->src2];
+    kb_set_cc(cpu, kb_compare<T>(cpu->regs[insn->src1], src2));
+    cpu->regs[insn->dst] = src2 + (uint32_t)Step;
+    trace_insn(cpu, insn, insn->dst, cpu->regs[insn->dst]);
+    cpu->ip += 4;
+}
+
+static void op_scanbyte(i960_cpu* cpu, const i960_decoded* insn) {
+    uint32_t diff = cpu->regs[insn->src1] ^ cpu->regs[insn->src2];
+    bool match = !(diff & 0xFF) || !(diff & 0xFF00) || !(diff & 0xFF0000) || !(diff & 0xFF000000);
+    kb_set_cc(cpu, match ? 2 : 0);
+    trace_insn(cpu, insn, insn->src1, kb_cc(cpu));
+    cpu->ip += 4;
+}
+
+static void op_chkbit(i960_cpu* cpu, const i960_decoded* insn) {
+    bool set = (cpu->regs[insn->src2] >> (cpu->regs[insn->src1] & 31)) & 1;
+    kb_set_cc(cpu, set ? 2 : 0);
+    trace_insn(cpu, insn, insn->src1, kb_cc(cpu));
+    cpu->ip += 4;
+}
+
+// Add/subtract with carry: carry in from cc bit 1, cc = carry out, overflow
+template <bool Subtract>
+static void op_addc(i960_cpu* cpu, const i960_decoded* insn) {
+    uint32_t s1 = cpu->regs[insn->src1];
+    uint32_t s2 = cpu->regs[insn->src2];
+    uint32_t operand = Subtract ? ~s1 : s1;
+    uint64_t sum = (uint64_t)s2 + operand + ((cpu->ac >> 1) & 1);
+    uint32_t result = (uint32_t)sum;
+    uint32_t overflow = ((s2 ^ result) & (operand ^ result)) >> 31;
+    cpu->regs[insn->dst] = result;
+    kb_set_cc(cpu, (uint32_t)(sum >> 32) << 1 | overflow);
+    trace_insn(cpu, insn, insn->dst, result);
+    cpu->ip += 4;
+}
+
+template <int N>
+static void op_movn(i960_cpu* cpu, const i960_decoded* insn) {
+    uint32_t values[N];
+    for (int i = 0; i < N; ++i) {
+        values[i] = kb_group_read(cpu, insn->src1, i);
+    }
+    for (int i = 0; i < N; ++i) {
+        kb_group_write(cpu, insn->dst, i, values[i]);
+    }
+    trace_insn(cpu, insn, insn->dst, values[0]);
+    cpu->ip += 4;
+}
+
+// Index of the most significant bit equal to Bit, or -1 with cc 000
+template <bool Bit>
+static void op_scanbit(i960_cpu* cpu, const i960_decoded* insn) {
+    uint32_t value = Bit ? cpu->regs[insn->src1] : ~cpu->regs[insn->src1];
+    uint32_t result = 0xFFFFFFFF;
+    for (int bit = 31; bit >= 0; --bit) {
+        if (value & (1u << bit)) {
+            result = (uint32_t)bit;
+            break;
+        }
+    }
+    cpu->regs[insn->dst] = result;
+    kb_set_cc(cpu, result != 0xFFFFFFFF ? 2 : 0);
+    trace_insn(cpu, insn, insn->dst, result);
+    cpu->ip += 4;
+}
+
+// modac/modtc/modpc mask, src, dst: dst = old register, then the masked
+// bits of the register are replaced by those of src
+template <uint32_t i960_cpu::*Reg>
+static void op_modreg(i960_cpu* cpu, const i960_decoded* insn) {
+    uint32_t mask = cpu->regs[insn->src1];
+    uint32_t old = cpu->*Reg;
+    cpu->*Reg = (cpu->regs[insn->src2] & mask) | (old & ~mask);
+    cpu->regs[insn->dst] = old;
+    trace_insn(cpu, insn, insn->dst, old);
+    cpu->ip += 4;
+}
+
+// modpc can lower the processor priority below a pending interrupt
+static void op_modpc(i960_cpu* cpu, const i960_decoded* insn) {
+    op_modreg<&i960_cpu::pc>(cpu, insn);
+    i960_update_interrupts(cpu);
+}
+
+// modify mask, src, src/dst
+static void op_modify(i960_cpu* cpu, const i960_decoded* insn) {
+    uint32_t mask = cpu->regs[insn->src1];
+    cpu->regs[insn->dst] = (cpu->regs[insn->src2] & mask) | (cpu->regs[insn->dst] & ~mask);
+    trace_insn(cpu, insn, insn->dst, cpu->regs[insn->dst]);
+    cpu->ip += 4;
+}
+
+// extract bitpos, len, src/dst
+static void op_extract(i960_cpu* cpu, const i960_decoded* insn) {
+    uint32_t pos = cpu->regs[insn->src1];
+    uint32_t len = cpu->regs[insn->src2];
+    uint32_t value = pos < 32 ? cpu->regs[insn->dst] >> pos : 0;
+    cpu->regs[insn->dst] = len < 32 ? value & ((1u << len) - 1) : value;
+    trace_insn(cpu, insn, insn->dst, cpu->regs[insn->dst]);
+    cpu->ip += 4;
+}
+
+// 32 x 32 -> 64 bit multiply into a register pair
+static void op_emul(i960_cpu* cpu, const i960_decoded* insn) {
+    uint64_t result = (uint64_t)cpu->regs[insn->src2] * cpu->regs[insn->src1];
+    kb_group_write(cpu, insn->dst, 0, (uint32_t)result);
+    kb_group_write(cpu, insn->dst, 1, (uint32_t)(result >> 32));
+    trace_insn(cpu, insn, insn->dst, (uint32_t)result);
+    cpu->ip += 4;
+}
+
+// 64 / 32 bit divide: dst = remainder, dst + 1 = quotient
+static void op_ediv(i960_cpu* cpu, const i960_decoded* insn) {
+    uint32_t divisor = cpu->regs[insn->src1];
+    if (divisor != 0) {
+        uint64_t dividend = kb_group_read(cpu, insn->src2, 0) | (uint64_t)kb_group_read(cpu, insn->src2, 1) << 32;
+        kb_group_write(cpu, insn->dst, 0, (uint32_t)(dividend % divisor));
+        kb_group_write(cpu, insn->dst, 1, (uint32_t)(dividend / divisor));
+    }
+    trace_insn(cpu, insn, insn->dst, cpu->regs[insn->dst]);
+    cpu->ip += 4;
+}
+
+// --- Calls ---
+// There is no on-chip register cache: a call saves the caller's locals in
+// its own frame and a return reloads them. Frames are 64-byte aligned and
+// start with the 16 local registers.
+
+static void kb_call(i960_cpu* cpu, uint32_t target, uint32_t return_ip) {
+    uint32_t* regs = cpu->regs;
+    regs[I960_REG_RIP] = return_ip;
+    uint32_t fp = regs[I960_REG_FP];
+    for (uint32_t i = 0; i < 16; ++i) {
+        bus_write<uint32_t>(cpu->bus, fp + 4 * i, regs[i]);
+    }
+    uint32_t new_fp = (regs[I960_REG_SP] + 63) & ~63u;
+    regs[I960_REG_PFP] = fp;
+    regs[I960_REG_FP] = new_fp;
+    regs[I960_REG_SP] = new_fp + 64;
+    cpu->ip = target;
+    if (cpu->profiler) {
+        profiler_call(cpu->profiler, target);
+    }
+}
+
+static void op_call(i960_cpu* cpu, const i960_decoded* insn) {
+    kb_call(cpu, insn->imm, insn->ip + insn->length);
+    trace_insn(cpu, insn, 0, cpu->ip);
+}
+
+// The low bits of pfp hold the return status; only local returns exist here
+static void kb_return(i960_cpu* cpu) {
+    uint32_t* regs = cpu->regs;
+    uint32_t fp = regs[I960_REG_PFP] & ~63u;
+    regs[I960_REG_FP] = fp;
+    for (uint32_t i = 0; i < 16; ++i) {
+        regs[i] = bus_read<uint32_t>(cpu->bus, fp + 4 * i);
+    }
+    cpu->ip = regs[I960_REG_RIP];
+    if (cpu->profiler) {
+        profiler_return(cpu->profiler);
+    }
+}
+
+static void op_ret(i960_cpu* cpu, const i960_decoded* insn) {
+    kb_return(cpu);
+    trace_insn(cpu, insn, 0, cpu->ip);
+}
+
+// Hooked ROM routine (see i960_hle.h): the native version does the work
+// and charges its cycles, then control returns as the routine would
+static void op_hle(i960_cpu* cpu, const i960_decoded* insn) {
+    i960_hle_hook* hook = i960_hle_lookup(cpu->hle, insn->ip);
+    if (hook == nullptr) {
+        // Hooks changed without a new decode: stay, like an undefined opcode
+        trace_insn(cpu, insn, 0, 0);
+        return;
+    }
+    cpu->cycles += i960_hle_invoke(cpu, hook);
+    if (hook->ret == I960_HLE_RETURN_RET) {
+        kb_return(cpu);
+    } else {
+        cpu->ip = cpu->regs[I960_REG_G14];
+    }
+    trace_insn(cpu, insn, 0, cpu->ip);
+}
+
+// --- CTRL format ---
+// Branches record the IP they continue at
+
+static void op_b(i960_cpu* cpu, const i960_decoded* insn) {
+    cpu->ip = insn->imm;
+    trace_insn(cpu, insn, 0, cpu->ip);
+}
+
+static void op_bal(i960_cpu* cpu, const i960_decoded* insn) {
+    cpu->regs[insn->dst] = insn->ip + insn->length;
+    cpu->ip = insn->imm;
+    trace_insn(cpu, insn, 0, cpu->ip);
+}
+
+static void op_bcc(i960_cpu* cpu, const i960_decoded* insn) {
+    cpu->ip = kb_condition(cpu, insn->aux) ? insn->imm : cpu->ip + 4;
+    trace_insn(cpu, insn, 0, cpu->ip);
+}
+
+// --- COBR format ---
+
+static void op_test(i960_cpu* cpu, const i960_decoded* insn) {
+    cpu->regs[insn->dst] = kb_condition(cpu, insn->aux) ? 1 : 0;
+    trace_insn(cpu, insn, insn->dst, cpu->regs[insn->dst]);
+    cpu->ip += 4;
+}
+
+// bbc/bbs bitpos, src, target: branch when the bit equals Bit
+template <bool Bit>
+static void op_bb(i960_cpu* cpu, const i960_decoded* insn) {
+    bool set = (cpu->regs[insn->src2] >> (cpu->regs[insn->src1] & 31)) & 1;
+    kb_set_cc(cpu, set ? 2 : 0);
+    cpu->ip = set == Bit ? insn->imm : cpu->ip + 4;
+    trace_insn(cpu, insn, 0, cpu->ip);
+}
+
+template <typename T>
+static void op_cmpb(i960_cpu* cpu, const i960_decoded* insn) {
+    kb_set_cc(cpu, kb_compare<T>(cpu->regs[insn->src1], cpu->regs[insn->src2]));
+    cpu->ip = kb_condition(cpu, insn->aux) ? insn->imm : cpu->ip + 4;
+    trace_insn(cpu, insn, 0, cpu->ip);
+}
+
+// --- MEM format ---
+// Every addressing mode is abase + (index << scale) + displacement, with
+// unused terms decoded as the literal 0 slot, so the effective address
+// needs no branches. Accesses add their wait states as they happen.
+
+static inline uint32_t kb_address(const i960_cpu* cpu, const i960_decoded* insn) {
+    return cpu->regs[insn->src1] + (cpu->regs[insn->src2] << insn->aux) + insn->imm;
+}
+
+// With a fastmem view, RAM accesses are single host loads and stores and
+// everything else faults over to the bus (see memory.h); without one, the
+// bus's inlined page-table fast path does the same for RAM
+template <typename T>
+static inline T kb_load(MemoryBus* bus, uint32_t address) {
+    if (bus->fastmem && !memory_stats_active(bus)) {
+        if (sizeof(T) == 1) return (T)memory_fast_read_byte(bus, address);
+        if (sizeof(T) == 2) return (T)memory_fast_read_half(bus, address);
+        return (T)memory_fast_read_dword(bus, address);
+    }
+    return bus_read<T>(bus, address);
+}
+
+template <typename T>
+static inline void kb_store(MemoryBus* bus, uint32_t address, T value) {
+    if (bus->fastmem && !memory_stats_active(bus)) {
+        if (sizeof(T) == 1) memory_fast_write_byte(bus, address, (uint8_t)value);
+        else if (sizeof(T) == 2) memory_fast_write_half(bus, address, (uint16_t)value);
+        else memory_fast_write_dword(bus, address, (uint32_t)value);
+        return;
+    }
+    bus_write<T>(bus, address, value);
+}
+
+static inline uint32_t kb_read_dword(MemoryBus* bus, uint32_t address) {
+    return kb_load<uint32_t>(bus, address);
+}
+
+static inline void kb_write_dword(MemoryBus* bus, uint32_t address, uint32_t value) {
+    kb_store<uint32_t>(bus, address, value);
+}
+
+// Halfwords are one access on both paths, like words and bytes
+template <typename T>
+static inline uint32_t kb_read(MemoryBus* bus, uint32_t address) {
+    typedef typename std::make_unsigned<T>::type U;
+    return (uint32_t)(T)kb_load<U>(bus, address);
+}
+
+template <typename T>
+static inline void kb_write(MemoryBus* bus, uint32_t address, uint32_t value) {
+    typedef typename std::make_unsigned<T>::type U;
+    kb_store<U>(bus, address, (U)value);
+}
+
+// Single loads extend to 32 bits by T's signedness
+template <typename T>
+static void op_load(i960_cpu* cpu, const i960_decoded* insn) {
+    uint32_t address = kb_address(cpu, insn);
+    cpu->cycles += memory_access_cycles(address);
+    cpu->regs[insn->dst] = kb_read<T>(cpu->bus, address);
+    trace_insn(cpu, insn, insn->dst, cpu->regs[insn->dst]);
+    cpu->ip += insn->length;
+}
+
+template <typename T>
+static void op_store(i960_cpu* cpu, const i960_decoded* insn) {
+    uint32_t address = kb_address(cpu, insn);
+    cpu->cycles += memory_access_cycles(address);
+    kb_write<T>(cpu->bus, address, cpu->regs[insn->dst]);
+    trace_insn(cpu, insn, insn->dst, cpu->regs[insn->dst]);
+    cpu->ip += insn->length;
+}
+
+// ldl/ldt/ldq: N consecutive words into a register group
+template <int N>
+static void op_load_group(i960_cpu* cpu, const i960_decoded* insn) {
+    uint32_t address = kb_address(cpu, insn);
+    cpu->cycles += N * memory_access_cycles(address);
+    for (int i = 0; i < N; ++i) {
+        kb_group_write(cpu, insn->dst, i, kb_read_dword(cpu->bus, address + 4 * i));
+    }
+    trace_insn(cpu, insn, insn->dst, cpu->regs[insn->dst]);
+    cpu->ip += insn->length;
+}
+
+template <int N>
+static void op_store_group(i960_cpu* cpu, const i960_decoded* insn) {
+    uint32_t address = kb_address(cpu, insn);
+    cpu->cycles += N * memory_access_cycles(address);
+    for (int i = 0; i < N; ++i) {
+        kb_write_dword(cpu->bus, address + 4 * i, kb_group_read(cpu, insn->dst, i));
+    }
+    trace_insn(cpu, insn, insn->dst, cpu->regs[insn->dst]);
+    cpu->ip += insn->length;
+}
+
+static void op_lda(i960_cpu* cpu, const i960_decoded* insn) {
+    cpu->regs[insn->dst] = kb_address(cpu, insn);
+    trace_insn(cpu, insn, insn->dst, cpu->regs[insn->dst]);
+    cpu->ip += insn->length;
+}
+
+static void op_bx(i960_cpu* cpu, const i960_decoded* insn) {
+    cpu->ip = kb_address(cpu, insn);
+    trace_insn(cpu, insn, 0, cpu->ip);
+}
+
+static void op_balx(i960_cpu* cpu, const i960_decoded* insn) {
+    uint32_t target = kb_address(cpu, insn);
+    cpu->regs[insn->dst] = insn->ip + insn->length;
+    cpu->ip = target;
+    trace_insn(cpu, insn, 0, cpu->ip);
+}
+
+static void op_callx(i960_cpu* cpu, const i960_decoded* insn) {
+    kb_call(cpu, kb_address(cpu, insn), insn->ip + insn->length);
+    trace_insn(cpu, insn, 0, cpu->ip);
+}
+
+// Reserved or unimplemented opcode (faults, calls, ...): the CPU stays on it
+static void op_undefined(i960_cpu* cpu, const i960_decoded* insn) {
+    trace_insn(cpu, insn, 0, 0);
+}
+
+// --- Opcode tables ---
+
+struct i960_kb_opcode {
+    i960_op op;
+    uint8_t format;        // i960_kb_format (primary table only)
+    uint8_t flags;         // I960_INSN_* flags
+    uint8_t aux;           // Condition mask
+    i960_handler handler;
+};
+
+constexpr uint8_t kb_format_of(uint32_t opcode) {
+    return opcode < 0x20 ? KB_FORMAT_CTRL : opcode < 0x40 ? KB_FORMAT_COBR : opcode < 0x80 ? KB_FORMAT_REG : KB_FORMAT_MEM;
+}
+
+constexpr std::array<i960_kb_opcode, 256> kb_make_primary_table() {
+    std::array<i960_kb_opcode, 256> t{};
+    for (uint32_t i = 0; i < 256; ++i) {
+        t[i] = {I960_OP_UNDEFINED, kb_format_of(i), I960_INSN_STOP, 0, op_undefined};
+    }
+    const uint8_t BRANCH = I960_INSN_BRANCH;
+    const uint8_t INDIRECT = I960_INSN_BRANCH | I960_INSN_INDIRECT;
+
+    // CTRL
+    t[0x08] = {I960_OP_B, KB_FORMAT_CTRL, BRANCH, 0, op_b};
+    t[0x09] = {I960_OP_CALL, KB_FORMAT_CTRL, BRANCH, 0, op_call};
+    t[0x0A] = {I960_OP_RET, KB_FORMAT_CTRL, INDIRECT, 0, op_ret};
+    t[0x0B] = {I960_OP_BAL, KB_FORMAT_CTRL, BRANCH, 0, op_bal};
+    for (uint8_t mask = 0; mask < 8; ++mask) {
+        t[0x10 + mask] = {I960_OP_BCC, KB_FORMAT_CTRL, BRANCH, mask, op_bcc};
+    }
+
+    // COBR
+    for (uint8_t mask = 0; mask < 8; ++mask) {
+        t[0x20 + mask] = {I960_OP_TEST, KB_FORMAT_COBR, 0, mask, op_test};
+        t[0x30 + mask] = {I960_OP_CMPOB, KB_FORMAT_COBR, BRANCH, mask, op_cmpb<uint32_t>};
+        t[0x38 + mask] = {I960_OP_CMPIB, KB_FORMAT_COBR, BRANCH, mask, op_cmpb<int32_t>};
+    }
+    t[0x30] = {I960_OP_BBC, KB_FORMAT_COBR, BRANCH, 0, op_bb<false>};
+    t[0x37] = {I960_OP_BBS, KB_FORMAT_COBR, BRANCH, 0, op_bb<true>};
+
+    // MEM
+    t[0x80] = {I960_OP_LDOB, KB_FORMAT_MEM, 0, 0, op_load<uint8_t>};
+    t[0x82] = {I960_OP_STOB, KB_FORMAT_MEM, 0, 0, op_store<uint8_t>};
+    t[0x84] = {I960_OP_BX, KB_FORMAT_MEM, INDIRECT, 0, op_bx};
+    t[0x85] = {I960_OP_BALX, KB_FORMAT_MEM, INDIRECT, 0, op_balx};
+    t[0x86] = {I960_OP_CALLX, KB_FORMAT_MEM, INDIRECT, 0, op_callx};
+    t[0x88] = {I960_OP_LDOS, KB_FORMAT_MEM, 0, 0, op_load<uint16_t>};
+    t[0x8A] = {I960_OP_STOS, KB_FORMAT_MEM, 0, 0, op_store<uint16_t>};
+    t[0x8C] = {I960_OP_LDA, KB_FORMAT_MEM, 0, 0, op_lda};
+    t[0x90] = {I960_OP_LD, KB_FORMAT_MEM, 0, 0, op_load<uint32_t>};
+    t[0x92] = {I960_OP_ST, KB_FORMAT_MEM, 0, 0, op_store<uint32_t>};
+    t[0x98] = {I960_OP_LDL, KB_FORMAT_MEM, 0, 0, op_load_group<2>};
+    t[0x9A] = {I960_OP_STL, KB_FORMAT_MEM, 0, 0, op_store_group<2>};
+    t[0xA0] = {I960_OP_LDT, KB_FORMAT_MEM, 0, 0, op_load_group<3>};
+    t[0xA2] = {I960_OP_STT, KB_FORMAT_MEM, 0, 0, op_store_group<3>};
+    t[0xB0] = {I960_OP_LDQ, KB_FORMAT_MEM, 0, 0, op_load_group<4>};
+    t[0xB2] = {I960_OP_STQ, KB_FORMAT_MEM, 0, 0, op_store_group<4>};
+    t[0xC0] = {I960_OP_LDIB, KB_FORMAT_MEM, 0, 0, op_load<int8_t>};
+    t[0xC2] = {I960_OP_STIB, KB_FORMAT_MEM, 0, 0, op_store<int8_t>};
+    t[0xC8] = {I960_OP_LDIS, KB_FORMAT_MEM, 0, 0, op_load<int16_t>};
+    t[0xCA] = {I960_OP_STIS, KB_FORMAT_MEM, 0, 0, op_store<int16_t>};
+    return t;
+}
+
+// REG opcodes are 12 bits: primary opcode (0x40-0x7F) and opcode2 (bits 10-7)
+constexpr uint32_t KB_REG_BASE = 0x400;
+constexpr uint32_t KB_REG_COUNT = 0x400;
+
+constexpr std::array<i960_kb_opcode, KB_REG_COUNT> kb_make_reg_table() {
+    std::array<i960_kb_opcode, KB_REG_COUNT> t{};
+    for (uint32_t i = 0; i < KB_REG_COUNT; ++i) {
+        t[i] = {I960_OP_UNDEFINED, KB_FORMAT_REG, I960_INSN_STOP, 0, op_undefined};
+    }
+    struct Entry {
+        uint32_t opcode;
+        i960_op op;
+        i960_handler handler;
+    };
+    const Entry entries[] = {
+        {0x580, I960_OP_NOTBIT, op_reg<alu_notbit>},
+        {0x581, I960_OP_AND, op_reg<alu_and>},
+        {0x582, I960_OP_ANDNOT, op_reg<alu_andnot>},
+        {0x583, I960_OP_SETBIT, op_reg<alu_setbit>},
+        {0x584, I960_OP_NOTAND, op_reg<alu_notand>},
+        {0x586, I960_OP_XOR, op_reg<alu_xor>},
+        {0x587, I960_OP_OR, op_reg<alu_or>},
+        {0x588, I960_OP_NOR, op_reg<alu_nor>},
+        {0x589, I960_OP_XNOR, op_reg<alu_xnor>},
+        {0x58A, I960_OP_NOT, op_reg<alu_not>},
+        {0x58B, I960_OP_ORNOT, op_reg<alu_ornot>},
+        {0x58C, I960_OP_CLRBIT, op_reg<alu_clrbit>},
+        {0x58D, I960_OP_NOTOR, op_reg<alu_notor>},
+        {0x58E, I960_OP_NAND, op_reg<alu_nand>},
+        {0x58F, I960_OP_ALTERBIT, op_alterbit},
+        {0x590, I960_OP_ADDO, op_reg<alu_add>},
+        {0x591, I960_OP_ADDI, op_reg<alu_add>},
+        {0x592, I960_OP_SUBO, op_reg<alu_sub>},
+        {0x593, I960_OP_SUBI, op_reg<alu_sub>},
+        {0x598, I960_OP_SHRO, op_reg<alu_shro>},
+        {0x59A, I960_OP_SHRDI, op_reg<alu_shrdi>},
+        {0x59B, I960_OP_SHRI, op_reg<alu_shri>},
+        {0x59C, I960_OP_SHLO, op_reg<alu_shlo>},
+        {0x59D, I960_OP_ROTATE, op_reg<alu_rotate>},
+        {0x59E, I960_OP_SHLI, op_reg<alu_shlo>},
+        {0x5A0, I960_OP_CMPO, op_cmp<uint32_t>},
+        {0x5A1, I960_OP_CMPI, op_cmp<int32_t>},
+        {0x5A2, I960_OP_CONCMPO, op_concmp<uint32_t>},
+        {0x5A3, I960_OP_CONCMPI, op_concmp<int32_t>},
+        {0x5A4, I960_OP_CMPINCO, op_cmpstep<uint32_t, 1>},
+        {0x5A5, I960_OP_CMPINCI, op_cmpstep<int32_t, 1>},
+        {0x5A6, I960_OP_CMPDECO, op_cmpstep<uint32_t, -1>},
+        {0x5A7, I960_OP_CMPDECI, op_cmpstep<int32_t, -1>},
+        {0x5AC, I960_OP_SCANBYTE, op_scanbyte},
+        {0x5AE, I960_OP_CHKBIT, op_chkbit},
+        {0x5B0, I960_OP_ADDC, op_addc<false>},
+        {0x5B2, I960_OP_SUBC, op_addc<true>},
+        {0x5CC, I960_OP_MOV, op_reg<alu_mov>},
+        {0x5DC, I960_OP_MOVL, op_movn<2>},
+        {0x5EC, I960_OP_MOVT, op_movn<3>},
+        {0x5FC, I960_OP_MOVQ, op_movn<4>},
+        {0x641, I960_OP_SCANBIT, op_scanbit<true>},
+        {0x640, I960_OP_SPANBIT, op_scanbit<false>},
+        {0x645, I960_OP_MODAC, op_modreg<&i960_cpu::ac>},
+        {0x650, I960_OP_MODIFY, op_modify},
+        {0x651, I960_OP_EXTRACT, op_extract},
+        {0x654, I960_OP_MODTC, op_modreg<&i960_cpu::tc>},
+        {0x655, I960_OP_MODPC, op_modpc},
+        {0x66B, I960_OP_NOP, op_nop}, // mark
+        {0x66C, I960_OP_NOP, op_nop}, // fmark
+        {0x66D, I960_OP_NOP, op_nop}, // flushreg
+        {0x66F, I960_OP_NOP, op_nop}, // syncf
+        {0x670, I960_OP_EMUL, op_emul},
+        {0x671, I960_OP_EDIV, op_ediv},
+        {0x701, I960_OP_MULO, op_reg<alu_mul>},
+        {0x708, I960_OP_REMO, op_reg_div<alu_remo>},
+        {0x70B, I960_OP_DIVO, op_reg_div<alu_divo>},
+        {0x741, I960_OP_MULI, op_reg<alu_mul>},
+        {0x748, I960_OP_REMI, op_reg_div<alu_remi>},
+        {0x749, I960_OP_MODI, op_reg_div<alu_modi>},
+        {0x74B, I960_OP_DIVI, op_reg_div<alu_divi>},
+    };
+    for (const Entry& entry : entries) {
+        t[entry.opcode - KB_REG_BASE] = {entry.op, KB_FORMAT_REG, 0, 0, entry.handler};
+    }
+    return t;
+}
+
+constexpr std::array<i960_kb_opcode, 256> KB_PRIMARY = kb_make_primary_table();
+constexpr std::array<i960_kb_opcode, KB_REG_COUNT> KB_REG = kb_make_reg_table();
+
+static_assert(KB_PRIMARY[0x12].op == I960_OP_BCC && KB_PRIMARY[0x12].aux == 2, "be decodes as bcc with mask 010");
+static_assert(KB_PRIMARY[0x3A].op == I960_OP_CMPIB && KB_PRIMARY[0x3A].aux == 2, "cmpibe decodes with mask 010");
+static_assert(KB_REG[0x592 - KB_REG_BASE].op == I960_OP_SUBO, "subo is REG opcode 0x592");
+
+// KB superinstructions (see i960_fuse.h): compare then branch or test,
+// count then compare-and-branch, load then compare or operate
+static const i960_fusion kb_fusion_table[] = {
+    {op_cmp<uint32_t>, op_bcc, i960_fused<op_cmp<uint32_t>, op_bcc>},
+    {op_cmp<int32_t>, op_bcc, i960_fused<op_cmp<int32_t>, op_bcc>},
+    {op_cmp<uint32_t>, op_test, i960_fused<op_cmp<uint32_t>, op_test>},
+    {op_cmp<int32_t>, op_test, i960_fused<op_cmp<int32_t>, op_test>},
+    {op_reg<alu_add>, op_cmpb<uint32_t>, i960_fused<op_reg<alu_add>, op_cmpb<uint32_t>>},
+    {op_reg<alu_sub>, op_cmpb<uint32_t>, i960_fused<op_reg<alu_sub>, op_cmpb<uint32_t>>},
+    {op_reg<alu_add>, op_cmpb<int32_t>, i960_fused<op_reg<alu_add>, op_cmpb<int32_t>>},
+    {op_reg<alu_sub>, op_cmpb<int32_t>, i960_fused<op_reg<alu_sub>, op_cmpb<int32_t>>},
+    {op_load<uint32_t>, op_cmpb<uint32_t>, i960_fused<op_load<uint32_t>, op_cmpb<uint32_t>>},
+    {op_load<uint32_t>, op_bb<false>, i960_fused<op_load<uint32_t>, op_bb<false>>},
+    {op_load<uint32_t>, op_bb<true>, i960_fused<op_load<uint32_t>, op_bb<true>>},
+    {op_load<uint32_t>, op_cmp<uint32_t>, i960_fused<op_load<uint32_t>, op_cmp<uint32_t>>},
+    {op_load<uint32_t>, op_reg<alu_and>, i960_fused<op_load<uint32_t>, op_reg<alu_and>>},
+    {op_load<uint32_t>, op_reg<alu_add>, i960_fused<op_load<uint32_t>, op_reg<alu_add>>},
+    {op_load<uint8_t>, op_cmpb<uint32_t>, i960_fused<op_load<uint8_t>, op_cmpb<uint32_t>>},
+    {op_lda, op_load<uint32_t>, i960_fused<op_lda, op_load<uint32_t>>},
+};
+
+const i960_fusion* i960_kb_fusions(uint32_t* count) {
+    *count = sizeof(kb_fusion_table) / sizeof(kb_fusion_table[0]);
+    return kb_fusion_table;
+}
+
+// --- Decoder ---
+
+// Sign-extends the low `bits` bits of value
+static inline uint32_t kb_sign_extend(uint32_t value, int bits) {
+    uint32_t sign = 1u << (bits - 1);
+    return (value ^ sign) - sign;
+}
+
+void i960_decode_kb(i960_cpu* cpu, uint32_t ip, i960_decoded* insn) {
+    if (cpu->hle != nullptr && i960_hle_lookup(cpu->hle, ip) != nullptr) {
+        // The whole routine runs as one instruction that returns to the caller
+        insn->opcode = 0;
+        insn->length = 4;
+        insn->imm = 0;
+        insn->aux = 0;
+        insn->dst = insn->src1 = insn->src2 = I960_REG_LITERAL;
+        insn->op = I960_OP_HLE;
+        insn->handler = op_hle;
+        insn->flags = I960_INSN_BRANCH | I960_INSN_INDIRECT;
+        insn->cycles = I960_OP_INFO[I960_OP_HLE].cycles;
+        return;
+    }
+
+    uint32_t word = i960_fetch_word(cpu, ip);
+    uint8_t opcode = (uint8_t)(word >> 24);
+    const i960_kb_opcode* entry = &KB_PRIMARY[opcode];
+
+    insn->opcode = opcode;
+    insn->length = 4;
+    insn->imm = 0;
+    insn->aux = entry->aux;
+    insn->dst = (word >> 19) & 0x1F;
+    const uint8_t zero = I960_REG_LITERAL; // Literal 0 slot
+
+    switch (entry->format) {
+        case KB_FORMAT_REG: {
+            entry = &KB_REG[((uint32_t)(opcode - 0x40) << 4) | ((word >> 7) & 0xF)];
+            insn->src1 = (word & 0x1F) | ((word & 0x0800) ? I960_REG_LITERAL : 0);
+            insn->src2 = ((word >> 14) & 0x1F) | ((word & 0x1000) ? I960_REG_LITERAL : 0);
+            break;
+        }
+
+        case KB_FORMAT_COBR:
+            // test* name their destination in the src1 field
+            insn->src1 = ((word >> 19) & 0x1F) | ((word & 0x2000) ? I960_REG_LITERAL : 0);
+            insn->src2 = (word >> 14) & 0x1F;
+            insn->imm = ip + kb_sign_extend(word & 0x1FFC, 13);
+            break;
+
+        case KB_FORMAT_CTRL:
+            insn->src1 = insn->src2 = zero;
+            insn->dst = I960_REG_G14; // bal links through g14
+            insn->imm = ip + kb_sign_extend(word & 0xFFFFFC, 24);
+            break;
+
+        case KB_FORMAT_MEM: {
+            uint8_t abase = (word >> 14) & 0x1F;
+            insn->src1 = insn->src2 = zero;
+            if (!(word & 0x1000)) {
+                // MEMA: offset, or abase + offset
+                insn->imm = word & 0xFFF;
+                if (word & 0x2000) insn->src1 = abase;
+                break;
+            }
+            // MEMB: modes with a displacement take a second word
+            uint32_t mode = (word >> 10) & 0xF;
+            uint8_t index = word & 0x1F;
+            uint8_t scale = (word >> 7) & 0x7;
+            if (mode >= 0xC || mode == 0x5) {
+                insn->length = 8;
+                insn->imm = i960_fetch_word(cpu, ip + 4);
+            }
+            switch (mode) {
+                case 0x4: // (abase)
+                case 0xD: // disp(abase)
+                    insn->src1 = abase;
+                    break;
+                case 0x5: // disp(ip)
+                    insn->imm += ip + 8;
+                    break;
+                case 0x7: // (abase)[index * scale]
+                case 0xF: // disp(abase)[index * scale]
+                    insn->src1 = abase;
+                    insn->src2 = index;
+                    insn->aux = scale;
+                    break;
+                case 0xC: // disp
+                    break;
+                case 0xE: // disp[index * scale]
+                    insn->src2 = index;
+                    insn->aux = scale;
+                    break;
+                default: // Reserved addressing mode
+                    entry = &KB_PRIMARY[0x00];
+                    break;
+            }
+            break;
+        }
+    }
+
+    insn->op = entry->op;
+    insn->handler = entry->handler;
+    insn->flags = entry->flags;
+    if (insn->op == I960_OP_TEST) {
+        insn->dst = insn->src1 & 0x1F;
+    }
+
+    // Memory wait states depend on the computed address and are added by
+    // the handlers
+    insn->cycles = I960_OP_INFO[insn->op].cycles;
+}
@@ -1,63 +1,29 @@
-#define _USE_MATH_DEFINES
 #include <SDL3/SDL.h>
 #include <SDL3/SDL_opengl.h>
 #include <iostream>
-#include <cmath>
 #include <algorithm>
 #include <filesystem>
 #include <string>
+#include <vector>
+#include <chrono>
 #include "i960.h"
 #include "memory.h"
 #include "tgp.h"
-
-// --- Input System ---
-struct InputState
-{
-    // Digital inputs (buttons)
-    bool start_button = false;
-    bool service_button = false;
-    bool test_button = false;
-    bool coin_button = false;
-
-    // Action buttons
-    bool button1 = false;
-    bool button2 = false;
-    bool button3 = false;
-    bool button4 = false;
-
-    // Directional inputs
-    bool up = false;
-    bool down = false;
-    bool left = false;
-    bool right = false;
-
-    // Analog inputs (for steering/wheel)
-    int16_t steering = 0; // -32768 to 32767
-    int16_t throttle = 0; // -32768 to 32767
-};
-
-InputState current_input;
-
-// --- Audio System ---
-struct AudioState
+#include "emulator.h"
+#include "trace.h"
+#include "i960_fuse.h"
+#include "i960_hle.h"
+#include "profiler.h"
+
+// Emulated CPU clock reached since `since`, given the cycles run in that time
+static double emulated_mhz(uint64_t cycles, std::chrono::steady_clock::time_point since)
 {
-    SDL_AudioStream *stream = nullptr;
-    bool enabled = true;
-    float master_volume = 1.0f;
-
-    // Sega Model 2 audio channels (simplified)
-    struct
-    {
-        bool enabled = false;
-        uint16_t frequency = 0;
-        uint8_t volume = 0;
-        uint8_t waveform = 0; // 0=sine, 1=square, 2=triangle, 3=sawtooth
-    } channels[8];            // 8 audio channels
-};
-
-static AudioState audio_state;
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - since).count();
+    return seconds > 0 ? cycles / seconds / 1e6 : 0.0;
+}
 
-void handle_input_event(const SDL_Event &event)
+// Updates an instance's controls from an SDL keyboard or joystick event
+void handle_input_event(InputState *input, const SDL_Event &event)
 {
     switch (event.type)
     {
@@ -70,79 +36,79 @@ void handle_input_event(const SDL_Event &event)
         // Sega Model 2 style controls
         if (key == SDLK_RETURN)
         { // Enter = Start
-            current_input.start_button = pressed;
+            input->start_button = pressed;
         }
         else if (key == SDLK_5)
         { // 5 = Coin
-            current_input.coin_button = pressed;
+            input->coin_button = pressed;
         }
         else if (key == SDLK_9)
         { // 9 = Service
-            current_input.service_button = pressed;
+            input->service_button = pressed;
         }
         else if (key == SDLK_F2)
         { // F2 = Test
-            current_input.test_button = pressed;
+            input->test_button = pressed;
         }
         else if (key == SDLK_Z)
         { // Z = Button 1
-            current_input.button1 = pressed;
+            input->button1 = pressed;
         }
         else if (key == SDLK_X)
         { // X = Button 2
-            current_input.button2 = pressed;
+            input->button2 = pressed;
         }
         else if (key == SDLK_C)
         { // C = Button 3
-            current_input.button3 = pressed;
+            input->button3 = pressed;
         }
         else if (key == SDLK_V)
         { // V = Button 4
-            current_input.button4 = pressed;
+            input->button4 = pressed;
         }
         else if (key == SDLK_UP)
         { // Directional controls
-            current_input.up = pressed;
+            input->up = pressed;
         }
         else if (key == SDLK_DOWN)
         {
-            current_input.down = pressed;
+            input->down = pressed;
         }
         else if (key == SDLK_LEFT)
         {
-            current_input.left = pressed;
+            input->left = pressed;
         }
         else if (key == SDLK_RIGHT)
         {
-            current_input.right = pressed;
+            input->right = pressed;
         }
         else if (key == SDLK_A)
         { // A = Steer left
             if (pressed)
-                current_input.steering = -16384;
+                input->steering = -16384;
             else
-                current_input.steering = 0;
+                input->steering = 0;
         }
         else if (key == SDLK_D)
         { // D = Steer right
             if (pressed)
-                current_input.steering = 16384;
+                input->steering = 16384;
             else
-                current_input.steering = 0;
+                input->steering = 0;
         }
         else if (key == SDLK_W)
         { // W = Accelerate
             if (pressed)
-                current_input.throttle = 16384;
+                input->throttle = 16384;
             else
-                current_input.throttle = 0;
+                input->throttle = 0;
         }
         else if (key == SDLK_S)
         { // S = Brake
             if (pressed)
-                current_input.throttle = -16384;
+                input->throttle = -16384;
             else
-                current_input.throttle = 0;
+                input->throttle = 0;
         }
         break;
     }
@@ -176,22 +142,22 @@ void handle_input_event(const SDL_Event &event)
         switch (button)
         {
         case 0: // A button
-            current_input.button1 = pressed;
+            input->button1 = pressed;
             break;
         case 1: // B button
-            current_input.button2 = pressed;
+            input->button2 = pressed;
             break;
         case 2: // X button
-            current_input.button3 = pressed;
+            input->button3 = pressed;
             break;
         case 3: // Y button
-            current_input.button4 = pressed;
+            input->button4 = pressed;
             break;
         case 6: // Back/Select
-            current_input.coin_button = pressed;
+            input->coin_button = pressed;
             break;
         case 7: // Start
-            current_input.start_button = pressed;
+            input->start_button = pressed;
             break;
         }
         break;
@@ -200,10 +166,10 @@ void handle_input_event(const SDL_Event &event)
     case SDL_EVENT_JOYSTICK_HAT_MOTION:
     {
         uint8_t hat_value = event.jhat.value;
-        current_input.up = (hat_value & SDL_HAT_UP);
-        current_input.down = (hat_value & SDL_HAT_DOWN);
-        current_input.left = (hat_value & SDL_HAT_LEFT);
-        current_input.right = (hat_value & SDL_HAT_RIGHT);
+        input->up = (hat_value & SDL_HAT_UP);
+        input->down = (hat_value & SDL_HAT_DOWN);
+        input->left = (hat_value & SDL_HAT_LEFT);
+        input->right = (hat_value & SDL_HAT_RIGHT);
         break;
     }
 
@@ -215,11 +181,11 @@ void handle_input_event(const SDL_Event &event)
         // Map analog sticks to steering/throttle
         if (axis == 0)
         { // X axis (steering)
-            current_input.steering = value;
+            input->steering = value;
         }
         else if (axis == 1)
         {                                    // Y axis (throttle)
-            current_input.throttle = -value; // Invert Y axis
+            input->throttle = -value; // Invert Y axis
         }
         break;
     }
@@ -227,79 +193,17 @@ void handle_input_event(const SDL_Event &event)
 }
 
 // --- Audio Callback ---
+// userdata is the Emulator whose sound registers are played
 void audio_callback(void *userdata, SDL_AudioStream *stream, int additional_amount, int total_amount)
 {
-    // Generate audio samples for all active channels
     const int sample_rate = 44100;
-    const int channels = 2; // Stereo
-    const int buffer_size = additional_amount;
-
-    static float phase[8] = {0.0f}; // Phase for each channel
-
-    int16_t *buffer = new int16_t[buffer_size / sizeof(int16_t)];
-
-    for (int i = 0; i < buffer_size / sizeof(int16_t); i += channels)
-    {
-        float left_sample = 0.0f;
-        float right_sample = 0.0f;
-
-        for (int ch = 0; ch < 8; ch++)
-        {
-            if (audio_state.channels[ch].enabled && audio_state.channels[ch].frequency > 0)
-            {
-                float freq = audio_state.channels[ch].frequency;
-                float vol = audio_state.channels[ch].volume / 255.0f;
-                uint8_t waveform = audio_state.channels[ch].waveform;
-
-                // Generate waveform
-                float sample = 0.0f;
-                switch (waveform)
-                {
-                case 0: // Sine wave
-                    sample = sinf(phase[ch] * 2.0f * (float)M_PI);
-                    break;
-                case 1: // Square wave
-                    sample = (phase[ch] < 0.5f) ? 1.0f : -1.0f;
-                    break;
-                case 2: // Triangle wave
-                    sample = (phase[ch] < 0.5f) ? (4.0f * phase[ch] - 1.0f) : (3.0f - 4.0f * phase[ch]);
-                    break;
-                case 3: // Sawtooth wave
-                    sample = 2.0f * phase[ch] - 1.0f;
-                    break;
-                }
-
-                // Mix channels (simple stereo panning)
-                if (ch % 2 == 0)
-                { // Even channels to left
-                    left_sample += sample * vol;
-                }
-                else
-                { // Odd channels to right
-                    right_sample += sample * vol;
-                }
-
-                // Update phase
-                phase[ch] += freq / sample_rate;
-                if (phase[ch] >= 1.0f)
-                    phase[ch] -= 1.0f;
-            }
-        }
+    const int frames = additional_amount / (int)(2 * sizeof(int16_t)); // Stereo
 
-        // Apply master volume and clamp
-        left_sample *= audio_state.master_volume;
-        right_sample *= audio_state.master_volume;
-
-        left_sample = std::max(-1.0f, std::min(1.0f, left_sample));
-        right_sample = std::max(-1.0f, std::min(1.0f, right_sample));
-
-        // Convert to 16-bit PCM
-        buffer[i] = (int16_t)(left_sample * 32767.0f);
-        buffer[i + 1] = (int16_t)(right_sample * 32767.0f);
-    }
+    int16_t *buffer = new int16_t[frames * 2];
+    emulator_render_audio(static_cast<Emulator *>(userdata), buffer, frames, sample_rate);
 
     // Put samples into the audio stream
-    SDL_PutAudioStreamData(stream, buffer, buffer_size);
+    SDL_PutAudioStreamData(stream, buffer, frames * 2 * (int)sizeof(int16_t));
     delete[] buffer;
 }
 
@@ -310,16 +214,136 @@ int main(int argc, char *argv[])
     // Show usage if help is requested
     if (argc > 1 && (strcmp(argv[1], "--help") == 0 || strcmp(argv[1], "-h") == 0))
     {
-        std::cout << "Usage: PixelModel2 <game_name>" << std::endl;
+        std::cout << "Usage: PixelModel2 [--engine=interp|threaded|jit] [--isa=kb|legacy] [--no-idle-skip] [--no-fusion] [--fastmem] [--watch=<addr>[:<len>][:r|w|rw]] [--bus-stats=<path>] [--pair-stats=<path>] [--hle=<path>] [--trace=off|device|cpu] [--trace-file=<path>] [--profile=insn:<n>|timer:<us>] [--profile-file=<path>] <game_name>" << std::endl;
         std::cout << "Available games:" << std::endl;
         std::cout << "  vf2     - Virtua Fighter 2 (ROMs ZIP disponibles)" << std::endl;
         std::cout << "  daytona - Daytona USA (ROMs ZIP présentes mais incompatibles)" << std::endl;
         std::cout << "ROM loading: Only ZIP files in roms/ folder are supported." << std::endl;
         std::cout << "Note: Daytona ROMs need configuration update to match ZIP contents." << std::endl;
         std::cout << "A game name must be specified as an argument." << std::endl;
+        std::cout << "Options:" << std::endl;
+        std::cout << "  --engine=interp    Decode-cached interpreter (default)" << std::endl;
+        std::cout << "  --engine=threaded  Threaded basic-block engine" << std::endl;
+        std::cout << "  --engine=jit       Threaded engine with x86-64 compiled hot blocks" << std::endl;
+        std::cout << "  --isa=kb           Boot the real i960 KB/CA instruction set from the ROM boot record (default)" << std::endl;
+        std::cout << "  --isa=legacy       Run the byte-oriented test encoding from address 0" << std::endl;
+        std::cout << "  --no-idle-skip     Execute idle loops instead of fast-forwarding through them" << std::endl;
+        std::cout << "  --no-fusion        Dispatch every instruction separately instead of fusing common pairs" << std::endl;
+        std::cout << "  --fastmem          Map guest RAM into a 4GB host view and fault device accesses over to the bus" << std::endl;
+        std::cout << "  --watch=<addr>[:<len>][:r|w|rw] Log guest reads and/or writes to a range (repeatable), hits listed on exit" << std::endl;
+        std::cout << "  --bus-stats=<path> Count bus accesses per region, device register and frame; report written on exit and on F3" << std::endl;
+        std::cout << "  --pair-stats=<path> Count adjacent instruction pairs in translated blocks, report written on exit" << std::endl;
+        std::cout << "  --hle=<path>       Replace the ROM routines listed in <path> with native code" << std::endl;
+        std::cout << "  --trace=<level>    Record a binary execution trace: off (default), device or cpu" << std::endl;
+        std::cout << "  --trace-file=<path> Trace file written on exit (default: trace.bin)" << std::endl;
+        std::cout << "  --profile=insn:<n> Sample the guest IP every n instructions" << std::endl;
+        std::cout << "  --profile=timer:<us> Sample the guest IP every us microseconds of host time" << std::endl;
+        std::cout << "  --profile-file=<path> Profile report written on exit (default: profile.txt, folded stacks in <path>.folded)" << std::endl;
         return 0;
     }
 
+    // --- Command-line options ---
+    const char *game_name = nullptr;
+    i960_engine cpu_engine = I960_ENGINE_INTERPRETER;
+    i960_isa cpu_isa = I960_ISA_KB;
+    TraceLevel trace_level = TRACE_OFF;
+    const char *trace_file = "trace.bin";
+    ProfileMode profile_mode = PROFILE_OFF;
+    uint32_t profile_interval = 0;
+    std::string profile_file = "profile.txt";
+    bool idle_skip = true;
+    bool fusion = true;
+    bool fastmem = false;
+    std::vector<MemoryWatchpoint> watchpoints;
+    const char *pair_stats_file = nullptr;
+    const char *bus_stats_file = nullptr;
+    const char *hle_file = nullptr;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strncmp(argv[i], "--engine=", 9) == 0)
+        {
+            if (!i960_parse_engine(argv[i] + 9, &cpu_engine))
+            {
+                std::cerr << "Unknown CPU engine: " << (argv[i] + 9) << std::endl;
+                return -1;
+            }
+        }
+        else if (strncmp(argv[i], "--isa=", 6) == 0)
+        {
+            if (!i960_parse_isa(argv[i] + 6, &cpu_isa))
+            {
+                std::cerr << "Unknown instruction set: " << (argv[i] + 6) << std::endl;
+                return -1;
+            }
+        }
+        else if (strncmp(argv[i], "--trace=", 8) == 0)
+        {
+            if (!trace_parse_level(argv[i] + 8, &trace_level))
+            {
+                std::cerr << "Unknown trace level: " << (argv[i] + 8) << std::endl;
+                return -1;
+            }
+            if (trace_level > TRACE_COMPILED_LEVEL)
+            {
+                std::cerr << "Warning: this build only records traces up to level " << (int)TRACE_COMPILED_LEVEL << std::endl;
+            }
+        }
+        else if (strncmp(argv[i], "--trace-file=", 13) == 0)
+        {
+            trace_file = argv[i] + 13;
+        }
+        else if (strncmp(argv[i], "--profile=", 10) == 0)
+        {
+            if (!profiler_parse(argv[i] + 10, &profile_mode, &profile_interval))
+            {
+                std::cerr << "Invalid profile mode: " << (argv[i] + 10) << " (expected insn:<n> or timer:<us>)" << std::endl;
+                return -1;
+            }
+        }
+        else if (strncmp(argv[i], "--profile-file=", 15) == 0)
+        {
+            profile_file = argv[i] + 15;
+        }
+        else if (strcmp(argv[i], "--no-idle-skip") == 0)
+        {
+            idle_skip = false;
+        }
+        else if (strcmp(argv[i], "--no-fusion") == 0)
+        {
+            fusion = false;
+        }
+        else if (strcmp(argv[i], "--fastmem") == 0)
+        {
+            fastmem = true;
+        }
+        else if (strncmp(argv[i], "--watch=", 8) == 0)
+        {
+            MemoryWatchpoint watchpoint;
+            if (!memory_parse_watchpoint(argv[i] + 8, &watchpoint))
+            {
+                std::cerr << "Invalid watchpoint: " << (argv[i] + 8) << " (expected <addr>[:<len>][:r|w|rw])" << std::endl;
+                return 1;
+            }
+            watchpoints.push_back(watchpoint);
+        }
+        else if (strncmp(argv[i], "--bus-stats=", 12) == 0)
+        {
+            bus_stats_file = argv[i] + 12;
+        }
+        else if (strncmp(argv[i], "--pair-stats=", 13) == 0)
+        {
+            pair_stats_file = argv[i] + 13;
+        }
+        else if (strncmp(argv[i], "--hle=", 6) == 0)
+        {
+            hle_file = argv[i] + 6;
+        }
+        else if (game_name == nullptr)
+        {
+            game_name = argv[i];
+        }
+    }
+
     // --- SDL Initialization ---
     std::cout << "Initializing SDL..." << std::endl;
     int sdlInitResult = SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO | SDL_INIT_JOYSTICK);
@@ -368,66 +392,106 @@ int main(int argc, char *argv[])
     std::cout << "OpenGL context created successfully." << std::endl;
 
     // --- Emulator State ---
-    std::cout << "Initializing memory bus..." << std::endl;
-    MemoryBus bus;
-    memory_init(&bus);
-    std::cout << "Memory bus initialized." << std::endl;
+    std::cout << "Initializing emulator (memory bus, i960 CPU, TGP GPU, input, audio)..." << std::endl;
+    EmulatorConfig config;
+    config.engine = cpu_engine;
+    config.isa = cpu_isa;
+    config.idle_skip = idle_skip;
+    config.fusion = fusion;
+    config.fastmem = fastmem;
+    Emulator *emu = emulator_create(&config);
+    MemoryBus &bus = emu->bus;
+    i960_cpu &cpu = emu->cpu;
+    if (fastmem && !bus.fastmem)
+    {
+        std::cerr << "Fastmem unavailable on this host, using the memory bus" << std::endl;
+    }
+    for (const MemoryWatchpoint &watchpoint : watchpoints)
+    {
+        if (!memory_add_watchpoint(&bus, watchpoint.address, watchpoint.length, watchpoint.kinds))
+        {
+            std::cerr << "Too many watchpoints, ignoring 0x" << std::hex << watchpoint.address << std::dec << std::endl;
+        }
+    }
+    if (bus_stats_file && !memory_enable_stats(&bus))
+    {
+        std::cerr << "Warning: this build has no bus statistics (PIXEL_BUS_STATS=0)" << std::endl;
+        bus_stats_file = nullptr;
+    }
+    std::cout << "Emulator initialized." << std::endl;
+
+    TraceBuffer trace;
+    if (trace_level != TRACE_OFF)
+    {
+        trace_init(&trace, trace_level);
+        bus.trace = &trace;
+    }
 
     // Load the game ROMs into memory
     std::cout << "Loading game ROMs..." << std::endl;
 
     // Check if a game name was provided
-    if (argc < 2)
+    if (game_name == nullptr)
     {
         std::cerr << "Error: No game specified!" << std::endl;
         std::cerr << "Usage: PixelModel2 <game_name>" << std::endl;
         std::cerr << "Available games: vf2, daytona" << std::endl;
         std::cerr << "Use --help for more information." << std::endl;
-        memory_destroy(&bus);
+        emulator_destroy(emu);
         SDL_GL_DestroyContext(glContext);
         SDL_DestroyWindow(window);
         SDL_Quit();
         return -1;
     }
 
-    const char *game_name = argv[1];
-
     // Use repository-local roms directory by default so the executable works in any clone
     std::filesystem::path roms_dir = std::filesystem::current_path() / "roms";
     std::string roms_dir_str = roms_dir.string();
-    if (!load_game_by_name(&bus, game_name, roms_dir_str.c_str()))
+    if (!emulator_load_game(emu, game_name, roms_dir_str.c_str()))
     {
         std::cerr << "Failed to load game ROMs!" << std::endl;
-        memory_destroy(&bus);
+        emulator_destroy(emu);
         return -1;
     }
     std::cout << "Game ROMs loaded successfully." << std::endl;
 
-    std::cout << "Initializing i960 CPU..." << std::endl;
-    i960_cpu cpu;
-    i960_init(&cpu, &bus);
-    std::cout << "CPU initialized successfully." << std::endl;
-
-    std::cout << "Initializing TGP GPU..." << std::endl;
-    TGP *tgp = new TGP();
-    tgp_init(tgp, &bus);
-    std::cout << "TGP initialized successfully." << std::endl;
-
-    std::cout << "Connecting input system..." << std::endl;
-    memory_connect_input(&bus, &current_input);
-    std::cout << "Input system connected successfully." << std::endl;
+    if (pair_stats_file)
+    {
+        cpu.pair_stats = i960_pair_stats_create();
+    }
+    i960_hle *hle = nullptr;
+    if (hle_file)
+    {
+        hle = i960_hle_create();
+        if (i960_hle_load(hle, hle_file))
+        {
+            uint32_t rom_hash = i960_hle_rom_hash(&bus);
+            uint32_t active = i960_hle_attach(&cpu, hle, rom_hash);
+            std::cout << "HLE: " << active << " of " << hle->hooks.size() << " hooks match ROM CRC 0x" << std::hex
+                      << rom_hash << std::dec << std::endl;
+        }
+        else
+        {
+            std::cerr << "HLE hooks disabled" << std::endl;
+        }
+    }
+    Profiler profiler;
+    if (profile_mode != PROFILE_OFF)
+    {
+        profiler_init(&profiler, profile_mode, profile_interval);
+        cpu.profiler = &profiler;
+    }
+    std::cout << "CPU initialized successfully (engine: " << i960_engine_name(cpu.engine)
+              << ", isa: " << i960_isa_name(cpu.isa) << ")." << std::endl;
 
     // --- Audio Initialization ---
     std::cout << "Initializing audio system..." << std::endl;
     // For now, skip audio initialization to focus on other systems
     // TODO: Implement proper SDL3 audio device enumeration and opening
-    audio_state.stream = nullptr;
+    // (audio_callback with emu as userdata)
+    emu->audio.stream = nullptr;
     std::cout << "Audio system initialization skipped (TODO: implement SDL3 audio)" << std::endl;
 
-    std::cout << "Connecting audio system..." << std::endl;
-    memory_connect_audio(&bus, &audio_state);
-    std::cout << "Audio system connected successfully." << std::endl;
-
     std::cout << "All initializations completed successfully!" << std::endl;
     std::cout << "Emulator components are working correctly." << std::endl;
     std::cout << "ROMs loaded, starting emulation..." << std::endl;
@@ -436,6 +500,8 @@ int main(int argc, char *argv[])
     bool running = true;
     int frame_count = 0;
     std::cout << "Starting main emulation loop..." << std::endl;
+    auto speed_start = std::chrono::steady_clock::now();
+    uint64_t speed_cycles = cpu.cycles;
     while (running)
     {
         SDL_Event event;
@@ -445,14 +511,22 @@ int main(int argc, char *argv[])
             {
                 running = false;
             }
+            else if (event.type == SDL_EVENT_KEY_DOWN && event.key.key == SDLK_F3 && bus_stats_file)
+            {
+                // F3 = Write the bus statistics so far
+                if (memory_write_stats(&bus, bus_stats_file))
+                {
+                    std::cout << "Bus statistics written to " << bus_stats_file << std::endl;
+                }
+            }
             else
             {
-                handle_input_event(event);
+                handle_input_event(&emu->input, event);
             }
         }
 
-        // --- CPU Execution ---
-        i960_step(&cpu);
+        // --- CPU and TGP Execution ---
+        emulator_run_frame(emu);
 
         // Check if CPU is halted
         if (cpu.halted)
@@ -461,41 +535,38 @@ int main(int argc, char *argv[])
             running = false;
         }
 
-        // --- TGP Execution ---
-        tgp_step(tgp);
-
         // --- Debug: Display active inputs every 60 frames ---
         if (frame_count % 60 == 0)
         {
             std::cout << "Input state: ";
-            if (current_input.start_button)
+            if (emu->input.start_button)
                 std::cout << "START ";
-            if (current_input.service_button)
+            if (emu->input.service_button)
                 std::cout << "SERVICE ";
-            if (current_input.test_button)
+            if (emu->input.test_button)
                 std::cout << "TEST ";
-            if (current_input.coin_button)
+            if (emu->input.coin_button)
                 std::cout << "COIN ";
-            if (current_input.button1)
+            if (emu->input.button1)
                 std::cout << "B1 ";
-            if (current_input.button2)
+            if (emu->input.button2)
                 std::cout << "B2 ";
-            if (current_input.button3)
+            if (emu->input.button3)
                 std::cout << "B3 ";
-            if (current_input.button4)
+            if (emu->input.button4)
                 std::cout << "B4 ";
-            if (current_input.up)
+            if (emu->input.up)
                 std::cout << "UP ";
-            if (current_input.down)
+            if (emu->input.down)
                 std::cout << "DOWN ";
-            if (current_input.left)
+            if (emu->input.left)
                 std::cout << "LEFT ";
-            if (current_input.right)
+            if (emu->input.right)
                 std::cout << "RIGHT ";
-            if (current_input.steering != 0)
-                std::cout << "STEER:" << current_input.steering << " ";
-            if (current_input.throttle != 0)
-                std::cout << "THROTTLE:" << current_input.throttle << " ";
+            if (emu->input.steering != 0)
+                std::cout << "STEER:" << emu->input.steering << " ";
+            if (emu->input.throttle != 0)
+                std::cout << "THROTTLE:" << emu->input.throttle << " ";
             std::cout << std::endl;
         }
 
@@ -505,7 +576,7 @@ int main(int argc, char *argv[])
         glClear(GL_COLOR_BUFFER_BIT);
 
         // Render TGP framebuffer to screen
-        tgp_render_to_opengl(tgp);
+        tgp_render_to_opengl(emu->tgp);
 
         // Swap buffers
         SDL_GL_SwapWindow(window);
@@ -517,6 +588,10 @@ int main(int argc, char *argv[])
         if (frame_count % 60 == 0)
         { // Print every second
             std::cout << "Frame " << frame_count << " rendered successfully." << std::endl;
+            std::cout << "Emulated CPU: " << emulated_mhz(cpu.cycles - speed_cycles, speed_start) << " MHz (hardware: "
+                      << CPU_CLOCK_HZ / 1000000 << " MHz)" << std::endl;
+            speed_start = std::chrono::steady_clock::now();
+            speed_cycles = cpu.cycles;
         }
 
         // Exit after 5 frames for debugging
@@ -527,9 +602,90 @@ int main(int argc, char *argv[])
         }
     }
 
+    std::cout << std::dec << "CPU ran " << cpu.cycles << " cycles (" << emulated_mhz(cpu.cycles - speed_cycles, speed_start)
+              << " MHz emulated over the last interval), " << cpu.idle_cycles << " fast-forwarded in idle loops" << std::endl;
+    std::cout << "Guest RAM resident: " << memory_resident_bytes(&bus) / 1024 << " KB of " << MEMORY_SIZE / 1024 << " KB" << std::endl;
+    if (!watchpoints.empty())
+    {
+        std::vector<MemoryWatchHit> hits(MEMORY_WATCH_LOG_SIZE);
+        hits.resize(memory_watch_hits(&bus, hits.data(), MEMORY_WATCH_LOG_SIZE));
+        std::cout << "Watchpoint hits: " << bus.watch->hit_count << " (last " << hits.size() << " listed)" << std::endl;
+        for (const MemoryWatchHit &hit : hits)
+        {
+            std::cout << std::hex << "  ip 0x" << hit.ip << (hit.write ? " write " : " read  ") << std::dec << hit.size
+                      << " bytes at 0x" << std::hex << hit.address << ": 0x" << hit.old_value;
+            if (hit.write)
+            {
+                std::cout << " -> 0x" << hit.new_value;
+            }
+            std::cout << std::dec << std::endl;
+        }
+    }
+
     // --- Cleanup ---
-    delete tgp;
-    memory_destroy(&bus);
+    if (bus.trace)
+    {
+        if (trace_save(&trace, trace_file))
+        {
+            std::cout << "Trace written to " << trace_file << " (" << trace.count << " records)" << std::endl;
+        }
+        else
+        {
+            std::cerr << "Failed to write trace file: " << trace_file << std::endl;
+        }
+        trace_destroy(&trace);
+    }
+    if (cpu.profiler)
+    {
+        std::string folded_file = profile_file + ".folded";
+        if (profiler_write_report(&profiler, profile_file.c_str()) && profiler_write_folded(&profiler, folded_file.c_str()))
+        {
+            std::cout << "Profile written to " << profile_file << " and " << folded_file << " (" << profiler.samples << " samples)" << std::endl;
+        }
+        else
+        {
+            std::cerr << "Failed to write profile: " << profile_file << std::endl;
+        }
+        profiler_destroy(&profiler);
+    }
+    if (cpu.pair_stats)
+    {
+        if (i960_pair_stats_write(cpu.pair_stats, pair_stats_file))
+        {
+            std::cout << "Instruction pair statistics written to " << pair_stats_file << std::endl;
+        }
+        else
+        {
+            std::cerr << "Failed to write pair statistics: " << pair_stats_file << std::endl;
+        }
+        i960_pair_stats_destroy(cpu.pair_stats);
+        cpu.pair_stats = nullptr;
+    }
+    if (bus_stats_file)
+    {
+        if (memory_write_stats(&bus, bus_stats_file))
+        {
+            std::cout << "Bus statistics written to " << bus_stats_file << std::endl;
+        }
+        else
+        {
+            std::cerr << "Failed to write bus statistics: " << bus_stats_file << std::endl;
+        }
+    }
+    if (hle)
+    {
+        std::cout << "HLE: " << hle->calls << " routine calls run natively (" << hle->cycles << " guest cycles)" << std::endl;
+        for (const i960_hle_hook &hook : hle->hooks)
+        {
+            if (hook.calls > 0)
+            {
+                std::cout << "  0x" << std::hex << hook.entry << std::dec << " " << hook.name << ": " << hook.calls << " calls" << std::endl;
+            }
+        }
+        cpu.hle = nullptr;
+        i960_hle_destroy(hle);
+    }
+    emulator_destroy(emu);
     SDL_GL_DestroyContext(glContext);
     SDL_DestroyWindow(window);
     SDL_Quit();
@@ -33,6 +33,7 @@ int main(int argc, char* argv[]) {
     std::cout << "CPU test completed successfully." << std::endl;
 
     // --- Cleanup ---
+    i960_destroy(&cpu);
     memory_destroy(&bus);
 
     std::cout << "Test completed successfully. The emulator core is working!" << std::endl;
@@ -68,6 +68,7 @@ int main(int argc, char* argv[]) {
     std::cout << "Memory[0x100] = 0x" << mem_value << " (should be 0x4b)" << std::endl;
 
     // Cleanup
+    i960_destroy(&cpu);
     memory_destroy(&bus);
     std::cout << "\nTest completed successfully!" << std::endl;
     return 0;
@@ -0,0 +1,214 @@
+#include <iostream>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include "i960.h"
+#include "i960_jit.h"
+#include "memory.h"
+#include "test_kb_assembler.h"
+
+// Runs the same guest code on every CPU engine, checks that they end in the
+// same state and reports their throughput in emulated MHz.
+//
+// Usage: PixelModel2EngineTest [game_name [cycles]]
+// Without a game name a built-in counting loop is used.
+
+struct EngineResult {
+    uint32_t g[16];
+    uint32_t ip;
+    bool zero_flag;
+    bool halted;
+    bool data_dirty;  // The page the loop stores to was marked dirty
+    uint64_t watch_hits;  // Accesses to the loop's variable caught by a watchpoint
+    uint64_t ram_writes;  // RAM stores counted by the bus statistics (0 when compiled out)
+    uint64_t cycles;
+    double seconds;
+};
+
+static void load_loop_program(MemoryBus* bus, uint32_t iterations) {
+    uint8_t program[] = {
+        // ld_const g0, iterations
+        0x90, 0x00, (uint8_t)(iterations >> 24), (uint8_t)(iterations >> 16), (uint8_t)(iterations >> 8), (uint8_t)iterations,
+        // ld_const g1, 1
+        0x90, 0x01, 0x00, 0x00, 0x00, 0x01,
+        // ld_const g2, 0
+        0x90, 0x02, 0x00, 0x00, 0x00, 0x00,
+        // ld_const g5, 0
+        0x90, 0x05, 0x00, 0x00, 0x00, 0x00,
+        // loop (0x18): add_reg g2, g2, g0
+        0x58, 0x02, 0x02, 0x00,
+        // xor_reg g3, g3, g2
+        0xE2, 0x03, 0x03, 0x02,
+        // st g2, [0x2000]
+        0xC1, 0x02, 0x00, 0x00, 0x20, 0x00,
+        // ld g4, [0x2000]
+        0xC0, 0x04, 0x00, 0x00, 0x20, 0x00,
+        // sub_reg g0, g0, g1
+        0xD0, 0x00, 0x00, 0x01,
+        // cmp_reg g0, g5
+        0xF0, 0x00, 0x05,
+        // bne loop
+        0xF2, 0x00, 0x00, 0x00, 0x18,
+        // halt
+        0xFF
+    };
+    for (size_t i = 0; i < sizeof(program); ++i) {
+        memory_write_byte(bus, (uint32_t)i, program[i]);
+    }
+}
+
+static bool run_engine(i960_engine engine, const char* game_name, uint64_t max_cycles, EngineResult* result) {
+    MemoryBus bus;
+    memory_init(&bus);
+
+    if (game_name) {
+        std::filesystem::path roms_dir = std::filesystem::current_path() / "roms";
+        std::string roms_dir_str = roms_dir.string() + "/";
+        if (!load_game_by_name(&bus, game_name, roms_dir_str.c_str())) {
+            memory_destroy(&bus);
+            return false;
+        }
+    } else {
+        load_loop_program(&bus, 20000);
+        memory_add_watchpoint(&bus, 0x2000, 4, MEMORY_WATCH_READ | MEMORY_WATCH_WRITE);
+        memory_enable_stats(&bus);
+    }
+
+    static uint64_t dirty[MEMORY_DIRTY_WORDS];
+    memory_take_dirty_pages(&bus, dirty);
+
+    i960_cpu cpu;
+    i960_init(&cpu, &bus);
+    i960_set_engine(&cpu, engine);
+
+    auto start = std::chrono::steady_clock::now();
+    result->cycles = i960_run(&cpu, max_cycles);
+    auto stop = std::chrono::steady_clock::now();
+
+    result->seconds = std::chrono::duration<double>(stop - start).count();
+    memcpy(result->g, cpu.g, sizeof(result->g));
+    result->ip = cpu.ip;
+    result->zero_flag = cpu.zero_flag;
+    result->halted = cpu.halted;
+    memory_take_dirty_pages(&bus, dirty);
+    result->data_dirty = memory_dirty_page(dirty, 0x2000);
+    result->watch_hits = bus.watch != nullptr ? bus.watch->hit_count : 0;
+    result->ram_writes = bus.stats != nullptr ? bus.stats->regions[MEMORY_REGION_RAM].writes : 0;
+
+    i960_destroy(&cpu);
+    memory_destroy(&bus);
+    return true;
+}
+
+// KB loop whose load is not the first instruction of its block: every
+// watchpoint hit must name the load itself. Returns the hit count, or 0 when
+// a hit names any other instruction.
+static uint64_t run_kb_watch(i960_engine engine) {
+    const uint32_t G0 = 16, G1 = 17, G2 = 18;
+    const uint32_t WATCHED_ADDRESS = 0x3000;
+    KBAssembler a(0x100);
+    a.lda(WATCHED_ADDRESS, G1);
+    uint32_t loop = a.here();
+    a.reg(0x590, 1, G0, G0, true);  // addo 1, g0, g0
+    a.reg(0x590, 1, G0, G0, true);  // addo 1, g0, g0
+    uint32_t load = a.here();
+    a.memb(0x90, G2, G1);           // ld (g1), g2
+    a.ctrl(0x08, loop);             // b loop
+
+    MemoryBus bus;
+    memory_init(&bus);
+    load_kb_image(&bus, a);
+    memory_add_watchpoint(&bus, WATCHED_ADDRESS, 4, MEMORY_WATCH_READ);
+    i960_cpu cpu;
+    i960_init(&cpu, &bus);
+    i960_set_engine(&cpu, engine);
+    i960_set_isa(&cpu, I960_ISA_KB);
+    i960_boot(&cpu);
+    i960_run(&cpu, 100000);
+
+    static MemoryWatchHit hits[MEMORY_WATCH_LOG_SIZE];
+    uint32_t count = memory_watch_hits(&bus, hits, MEMORY_WATCH_LOG_SIZE);
+    uint64_t total = bus.watch->hit_count;
+    for (uint32_t i = 0; i < count; ++i) {
+        if (hits[i].ip != load) {
+            std::cerr << i960_engine_name(engine) << ": watchpoint hit at ip 0x" << std::hex << hits[i].ip
+                      << ", the load is at 0x" << load << std::dec << std::endl;
+            total = 0;
+            break;
+        }
+    }
+    i960_destroy(&cpu);
+    memory_destroy(&bus);
+    return total;
+}
+
+int main(int argc, char* argv[]) {
+    const char* game_name = argc > 1 ? argv[1] : nullptr;
+    uint64_t max_cycles = argc > 2 ? strtoull(argv[2], nullptr, 10) : 10000000;
+
+    std::cout << "Comparing CPU engines on " << (game_name ? game_name : "built-in loop") << std::endl;
+
+    const i960_engine engines[] = {I960_ENGINE_INTERPRETER, I960_ENGINE_THREADED, I960_ENGINE_JIT};
+    const int engine_count = i960_jit_available() ? 3 : 2;
+    EngineResult results[3];
+    for (int i = 0; i < engine_count; ++i) {
+        if (!run_engine(engines[i], game_name, max_cycles, &results[i])) {
+            std::cerr << "Failed to set up guest code" << std::endl;
+            return 1;
+        }
+        double mhz = results[i].seconds > 0 ? results[i].cycles / results[i].seconds / 1e6 : 0.0;
+        std::cout << i960_engine_name(engines[i]) << ": " << std::dec << results[i].cycles << " cycles in "
+                  << results[i].seconds * 1000.0 << " ms (" << mhz << " emulated MHz)" << std::endl;
+    }
+
+    const EngineResult& a = results[0];
+    for (int i = 1; i < engine_count; ++i) {
+        const EngineResult& b = results[i];
+        bool same = a.cycles == b.cycles && a.ip == b.ip && a.zero_flag == b.zero_flag &&
+                    a.halted == b.halted && a.data_dirty == b.data_dirty && a.watch_hits == b.watch_hits &&
+                    a.ram_writes == b.ram_writes && memcmp(a.g, b.g, sizeof(a.g)) == 0;
+        if (!same) {
+            std::cerr << "Engine state mismatch (" << i960_engine_name(engines[i]) << "): ip 0x" << std::hex << a.ip
+                      << " vs 0x" << b.ip << std::endl;
+            for (int r = 0; r < 16; ++r) {
+                if (a.g[r] != b.g[r]) {
+                    std::cerr << "  g" << std::dec << r << ": 0x" << std::hex << a.g[r] << " vs 0x" << b.g[r] << std::endl;
+                }
+            }
+            return 1;
+        }
+    }
+
+    if (!game_name && !a.data_dirty) {
+        std::cerr << "The loop's stores did not mark their page dirty" << std::endl;
+        return 1;
+    }
+    if (!game_name && a.watch_hits != 2 * 20000) {
+        std::cerr << "Watchpoint caught " << std::dec << a.watch_hits << " of the loop's 40000 accesses" << std::endl;
+        return 1;
+    }
+
+    if (!game_name && MEMORY_STATS_COMPILED && a.ram_writes != 20000) {
+        std::cerr << "Bus statistics counted " << std::dec << a.ram_writes << " of the loop's 20000 stores" << std::endl;
+        return 1;
+    }
+
+    if (!game_name) {
+        uint64_t kb_hits = run_kb_watch(engines[0]);
+        for (int i = 1; i < engine_count && kb_hits != 0; ++i) {
+            if (run_kb_watch(engines[i]) != kb_hits) {
+                std::cerr << "KB watchpoint hits differ on " << i960_engine_name(engines[i]) << std::endl;
+                return 1;
+            }
+        }
+        if (kb_hits == 0) {
+            std::cerr << "KB watchpoint hits name the wrong instruction" << std::endl;
+            return 1;
+        }
+        std::cout << "KB watchpoint: " << std::dec << kb_hits << " hits at the load on every engine" << std::endl;
+    }
+
+    std::cout << "Final state matches across engines (g2 = 0x" << std::hex << a.g[2] << ")" << std::endl;
+    return 0;
+}
@@ -0,0 +1,195 @@
+#include <iostream>
+#include <cstring>
+#include <thread>
+#include <vector>
+#include "emulator.h"
+#include "test_kb_assembler.h"
+
+// Checks the fastmem view: a program mixing RAM, device registers,
+// unmapped space, accesses straddling the end of RAM and a store over code
+// it has already run must end in exactly the same state with and without
+// fastmem, on every engine and with several instances faulting at once.
+
+const uint32_t G0 = 16, G1 = 17, G2 = 18, G3 = 19, G4 = 20, G5 = 21, G6 = 22, G7 = 23;
+const uint32_t G9 = 25, G10 = 26, G11 = 27, G12 = 28, G13 = 29;
+const uint32_t PROGRAM_START = 0x100;
+const uint32_t SCRATCH_ADDRESS = 0x3000;
+const uint32_t PATCH_DATA_ADDRESS = 0x3100;
+const uint32_t UNMAPPED_ADDRESS = 0x80000000;
+const int INSTANCES = 4;
+
+// The patched-in replacement for the loop's "addo 1, g9, g9"
+static const uint32_t PATCHED_ADD = KBAssembler::reg_word(0x590, 16, G9, G9, true); // addo 16, g9, g9
+
+static KBAssembler assemble_program() {
+    KBAssembler a(PROGRAM_START);
+    // Device registers: steering in, audio frequency out and back
+    a.lda(INPUT_BASE_ADDRESS + 0x24, G1);
+    a.memb(0x90, G4, G1);                  // ld (g1), g4
+    a.lda(AUDIO_BASE_ADDRESS + 0x14, G3);
+    a.memb(0x92, G4, G3);                  // st g4, (g3)
+    a.memb(0x90, G5, G3);                  // ld (g3), g5
+    a.memb(0x82, G4, G3);                  // stob g4, (g3): byte writes to devices are ignored
+    // Unmapped space reads 0 and ignores writes
+    a.lda(7, G6);
+    a.lda(UNMAPPED_ADDRESS, G1);
+    a.memb(0x92, G6, G1);                  // st g6, (g1)
+    a.memb(0x90, G6, G1);                  // ld (g1), g6
+    // RAM at every width, unaligned included
+    a.lda(SCRATCH_ADDRESS, G2);
+    a.memb(0x92, G4, G2);                  // st g4, (g2)
+    a.lda(SCRATCH_ADDRESS + 6, G2);
+    a.memb(0x8A, G4, G2);                  // stos g4, (g2)
+    a.memb(0x88, G13, G2);                 // ldos (g2), g13
+    a.lda(SCRATCH_ADDRESS + 1, G2);
+    a.memb(0x80, G12, G2);                 // ldob (g2), g12
+    // A word straddling the end of RAM keeps only the bytes inside it
+    a.lda(MEMORY_SIZE - 2, G1);
+    a.memb(0x92, G4, G1);                  // st g4, (g1)
+    a.memb(0x90, G0, G1);                  // ld (g1), g0
+    // Three passes over an add that the first pass rewrites
+    a.lda(0, G9);
+    a.lda(3, G7);
+    a.lda(PATCH_DATA_ADDRESS, G10);
+    a.memb(0x90, G10, G10);                // ld (g10), g10
+    uint32_t loop = a.here();
+    a.reg(0x590, 1, G9, G9, true);         // addo 1, g9, g9 (patched)
+    a.lda(loop, G11);
+    a.memb(0x92, G10, G11);                // st g10, (g11)
+    a.reg(0x592, 1, G7, G7, true);         // subo 1, g7, g7
+    a.cobr(0x34, 0, G7, loop, true);       // cmpobl 0, g7, loop
+    uint32_t spin = a.here();
+    a.ctrl(0x08, spin);                    // b .
+    return a;
+}
+
+struct FastmemResult {
+    uint32_t regs[32];       // r0-r15, g0-g15
+    uint64_t cycles;
+    uint16_t frequency;      // Audio channel 0 as the program left it
+    std::vector<uint8_t> scratch;
+    bool fastmem;            // The view was actually in use
+};
+
+static void run_program(i960_engine engine, bool fastmem, int16_t steering, FastmemResult* result) {
+    EmulatorConfig config;
+    config.engine = engine;
+    config.fastmem = fastmem;
+    Emulator* emu = emulator_create(&config);
+
+    load_kb_image(&emu->bus, assemble_program());
+    memory_write_dword(&emu->bus, PATCH_DATA_ADDRESS, PATCHED_ADD);
+    emulator_reset(emu);
+    emu->input.steering = steering;
+    emulator_run_frame(emu);
+
+    memcpy(result->regs, emu->cpu.regs, sizeof(result->regs));
+    result->cycles = emu->cpu.cycles;
+    result->frequency = emu->audio.channels[0].frequency;
+    result->scratch.assign(emu->bus.ram + SCRATCH_ADDRESS, emu->bus.ram + SCRATCH_ADDRESS + 16);
+    result->fastmem = emu->bus.fastmem != nullptr;
+    emulator_destroy(emu);
+}
+
+static bool same(const FastmemResult& a, const FastmemResult& b) {
+    return memcmp(a.regs, b.regs, sizeof(a.regs)) == 0 && a.cycles == b.cycles && a.frequency == b.frequency &&
+           a.scratch == b.scratch;
+}
+
+int main() {
+    std::cout << "Testing fastmem..." << std::endl;
+    bool ok = true;
+
+    // Enabling the view keeps what is already in RAM
+    {
+        MemoryBus bus;
+        memory_init(&bus);
+        memory_write_dword(&bus, 0x1234, 0xCAFEF00D);
+        bool enabled = memory_enable_fastmem(&bus);
+        std::cout << "Fastmem " << (enabled ? "enabled" : "unavailable, checking the fallback only") << std::endl;
+        ok = ok && enabled == (MEMORY_FASTMEM_SUPPORTED != 0);
+        ok = ok && memory_read_dword(&bus, 0x1234) == 0xCAFEF00D && memory_fast_read_dword(&bus, 0x1234) == 0xCAFEF00D;
+        memory_fast_write_dword(&bus, 0x2000, 0x12345678);
+        ok = ok && memory_read_dword(&bus, 0x2000) == 0x12345678 && memory_fast_read_dword(&bus, INPUT_BASE_ADDRESS) == 0;
+        // Fastmem stores mark pages dirty too, once per snapshot
+        static uint64_t dirty[MEMORY_DIRTY_WORDS];
+        memory_take_dirty_pages(&bus, dirty);
+        memory_fast_write_dword(&bus, 0x7000, 1);
+        memory_fast_write_byte(&bus, 0x7001, 2);
+        ok = ok && memory_take_dirty_pages(&bus, dirty) == 1 && memory_dirty_page(dirty, 0x7000);
+        memory_fast_write_dword(&bus, 0x7000, 3);
+        ok = ok && memory_take_dirty_pages(&bus, dirty) == 1 && memory_read_dword(&bus, 0x7000) == 3;
+        // Watched RAM faults over to the bus on every access
+        memory_add_watchpoint(&bus, 0x7000, 4, MEMORY_WATCH_WRITE);
+        memory_fast_write_dword(&bus, 0x7000, 4);
+        memory_fast_write_dword(&bus, 0x7000, 5);
+        memory_fast_write_dword(&bus, 0x7100, 6);
+        MemoryWatchHit hits[4];
+        ok = ok && memory_watch_hits(&bus, hits, 4) == 2 && hits[1].old_value == 4 && hits[1].new_value == 5 &&
+             memory_fast_read_dword(&bus, 0x7000) == 5 && memory_fast_read_dword(&bus, 0x7100) == 6;
+        memory_clear_watchpoints(&bus);
+        memory_fast_write_dword(&bus, 0x7000, 7);
+        ok = ok && memory_watch_hits(&bus, hits, 4) == 2 && memory_read_dword(&bus, 0x7000) == 7;
+        // Halfwords, including one straddling the end of RAM
+        memory_fast_write_half(&bus, 0x2001, 0xBEEF);
+        memory_fast_write_half(&bus, MEMORY_SIZE - 1, 0xA55A);
+        ok = ok && memory_fast_read_half(&bus, 0x2001) == 0xBEEF && memory_read_dword(&bus, 0x2000) == 0x12BEEF78 &&
+             memory_fast_read_half(&bus, MEMORY_SIZE - 1) == 0x5A && memory_read_byte(&bus, MEMORY_SIZE - 1) == 0x5A;
+        // A board map is followed by the view: ROM read-only, gaps unmapped
+        ok = ok && memory_apply_board(&bus, memory_find_board("model2a"));
+        memory_fast_write_dword(&bus, 0x200100, 10);   // Work RAM
+        memory_fast_write_dword(&bus, 0x000100, 11);   // Program ROM
+        memory_fast_write_dword(&bus, 0x300100, 12);   // Between regions
+        ok = ok && memory_fast_read_dword(&bus, 0x200100) == 10 && memory_fast_read_dword(&bus, 0x000100) == 0 &&
+             memory_fast_read_dword(&bus, 0x300100) == 0 && memory_read_dword(&bus, 0x200100) == 10;
+        // Shared ROM is mapped into the view read-only; stores to it are dropped
+        static uint8_t rom[MEMORY_PAGE_SIZE];
+        for (uint32_t i = 0; i < MEMORY_PAGE_SIZE; ++i) {
+            rom[i] = (uint8_t)(i * 13 + 0x5C);
+        }
+        ok = ok && memory_load_rom(&bus, 0x2000000, rom, MEMORY_PAGE_SIZE);
+        memory_fast_write_dword(&bus, 0x2000100, 0);
+        memory_fast_write_byte(&bus, 0x2000101, 0);
+        ok = ok && memory_fast_read_dword(&bus, 0x2000100) == memory_load_le32(rom + 0x100) &&
+             memory_read_dword(&bus, 0x2000100) == memory_load_le32(rom + 0x100);
+        memory_fast_write_dword(&bus, 0x23FF00, 9); // Work RAM still writable
+        ok = ok && memory_fast_read_dword(&bus, 0x23FF00) == 9;
+        memory_destroy(&bus);
+    }
+
+    FastmemResult reference;
+    run_program(I960_ENGINE_INTERPRETER, false, 300, &reference);
+    bool expected = reference.regs[G4] == 300 && reference.regs[G5] == 300 && reference.frequency == 300 &&
+                    reference.regs[G6] == 0 && reference.regs[G0] == 300 && reference.regs[G12] == 1 &&
+                    reference.regs[G13] == 300 && reference.regs[G9] == 33;
+    std::cout << "Bus: g9 = " << reference.regs[G9] << " (should be 33 once the add is rewritten), g0 = "
+              << reference.regs[G0] << ", " << reference.cycles << " cycles" << std::endl;
+    ok = ok && expected;
+
+    for (i960_engine engine : {I960_ENGINE_INTERPRETER, I960_ENGINE_THREADED, I960_ENGINE_JIT}) {
+        FastmemResult bus, fast;
+        run_program(engine, false, 300, &bus);
+        run_program(engine, true, 300, &fast);
+        bool match = same(bus, reference) && same(fast, reference) && fast.fastmem == (MEMORY_FASTMEM_SUPPORTED != 0);
+        std::cout << i960_engine_name(engine) << ": " << (match ? "matches" : "MISMATCH") << std::endl;
+        ok = ok && match;
+    }
+
+    // Instances fault concurrently, each through its own view
+    FastmemResult sequential[INSTANCES], threaded[INSTANCES];
+    std::vector<std::thread> threads;
+    for (int i = 0; i < INSTANCES; ++i) {
+        run_program(I960_ENGINE_THREADED, false, (int16_t)(100 * (i + 1)), &sequential[i]);
+        threads.emplace_back(run_program, I960_ENGINE_THREADED, true, (int16_t)(100 * (i + 1)), &threaded[i]);
+    }
+    bool parallel = true;
+    for (int i = 0; i < INSTANCES; ++i) {
+        threads[i].join();
+        parallel = parallel && same(threaded[i], sequential[i]) && threaded[i].frequency == 100 * (i + 1);
+    }
+    std::cout << INSTANCES << " instances in parallel: " << (parallel ? "independent" : "MISMATCH") << std::endl;
+    ok = ok && parallel;
+
+    std::cout << (ok ? "\nFastmem test passed!" : "\nFastmem test FAILED!") << std::endl;
+    return ok ? 0 : 1;
+}
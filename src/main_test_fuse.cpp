@@ -0,0 +1,182 @@
+#include <algorithm>
+#include <iostream>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include "i960.h"
+#include "i960_block.h"
+#include "i960_fuse.h"
+#include "memory.h"
+#include "test_kb_assembler.h"
+
+// Checks superinstruction fusion: programs full of fusable pairs must end
+// in exactly the same state and cycle count with fusion on and off, and on
+// every engine. The pair statistics must count each executed pair once.
+
+const uint32_t G0 = 16, G1 = 17, G3 = 19, G4 = 20, G5 = 21, G6 = 22;
+const uint32_t PROGRAM_START = 0x100;
+const uint32_t DATA_ADDRESS = 0x3000;
+
+struct FuseResult {
+    uint32_t regs[32];
+    uint32_t ip;
+    uint64_t cycles;
+    uint64_t dispatches; // Dispatch list entries over all translated blocks
+    uint64_t insns;      // Instructions over all translated blocks
+};
+
+// Legacy countdown loop (sub_reg + bne), then load + compare + branch
+static const uint8_t legacy_program[] = {
+    0x90, 0x00, 0x00, 0x00, 0x03, 0xE8, // 0:  ld_const g0, 1000
+    0x90, 0x01, 0x00, 0x00, 0x00, 0x01, // 6:  ld_const g1, 1
+    0xD0, 0x00, 0x00, 0x01,             // 12: sub_reg g0, g0, g1
+    0xF2, 0x00, 0x00, 0x00, 0x0C,       // 16: bne 12
+    0x90, 0x03, 0x00, 0x00, 0x00, 0x07, // 21: ld_const g3, 7
+    0xC0, 0x04, 0x00, 0x00, 0x08, 0x00, // 27: ld g4, [0x800]
+    0xF0, 0x04, 0x03,                   // 33: cmp_reg g4, g3
+    0xF1, 0x00, 0x00, 0x00, 0x2C,       // 36: beq 44
+    0xFF, 0xFF, 0xFF,                   // 41: halt (skipped)
+    0x58, 0x05, 0x04, 0x03,             // 44: add_reg g5, g4, g3
+    0xFF,                               // 48: halt
+};
+
+// KB: count down (subo + cmpobl), poll a word (ld + cmpobe), compare and
+// branch (cmpo + be), then spin
+static KBAssembler assemble_kb() {
+    KBAssembler a(PROGRAM_START);
+    a.reg(0x5CC, 0, 0, G1, true);                    // mov 0, g1
+    a.lda(DATA_ADDRESS, G3);                         // lda DATA_ADDRESS, g3
+    a.reg(0x5CC, 20, 0, G0, true);                   // mov 20, g0
+    uint32_t loop = a.here();
+    a.reg(0x590, G0, G1, G1);                        // addo g0, g1, g1
+    a.reg(0x592, 1, G0, G0, true);                   // subo 1, g0, g0
+    a.cobr(0x34, 0, G0, loop, true);                 // cmpobl 0, g0, loop
+    a.memb(0x90, G4, G3);                            // ld (g3), g4
+    uint32_t poll = a.here();
+    a.cobr(0x32, 0, G4, poll, true);                 // cmpobe 0, g4, skip (patched)
+    a.reg(0x5CC, 1, 0, G5, true);                    // mov 1, g5
+    uint32_t skip = a.here();
+    a.reg(0x5A0, G1, G4, 0);                         // cmpo g1, g4
+    uint32_t be = a.here();
+    a.ctrl(0x12, be);                                // be done (patched)
+    a.reg(0x5CC, 2, 0, G6, true);                    // mov 2, g6
+    uint32_t done = a.here();
+    a.ctrl(0x08, done);                              // b .
+
+    a.patch_cobr(poll, skip);
+    a.patch_ctrl(be, done);
+    return a;
+}
+
+static void run(i960_isa isa, i960_engine engine, bool fusion, FuseResult* result, i960_pair_stats* stats) {
+    MemoryBus bus;
+    memory_init(&bus);
+    if (isa == I960_ISA_KB) {
+        load_kb_image(&bus, assemble_kb());
+    } else {
+        for (uint32_t i = 0; i < sizeof(legacy_program); ++i) {
+            memory_write_byte(&bus, i, legacy_program[i]);
+        }
+        memory_write_dword(&bus, 0x800, 7);
+    }
+
+    i960_cpu cpu;
+    i960_init(&cpu, &bus);
+    i960_set_engine(&cpu, engine);
+    i960_set_isa(&cpu, isa);
+    if (isa == I960_ISA_KB) {
+        i960_boot(&cpu);
+    }
+    cpu.fusion = fusion;
+    cpu.pair_stats = stats;
+    i960_run(&cpu, 50000);
+
+    memcpy(result->regs, cpu.regs, sizeof(result->regs));
+    result->ip = cpu.ip;
+    result->cycles = cpu.cycles;
+    result->dispatches = 0;
+    result->insns = 0;
+    if (cpu.block_cache) {
+        for (const auto& entry : cpu.block_cache->blocks) {
+            result->dispatches += entry.second.code.size();
+            result->insns += entry.second.ops.size();
+        }
+    }
+    i960_destroy(&cpu);
+    memory_destroy(&bus);
+}
+
+static bool same(const FuseResult& a, const FuseResult& b) {
+    return memcmp(a.regs, b.regs, sizeof(a.regs)) == 0 && a.ip == b.ip && a.cycles == b.cycles;
+}
+
+// Writes the pair report and reads back its first pair: the most frequent
+// one, named expected_pair when given
+static bool check_report(const i960_pair_stats* stats, const char* expected_pair) {
+    const char* path = "fuse_test_pairs.txt";
+    uint64_t most = 0;
+    for (uint32_t first = 0; first < I960_OP_COUNT; ++first) {
+        for (uint32_t second = 0; second < I960_OP_COUNT; ++second) {
+            most = std::max(most, stats->counts[first][second]);
+        }
+    }
+
+    bool ok = i960_pair_stats_write(stats, path);
+    std::string line;
+    {
+        // Header, blank line and column titles come first
+        std::ifstream file(path);
+        for (int i = 0; i < 4 && std::getline(file, line); ++i) {
+        }
+    }
+    std::remove(path);
+
+    uint64_t count = 0;
+    std::istringstream(line) >> count;
+    std::cout << "Top pair in the report:" << line << std::endl;
+    return ok && count == most && (expected_pair == nullptr || line.find(expected_pair) != std::string::npos);
+}
+
+int main() {
+    std::cout << "Testing superinstruction fusion..." << std::endl;
+    bool ok = true;
+
+    for (i960_isa isa : {I960_ISA_LEGACY, I960_ISA_KB}) {
+        FuseResult interp, unfused, fused, jit;
+        i960_pair_stats* stats = i960_pair_stats_create();
+        run(isa, I960_ENGINE_INTERPRETER, true, &interp, nullptr);
+        run(isa, I960_ENGINE_THREADED, false, &unfused, nullptr);
+        run(isa, I960_ENGINE_THREADED, true, &fused, stats);
+        run(isa, I960_ENGINE_JIT, true, &jit, nullptr);
+
+        bool identical = same(unfused, interp) && same(fused, interp) && same(jit, interp);
+        std::cout << i960_isa_name(isa) << ": " << interp.cycles << " cycles, engines "
+                  << (identical ? "identical" : "MISMATCH") << "; " << fused.insns << " instructions in "
+                  << fused.dispatches << " dispatches (" << unfused.dispatches << " unfused)" << std::endl;
+        ok = ok && identical && fused.dispatches < unfused.dispatches && unfused.dispatches == unfused.insns;
+
+        if (isa == I960_ISA_LEGACY) {
+            // Every pass of the countdown runs sub_reg + bne as one superinstruction
+            uint64_t countdown = stats->counts[I960_OP_SUB_REG][I960_OP_BNE];
+            std::cout << "sub_reg + bne: " << countdown << " (should be 1000), fused "
+                      << stats->fused[I960_OP_SUB_REG][I960_OP_BNE] << std::endl;
+            ok = ok && countdown == 1000 && stats->fused[I960_OP_SUB_REG][I960_OP_BNE] &&
+                 interp.regs[G5] == 14 && interp.regs[G0] == 0;
+        } else {
+            uint64_t countdown = stats->counts[I960_OP_SUBO][I960_OP_CMPOB];
+            std::cout << "subo + cmpob: " << countdown << " (should be 20), fused "
+                      << stats->fused[I960_OP_SUBO][I960_OP_CMPOB] << std::endl;
+            ok = ok && countdown == 20 && stats->fused[I960_OP_SUBO][I960_OP_CMPOB] &&
+                 stats->fused[I960_OP_CMPO][I960_OP_BCC] && interp.regs[G1] == 210 && interp.regs[G5] == 0 &&
+                 interp.regs[G6] == 2;
+        }
+        ok = ok && stats->fused_pairs > 0 && stats->fused_pairs <= stats->pairs;
+        ok = check_report(stats, isa == I960_ISA_LEGACY ? "sub_reg + bne" : nullptr) && ok;
+        i960_pair_stats_destroy(stats);
+    }
+
+    std::cout << (ok ? "\nFusion test passed!" : "\nFusion test FAILED!") << std::endl;
+    return ok ? 0 : 1;
+}
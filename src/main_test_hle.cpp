@@ -0,0 +1,269 @@
+#include <iostream>
+#include <fstream>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include "i960.h"
+#include "i960_decode.h"
+#include "i960_hle.h"
+#include "memory.h"
+#include "test_kb_assembler.h"
+
+// Checks the high-level emulation hooks: each native routine must leave
+// memory and g0 exactly as its interpreted guest loop does, in the same
+// number of cycles, on every engine; hooks registered for another ROM
+// must not fire. Sources are read from RAM and from a ROM image.
+
+const uint32_t G0 = 16, G1 = 17, G2 = 18, G3 = 19, G4 = 20, G8 = 24, G13 = 29, G14 = 30;
+const uint32_t PROGRAM_START = 0x100;
+const uint32_t MEMCPY_ADDRESS = 0x1000;
+const uint32_t MEMSET_ADDRESS = 0x1100;
+const uint32_t CHECKSUM_ADDRESS = 0x1200;
+const uint32_t CHECKSUM_CALL_ADDRESS = 0x1300; // Same loop, reached by call and ending in ret
+const uint32_t SOURCE_ADDRESS = 0x4000;
+const uint32_t COPY_ADDRESS = 0x5000;
+const uint32_t FILL_ADDRESS = 0x6000;
+const uint32_t DATA_END = 0x7000;
+const uint32_t ROM_ADDRESS = 0x100000;
+const uint32_t RESULT_COUNT = 6; // g8-g13
+
+// memcpy(g0 = dst, g1 = src, g2 = bytes), byte at a time
+static KBAssembler assemble_memcpy() {
+    KBAssembler a(MEMCPY_ADDRESS);
+    a.reg(0x5CC, G0, 0, G3);           // mov g0, g3
+    uint32_t skip = a.here();
+    a.cobr(0x32, 0, G2, skip, true);   // cmpobe 0, g2, done
+    uint32_t loop = a.here();
+    a.memb(0x80, G4, G1);              // ldob (g1), g4
+    a.memb(0x82, G4, G3);              // stob g4, (g3)
+    a.reg(0x590, 1, G1, G1, true);     // addo 1, g1, g1
+    a.reg(0x590, 1, G3, G3, true);     // addo 1, g3, g3
+    a.reg(0x592, 1, G2, G2, true);     // subo 1, g2, g2
+    a.cobr(0x34, 0, G2, loop, true);   // cmpobl 0, g2, loop
+    a.patch_cobr(skip, a.here());
+    a.memb(0x84, 0, G14);              // bx (g14)
+    return a;
+}
+
+// memset(g0 = dst, g1 = byte, g2 = bytes)
+static KBAssembler assemble_memset() {
+    KBAssembler a(MEMSET_ADDRESS);
+    a.reg(0x5CC, G0, 0, G3);           // mov g0, g3
+    uint32_t skip = a.here();
+    a.cobr(0x32, 0, G2, skip, true);   // cmpobe 0, g2, done
+    uint32_t loop = a.here();
+    a.memb(0x82, G1, G3);              // stob g1, (g3)
+    a.reg(0x590, 1, G3, G3, true);     // addo 1, g3, g3
+    a.reg(0x592, 1, G2, G2, true);     // subo 1, g2, g2
+    a.cobr(0x34, 0, G2, loop, true);   // cmpobl 0, g2, loop
+    a.patch_cobr(skip, a.here());
+    a.memb(0x84, 0, G14);              // bx (g14)
+    return a;
+}
+
+// checksum32(g0 = address, g1 = words) -> g0, returning with bx or ret
+static KBAssembler assemble_checksum(uint32_t origin, bool leaf) {
+    KBAssembler a(origin);
+    a.reg(0x5CC, 0, 0, G3, true);      // mov 0, g3
+    uint32_t skip = a.here();
+    a.cobr(0x32, 0, G1, skip, true);   // cmpobe 0, g1, done
+    uint32_t loop = a.here();
+    a.memb(0x90, G4, G0);              // ld (g0), g4
+    a.reg(0x590, G4, G3, G3);          // addo g4, g3, g3
+    a.reg(0x590, 4, G0, G0, true);     // addo 4, g0, g0
+    a.reg(0x592, 1, G1, G1, true);     // subo 1, g1, g1
+    a.cobr(0x34, 0, G1, loop, true);   // cmpobl 0, g1, loop
+    a.patch_cobr(skip, a.here());
+    a.reg(0x5CC, G3, 0, G0);           // mov g3, g0
+    if (leaf) {
+        a.memb(0x84, 0, G14);          // bx (g14)
+    } else {
+        a.words.push_back(0x0Au << 24); // ret
+    }
+    return a;
+}
+
+// Calls every routine, keeping each g0 in g8-g12, then spins
+static KBAssembler assemble_driver(uint32_t* spin) {
+    KBAssembler a(PROGRAM_START);
+    a.lda(COPY_ADDRESS, G0);
+    a.lda(SOURCE_ADDRESS, G1);
+    a.lda(300, G2);
+    a.ctrl(0x0B, MEMCPY_ADDRESS);      // bal memcpy
+    a.reg(0x5CC, G0, 0, G8);           // mov g0, g8
+    a.lda(FILL_ADDRESS, G0);
+    a.lda(0xA5, G1);
+    a.lda(200, G2);
+    a.ctrl(0x0B, MEMSET_ADDRESS);      // bal memset
+    a.reg(0x5CC, G0, 0, G8 + 1);       // mov g0, g9
+    a.lda(COPY_ADDRESS, G0);
+    a.lda(75, G1);
+    a.ctrl(0x0B, CHECKSUM_ADDRESS);    // bal checksum32
+    a.reg(0x5CC, G0, 0, G8 + 2);       // mov g0, g10
+    a.lda(SOURCE_ADDRESS, G0);
+    a.lda(64, G1);
+    a.ctrl(0x09, CHECKSUM_CALL_ADDRESS); // call checksum32
+    a.reg(0x5CC, G0, 0, G8 + 3);       // mov g0, g11
+    a.lda(SOURCE_ADDRESS + 0x10, G0);  // Overlapping copy: replicates the first 16 bytes
+    a.lda(SOURCE_ADDRESS, G1);
+    a.lda(40, G2);
+    a.ctrl(0x0B, MEMCPY_ADDRESS);      // bal memcpy
+    a.reg(0x5CC, G0, 0, G8 + 4);       // mov g0, g12
+    a.lda(COPY_ADDRESS + 0x400, G0);   // Copy out of ROM
+    a.lda(ROM_ADDRESS + 5, G1);
+    a.lda(100, G2);
+    a.ctrl(0x0B, MEMCPY_ADDRESS);      // bal memcpy
+    a.lda(ROM_ADDRESS + 0x40, G0);     // Checksum of ROM
+    a.lda(32, G1);
+    a.ctrl(0x0B, CHECKSUM_ADDRESS);    // bal checksum32
+    a.reg(0x5CC, G0, 0, G13);          // mov g0, g13
+    *spin = a.here();
+    a.ctrl(0x08, *spin);               // b .
+    return a;
+}
+
+struct HLEResult {
+    uint32_t results[RESULT_COUNT];
+    uint32_t ip;
+    uint64_t cycles;       // When the driver reached its spin (stepped runs only)
+    uint64_t calls;        // Routines replaced
+    std::vector<uint8_t> data;
+};
+
+enum HookMode {
+    HOOKS_NONE,      // Plain interpretation
+    HOOKS_OTHER_ROM, // Hooks registered for a different ROM hash
+    HOOKS_THIS_ROM,  // Hooks loaded from a file for this ROM
+};
+
+static const char* HOOK_FILE = "hle_test_hooks.txt";
+
+static void load_program(MemoryBus* bus, uint32_t* spin) {
+    load_kb_image(bus, assemble_driver(spin));
+    KBAssembler routines[] = {assemble_memcpy(), assemble_memset(), assemble_checksum(CHECKSUM_ADDRESS, true),
+                              assemble_checksum(CHECKSUM_CALL_ADDRESS, false)};
+    for (const KBAssembler& routine : routines) {
+        load_kb_code(bus, routine);
+    }
+    for (uint32_t i = 0; i < 512; ++i) {
+        memory_write_byte(bus, SOURCE_ADDRESS + i, (uint8_t)(i * 7 + 3));
+    }
+    static uint8_t rom[MEMORY_PAGE_SIZE];
+    for (uint32_t i = 0; i < MEMORY_PAGE_SIZE; ++i) {
+        rom[i] = (uint8_t)(i * 13 + 1);
+    }
+    memory_map_rom(bus, ROM_ADDRESS, MEMORY_PAGE_SIZE, rom);
+}
+
+// Runs the program on engine; stepped runs go one instruction at a time up
+// to the spin so the cycle count is that of the routines themselves
+static bool run(i960_engine engine, HookMode mode, bool stepped, HLEResult* result) {
+    MemoryBus bus;
+    memory_init(&bus);
+    uint32_t spin = 0;
+    load_program(&bus, &spin);
+
+    i960_cpu cpu;
+    i960_init(&cpu, &bus);
+    i960_set_engine(&cpu, engine);
+    i960_set_isa(&cpu, I960_ISA_KB);
+    i960_boot(&cpu);
+
+    i960_hle* hle = i960_hle_create();
+    uint32_t rom_hash = i960_hle_rom_hash(&bus);
+    bool ok = true;
+    if (mode == HOOKS_OTHER_ROM) {
+        i960_hle_register(hle, rom_hash ^ 1, MEMCPY_ADDRESS, "memcpy", I960_HLE_RETURN_BX);
+        i960_hle_register(hle, rom_hash ^ 1, MEMSET_ADDRESS, "memset", I960_HLE_RETURN_BX);
+        ok = i960_hle_attach(&cpu, hle, rom_hash) == 0;
+    } else if (mode == HOOKS_THIS_ROM) {
+        ok = i960_hle_load(hle, HOOK_FILE) && i960_hle_attach(&cpu, hle, rom_hash) == 4;
+    }
+
+    if (stepped) {
+        for (uint32_t i = 0; i < 1000000 && cpu.ip != spin; ++i) {
+            i960_step(&cpu);
+        }
+    } else {
+        i960_run(&cpu, 200000);
+    }
+
+    for (uint32_t i = 0; i < RESULT_COUNT; ++i) {
+        result->results[i] = cpu.regs[G8 + i];
+    }
+    result->ip = cpu.ip;
+    result->cycles = cpu.cycles;
+    result->calls = hle->calls;
+    result->data.assign(bus.ram + SOURCE_ADDRESS, bus.ram + DATA_END);
+    ok = ok && cpu.ip == spin;
+
+    i960_destroy(&cpu);
+    i960_hle_destroy(hle);
+    memory_destroy(&bus);
+    return ok;
+}
+
+static bool same(const HLEResult& a, const HLEResult& b) {
+    return memcmp(a.results, b.results, sizeof(a.results)) == 0 && a.ip == b.ip && a.data == b.data;
+}
+
+int main() {
+    std::cout << "Testing high-level emulation hooks..." << std::endl;
+
+    // The hook list names this test program's ROM by its hash
+    uint32_t rom_hash;
+    {
+        MemoryBus bus;
+        memory_init(&bus);
+        uint32_t spin;
+        load_program(&bus, &spin);
+        rom_hash = i960_hle_rom_hash(&bus);
+        memory_destroy(&bus);
+    }
+    std::ofstream hooks(HOOK_FILE);
+    hooks << std::hex << "# rom      entry  routine     convention\n"
+          << rom_hash << " " << MEMCPY_ADDRESS << " memcpy bal\n"
+          << rom_hash << " " << MEMSET_ADDRESS << " memset bal\n"
+          << rom_hash << " " << CHECKSUM_ADDRESS << " checksum32 bal  # leaf version\n\n"
+          << rom_hash << " " << CHECKSUM_CALL_ADDRESS << " checksum32 call\n";
+    hooks.close();
+
+    bool ok = true;
+    HLEResult reference, other, hooked;
+    ok = run(I960_ENGINE_INTERPRETER, HOOKS_NONE, true, &reference) && ok;
+    ok = run(I960_ENGINE_INTERPRETER, HOOKS_OTHER_ROM, true, &other) && ok;
+    ok = run(I960_ENGINE_INTERPRETER, HOOKS_THIS_ROM, true, &hooked) && ok;
+
+    std::cout << "Interpreted: " << reference.cycles << " cycles; hooked: " << hooked.cycles << " cycles, "
+              << hooked.calls << " calls replaced (should be 7)" << std::endl;
+    std::cout << "Results: memcpy 0x" << std::hex << hooked.results[0] << ", memset 0x" << hooked.results[1]
+              << ", checksum32 0x" << hooked.results[2] << " / 0x" << hooked.results[3] << ", of ROM 0x"
+              << hooked.results[5] << std::dec << std::endl;
+    ok = ok && same(hooked, reference) && hooked.cycles == reference.cycles && hooked.calls == 7;
+    ok = ok && same(other, reference) && other.cycles == reference.cycles && other.calls == 0;
+
+    // The overlapping copy repeats the first 16 source bytes
+    ok = ok && reference.data[0x10] == reference.data[0] && reference.data[0x2F] == reference.data[0x0F];
+    ok = ok && reference.data[FILL_ADDRESS - SOURCE_ADDRESS + 199] == 0xA5 &&
+         reference.data[FILL_ADDRESS - SOURCE_ADDRESS + 200] == 0;
+    // ROM sources: the copy and the sum see the image's bytes
+    uint32_t rom_sum = 0;
+    for (uint32_t i = 0; i < 32 * 4; ++i) {
+        rom_sum += (uint32_t)(uint8_t)((0x40 + i) * 13 + 1) << (8 * (i & 3));
+    }
+    ok = ok && reference.data[COPY_ADDRESS + 0x400 - SOURCE_ADDRESS] == (uint8_t)(5 * 13 + 1) &&
+         reference.data[COPY_ADDRESS + 0x400 - SOURCE_ADDRESS + 99] == (uint8_t)(104 * 13 + 1) &&
+         reference.results[5] == rom_sum;
+
+    for (i960_engine engine : {I960_ENGINE_INTERPRETER, I960_ENGINE_THREADED, I960_ENGINE_JIT}) {
+        HLEResult result;
+        bool ran = run(engine, HOOKS_THIS_ROM, false, &result);
+        bool match = ran && same(result, reference) && result.calls == 7;
+        std::cout << i960_engine_name(engine) << " with hooks: " << (match ? "matches" : "MISMATCH") << std::endl;
+        ok = ok && match;
+    }
+
+    std::remove(HOOK_FILE);
+    std::cout << (ok ? "\nHLE test passed!" : "\nHLE test FAILED!") << std::endl;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,162 @@
+#include <iostream>
+#include <chrono>
+#include <cstring>
+#include "i960.h"
+#include "memory.h"
+#include "tgp.h"
+
+// Checks idle-loop fast-forward: a loop polling the TGP control register
+// must end in exactly the same state and cycle count on every engine, with
+// the block engines skipping most of the iterations, and ordinary loops
+// must not be skipped. With bus statistics on, nothing is skipped and every
+// poll is counted.
+
+struct IdleResult {
+    uint32_t g[16];
+    uint32_t ip;
+    uint64_t cycles;
+    uint64_t idle_cycles;
+    uint64_t device_reads;  // Counted by the bus statistics, when enabled
+    bool halted;
+    double seconds;
+};
+
+// Waits for the TGP busy bit to clear, then halts
+static const uint8_t POLL_PROGRAM[] = {
+    // ld_const g1, 1
+    0x90, 0x01, 0x00, 0x00, 0x00, 0x01,
+    // ld_const g2, 0
+    0x90, 0x02, 0x00, 0x00, 0x00, 0x00,
+    // poll (0x0C): ld g0, [TGP control register]
+    0xC0, 0x00, 0xC0, 0x00, 0x00, 0x00,
+    // and_reg g0, g0, g1
+    0xE0, 0x00, 0x00, 0x01,
+    // cmp_reg g0, g2
+    0xF0, 0x00, 0x02,
+    // bne poll
+    0xF2, 0x00, 0x00, 0x00, 0x0C,
+    // halt (0x1E)
+    0xFF
+};
+
+// Counts g0 down: every iteration changes state, so it is not idle
+static const uint8_t COUNT_PROGRAM[] = {
+    // ld_const g0, 100000
+    0x90, 0x00, 0x00, 0x01, 0x86, 0xA0,
+    // ld_const g1, 1
+    0x90, 0x01, 0x00, 0x00, 0x00, 0x01,
+    // loop (0x0C): sub_reg g0, g0, g1
+    0xD0, 0x00, 0x00, 0x01,
+    // cmp_reg g0, g2
+    0xF0, 0x00, 0x02,
+    // bne loop
+    0xF2, 0x00, 0x00, 0x00, 0x0C,
+    // halt
+    0xFF
+};
+
+// jmp to itself
+static const uint8_t SPIN_PROGRAM[] = {
+    0xF3, 0x00, 0x00, 0x00, 0x00
+};
+
+static void run_program(const uint8_t* program, size_t size, i960_engine engine, uint64_t budget, IdleResult* result,
+                        bool stats = false) {
+    MemoryBus bus;
+    memory_init(&bus);
+    if (stats) {
+        memory_enable_stats(&bus);
+    }
+    TGP* tgp = new TGP();
+    tgp_init(tgp, &bus);
+    memory_connect_tgp(&bus, tgp);
+    for (size_t i = 0; i < size; ++i) {
+        memory_write_byte(&bus, (uint32_t)i, program[i]);
+    }
+
+    i960_cpu cpu;
+    i960_init(&cpu, &bus);
+    i960_set_engine(&cpu, engine);
+
+    // TGP busy: the poll loop spins for the whole budget
+    tgp->control_register = 1;
+    auto start = std::chrono::steady_clock::now();
+    i960_run(&cpu, budget);
+    auto stop = std::chrono::steady_clock::now();
+    result->seconds = std::chrono::duration<double>(stop - start).count();
+    result->idle_cycles = cpu.idle_cycles;
+
+    // TGP done: the loop exits on its next pass
+    tgp->control_register = 0;
+    i960_run(&cpu, 1000);
+
+    memcpy(result->g, cpu.g, sizeof(result->g));
+    result->ip = cpu.ip;
+    result->cycles = cpu.cycles;
+    result->halted = cpu.halted;
+    result->device_reads = 0;
+    for (uint32_t region = MEMORY_REGION_DEVICE; bus.stats != nullptr && region < MEMORY_REGION_COUNT; ++region) {
+        result->device_reads += bus.stats->regions[region].reads;
+    }
+
+    i960_destroy(&cpu);
+    delete tgp;
+    memory_destroy(&bus);
+}
+
+static bool same_state(const IdleResult& a, const IdleResult& b) {
+    return a.ip == b.ip && a.cycles == b.cycles && a.halted == b.halted && memcmp(a.g, b.g, sizeof(a.g)) == 0;
+}
+
+int main() {
+    std::cout << "Testing idle-loop fast-forward..." << std::endl;
+    const uint64_t budget = 10000000;
+    bool ok = true;
+
+    IdleResult interp, threaded, jit;
+    run_program(POLL_PROGRAM, sizeof(POLL_PROGRAM), I960_ENGINE_INTERPRETER, budget, &interp);
+    run_program(POLL_PROGRAM, sizeof(POLL_PROGRAM), I960_ENGINE_THREADED, budget, &threaded);
+    run_program(POLL_PROGRAM, sizeof(POLL_PROGRAM), I960_ENGINE_JIT, budget, &jit);
+
+    std::cout << "\n=== Polling loop on the TGP control register ===" << std::endl;
+    std::cout << std::dec << "interp: " << interp.cycles << " cycles, " << interp.seconds * 1000.0 << " ms" << std::endl;
+    std::cout << "threaded: " << threaded.cycles << " cycles, " << threaded.idle_cycles << " skipped, "
+              << threaded.seconds * 1000.0 << " ms" << std::endl;
+    std::cout << "jit: " << jit.cycles << " cycles, " << jit.idle_cycles << " skipped, "
+              << jit.seconds * 1000.0 << " ms" << std::endl;
+    std::cout << "Final ip = 0x" << std::hex << threaded.ip << std::dec << " (should be 0x1e, halted)" << std::endl;
+    ok = ok && same_state(interp, threaded) && same_state(interp, jit);
+    ok = ok && threaded.halted && threaded.ip == 0x1E && threaded.idle_cycles > budget * 9 / 10;
+
+    std::cout << "\n=== Counting loop ===" << std::endl;
+    IdleResult count_interp, count_threaded;
+    run_program(COUNT_PROGRAM, sizeof(COUNT_PROGRAM), I960_ENGINE_INTERPRETER, 100000, &count_interp);
+    run_program(COUNT_PROGRAM, sizeof(COUNT_PROGRAM), I960_ENGINE_THREADED, 100000, &count_threaded);
+    std::cout << std::dec << "Skipped " << count_threaded.idle_cycles << " cycles (should be 0), g0 = " << count_threaded.g[0]
+              << " (interp: " << count_interp.g[0] << ")" << std::endl;
+    ok = ok && count_threaded.idle_cycles == 0 && same_state(count_interp, count_threaded);
+
+    std::cout << "\n=== Branch to self ===" << std::endl;
+    IdleResult spin_interp, spin_threaded;
+    run_program(SPIN_PROGRAM, sizeof(SPIN_PROGRAM), I960_ENGINE_INTERPRETER, budget, &spin_interp);
+    run_program(SPIN_PROGRAM, sizeof(SPIN_PROGRAM), I960_ENGINE_THREADED, budget, &spin_threaded);
+    std::cout << std::dec << "Skipped " << spin_threaded.idle_cycles << " of " << spin_threaded.cycles << " cycles" << std::endl;
+    ok = ok && same_state(spin_interp, spin_threaded) && spin_threaded.idle_cycles > budget * 9 / 10;
+
+    if (MEMORY_STATS_COMPILED) {
+        std::cout << "\n=== Polling loop with bus statistics ===" << std::endl;
+        IdleResult stats_interp, stats_threaded, stats_jit;
+        run_program(POLL_PROGRAM, sizeof(POLL_PROGRAM), I960_ENGINE_INTERPRETER, 100000, &stats_interp, true);
+        run_program(POLL_PROGRAM, sizeof(POLL_PROGRAM), I960_ENGINE_THREADED, 100000, &stats_threaded, true);
+        run_program(POLL_PROGRAM, sizeof(POLL_PROGRAM), I960_ENGINE_JIT, 100000, &stats_jit, true);
+        std::cout << std::dec << "Device reads: interp " << stats_interp.device_reads << ", threaded "
+                  << stats_threaded.device_reads << " (" << stats_threaded.idle_cycles << " cycles skipped), jit "
+                  << stats_jit.device_reads << std::endl;
+        ok = ok && stats_interp.device_reads > 1000 && stats_threaded.device_reads == stats_interp.device_reads &&
+             stats_jit.device_reads == stats_interp.device_reads && stats_threaded.idle_cycles == 0 &&
+             stats_jit.idle_cycles == 0 && same_state(stats_interp, stats_threaded) && same_state(stats_interp, stats_jit);
+    }
+
+    std::cout << (ok ? "\nIdle loop test passed!" : "\nIdle loop test FAILED!") << std::endl;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,126 @@
+#include <iostream>
+#include <cstring>
+#include <thread>
+#include <vector>
+#include "emulator.h"
+#include "test_kb_assembler.h"
+
+// Checks that emulator instances share nothing: several boards running the
+// same program on their own threads, each with different controls, must
+// end up exactly where the same boards run one after another do, and each
+// instance's audio must depend only on its own sound registers.
+
+const uint32_t G1 = 17, G2 = 18, G3 = 19, G4 = 20, G5 = 21, G6 = 22;
+const uint32_t PROGRAM_START = 0x100;
+const uint32_t RESULT_ADDRESS = 0x3000;
+const int INSTANCES = 4;
+const int FRAMES = 3;
+const int AUDIO_FRAMES = 1024;
+
+// Turns on audio channel 0, then forever adds the steering input to g5,
+// stores the total and plays the steering value as channel 0's frequency
+static KBAssembler assemble_program() {
+    KBAssembler a(PROGRAM_START);
+    a.lda(1, G6);
+    a.lda(AUDIO_BASE_ADDRESS + 0x10, G3);  // Channel 0 enable
+    a.memb(0x92, G6, G3);                  // st g6, (g3)
+    a.lda(255, G6);
+    a.lda(AUDIO_BASE_ADDRESS + 0x18, G3);  // Channel 0 volume
+    a.memb(0x92, G6, G3);                  // st g6, (g3)
+    a.lda(0, G5);
+    uint32_t loop = a.here();
+    a.lda(INPUT_BASE_ADDRESS + 0x24, G1);  // Steering
+    a.memb(0x90, G4, G1);                  // ld (g1), g4
+    a.reg(0x590, G4, G5, G5);              // addo g4, g5, g5
+    a.lda(RESULT_ADDRESS, G2);
+    a.memb(0x92, G5, G2);                  // st g5, (g2)
+    a.lda(AUDIO_BASE_ADDRESS + 0x14, G3);  // Channel 0 frequency
+    a.memb(0x92, G4, G3);                  // st g4, (g3)
+    a.ctrl(0x08, loop);                    // b loop
+    return a;
+}
+
+struct InstanceResult {
+    uint32_t total;    // Guest's running sum of the steering input
+    uint32_t g5;
+    uint64_t cycles;
+    uint64_t frames;
+    std::vector<int16_t> audio;
+};
+
+// Builds a board, runs FRAMES frames with the given steering and renders
+// some audio from whatever the guest left in the sound registers
+static void run_instance(i960_engine engine, int16_t steering, InstanceResult* result) {
+    EmulatorConfig config;
+    config.engine = engine;
+    Emulator* emu = emulator_create(&config);
+
+    load_kb_image(&emu->bus, assemble_program());
+    emulator_reset(emu);
+
+    emu->input.steering = steering;
+    for (int frame = 0; frame < FRAMES; ++frame) {
+        emulator_run_frame(emu);
+    }
+
+    result->total = memory_read_dword(&emu->bus, RESULT_ADDRESS);
+    result->g5 = emu->cpu.regs[G5];
+    result->cycles = emu->cpu.cycles;
+    result->frames = emu->frames;
+    result->audio.resize(2 * AUDIO_FRAMES);
+    emulator_render_audio(emu, result->audio.data(), AUDIO_FRAMES, 44100);
+    emulator_destroy(emu);
+}
+
+static bool same(const InstanceResult& a, const InstanceResult& b) {
+    return a.total == b.total && a.g5 == b.g5 && a.cycles == b.cycles && a.frames == b.frames && a.audio == b.audio;
+}
+
+static int16_t steering_for(int instance) {
+    return (int16_t)(220 * (instance + 1));
+}
+
+int main() {
+    std::cout << "Testing independent emulator instances..." << std::endl;
+
+    bool ok = true;
+    for (i960_engine engine : {I960_ENGINE_INTERPRETER, I960_ENGINE_THREADED, I960_ENGINE_JIT}) {
+        InstanceResult sequential[INSTANCES];
+        for (int i = 0; i < INSTANCES; ++i) {
+            run_instance(engine, steering_for(i), &sequential[i]);
+        }
+
+        InstanceResult threaded[INSTANCES];
+        std::vector<std::thread> threads;
+        for (int i = 0; i < INSTANCES; ++i) {
+            threads.emplace_back(run_instance, engine, steering_for(i), &threaded[i]);
+        }
+        for (std::thread& thread : threads) {
+            thread.join();
+        }
+
+        bool match = true;
+        for (int i = 0; i < INSTANCES; ++i) {
+            const InstanceResult& r = threaded[i];
+            // Each board saw only its own controls and played only its own sound
+            bool own = r.total == r.g5 && r.total != 0 && r.total % (uint32_t)steering_for(i) == 0 && r.frames == FRAMES;
+            bool silent = true;
+            for (int16_t sample : r.audio) {
+                silent = silent && sample == 0;
+            }
+            match = match && own && !silent && same(r, sequential[i]);
+            if (i > 0) {
+                match = match && r.audio != threaded[i - 1].audio;
+            }
+        }
+        std::cout << i960_engine_name(engine) << ": " << INSTANCES << " threads, totals";
+        for (int i = 0; i < INSTANCES; ++i) {
+            std::cout << " " << threaded[i].total;
+        }
+        std::cout << " after " << threaded[0].cycles << " cycles: " << (match ? "independent" : "MISMATCH") << std::endl;
+        ok = ok && match;
+    }
+
+    std::cout << (ok ? "\nInstance test passed!" : "\nInstance test FAILED!") << std::endl;
+    return ok ? 0 : 1;
+}
@@ -1,6 +1,120 @@
 #include <iostream>
 #include "i960.h"
 #include "memory.h"
+#include "test_kb_assembler.h"
+
+// Legacy loop used by the controller checks: g1 += g2 forever
+static void load_spin_program(MemoryBus* bus) {
+    const uint8_t program[] = {0x90, 0x02, 0x00, 0x00, 0x00, 0x01, // ld_const g2, 1
+                               0x58, 0x01, 0x01, 0x02,             // add_reg g1, g1, g2
+                               0xF3, 0x00, 0x00, 0x00, 0x06};      // jmp 6
+    for (uint32_t i = 0; i < sizeof(program); ++i) {
+        memory_write_byte(bus, i, program[i]);
+    }
+    // Handlers spin too, so the IP shows which one is running
+    for (uint32_t handler : {0x200u, 0x300u, 0x400u}) {
+        const uint8_t spin[] = {0xF3, 0x00, 0x00, (uint8_t)(handler >> 8), (uint8_t)handler};
+        for (uint32_t i = 0; i < sizeof(spin); ++i) {
+            memory_write_byte(bus, handler + i, spin[i]);
+        }
+    }
+}
+
+static bool pending(const i960_cpu* cpu, uint8_t vector) {
+    return (cpu->ipnd[vector >> 5] >> (vector & 31)) & 1;
+}
+
+// Priorities, masks and nesting on one engine
+static bool check_controller(i960_engine engine) {
+    MemoryBus bus;
+    memory_init(&bus);
+    load_spin_program(&bus);
+    i960_cpu cpu;
+    i960_init(&cpu, &bus);
+    i960_set_engine(&cpu, engine);
+    i960_set_interrupt_vector(&cpu, 0x20, 0x200); // Priority 4
+    i960_set_interrupt_vector(&cpu, 0x48, 0x300); // Priority 9
+    i960_set_interrupt_vector(&cpu, 0x05, 0x400); // Priority 0: never taken
+    bool ok = true;
+    i960_run(&cpu, 1000);
+
+    // The higher priority wins; the other stays pending below the handler's priority
+    i960_request_interrupt(&cpu, 0x20);
+    i960_request_interrupt(&cpu, 0x48);
+    i960_run(&cpu, 1000);
+    ok = ok && cpu.ip == 0x300 && cpu.interrupt_depth == 1 && i960_priority(&cpu) == 9 && pending(&cpu, 0x20) &&
+         !pending(&cpu, 0x48) && !i960_interrupt_ready(&cpu);
+
+    // Returning lowers the priority and lets the pending one in
+    i960_return_from_interrupt(&cpu);
+    ok = ok && i960_interrupt_ready(&cpu);
+    i960_run(&cpu, 1000);
+    ok = ok && cpu.ip == 0x200 && cpu.interrupt_depth == 1 && i960_priority(&cpu) == 4 && !pending(&cpu, 0x20);
+
+    // A higher priority nests inside the running handler
+    i960_request_interrupt(&cpu, 0x48);
+    i960_run(&cpu, 1000);
+    ok = ok && cpu.ip == 0x300 && cpu.interrupt_depth == 2;
+    i960_return_from_interrupt(&cpu);
+    ok = ok && cpu.ip == 0x200 && i960_priority(&cpu) == 4;
+    i960_return_from_interrupt(&cpu);
+    ok = ok && (cpu.ip == 6 || cpu.ip == 10) && i960_priority(&cpu) == 0 && cpu.interrupt_depth == 0;
+
+    // Masked vectors stay pending until enabled
+    i960_set_interrupt_enabled(&cpu, 0x48, false);
+    i960_request_interrupt(&cpu, 0x48);
+    uint64_t used = i960_run(&cpu, 1000);
+    ok = ok && !i960_interrupt_ready(&cpu) && cpu.interrupt_depth == 0 && used >= 1000 && pending(&cpu, 0x48);
+    i960_set_interrupt_enabled(&cpu, 0x48, true);
+    ok = ok && i960_interrupt_ready(&cpu);
+    i960_run(&cpu, 1000);
+    ok = ok && cpu.ip == 0x300;
+    i960_return_from_interrupt(&cpu);
+
+    // Priority 0 is never delivered
+    i960_request_interrupt(&cpu, 0x05);
+    ok = ok && !i960_interrupt_ready(&cpu);
+
+    std::cout << i960_engine_name(engine) << ": priorities, nesting and masks " << (ok ? "ok" : "WRONG") << std::endl;
+    i960_destroy(&cpu);
+    memory_destroy(&bus);
+    return ok;
+}
+
+// KB program that lowers the processor priority with modpc and then spins:
+// the run must end at that point instead of at the end of the budget
+static bool check_modpc(i960_engine engine) {
+    const uint32_t G0 = 16, G1 = 17, G2 = 18;
+    KBAssembler a(0x100);
+    a.reg(0x5CC, 31, 0, G1, true);   // mov 31, g1
+    a.reg(0x59C, 16, G1, G1, true);  // shlo 16, g1, g1 (priority field mask)
+    a.reg(0x655, G1, G0, G2);        // modpc g1, g0, g2 (priority 0)
+    a.ctrl(0x08, a.here());          // b .
+    MemoryBus bus;
+    memory_init(&bus);
+    load_kb_image(&bus, a);
+
+    i960_cpu cpu;
+    i960_init(&cpu, &bus);
+    i960_set_engine(&cpu, engine);
+    i960_set_isa(&cpu, I960_ISA_KB);
+    i960_boot(&cpu);
+    i960_set_interrupt_vector(&cpu, 0x48, 0x300);
+
+    // Boot runs at priority 31: the request waits for modpc
+    i960_request_interrupt(&cpu, 0x48);
+    bool ok = !i960_interrupt_ready(&cpu);
+    uint64_t used = i960_run(&cpu, 100000);
+    ok = ok && used < 100 && i960_interrupt_ready(&cpu) && cpu.g[2] == 0x001F2002;
+    i960_run(&cpu, 0);
+    ok = ok && cpu.ip == 0x300 && cpu.interrupt_depth == 1 && i960_priority(&cpu) == 9;
+
+    std::cout << i960_engine_name(engine) << ": modpc ends the run after " << used << " cycles "
+              << (ok ? "ok" : "WRONG") << std::endl;
+    i960_destroy(&cpu);
+    memory_destroy(&bus);
+    return ok;
+}
 
 int main(int argc, char* argv[]) {
     std::cout << "Testing i960 interrupt system..." << std::endl;
@@ -70,7 +184,16 @@ int main(int argc, char* argv[]) {
     std::cout << "g3 = 0x" << cpu.g[3] << " (should be 0x1)" << std::endl;
 
     // Cleanup
+    i960_destroy(&cpu);
     memory_destroy(&bus);
-    std::cout << "\nInterrupt system test completed!" << std::endl;
-    return 0;
+
+    std::cout << "\n=== Interrupt controller ===" << std::endl;
+    bool ok = true;
+    for (i960_engine engine : {I960_ENGINE_INTERPRETER, I960_ENGINE_THREADED, I960_ENGINE_JIT}) {
+        ok = check_controller(engine) && ok;
+        ok = check_modpc(engine) && ok;
+    }
+
+    std::cout << (ok ? "\nInterrupt system test completed!" : "\nInterrupt system test FAILED!") << std::endl;
+    return ok ? 0 : 1;
 }
\ No newline at end of file
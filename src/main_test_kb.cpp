@@ -0,0 +1,213 @@
+#include <iostream>
+#include <cstring>
+#include <vector>
+#include "i960.h"
+#include "i960_decode.h"
+#include "i960_jit.h"
+#include "memory.h"
+#include "test_kb_assembler.h"
+
+// Checks the i960 KB/CA decoder: boots a small program in the real 32-bit
+// encoding from an initialization boot record, exercising each instruction
+// format, and runs it on every engine.
+
+// Register numbers as encoded in instructions
+const uint32_t R3 = 3, R4 = 4, R5 = 5, R6 = 6, R7 = 7, R8 = 8;
+const uint32_t G0 = 16, G1 = 17, G2 = 18, G3 = 19, G4 = 20, G5 = 21, G6 = 22, G7 = 23;
+const uint32_t G8 = 24, G10 = 26, G11 = 27, G12 = 28, G13 = 29, G14 = 30;
+
+const uint32_t PROGRAM_START = 0x100;
+const uint32_t DATA_ADDRESS = 0x3000;
+const uint32_t TABLE_ADDRESS = 0x3100;
+
+struct KBResult {
+    uint32_t regs[32];
+    uint32_t ip;
+    uint32_t ac;
+    uint64_t cycles;
+    uint64_t idle_cycles;
+    uint32_t stored;
+    uint32_t table_sum;
+    uint32_t jit_bytes;
+};
+
+static uint32_t spin_address = 0;
+
+static void assemble(KBAssembler* a) {
+    a->reg(0x5CC, 10, 0, G0, true);          // mov 10, g0
+    a->reg(0x5CC, 0, 0, G1, true);           // mov 0, g1
+    uint32_t loop = a->here();
+    a->reg(0x590, G0, G1, G1);               // addo g0, g1, g1
+    a->reg(0x592, 1, G0, G0, true);          // subo 1, g0, g0
+    a->cobr(0x34, 0, G0, loop, true);        // cmpobl 0, g0, loop
+
+    a->reg(0x5CC, 21, 0, R3, true);          // mov 21, r3
+    uint32_t call_at = a->here();
+    a->ctrl(0x09, call_at);                  // call sub (patched below)
+
+    a->memb_disp(0x8C, G3, DATA_ADDRESS);    // lda 0x3000, g3
+    a->memb(0x92, G2, G3, 0x4);              // st g2, (g3)
+    a->memb(0x90, G12, G3, 0x4);             // ld (g3), g12
+    a->mema(0x82, G2, G3, 8);                // stob g2, 8(g3)
+    a->mema(0xC0, G5, G3, 8);                // ldib 8(g3), g5
+    a->reg(0x5CC, 7, 0, G8, true);           // mov 7, g8
+    a->reg(0x5CC, 9, 0, G8 + 1, true);       // mov 9, g9
+    a->mema(0x9A, G8, G3, 16);               // stl g8, 16(g3)
+    a->mema(0x98, G10, G3, 16);              // ldl 16(g3), g10
+    a->reg(0x5CC, 4, 0, G6, true);           // mov 4, g6
+    a->memb(0x90, G13, G3, 0x7, G6, 2);      // ld (g3)[g6*4], g13
+    a->reg(0x641, G2, 0, G7);                // scanbit g2, g7
+    a->reg(0x5CC, G2, 0, R4);                // mov g2, r4
+    a->reg(0x651, 4, 4, R4, true, true);     // extract 4, 4, r4
+    a->reg(0x5A1, G5, 0, 0, false, true);    // cmpi g5, 0
+    a->cobr(0x24, G11, 0, a->here());        // testl g11
+    uint32_t bal_at = a->here();
+    a->ctrl(0x0B, bal_at);                   // bal sub2 (patched below)
+
+    // Hot loop over a table: indexed stores and loads, compare and branch
+    a->memb_disp(0x8C, G4, TABLE_ADDRESS);   // lda 0x3100, g4
+    a->reg(0x5CC, 0, 0, R6, true);           // mov 0, r6
+    a->reg(0x5CC, 0, 0, R8, true);           // mov 0, r8
+    uint32_t loop2 = a->here();
+    a->memb(0x92, R6, G4, 0x7, R6, 2);       // st r6, (g4)[r6*4]
+    a->memb(0x80, R7, G4, 0x7, R6, 2);       // ldob (g4)[r6*4], r7
+    a->reg(0x590, R7, R8, R8);               // addo r7, r8, r8
+    a->mema(0x82, R8, G4, 0x40);             // stob r8, 0x40(g4)
+    a->reg(0x590, 1, R6, R6, true);          // addo 1, r6, r6
+    a->reg(0x5A0, R6, 12, 0, false, true);   // cmpo r6, 12
+    a->ctrl(0x14, loop2);                    // bl loop2
+    spin_address = a->here();
+    a->ctrl(0x08, spin_address);             // b . (idle)
+
+    uint32_t sub = a->here();
+    a->reg(0x59C, 2, G1, G2, true);          // sub: shlo 2, g1, g2
+    a->reg(0x5CC, 0, 0, R3, true);           // mov 0, r3
+    a->ctrl(0x0A, a->here());                // ret
+    uint32_t sub2 = a->here();
+    a->reg(0x5CC, 5, 0, R5, true);           // sub2: mov 5, r5
+    a->memb(0x84, 0, G14, 0x4);              // bx (g14)
+
+    a->patch_ctrl(call_at, sub);
+    a->patch_ctrl(bal_at, sub2);
+}
+
+static void run_program(i960_engine engine, KBResult* result) {
+    MemoryBus bus;
+    memory_init(&bus);
+
+    KBAssembler a(PROGRAM_START);
+    assemble(&a);
+    load_kb_image(&bus, a);
+
+    i960_cpu cpu;
+    i960_init(&cpu, &bus);
+    i960_set_engine(&cpu, engine);
+    i960_set_isa(&cpu, I960_ISA_KB);
+    i960_boot(&cpu);
+    i960_run(&cpu, 100000);
+
+    memcpy(result->regs, cpu.regs, sizeof(result->regs));
+    result->ip = cpu.ip;
+    result->ac = cpu.ac;
+    result->cycles = cpu.cycles;
+    result->idle_cycles = cpu.idle_cycles;
+    result->stored = memory_read_dword(&bus, DATA_ADDRESS);
+    result->table_sum = memory_read_byte(&bus, TABLE_ADDRESS + 0x40);
+    result->jit_bytes = i960_jit_code_used(cpu.jit);
+
+    i960_destroy(&cpu);
+    memory_destroy(&bus);
+}
+
+static bool check(const char* what, uint32_t value, uint32_t expected) {
+    std::cout << what << " = 0x" << std::hex << value << " (should be 0x" << expected << ")" << std::dec << std::endl;
+    return value == expected;
+}
+
+int main() {
+    std::cout << "Testing the i960 KB/CA decoder..." << std::endl;
+    bool ok = true;
+
+    // Decoding alone: one instruction of each format
+    MemoryBus bus;
+    memory_init(&bus);
+    i960_cpu cpu;
+    i960_init(&cpu, &bus);
+    i960_set_isa(&cpu, I960_ISA_KB);
+    const struct {
+        uint32_t word;
+        i960_op op;
+    } samples[] = {
+        {0x5C88061Du, I960_OP_MOV},     // mov g13, g1 (REG)
+        {0x3A84C010u, I960_OP_CMPIB},   // cmpibe g0, g3, +16 (COBR)
+        {0x12000010u, I960_OP_BCC},     // be +16 (CTRL)
+        {0x90A00123u, I960_OP_LD},      // ld 0x123, g4 (MEM)
+        {0x00000000u, I960_OP_UNDEFINED}, // Reserved CTRL opcode
+    };
+    for (const auto& sample : samples) {
+        memory_write_dword(&bus, 0x400, sample.word);
+        i960_decoded insn;
+        i960_decode(&cpu, 0x400, &insn);
+        std::cout << "0x" << std::hex << sample.word << std::dec << " -> " << i960_op_name(insn.op)
+                  << " (should be " << i960_op_name(sample.op) << ")" << std::endl;
+        ok = ok && insn.op == sample.op;
+    }
+
+    // Fetch stream: a MEMB instruction whose displacement word starts the
+    // next page, then a write to the decoded page's neighbour
+    const uint32_t straddle = 2 * I960_FETCH_PAGE_SIZE - 4;
+    memory_write_dword(&bus, straddle, 0x8C803000u);   // lda disp, g0
+    memory_write_dword(&bus, straddle + 4, 0x12345678u);
+    i960_decoded insn;
+    i960_decode(&cpu, straddle, &insn);
+    ok = check("lda displacement across a page boundary", insn.imm, 0x12345678) && ok;
+    ok = check("fetch stream page", cpu.fetch.page_base, 2 * I960_FETCH_PAGE_SIZE) && ok;
+    memory_write_dword(&bus, straddle + 4, 0x9ABCDEF0u);
+    i960_decode(&cpu, straddle, &insn);
+    ok = check("displacement after rewrite", insn.imm, 0x9ABCDEF0) && ok;
+    // Outside plain memory the decoder falls back to bus reads
+    i960_decode(&cpu, MEMORY_SIZE, &insn);
+    ok = check("fetch beyond RAM", insn.op == I960_OP_UNDEFINED && cpu.fetch.page == nullptr, 1) && ok;
+    i960_destroy(&cpu);
+    memory_destroy(&bus);
+
+    KBResult interp, threaded, jit;
+    run_program(I960_ENGINE_INTERPRETER, &interp);
+    run_program(I960_ENGINE_THREADED, &threaded);
+    run_program(I960_ENGINE_JIT, &jit);
+
+    std::cout << "\n=== Program results (interp) ===" << std::endl;
+    ok = check("g1 (sum 1..10)", interp.regs[G1], 55) && ok;
+    ok = check("g2 (call: sum << 2)", interp.regs[G2], 220) && ok;
+    ok = check("r3 (restored by ret)", interp.regs[R3], 21) && ok;
+    ok = check("[0x3000]", interp.stored, 220) && ok;
+    ok = check("g12 (ld)", interp.regs[G12], 220) && ok;
+    ok = check("g5 (ldib)", interp.regs[G5], 0xFFFFFFDC) && ok;
+    ok = check("g10 (ldl)", interp.regs[G10], 7) && ok;
+    ok = check("g11 (testl after cmpi)", interp.regs[G11], 1) && ok;
+    ok = check("g13 (indexed ld)", interp.regs[G13], 7) && ok;
+    ok = check("g7 (scanbit)", interp.regs[G7], 7) && ok;
+    ok = check("r4 (extract)", interp.regs[R4], 13) && ok;
+    ok = check("r5 (bal/bx)", interp.regs[R5], 5) && ok;
+    ok = check("r8 (table loop)", interp.regs[R8], 66) && ok;
+    ok = check("[0x3140] (stob)", interp.table_sum, 66) && ok;
+    ok = check("ip (spinning)", interp.ip, spin_address) && ok;
+
+    std::cout << "\n=== Engines ===" << std::endl;
+    bool same = true;
+    for (const KBResult* other : {&threaded, &jit}) {
+        same = same && memcmp(other->regs, interp.regs, sizeof(interp.regs)) == 0 && other->ip == interp.ip &&
+               other->ac == interp.ac && other->cycles == interp.cycles && other->stored == interp.stored &&
+               other->table_sum == interp.table_sum;
+    }
+    std::cout << "interp " << interp.cycles << ", threaded " << threaded.cycles << ", jit " << jit.cycles
+              << " cycles: " << (same ? "identical" : "MISMATCH") << std::endl;
+    std::cout << "Threaded engine skipped " << threaded.idle_cycles << " cycles of the final b ." << std::endl;
+    ok = ok && same && threaded.idle_cycles > 0;
+    // The loops are pure KB code: the JIT must have compiled them
+    std::cout << "JIT compiled " << jit.jit_bytes << " bytes of native code" << std::endl;
+    ok = ok && (jit.jit_bytes > 0 || !i960_jit_available());
+
+    std::cout << (ok ? "\nKB decoder test passed!" : "\nKB decoder test FAILED!") << std::endl;
+    return ok ? 0 : 1;
+}
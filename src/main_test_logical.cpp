@@ -64,6 +64,7 @@ int main(int argc, char* argv[]) {
     std::cout << "g5 = 0x" << cpu.g[5] << " (should be 0xFFFFFFF0 = ~15)" << std::endl;
 
     // Cleanup
+    i960_destroy(&cpu);
     memory_destroy(&bus);
     std::cout << "\nLogical instructions test completed!" << std::endl;
     return 0;
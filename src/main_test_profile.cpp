@@ -0,0 +1,153 @@
+#include <iostream>
+#include <cstdio>
+#include "i960.h"
+#include "memory.h"
+#include "profiler.h"
+#include "test_kb_assembler.h"
+
+// Checks the guest profiler: every engine must report the same IP histogram
+// and call stacks for the same run, including the part of an idle loop the
+// block engines skip, and sampling every instruction must count each one.
+
+const uint32_t G0 = 16, G1 = 17, G2 = 18;
+const uint32_t PROGRAM_START = 0x100;
+const uint64_t RUN_CYCLES = 200000;
+
+static uint32_t sub_address = 0;
+
+// KB program: call a small routine 50 times, then spin on b .
+static KBAssembler assemble() {
+    KBAssembler a(PROGRAM_START);
+    a.reg(0x5CC, 25, 0, G0, true);             // mov 25, g0
+    a.reg(0x590, G0, G0, G0);                  // addo g0, g0, g0 (50 calls)
+    uint32_t loop = a.here();
+    uint32_t call_at = a.here();
+    a.ctrl(0x09, call_at);                     // call sub (patched below)
+    a.reg(0x592, 1, G0, G0, true);             // subo 1, g0, g0
+    a.cobr(0x34, 0, G0, loop, true);           // cmpobl 0, g0, loop
+    uint32_t spin = a.here();
+    a.ctrl(0x08, spin);                        // b .
+
+    sub_address = a.here();
+    a.reg(0x590, 3, G1, G1, true);             // sub: addo 3, g1, g1
+    a.reg(0x5CC, G1, 0, G2);                   // mov g1, g2
+    a.ctrl(0x0A, a.here());                    // ret
+
+    a.patch_ctrl(call_at, sub_address);
+    return a;
+}
+
+static void run_profiled(i960_engine engine, uint32_t interval, Profiler* profiler) {
+    MemoryBus bus;
+    memory_init(&bus);
+    load_kb_image(&bus, assemble());
+
+    i960_cpu cpu;
+    i960_init(&cpu, &bus);
+    i960_set_engine(&cpu, engine);
+    i960_set_isa(&cpu, I960_ISA_KB);
+    i960_boot(&cpu);
+    profiler_init(profiler, PROFILE_INSTRUCTIONS, interval);
+    cpu.profiler = profiler;
+    // Several slices, so sampling carries over between i960_run calls
+    for (int i = 0; i < 10; ++i) {
+        i960_run(&cpu, RUN_CYCLES / 10);
+    }
+
+    i960_destroy(&cpu);
+    memory_destroy(&bus);
+}
+
+int main() {
+    std::cout << "Testing the guest profiler..." << std::endl;
+    bool ok = true;
+
+    // Option parsing
+    const struct {
+        const char* spec;
+        bool valid;
+    } specs[] = {{"insn:1000", true}, {"timer:500", true}, {"insn:0", false}, {"insn:", false},
+                 {"timer:5x", false}, {"cycles:10", false}};
+    for (const auto& spec : specs) {
+        ProfileMode mode;
+        uint32_t interval;
+        bool valid = profiler_parse(spec.spec, &mode, &interval);
+        std::cout << spec.spec << ": " << (valid ? "accepted" : "rejected") << std::endl;
+        ok = ok && valid == spec.valid;
+    }
+
+    // Sampling every instruction counts exactly the instructions executed
+    {
+        MemoryBus bus;
+        memory_init(&bus);
+        const uint8_t program[] = {0x90, 0x00, 0x00, 0x00, 0x00, 0x05, // ld_const g0, 5
+                                   0x58, 0x00, 0x00, 0x00,             // add_reg g0, g0, g0
+                                   0xF3, 0x00, 0x00, 0x00, 0x06};      // jmp 6
+        for (uint32_t i = 0; i < sizeof(program); ++i) {
+            memory_write_byte(&bus, i, program[i]);
+        }
+        i960_cpu cpu;
+        i960_init(&cpu, &bus);
+        Profiler profiler;
+        profiler_init(&profiler, PROFILE_INSTRUCTIONS, 1);
+        cpu.profiler = &profiler;
+        const uint64_t STEPS = 1001;
+        for (uint64_t i = 0; i < STEPS; ++i) {
+            i960_step(&cpu);
+        }
+        std::cout << "insn:1 over " << STEPS << " steps: " << profiler.samples << " samples, "
+                  << profiler.ip_hits[6] << " at add_reg" << std::endl;
+        ok = ok && profiler.samples == STEPS && profiler.ip_hits[0] == 1 && profiler.ip_hits[6] == 500;
+        profiler_destroy(&profiler);
+        i960_destroy(&cpu);
+        memory_destroy(&bus);
+    }
+
+    // Every engine samples the same instructions
+    for (uint32_t interval : {1u, 7u, 1000u}) {
+        Profiler interp, threaded, jit;
+        run_profiled(I960_ENGINE_INTERPRETER, interval, &interp);
+        run_profiled(I960_ENGINE_THREADED, interval, &threaded);
+        run_profiled(I960_ENGINE_JIT, interval, &jit);
+        bool same = threaded.ip_hits == interp.ip_hits && jit.ip_hits == interp.ip_hits &&
+                    threaded.stacks == interp.stacks && jit.stacks == interp.stacks;
+        std::cout << "insn:" << interval << ": " << interp.samples << " samples, " << interp.stacks.size()
+                  << " stacks, engines " << (same ? "identical" : "MISMATCH") << std::endl;
+        ok = ok && same && interp.samples > 0;
+
+        if (interval == 1) {
+            char frame[32];
+            snprintf(frame, sizeof(frame), "guest;0x%08x", sub_address);
+            uint64_t in_sub = interp.stacks.count(frame) ? interp.stacks[frame] : 0;
+            std::cout << frame << " " << in_sub << " (should be 150)" << std::endl;
+            ok = ok && in_sub == 150 && interp.call_stack.empty();
+        }
+        profiler_destroy(&interp);
+        profiler_destroy(&threaded);
+        profiler_destroy(&jit);
+    }
+
+    // Timer sampling: the run is long enough for a 1 us period to elapse
+    {
+        Profiler profiler;
+        MemoryBus bus;
+        memory_init(&bus);
+        const uint8_t program[] = {0xF3, 0x00, 0x00, 0x00, 0x00}; // jmp 0
+        for (uint32_t i = 0; i < sizeof(program); ++i) {
+            memory_write_byte(&bus, i, program[i]);
+        }
+        i960_cpu cpu;
+        i960_init(&cpu, &bus);
+        profiler_init(&profiler, PROFILE_TIMER, 1);
+        cpu.profiler = &profiler;
+        i960_run(&cpu, 2000000);
+        std::cout << "timer:1: " << profiler.samples << " samples" << std::endl;
+        ok = ok && profiler.samples > 0 && profiler.ip_hits.size() == 1;
+        profiler_destroy(&profiler);
+        i960_destroy(&cpu);
+        memory_destroy(&bus);
+    }
+
+    std::cout << (ok ? "\nProfiler test passed!" : "\nProfiler test FAILED!") << std::endl;
+    return ok ? 0 : 1;
+}
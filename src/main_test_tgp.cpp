@@ -78,6 +78,7 @@ int main(int argc, char* argv[]) {
     std::cout << "TGP Busy = " << (tgp.busy ? "true" : "false") << std::endl;
 
     // Cleanup
+    i960_destroy(&cpu);
     memory_destroy(&bus);
     std::cout << "\nTGP integration test completed!" << std::endl;
     return 0;
@@ -0,0 +1,104 @@
+#include <iostream>
+#include <cstdio>
+#include <vector>
+#include "i960.h"
+#include "i960_decode.h"
+#include "memory.h"
+#include "trace.h"
+
+// Checks that instruction tracing records every executed instruction,
+// respects the runtime level and survives a save/load round trip.
+
+// Instructions the test program executes: 2 + 3 loop iterations * 3 + st + halt
+const uint64_t PROGRAM_INSTRUCTIONS = 13;
+
+static void load_program(MemoryBus* bus) {
+    uint8_t program[] = {
+        // ld_const g0, 3
+        0x90, 0x00, 0x00, 0x00, 0x00, 0x03,
+        // ld_const g1, 1
+        0x90, 0x01, 0x00, 0x00, 0x00, 0x01,
+        // loop (0x0C): sub_reg g0, g0, g1
+        0xD0, 0x00, 0x00, 0x01,
+        // cmp_reg g0, g2
+        0xF0, 0x00, 0x02,
+        // bne loop
+        0xF2, 0x00, 0x00, 0x00, 0x0C,
+        // st g1, [0x2000]
+        0xC1, 0x01, 0x00, 0x00, 0x20, 0x00,
+        // halt
+        0xFF
+    };
+    for (size_t i = 0; i < sizeof(program); ++i) {
+        memory_write_byte(bus, (uint32_t)i, program[i]);
+    }
+}
+
+// Runs the program to completion with the given runtime level
+static void run_traced(TraceBuffer* trace, TraceLevel level, uint32_t capacity) {
+    MemoryBus bus;
+    memory_init(&bus);
+    trace_init(trace, level, capacity);
+    bus.trace = trace;
+    load_program(&bus);
+
+    i960_cpu cpu;
+    i960_init(&cpu, &bus);
+    i960_run(&cpu, 1000);
+
+    i960_destroy(&cpu);
+    memory_destroy(&bus);
+}
+
+int main() {
+    std::cout << "Testing execution tracing (compiled level " << (int)TRACE_COMPILED_LEVEL << ")..." << std::endl;
+    bool ok = true;
+
+    TraceBuffer trace;
+    run_traced(&trace, TRACE_CPU, 64);
+    uint64_t expected = TRACE_COMPILED_LEVEL >= TRACE_CPU ? PROGRAM_INSTRUCTIONS : 0;
+    std::cout << "Traced " << trace.count
+              << " (should be " << expected << ")" << std::endl;
+    ok = ok && trace.count == expected;
+
+    if (trace.count > 0) {
+        const TraceRecord& first = trace.records[0];
+        const TraceRecord& last = trace.records[(trace.count - 1) & trace.mask];
+        std::cout << "First: 0x" << std::hex << first.address << " " << i960_op_name((i960_op)first.code)
+                  << " " << i960_register_name(first.arg[0]) << " = 0x" << std::hex << first.value[0]
+                  << " (should be 0x0 ld_const g0 = 0x3)" << std::endl;
+        std::cout << "Last: 0x" << last.address << " " << i960_op_name((i960_op)last.code)
+                  << " (should be 0x1e halt)" << std::dec << std::endl;
+        ok = ok && first.event == TRACE_EVENT_INSN && first.code == I960_OP_LD_CONST && first.address == 0 &&
+             first.value[0] == 3 && last.code == I960_OP_HALT && last.address == 0x1E;
+
+        // Round trip through a trace file
+        std::vector<TraceRecord> loaded;
+        uint64_t total = 0;
+        bool saved = trace_save(&trace, "trace_test.bin") && trace_load("trace_test.bin", &loaded, &total);
+        std::cout << "Reloaded " << loaded.size() << " of " << total << " records" << std::endl;
+        ok = ok && saved && total == trace.count && loaded.size() == trace.count &&
+             loaded.back().code == I960_OP_HALT;
+        std::remove("trace_test.bin");
+    }
+    trace_destroy(&trace);
+
+    // A small ring keeps only the newest records
+    run_traced(&trace, TRACE_CPU, 4);
+    if (TRACE_COMPILED_LEVEL >= TRACE_CPU) {
+        const TraceRecord& last = trace.records[(trace.count - 1) & trace.mask];
+        std::cout << "Ring of " << (trace.mask + 1) << " records: newest is " << i960_op_name((i960_op)last.code)
+                  << " (should be halt)" << std::endl;
+        ok = ok && trace.count == PROGRAM_INSTRUCTIONS && last.code == I960_OP_HALT;
+    }
+    trace_destroy(&trace);
+
+    // CPU trace points stay silent below the cpu level
+    run_traced(&trace, TRACE_DEVICE, 64);
+    std::cout << "Records at device level: " << trace.count << " (should be 0)" << std::endl;
+    ok = ok && trace.count == 0;
+    trace_destroy(&trace);
+
+    std::cout << (ok ? "\nTrace test passed!" : "\nTrace test FAILED!") << std::endl;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,151 @@
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include "i960_decode.h"
+#include "trace.h"
+
+// Decodes a binary trace written with --trace into readable text.
+//
+// Usage: PixelModel2TraceDecode <trace.bin>
+
+static void print_hex(uint32_t value) {
+    std::cout << "0x" << std::hex << value << std::dec;
+}
+
+static void print_insn(const TraceRecord& record) {
+    i960_op op = (i960_op)record.code;
+    int reg = record.arg[0];
+    uint32_t result = record.value[0];
+    uint32_t imm = record.value[1];
+
+    std::cout << std::left << std::setw(9) << i960_op_name(op) << std::right;
+    switch (op) {
+        case I960_OP_LD_ABS:
+        case I960_OP_LD_BYTE:
+            std::cout << i960_register_name(reg) << " = [";
+            print_hex(imm);
+            std::cout << "] = ";
+            print_hex(result);
+            break;
+        case I960_OP_ST_ABS:
+        case I960_OP_ST_BYTE:
+            std::cout << "[";
+            print_hex(imm);
+            std::cout << "] = " << i960_register_name(reg) << " = ";
+            print_hex(result);
+            break;
+        case I960_OP_CMP_REG:
+            std::cout << i960_register_name(reg) << " -> zero_flag = " << result;
+            break;
+        case I960_OP_CMPO:
+        case I960_OP_CMPI:
+        case I960_OP_CONCMPO:
+        case I960_OP_CONCMPI:
+        case I960_OP_SCANBYTE:
+        case I960_OP_CHKBIT:
+            std::cout << i960_register_name(reg) << " -> cc = " << result;
+            break;
+        case I960_OP_B:
+        case I960_OP_BAL:
+        case I960_OP_BCC:
+        case I960_OP_CALL:
+        case I960_OP_RET:
+        case I960_OP_BBC:
+        case I960_OP_BBS:
+        case I960_OP_CMPOB:
+        case I960_OP_CMPIB:
+        case I960_OP_BX:
+        case I960_OP_BALX:
+        case I960_OP_CALLX:
+            std::cout << "-> ";
+            print_hex(result);
+            break;
+        case I960_OP_BEQ:
+        case I960_OP_BNE:
+        case I960_OP_JMP:
+            std::cout << "-> ";
+            print_hex(result);
+            if (result != imm) {
+                std::cout << " (target ";
+                print_hex(imm);
+                std::cout << (op == I960_OP_JMP ? ", out of bounds: halted)" : " not taken)");
+            }
+            break;
+        case I960_OP_UNKNOWN:
+        case I960_OP_UNDEFINED:
+            std::cout << "opcode 0x" << std::hex << std::uppercase << std::setw(2) << std::setfill('0')
+                      << (int)record.arg[1] << std::nouppercase << std::setfill(' ') << std::dec;
+            if (op == I960_OP_UNKNOWN) {
+                std::cout << " params 0x" << std::hex << reg << ", 0x" << result << std::dec;
+            }
+            break;
+        case I960_OP_HALT:
+        case I960_OP_NOP:
+            break;
+        default:
+            std::cout << i960_register_name(reg) << " = ";
+            print_hex(result);
+            break;
+    }
+}
+
+static void print_record(const TraceRecord& record) {
+    switch (record.event) {
+        case TRACE_EVENT_INSN:
+            std::cout << std::hex << std::setw(8) << std::setfill('0') << record.address << std::setfill(' ')
+                      << std::dec << "  ";
+            print_insn(record);
+            break;
+        case TRACE_EVENT_TGP_COMMAND:
+            std::cout << "TGP       command 0x" << std::hex << (int)record.code << std::dec;
+            if (record.address != 0) {
+                std::cout << " operand ";
+                print_hex(record.address);
+            }
+            std::cout << " (matrix stack " << record.value[0] << (record.arg[0] ? ", overflow/underflow" : "") << ")";
+            break;
+        case TRACE_EVENT_TGP_COMPLETE:
+            std::cout << "TGP       command completed";
+            break;
+        case TRACE_EVENT_TGP_WRITE:
+            std::cout << "TGP       write [";
+            print_hex(record.address);
+            std::cout << "] = ";
+            print_hex(record.value[0]);
+            break;
+        case TRACE_EVENT_TGP_READ:
+            std::cout << "TGP       read of unknown register ";
+            print_hex(record.address);
+            break;
+        default:
+            std::cout << "unknown event " << (int)record.event;
+            break;
+    }
+    std::cout << "\n";
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        std::cout << "Usage: PixelModel2TraceDecode <trace.bin>" << std::endl;
+        return 1;
+    }
+
+    std::vector<TraceRecord> records;
+    uint64_t total = 0;
+    if (!trace_load(argv[1], &records, &total)) {
+        std::cerr << "Could not read trace file: " << argv[1] << std::endl;
+        return 1;
+    }
+
+    std::cout << "Trace " << argv[1] << ": " << total << " records";
+    if (total > records.size()) {
+        std::cout << " (oldest " << (total - records.size()) << " overwritten)";
+    }
+    std::cout << "\n";
+
+    for (const TraceRecord& record : records) {
+        print_record(record);
+    }
+    std::cout.flush();
+    return 0;
+}
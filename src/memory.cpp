@@ -7,188 +7,1154 @@
 #include <string>
 #include <cstring>
 #include <cstdlib>  // for system()
+#include <new>
 #include <map>
 #include <vector>
 #include <algorithm>
+#include <bitset>
 #include <cctype>
 #include <sstream>
+#include <iomanip>
 #include <ctime>
 
 #include "miniz.h"
 
-void memory_init(MemoryBus* bus) {
-    bus->ram = new uint8_t[MEMORY_SIZE];
-    // Initialize all memory to a known value, e.g., 0
-    for (uint32_t i = 0; i < MEMORY_SIZE; ++i) {
-        bus->ram[i] = 0;
+#if defined(__unix__) || defined(__APPLE__)
+#define MEMORY_MMAP_RAM 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#define MEMORY_MMAP_RAM 0
+#endif
+
+#include <deque>
+#include <mutex>
+
+#if MEMORY_FASTMEM_SUPPORTED
+#include <atomic>
+#include <signal.h>
+#include <ucontext.h>
+#endif
+
+static void fastmem_protect_code(MemoryBus* bus, uint32_t code_page);
+static void fastmem_protect_dirty(MemoryBus* bus, const uint64_t* dirty);
+static void fastmem_map_view(MemoryBus* bus, uint32_t base, uint32_t size);
+static void memory_pages_changed(MemoryBus* bus, uint32_t base, uint32_t size);
+static bool fastmem_release(MemoryBus* bus);
+
+// Guest RAM comes straight from the OS as untouched zero pages: nothing is
+// committed until the guest (or a ROM load) writes to it
+static uint8_t* ram_allocate(size_t size) {
+#if MEMORY_MMAP_RAM
+    void* p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED) {
+        throw std::bad_alloc();
+    }
+    return (uint8_t*)p;
+#else
+    uint8_t* p = (uint8_t*)calloc(size, 1);
+    if (p == nullptr) {
+        throw std::bad_alloc();
+    }
+    return p;
+#endif
+}
+
+static void ram_free(uint8_t* ram, size_t size) {
+#if MEMORY_MMAP_RAM
+    munmap(ram, size);
+#else
+    free(ram);
+#endif
+}
+
+// Which host pages of [start, start + size) are resident, one entry per
+// page of page_size bytes; false where the host cannot tell
+static bool ram_residency(const uint8_t* start, size_t size, std::vector<unsigned char>* resident, size_t* page_size) {
+#if MEMORY_MMAP_RAM
+    *page_size = (size_t)sysconf(_SC_PAGESIZE);
+    resident->resize((size + *page_size - 1) / *page_size);
+#if defined(__APPLE__)
+    char* vector = (char*)resident->data();
+#else
+    unsigned char* vector = resident->data();
+#endif
+    return mincore((void*)start, size, vector) == 0;
+#else
+    return false;
+#endif
+}
+
+// --- Shared ROM images ---
+// ROM contents are held once per host rather than once per instance: each
+// image lives in a file named after its CRC, in a directory private to the
+// user (pixel-model2-<uid> under /dev/shm, or the temp directory), that
+// every instance of every process loading the same ROM maps read-only, so
+// they all share the same page cache pages. Where no such file can be made
+// or trusted, an anonymous memory file still shares the image within the
+// process. Images stay mapped until the process exits. The files are not
+// removed on exit, so later runs map them again; they occupy tmpfs memory
+// until deleted, which is safe whenever no emulator is running.
+
+struct SharedRom {
+    uint32_t crc;
+    uint32_t size;
+    int fd;               // The mapped file, kept open for fastmem views
+    const uint8_t* data;  // Read-only mapping of the whole image
+};
+
+static std::mutex shared_rom_lock;
+static std::deque<SharedRom> shared_roms; // Never shrinks, so entries stay put
+
+#if MEMORY_MMAP_RAM
+static bool shared_rom_write(int fd, const uint8_t* data, uint32_t size) {
+    while (size > 0) {
+        ssize_t written = write(fd, data, size);
+        if (written <= 0) {
+            return false;
+        }
+        data += written;
+        size -= (uint32_t)written;
+    }
+    return true;
+}
+
+// Maps fd as the image when it holds exactly data
+static bool shared_rom_map(int fd, const uint8_t* data, uint32_t size, SharedRom* rom) {
+    struct stat info;
+    if (fstat(fd, &info) != 0 || (uint64_t)info.st_size != size) {
+        return false;
+    }
+    void* p = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    if (p == MAP_FAILED) {
+        return false;
+    }
+    if (memcmp(p, data, size) != 0) {
+        munmap(p, size);
+        return false;
+    }
+    rom->fd = fd;
+    rom->data = (const uint8_t*)p;
+    return true;
+}
+
+// Whether fd (or, for a directory, its contents) can only have been
+// written by this user: anything another user could rewrite after the
+// contents were checked must not be mapped
+static bool shared_rom_owned(int fd, bool directory) {
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_uid != geteuid() || (info.st_mode & (S_IWGRP | S_IWOTH)) != 0) {
+        return false;
+    }
+    return directory ? S_ISDIR(info.st_mode) && (info.st_mode & (S_IRWXG | S_IRWXO)) == 0 : S_ISREG(info.st_mode);
+}
+
+// The user's private image directory, created 0700 on first use; empty
+// when it cannot be made or is not the user's alone
+static std::string shared_rom_directory() {
+    std::error_code error;
+    std::filesystem::path base = "/dev/shm";
+    if (!std::filesystem::is_directory(base, error)) {
+        base = std::filesystem::temp_directory_path(error);
+        if (error) {
+            return std::string();
+        }
+    }
+    std::string directory = (base / ("pixel-model2-" + std::to_string(geteuid()))).string();
+    mkdir(directory.c_str(), 0700);
+    int fd = open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC | O_NOFOLLOW);
+    if (fd < 0) {
+        return std::string();
+    }
+    bool owned = shared_rom_owned(fd, true);
+    close(fd);
+    return owned ? directory : std::string();
+}
+
+static bool shared_rom_create(const uint8_t* data, uint32_t size, SharedRom* rom) {
+    std::string directory = shared_rom_directory();
+    int fd = -1;
+    if (!directory.empty()) {
+        char name[64];
+        snprintf(name, sizeof(name), "/pixel-model2-rom-%08x-%08x.bin", rom->crc, size);
+        std::string path = directory + name;
+
+        fd = open(path.c_str(), O_RDONLY | O_CLOEXEC | O_NOFOLLOW);
+        if (fd < 0) {
+            // First to load it: write the image under a private name and
+            // rename it into place, so nobody maps a partial file
+            std::string temp = path + ".XXXXXX";
+            int out = mkstemp(&temp[0]);
+            if (out >= 0) {
+                bool written = shared_rom_write(out, data, size);
+                close(out);
+                if (!written || rename(temp.c_str(), path.c_str()) != 0) {
+                    unlink(temp.c_str());
+                }
+            }
+            fd = open(path.c_str(), O_RDONLY | O_CLOEXEC | O_NOFOLLOW);
+        }
+        if (fd >= 0 && !shared_rom_owned(fd, false)) {
+            close(fd);
+            fd = -1;
+        }
+    }
+    if (fd >= 0) {
+        if (shared_rom_map(fd, data, size, rom)) {
+            return true;
+        }
+        close(fd);
+    }
+#if defined(__linux__)
+    fd = memfd_create("pixel-model2-rom", MFD_CLOEXEC);
+    if (fd >= 0) {
+        if (shared_rom_write(fd, data, size) && shared_rom_map(fd, data, size, rom)) {
+            return true;
+        }
+        close(fd);
+    }
+#endif
+    return false;
+}
+#endif
+
+// The shared image of data, created on first use; nullptr where the host
+// cannot share one
+static const SharedRom* shared_rom_acquire(const uint8_t* data, uint32_t size) {
+#if MEMORY_MMAP_RAM
+    uint32_t crc = (uint32_t)mz_crc32(MZ_CRC32_INIT, data, size);
+    std::lock_guard<std::mutex> lock(shared_rom_lock);
+    for (const SharedRom& rom : shared_roms) {
+        if (rom.crc == crc && rom.size == size && memcmp(rom.data, data, size) == 0) {
+            return &rom;
+        }
+    }
+    SharedRom rom = {crc, size, -1, nullptr};
+    if (!shared_rom_create(data, size, &rom)) {
+        return nullptr;
+    }
+    shared_roms.push_back(rom);
+    return &shared_roms.back();
+#else
+    return nullptr;
+#endif
+}
+
+// The shared image holding the byte at host, or nullptr
+static const SharedRom* shared_rom_containing(const uint8_t* host) {
+    std::lock_guard<std::mutex> lock(shared_rom_lock);
+    for (const SharedRom& rom : shared_roms) {
+        if (host >= rom.data && host < rom.data + rom.size) {
+            return &rom;
+        }
     }
+    return nullptr;
+}
+
+void memory_init(MemoryBus* bus) {
+    bus->ram = ram_allocate(MEMORY_SIZE);
     bus->tgp = nullptr;  // Will be set later when TGP is initialized
+    bus->device_count = 0;
+    bus->code_pages = new uint8_t[CODE_PAGE_COUNT]();
+    bus->dirty_pages = new uint64_t[MEMORY_DIRTY_WORDS]();
+    bus->code_generation = 1; // Decode cache slots start at generation 0 (empty)
+    bus->map_generation = 1;  // Fetch streams start at generation 0 (unresolved)
+    bus->trace = nullptr;
+    bus->pages = (MemoryPage*)calloc(MEMORY_PAGE_COUNT, sizeof(MemoryPage)); // Everything unmapped, committed lazily too
+    if (bus->pages == nullptr) {
+        throw std::bad_alloc();
+    }
+    bus->fastmem = nullptr;
+    bus->watch = nullptr;
+    bus->cpu_ip = nullptr;
+    bus->stats = nullptr;
+    bus->board = nullptr;
+    memory_map_host(bus, 0, MEMORY_SIZE, bus->ram);
     std::cout << "Memory Bus Initialized: " << (MEMORY_SIZE / 1024 / 1024) << "MB" << std::endl;
 }
 
 void memory_destroy(MemoryBus* bus) {
-    delete[] bus->ram;
+    if (!fastmem_release(bus)) {
+        ram_free(bus->ram, MEMORY_SIZE);
+    }
     bus->ram = nullptr;
+    delete[] bus->code_pages;
+    bus->code_pages = nullptr;
+    delete[] bus->dirty_pages;
+    bus->dirty_pages = nullptr;
+    free(bus->pages);
+    bus->pages = nullptr;
+    delete bus->watch;
+    bus->watch = nullptr;
+    delete bus->stats;
+    bus->stats = nullptr;
     bus->tgp = nullptr;
 }
 
+uint64_t memory_resident_bytes(const MemoryBus* bus) {
+    std::vector<unsigned char> resident;
+    size_t page_size;
+    if (!ram_residency(bus->ram, MEMORY_SIZE, &resident, &page_size)) {
+        return MEMORY_SIZE;
+    }
+    uint64_t pages = 0;
+    for (unsigned char page : resident) {
+        pages += page & 1;
+    }
+    return pages * page_size;
+}
 
-uint8_t memory_read_byte(MemoryBus* bus, uint32_t address) {
-    if (address >= MEMORY_SIZE) {
-        // Return 0 for out-of-bounds reads (could be peripheral space)
-        return 0;
+void memory_map_host(MemoryBus* bus, uint32_t base, uint32_t size, uint8_t* host) {
+    for (uint64_t offset = 0; offset < size; offset += MEMORY_PAGE_SIZE) {
+        MemoryPage* page = &bus->pages[(base + offset) >> MEMORY_PAGE_SHIFT];
+        *page = MemoryPage();
+        page->host = host + offset;
     }
-    return bus->ram[address];
+    memory_pages_changed(bus, base, size);
 }
 
-void memory_write_byte(MemoryBus* bus, uint32_t address, uint8_t value) {
-    if (address >= MEMORY_SIZE) {
-        // Ignore out-of-bounds writes (could be peripheral space)
+void memory_map_rom(MemoryBus* bus, uint32_t base, uint32_t size, const uint8_t* host) {
+    for (uint64_t offset = 0; offset < size; offset += MEMORY_PAGE_SIZE) {
+        MemoryPage* page = &bus->pages[(base + offset) >> MEMORY_PAGE_SHIFT];
+        *page = MemoryPage();
+        page->host = const_cast<uint8_t*>(host) + offset; // Never written: stores take the slow path and are dropped
+        page->read_only = true;
+    }
+    memory_pages_changed(bus, base, size);
+}
+
+bool memory_load_rom(MemoryBus* bus, uint32_t offset, const uint8_t* data, uint32_t size) {
+    if (bus->board != nullptr) {
+        const BoardRegion* region = memory_board_region(bus, offset);
+        if (region == nullptr || !region->read_only || (uint64_t)offset + size > (uint64_t)region->base + region->size) {
+            std::cerr << "Error: ROM data at offset 0x" << std::hex << offset << std::dec << " is outside the ROM regions of board "
+                      << bus->board->name << std::endl;
+            return false;
+        }
+    }
+    // Only a board has ROM regions: without one, the image is plain RAM
+    // contents whatever its alignment
+    const SharedRom* rom = nullptr;
+    if (bus->board != nullptr && size != 0 && offset % MEMORY_PAGE_SIZE == 0 && size % MEMORY_PAGE_SIZE == 0) {
+        rom = shared_rom_acquire(data, size);
+    }
+    if (rom != nullptr) {
+        memory_map_rom(bus, offset, size, rom->data);
+        return true;
+    }
+
+    // A private copy in RAM, read-only in a board's ROM region and
+    // writable without a board
+    if ((uint64_t)offset + size > MEMORY_SIZE) {
+        std::cerr << "Error: ROM data would overflow memory when loaded at offset 0x" << std::hex << offset << std::dec << std::endl;
+        return false;
+    }
+    uint32_t first = offset & ~(MEMORY_PAGE_SIZE - 1);
+    uint32_t end = (uint32_t)(((uint64_t)offset + size + MEMORY_PAGE_SIZE - 1) & ~(uint64_t)(MEMORY_PAGE_SIZE - 1));
+    bool read_only = bus->board != nullptr;
+    bool remap = false;
+    for (uint32_t address = first; address < end; address += MEMORY_PAGE_SIZE) {
+        const MemoryPage* page = memory_page(bus, address);
+        const uint8_t* host = page->watched ? page->watched_host : page->host;
+        remap = remap || host != bus->ram + address || page->read_only != read_only;
+    }
+    if (remap) {
+        // Unmap a shared ROM loaded there before
+        for (uint32_t address = first; address < end; address += MEMORY_PAGE_SIZE) {
+            MemoryPage* page = &bus->pages[address >> MEMORY_PAGE_SHIFT];
+            *page = MemoryPage();
+            page->host = bus->ram + address;
+            page->read_only = read_only;
+        }
+        memory_pages_changed(bus, first, end - first);
+    }
+    memory_invalidate_code(bus, offset, size);
+    memcpy(bus->ram + offset, data, size);
+    return true;
+}
+
+const MmioDevice* memory_register_device(MemoryBus* bus, const MmioDevice* device) {
+    if (bus->device_count == MEMORY_MAX_DEVICES) {
+        std::cerr << "Memory bus: no room for device " << device->name << std::endl;
+        return nullptr;
+    }
+    MmioDevice* registered = &bus->devices[bus->device_count++];
+    *registered = *device;
+    for (uint64_t offset = 0; offset < device->size; offset += MEMORY_PAGE_SIZE) {
+        MemoryPage* page = &bus->pages[(device->base + offset) >> MEMORY_PAGE_SHIFT];
+        *page = MemoryPage();
+        if (device->direct != nullptr && offset >= device->direct_offset &&
+            offset < (uint64_t)device->direct_offset + device->direct_size) {
+            page->host = device->direct + (offset - device->direct_offset);
+        } else {
+            page->device = registered;
+        }
+    }
+    memory_pages_changed(bus, device->base, device->size);
+    return registered;
+}
+
+uint8_t* memory_host_pointer(MemoryBus* bus, uint32_t address) {
+    const MemoryPage* page = memory_page(bus, address);
+    uint8_t* host = page->host != nullptr ? page->host : page->watched_host;
+    return host != nullptr ? host + (address & (MEMORY_PAGE_SIZE - 1)) : nullptr;
+}
+
+void memory_mark_code(MemoryBus* bus, uint32_t address) {
+    if (address < MEMORY_SIZE && !bus->code_pages[address >> CODE_PAGE_SHIFT]) {
+        bus->code_pages[address >> CODE_PAGE_SHIFT] = 1;
+        if (bus->fastmem) {
+            fastmem_protect_code(bus, address >> CODE_PAGE_SHIFT);
+        }
+    }
+}
+
+void memory_invalidate_code(MemoryBus* bus, uint32_t address, uint32_t length) {
+    if (length == 0 || address >= MEMORY_SIZE) {
         return;
     }
-    bus->ram[address] = value;
+    uint64_t end = std::min<uint64_t>((uint64_t)address + length, MEMORY_SIZE);
+    for (uint64_t page = address >> CODE_PAGE_SHIFT; page <= ((end - 1) >> CODE_PAGE_SHIFT); ++page) {
+        bus->dirty_pages[page >> 6] |= 1ull << (page & 63);
+        if (bus->code_pages[page]) {
+            bus->code_pages[page] = 0;
+            bus->code_generation++;
+        }
+    }
 }
 
-uint32_t memory_read_dword(MemoryBus* bus, uint32_t address) {
-    // Check if this is an input register access
-    if (address >= INPUT_BASE_ADDRESS && address < INPUT_BASE_ADDRESS + 0x100) {
-        if (bus->input_state) {
-            // Cast to InputState structure (defined in main.cpp)
-            struct InputState {
-                bool start_button, service_button, test_button, coin_button;
-                bool button1, button2, button3, button4;
-                bool up, down, left, right;
-                int16_t steering, throttle;
-            } *input = (InputState*)bus->input_state;
-            uint32_t offset = address - INPUT_BASE_ADDRESS;
-            
-            switch (offset) {
-                case 0x00: return input->start_button ? 1 : 0;
-                case 0x04: return input->service_button ? 1 : 0;
-                case 0x08: return input->test_button ? 1 : 0;
-                case 0x0C: return input->coin_button ? 1 : 0;
-                case 0x10: return input->button1 ? 1 : 0;
-                case 0x14: return input->button2 ? 1 : 0;
-                case 0x18: return input->button3 ? 1 : 0;
-                case 0x1C: return input->button4 ? 1 : 0;
-                case 0x20: return (input->up ? 1 : 0) | (input->down ? 2 : 0) | (input->left ? 4 : 0) | (input->right ? 8 : 0);
-                case 0x24: return (uint32_t)(int32_t)input->steering;
-                case 0x28: return (uint32_t)(int32_t)input->throttle;
-                default: return 0;
+uint32_t memory_take_dirty_pages(MemoryBus* bus, uint64_t* out) {
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < MEMORY_DIRTY_WORDS; ++i) {
+        out[i] = bus->dirty_pages[i];
+        count += (uint32_t)std::bitset<64>(out[i]).count();
+    }
+    memset(bus->dirty_pages, 0, MEMORY_DIRTY_WORDS * sizeof(uint64_t));
+    if (bus->fastmem) {
+        fastmem_protect_dirty(bus, out);
+    }
+    return count;
+}
+
+// After the page table changed: rebuilds the watched flags from the
+// watchpoints, invalidates what cached the old entries and brings the
+// fastmem view of [base, base + size) in line
+static void memory_pages_changed(MemoryBus* bus, uint32_t base, uint32_t size) {
+    if (bus->watch != nullptr) {
+        for (uint32_t i = 0; i < MEMORY_PAGE_COUNT; ++i) {
+            MemoryPage* page = &bus->pages[i];
+            if (page->watched) {
+                page->host = page->watched_host;
+                page->watched = false;
+                page->watched_host = nullptr;
             }
         }
+        for (uint32_t i = 0; i < bus->watch->point_count; ++i) {
+            const MemoryWatchpoint& point = bus->watch->points[i];
+            uint64_t last = std::min<uint64_t>((uint64_t)point.address + point.length - 1, 0xFFFFFFFFu);
+            for (uint64_t index = point.address >> MEMORY_PAGE_SHIFT; index <= last >> MEMORY_PAGE_SHIFT; ++index) {
+                MemoryPage* page = &bus->pages[index];
+                if (!page->watched) {
+                    page->watched = true;
+                    page->watched_host = page->host;
+                    page->host = nullptr;
+                }
+            }
+        }
+    }
+
+    // Host pointers changed, and compiled code may hold accesses to pages
+    // that are now watched or no longer RAM
+    bus->map_generation++;
+    bus->code_generation++;
+    if (bus->fastmem) {
+        // Watched pages may have moved anywhere
+        fastmem_map_view(bus, bus->watch != nullptr ? 0 : base, bus->watch != nullptr ? MEMORY_SIZE : size);
+    }
+}
+
+bool memory_add_watchpoint(MemoryBus* bus, uint32_t address, uint32_t length, uint32_t kinds) {
+    if (bus->watch == nullptr) {
+        bus->watch = new MemoryWatchLog();
+    }
+    if (length == 0 || bus->watch->point_count == MEMORY_MAX_WATCHPOINTS) {
+        return false;
+    }
+    bus->watch->points[bus->watch->point_count++] = {address, length, kinds};
+    memory_pages_changed(bus, 0, 0);
+    return true;
+}
+
+void memory_clear_watchpoints(MemoryBus* bus) {
+    if (bus->watch != nullptr) {
+        bus->watch->point_count = 0;
+        memory_pages_changed(bus, 0, 0);
+    }
+}
+
+uint32_t memory_watch_hits(const MemoryBus* bus, MemoryWatchHit* out, uint32_t max) {
+    if (bus->watch == nullptr) {
         return 0;
     }
+    uint64_t total = bus->watch->hit_count;
+    uint64_t count = std::min<uint64_t>({total, (uint64_t)MEMORY_WATCH_LOG_SIZE, (uint64_t)max});
+    for (uint64_t i = 0; i < count; ++i) {
+        out[i] = bus->watch->hits[(total - count + i) % MEMORY_WATCH_LOG_SIZE];
+    }
+    return (uint32_t)count;
+}
 
-    // Check if this is a TGP register access
-    if (address >= TGP_BASE_ADDRESS && address < TGP_BASE_ADDRESS + 0x1000) {
-        uint32_t offset = address - TGP_BASE_ADDRESS;
-        return tgp_read_register(bus->tgp, offset);
-    }
-
-    // Check if this is an audio register access
-    if (address >= AUDIO_BASE_ADDRESS && address < AUDIO_BASE_ADDRESS + 0x200) {
-        if (bus->audio_state) {
-            // Cast to AudioState structure (defined in main.cpp)
-            struct AudioState {
-                void* stream;
-                bool enabled;
-                float master_volume;
-                struct {
-                    bool enabled;
-                    uint16_t frequency;
-                    uint8_t volume;
-                    uint8_t waveform;
-                } channels[8];
-            } *audio = (AudioState*)bus->audio_state;
-            uint32_t offset = address - AUDIO_BASE_ADDRESS;
-            
-            switch (offset) {
-                case 0x00: return audio->enabled ? 1 : 0;
-                case 0x04: return (uint32_t)(audio->master_volume * 255.0f);
-                // Channel registers (0x10 + channel*0x10 + register)
-                default: {
-                    uint32_t channel = (offset - 0x10) / 0x10;
-                    uint32_t reg = (offset - 0x10) % 0x10;
-                    if (channel < 8) {
-                        switch (reg) {
-                            case 0x00: return audio->channels[channel].enabled ? 1 : 0;
-                            case 0x04: return audio->channels[channel].frequency;
-                            case 0x08: return audio->channels[channel].volume;
-                            case 0x0C: return audio->channels[channel].waveform;
-                        }
-                    }
-                    return 0;
-                }
+bool memory_parse_watchpoint(const char* text, MemoryWatchpoint* out) {
+    char* end;
+    out->address = (uint32_t)strtoul(text, &end, 0);
+    out->length = 4;
+    out->kinds = MEMORY_WATCH_READ | MEMORY_WATCH_WRITE;
+    if (end == text) {
+        return false;
+    }
+    if (*end == ':' && isdigit((unsigned char)end[1])) {
+        const char* length = end + 1;
+        out->length = (uint32_t)strtoul(length, &end, 0);
+        if (out->length == 0) {
+            return false;
+        }
+    }
+    if (*end == ':') {
+        std::string kinds = end + 1;
+        if (kinds == "r") {
+            out->kinds = MEMORY_WATCH_READ;
+        } else if (kinds == "w") {
+            out->kinds = MEMORY_WATCH_WRITE;
+        } else if (kinds != "rw") {
+            return false;
+        }
+        return true;
+    }
+    return *end == '\0';
+}
+
+
+// --- Fastmem ---
+#if MEMORY_FASTMEM_SUPPORTED
+
+// Guest space plus a guard page, so an access at the top of the guest space
+// faults inside the view instead of running past it
+const uint64_t FASTMEM_VIEW_SIZE = (1ull << 32) + 4096;
+
+// Buses with a fastmem view, searched by the fault handler (which has
+// nothing but the faulting address to go on)
+const int FASTMEM_MAX_VIEWS = 64;
+static std::atomic<MemoryBus*> fastmem_views[FASTMEM_MAX_VIEWS];
+static int fastmem_ram_fds[FASTMEM_MAX_VIEWS]; // The RAM file of each view, for remapping it
+static std::mutex fastmem_lock;
+static struct sigaction fastmem_previous_handler;
+
+// Whether the page holding address is writable RAM backed by the view's
+// RAM file (not watched, ROM or anything else mapped over it)
+static bool fastmem_is_ram(MemoryBus* bus, uint32_t address) {
+    uint32_t base = address & ~(MEMORY_PAGE_SIZE - 1);
+    const MemoryPage* page = memory_page(bus, address);
+    return page->host == bus->ram + base && !page->read_only;
+}
+
+static MemoryBus* fastmem_owner(const uint8_t* host) {
+    for (int i = 0; i < FASTMEM_MAX_VIEWS; ++i) {
+        MemoryBus* bus = fastmem_views[i].load(std::memory_order_acquire);
+        if (bus != nullptr && host >= bus->fastmem && host < bus->fastmem + FASTMEM_VIEW_SIZE) {
+            return bus;
+        }
+    }
+    return nullptr;
+}
+
+// Completes a faulting memory_fast_* access through the page table.
+// Returns false if the instruction is not one of them.
+static bool fastmem_emulate(MemoryBus* bus, greg_t* regs) {
+    const uint8_t* rip = (const uint8_t*)regs[REG_RIP];
+    uint32_t address = (uint32_t)regs[REG_RDI];
+    if ((uint8_t*)regs[REG_RSI] != bus->fastmem) {
+        return false;
+    }
+    if (rip[0] == 0x8B && rip[1] == 0x04 && rip[2] == 0x3E) { // movl (%rsi,%rdi), %eax
+        regs[REG_RAX] = memory_read_dword(bus, address);
+        regs[REG_RIP] += 3;
+    } else if (rip[0] == 0x0F && rip[1] == 0xB6 && rip[2] == 0x04 && rip[3] == 0x3E) { // movzbl (%rsi,%rdi), %eax
+        regs[REG_RAX] = memory_read_byte(bus, address);
+        regs[REG_RIP] += 4;
+    } else if (rip[0] == 0x89 && rip[1] == 0x04 && rip[2] == 0x3E) { // movl %eax, (%rsi,%rdi)
+        memory_write_dword(bus, address, (uint32_t)regs[REG_RAX]);
+        regs[REG_RIP] += 3;
+    } else if (rip[0] == 0x88 && rip[1] == 0x04 && rip[2] == 0x3E) { // movb %al, (%rsi,%rdi)
+        memory_write_byte(bus, address, (uint8_t)regs[REG_RAX]);
+        regs[REG_RIP] += 3;
+    } else if (rip[0] == 0x0F && rip[1] == 0xB7 && rip[2] == 0x04 && rip[3] == 0x3E) { // movzwl (%rsi,%rdi), %eax
+        regs[REG_RAX] = bus_read<uint16_t>(bus, address);
+        regs[REG_RIP] += 4;
+    } else if (rip[0] == 0x66 && rip[1] == 0x89 && rip[2] == 0x04 && rip[3] == 0x3E) { // movw %ax, (%rsi,%rdi)
+        bus_write<uint16_t>(bus, address, (uint16_t)regs[REG_RAX]);
+        regs[REG_RIP] += 4;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+static void fastmem_fault(int signal, siginfo_t* info, void* context) {
+    uint8_t* host = (uint8_t*)info->si_addr;
+    greg_t* regs = ((ucontext_t*)context)->uc_mcontext.gregs;
+    MemoryBus* bus = fastmem_owner(host);
+    if (bus != nullptr) {
+        uint64_t offset = host - bus->fastmem;
+        bool write = (regs[REG_ERR] & 2) != 0;
+        if (offset < MEMORY_SIZE && write && fastmem_is_ram(bus, (uint32_t)offset)) {
+            // A store to a protected page (holding code, or clean since the
+            // last dirty snapshot): mark it dirty, drop its decodes, then
+            // let the store run again
+            uint32_t code_page = (uint32_t)(offset >> CODE_PAGE_SHIFT);
+            bus->dirty_pages[code_page >> 6] |= 1ull << (code_page & 63);
+            if (bus->code_pages[code_page]) {
+                bus->code_pages[code_page] = 0;
+                bus->code_generation++;
             }
+            mprotect(bus->fastmem + ((uint64_t)code_page << CODE_PAGE_SHIFT), 1u << CODE_PAGE_SHIFT, PROT_READ | PROT_WRITE);
+            return;
+        }
+        if (fastmem_emulate(bus, regs)) {
+            return;
         }
-        return 0;
     }
 
-    uint32_t value = 0;
-    value |= (uint32_t)memory_read_byte(bus, address + 0);
-    value |= (uint32_t)memory_read_byte(bus, address + 1) << 8;
-    value |= (uint32_t)memory_read_byte(bus, address + 2) << 16;
-    value |= (uint32_t)memory_read_byte(bus, address + 3) << 24;
-    return value;
+    // Not ours: hand over to whoever was installed before, or crash as usual
+    if (fastmem_previous_handler.sa_flags & SA_SIGINFO) {
+        fastmem_previous_handler.sa_sigaction(signal, info, context);
+    } else if (fastmem_previous_handler.sa_handler != SIG_IGN && fastmem_previous_handler.sa_handler != SIG_DFL) {
+        fastmem_previous_handler.sa_handler(signal);
+    } else {
+        sigaction(SIGSEGV, &fastmem_previous_handler, nullptr); // Returning re-runs the access under it
+    }
+}
+
+static bool fastmem_install_handler() {
+    static bool installed = false;
+    if (!installed) {
+        struct sigaction action = {};
+        action.sa_sigaction = fastmem_fault;
+        action.sa_flags = SA_SIGINFO | SA_NODEFER;
+        sigemptyset(&action.sa_mask);
+        installed = sigaction(SIGSEGV, &action, &fastmem_previous_handler) == 0;
+    }
+    return installed;
+}
+
+bool memory_enable_fastmem(MemoryBus* bus) {
+    if (bus->fastmem != nullptr) {
+        return true;
+    }
+    if (sysconf(_SC_PAGESIZE) != (1 << CODE_PAGE_SHIFT)) {
+        return false; // Code pages could not be protected one by one
+    }
+    std::lock_guard<std::mutex> lock(fastmem_lock);
+    int slot = 0;
+    while (slot < FASTMEM_MAX_VIEWS && fastmem_views[slot].load() != nullptr) {
+        ++slot;
+    }
+    if (slot == FASTMEM_MAX_VIEWS || !fastmem_install_handler()) {
+        return false;
+    }
+
+    // RAM moves into a memory file mapped twice: at bus->ram for the bus,
+    // and at guest address 0 of the view
+    int fd = memfd_create("pixel-model2-ram", MFD_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    uint8_t* ram = nullptr;
+    uint8_t* view = nullptr;
+    if (ftruncate(fd, MEMORY_SIZE) == 0) {
+        void* p = mmap(nullptr, MEMORY_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        ram = p != MAP_FAILED ? (uint8_t*)p : nullptr;
+        p = mmap(nullptr, FASTMEM_VIEW_SIZE, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        view = p != MAP_FAILED ? (uint8_t*)p : nullptr;
+    }
+    bool mapped = ram != nullptr && view != nullptr &&
+                  mmap(view, MEMORY_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) != MAP_FAILED;
+    if (!mapped) {
+        close(fd);
+        if (ram != nullptr) munmap(ram, MEMORY_SIZE);
+        if (view != nullptr) munmap(view, FASTMEM_VIEW_SIZE);
+        return false;
+    }
+
+    // Only pages already written hold anything; copying the rest would
+    // commit the whole of RAM
+    std::vector<unsigned char> resident;
+    size_t page_size;
+    if (ram_residency(bus->ram, MEMORY_SIZE, &resident, &page_size)) {
+        for (size_t page = 0; page < resident.size(); ++page) {
+            if (resident[page] & 1) {
+                memcpy(ram + page * page_size, bus->ram + page * page_size, page_size);
+            }
+        }
+    } else {
+        memcpy(ram, bus->ram, MEMORY_SIZE);
+    }
+    uint8_t* old_ram = bus->ram;
+    for (uint32_t i = 0; i < MEMORY_PAGE_COUNT; ++i) {
+        uint8_t** hosts[] = {&bus->pages[i].host, &bus->pages[i].watched_host};
+        for (uint8_t** host : hosts) {
+            if (*host != nullptr && *host >= old_ram && *host < old_ram + MEMORY_SIZE) {
+                *host = ram + (*host - old_ram);
+            }
+        }
+    }
+    bus->map_generation++;
+    bus->code_generation++;
+    bus->ram = ram;
+    ram_free(old_ram, MEMORY_SIZE);
+
+    bus->fastmem = view;
+    fastmem_ram_fds[slot] = fd;
+    fastmem_views[slot].store(bus, std::memory_order_release);
+    fastmem_map_view(bus, 0, MEMORY_SIZE); // ROM mapped over RAM, every RAM page clean
+    return true;
+}
+
+// Maps the view's pages in [base, base + size) below MEMORY_SIZE to what
+// the page table has there: the RAM file, a shared ROM image, or nothing
+// (the fault handler completes those accesses through the bus). RAM comes
+// back write-protected, clean until its next store; watched pages stay
+// inaccessible so that every access faults over to the bus and its checks.
+static void fastmem_map_view(MemoryBus* bus, uint32_t base, uint32_t size) {
+    int slot = 0;
+    while (fastmem_views[slot].load() != bus) {
+        ++slot;
+    }
+    int ram_fd = fastmem_ram_fds[slot];
+    uint64_t end = std::min<uint64_t>((uint64_t)base + size, MEMORY_SIZE);
+    for (uint64_t address = base & ~(uint64_t)(MEMORY_PAGE_SIZE - 1); address < end; address += MEMORY_PAGE_SIZE) {
+        const MemoryPage* page = memory_page(bus, (uint32_t)address);
+        const uint8_t* host = page->watched ? page->watched_host : page->host;
+        const SharedRom* rom = page->read_only && host != nullptr ? shared_rom_containing(host) : nullptr;
+        uint8_t* target = bus->fastmem + address;
+        int prot = page->watched ? PROT_NONE : PROT_READ;
+        if (host == bus->ram + address) {
+            mmap(target, MEMORY_PAGE_SIZE, prot, MAP_SHARED | MAP_FIXED, ram_fd, (off_t)address);
+        } else if (rom != nullptr) {
+            mmap(target, MEMORY_PAGE_SIZE, prot, MAP_SHARED | MAP_FIXED, rom->fd, (off_t)(host - rom->data));
+        } else {
+            mmap(target, MEMORY_PAGE_SIZE, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED | MAP_NORESERVE, -1, 0);
+        }
+    }
+}
+
+static void fastmem_protect_code(MemoryBus* bus, uint32_t code_page) {
+    if (fastmem_is_ram(bus, code_page << CODE_PAGE_SHIFT)) { // Anything else is read-only or inaccessible already
+        mprotect(bus->fastmem + ((uint64_t)code_page << CODE_PAGE_SHIFT), 1u << CODE_PAGE_SHIFT, PROT_READ);
+    }
+}
+
+// Write-protects again the RAM pages of a dirty snapshot, so the next
+// store to each faults and marks it dirty. Clean pages never lost their
+// protection; runs of consecutive pages take one call.
+static void fastmem_protect_dirty(MemoryBus* bus, const uint64_t* dirty) {
+    uint32_t run_start = 0;
+    uint32_t run_length = 0;
+    for (uint32_t word = 0; word < MEMORY_DIRTY_WORDS; ++word) {
+        for (uint32_t bit = 0; dirty[word] != 0 && bit < 64; ++bit) {
+            uint32_t page = word * 64 + bit;
+            if (!((dirty[word] >> bit) & 1) || !fastmem_is_ram(bus, page << CODE_PAGE_SHIFT)) {
+                continue; // Clean, or not writable RAM in the view
+            }
+            if (run_length != 0 && run_start + run_length == page) {
+                ++run_length;
+                continue;
+            }
+            if (run_length != 0) {
+                mprotect(bus->fastmem + ((uint64_t)run_start << CODE_PAGE_SHIFT), (size_t)run_length << CODE_PAGE_SHIFT, PROT_READ);
+            }
+            run_start = page;
+            run_length = 1;
+        }
+    }
+    if (run_length != 0) {
+        mprotect(bus->fastmem + ((uint64_t)run_start << CODE_PAGE_SHIFT), (size_t)run_length << CODE_PAGE_SHIFT, PROT_READ);
+    }
+}
+
+// Unmaps the view and the shared RAM; false if the bus had no view
+static bool fastmem_release(MemoryBus* bus) {
+    if (bus->fastmem == nullptr) {
+        return false;
+    }
+    {
+        std::lock_guard<std::mutex> lock(fastmem_lock);
+        for (int i = 0; i < FASTMEM_MAX_VIEWS; ++i) {
+            if (fastmem_views[i].load() == bus) {
+                fastmem_views[i].store(nullptr);
+                close(fastmem_ram_fds[i]);
+            }
+        }
+    }
+    munmap(bus->fastmem, FASTMEM_VIEW_SIZE);
+    munmap(bus->ram, MEMORY_SIZE);
+    bus->fastmem = nullptr;
+    bus->ram = nullptr;
+    return true;
+}
+
+#else
+
+bool memory_enable_fastmem(MemoryBus* bus) {
+    return false;
+}
+
+static void fastmem_protect_code(MemoryBus* bus, uint32_t code_page) {}
+
+static void fastmem_protect_dirty(MemoryBus* bus, const uint64_t* dirty) {}
+
+static void fastmem_map_view(MemoryBus* bus, uint32_t base, uint32_t size) {}
+
+static bool fastmem_release(MemoryBus* bus) {
+    return false;
+}
+
+#endif
+
+// Offset of address inside the page's device when the device decodes it,
+// otherwise false (unmapped space, or past the device's registers)
+static inline bool memory_device_offset(const MemoryPage* page, uint32_t address, uint32_t* offset) {
+    const MmioDevice* device = page->device;
+    *offset = address - (device != nullptr ? device->base : 0);
+    return device != nullptr && *offset < device->size;
+}
+
+uint8_t memory_read_byte(MemoryBus* bus, uint32_t address) {
+    return bus_read<uint8_t>(bus, address);
+}
+
+void memory_write_byte(MemoryBus* bus, uint32_t address, uint8_t value) {
+    bus_write<uint8_t>(bus, address, value);
+}
+
+uint32_t memory_read_dword(MemoryBus* bus, uint32_t address) {
+    return bus_read<uint32_t>(bus, address);
 }
 
 void memory_write_dword(MemoryBus* bus, uint32_t address, uint32_t value) {
-    // Check if this is an input register access (read-only, ignore writes)
-    if (address >= INPUT_BASE_ADDRESS && address < INPUT_BASE_ADDRESS + 0x100) {
+    bus_write<uint32_t>(bus, address, value);
+}
+
+// Host memory behind a page whether or not it is watched
+static inline uint8_t* memory_page_host(const MemoryPage* page) {
+    return page->host != nullptr ? page->host : page->watched_host;
+}
+
+// The slow paths proper, without the watchpoint check: recursing through
+// these rather than bus_read/bus_write logs a split access once
+static uint64_t memory_read_unwatched(MemoryBus* bus, uint32_t address, uint32_t size) {
+    const MemoryPage* page = memory_page(bus, address);
+    uint8_t* host = memory_page_host(page);
+    uint32_t page_offset = address & (MEMORY_PAGE_SIZE - 1);
+    if (host != nullptr && page_offset <= MEMORY_PAGE_SIZE - size) {
+        switch (size) {
+        case 1: return host[page_offset];
+        case 2: return memory_load_le<uint16_t>(host + page_offset);
+        case 4: return memory_load_le<uint32_t>(host + page_offset);
+        default: return memory_load_le<uint64_t>(host + page_offset);
+        }
+    }
+    if (host == nullptr) {
+        // Devices decode bytes and words; halfwords are two byte reads and
+        // doublewords two word reads, as the i960 bus splits them
+        uint32_t offset;
+        if (!memory_device_offset(page, address, &offset)) {
+            return 0;
+        }
+        const MmioDevice* device = page->device;
+        switch (size) {
+        case 1: return device->read8 != nullptr ? device->read8(device->context, offset) : 0;
+        case 2: return memory_read_unwatched(bus, address, 1) | memory_read_unwatched(bus, address + 1, 1) << 8;
+        case 4: return device->read32 != nullptr ? device->read32(device->context, offset) : 0;
+        default: return memory_read_unwatched(bus, address, 4) | memory_read_unwatched(bus, address + 4, 4) << 32;
+        }
+    }
+
+    // Straddles two pages
+    uint64_t value = 0;
+    for (uint32_t i = 0; i < size; ++i) {
+        value |= memory_read_unwatched(bus, address + i, 1) << (8 * i);
+    }
+    return value;
+}
+
+static void memory_write_unwatched(MemoryBus* bus, uint32_t address, uint32_t size, uint64_t value) {
+    const MemoryPage* page = memory_page(bus, address);
+    uint8_t* host = memory_page_host(page);
+    uint32_t page_offset = address & (MEMORY_PAGE_SIZE - 1);
+    if (page->read_only && page_offset <= MEMORY_PAGE_SIZE - size) {
+        return; // ROM
+    }
+    if (host != nullptr && page_offset <= MEMORY_PAGE_SIZE - size) {
+        memory_note_write(bus, address);
+        memory_note_write(bus, address + size - 1);
+        switch (size) {
+        case 1: host[page_offset] = (uint8_t)value; break;
+        case 2: memory_store_le<uint16_t>(host + page_offset, (uint16_t)value); break;
+        case 4: memory_store_le<uint32_t>(host + page_offset, (uint32_t)value); break;
+        default: memory_store_le<uint64_t>(host + page_offset, value); break;
+        }
+        return;
+    }
+    if (host == nullptr) {
+        uint32_t offset;
+        if (!memory_device_offset(page, address, &offset)) {
+            return;
+        }
+        const MmioDevice* device = page->device;
+        switch (size) {
+        case 1:
+            if (device->write8 != nullptr) device->write8(device->context, offset, (uint8_t)value);
+            break;
+        case 2:
+            memory_write_unwatched(bus, address, 1, value & 0xFF);
+            memory_write_unwatched(bus, address + 1, 1, (value >> 8) & 0xFF);
+            break;
+        case 4:
+            if (device->write32 != nullptr) device->write32(device->context, offset, (uint32_t)value);
+            break;
+        default:
+            memory_write_unwatched(bus, address, 4, value & 0xFFFFFFFF);
+            memory_write_unwatched(bus, address + 4, 4, value >> 32);
+            break;
+        }
         return;
     }
 
-    // Check if this is a TGP register access
-    if (address >= TGP_BASE_ADDRESS && address < TGP_BASE_ADDRESS + 0x1000) {
-        uint32_t offset = address - TGP_BASE_ADDRESS;
-        tgp_write_register(bus->tgp, offset, value);
+    // Straddles two pages
+    for (uint32_t i = 0; i < size; ++i) {
+        memory_write_unwatched(bus, address + i, 1, (value >> (8 * i)) & 0xFF);
+    }
+}
+
+// Whether an access of the given kind to [address, address + size) hits a watchpoint
+static bool memory_watch_match(const MemoryWatchLog* watch, uint32_t address, uint32_t size, uint32_t kind) {
+    uint64_t end = (uint64_t)address + size;
+    for (uint32_t i = 0; i < watch->point_count; ++i) {
+        const MemoryWatchpoint& point = watch->points[i];
+        if ((point.kinds & kind) && address < (uint64_t)point.address + point.length && point.address < end) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void memory_watch_log(MemoryBus* bus, uint32_t address, uint32_t size, bool write, uint64_t old_value,
+                             uint64_t new_value) {
+    MemoryWatchLog* watch = bus->watch;
+    MemoryWatchHit& hit = watch->hits[watch->hit_count++ % MEMORY_WATCH_LOG_SIZE];
+    hit.ip = bus->cpu_ip != nullptr ? *bus->cpu_ip : 0;
+    hit.address = address;
+    hit.size = size;
+    hit.write = write;
+    hit.old_value = old_value;
+    hit.new_value = new_value;
+}
+
+uint64_t memory_read_slow(MemoryBus* bus, uint32_t address, uint32_t size) {
+    memory_stats_count(bus, address, size, false);
+    uint64_t value = memory_read_unwatched(bus, address, size);
+    if (bus->watch != nullptr && memory_watch_match(bus->watch, address, size, MEMORY_WATCH_READ)) {
+        memory_watch_log(bus, address, size, false, value, value);
+    }
+    return value;
+}
+
+void memory_write_slow(MemoryBus* bus, uint32_t address, uint32_t size, uint64_t value) {
+    memory_stats_count(bus, address, size, true);
+    if (bus->watch != nullptr && memory_watch_match(bus->watch, address, size, MEMORY_WATCH_WRITE)) {
+        // Reading device registers can have side effects, so only memory
+        // reports what it held
+        bool memory = memory_page_host(memory_page(bus, address)) != nullptr &&
+                      memory_page_host(memory_page(bus, address + size - 1)) != nullptr;
+        uint64_t old_value = memory ? memory_read_unwatched(bus, address, size) : 0;
+        memory_write_unwatched(bus, address, size, value);
+        memory_watch_log(bus, address, size, true, old_value, value);
         return;
     }
+    memory_write_unwatched(bus, address, size, value);
+}
 
-    // Check if this is an audio register access
-    if (address >= AUDIO_BASE_ADDRESS && address < AUDIO_BASE_ADDRESS + 0x200) {
-        if (bus->audio_state) {
-            // Cast to AudioState structure (defined in main.cpp)
-            struct AudioState {
-                void* stream;
-                bool enabled;
-                float master_volume;
-                struct {
-                    bool enabled;
-                    uint16_t frequency;
-                    uint8_t volume;
-                    uint8_t waveform;
-                } channels[8];
-            } *audio = (AudioState*)bus->audio_state;
-            uint32_t offset = address - AUDIO_BASE_ADDRESS;
-            
-            switch (offset) {
-                case 0x00: audio->enabled = (value != 0); break;
-                case 0x04: audio->master_volume = (float)value / 255.0f; break;
-                // Channel registers (0x10 + channel*0x10 + register)
-                default: {
-                    uint32_t channel = (offset - 0x10) / 0x10;
-                    uint32_t reg = (offset - 0x10) % 0x10;
-                    if (channel < 8) {
-                        switch (reg) {
-                            case 0x00: audio->channels[channel].enabled = (value != 0); break;
-                            case 0x04: audio->channels[channel].frequency = (uint16_t)value; break;
-                            case 0x08: audio->channels[channel].volume = (uint8_t)value; break;
-                            case 0x0C: audio->channels[channel].waveform = (uint8_t)value; break;
-                        }
-                    }
-                    break;
-                }
+// --- Bus statistics ---
+
+bool memory_enable_stats(MemoryBus* bus) {
+    if (!MEMORY_STATS_COMPILED) {
+        return false;
+    }
+    if (bus->stats == nullptr) {
+        bus->stats = new MemoryStats();
+        bus->code_generation++; // Compiled blocks access RAM directly; recompile them through the bus
+    }
+    return true;
+}
+
+static void memory_stats_add(MemoryAccessCounts* counts, uint32_t size, bool write) {
+    if (write) {
+        counts->writes++;
+        counts->bytes_written += size;
+    } else {
+        counts->reads++;
+        counts->bytes_read += size;
+    }
+}
+
+void memory_stats_record(MemoryBus* bus, uint32_t address, uint32_t size, bool write) {
+    MemoryStats* stats = bus->stats;
+    const MemoryPage* page = memory_page(bus, address);
+    uint32_t region = MEMORY_REGION_UNMAPPED;
+    uint32_t offset;
+    if (memory_device_offset(page, address, &offset)) {
+        uint32_t device = (uint32_t)(page->device - bus->devices);
+        region = MEMORY_REGION_DEVICE + device;
+        memory_stats_add(&stats->registers[(uint64_t)device << 32 | offset], size, write);
+    } else if (page->read_only) {
+        region = MEMORY_REGION_ROM;
+    } else if (memory_page_host(page) != nullptr) {
+        region = MEMORY_REGION_RAM;
+    }
+    memory_stats_add(&stats->regions[region], size, write);
+    stats->frame_bytes += size;
+}
+
+void memory_stats_end_frame(MemoryBus* bus) {
+    if (memory_stats_active(bus)) {
+        bus->stats->frames.push_back(bus->stats->frame_bytes);
+        bus->stats->frame_bytes = 0;
+    }
+}
+
+static const char* memory_region_name(const MemoryBus* bus, uint32_t region) {
+    switch (region) {
+        case MEMORY_REGION_RAM: return "ram";
+        case MEMORY_REGION_ROM: return "rom";
+        case MEMORY_REGION_UNMAPPED: return "unmapped";
+        default: return bus->devices[region - MEMORY_REGION_DEVICE].name;
+    }
+}
+
+bool memory_write_stats(const MemoryBus* bus, const char* path, uint32_t top) {
+    const MemoryStats* stats = bus->stats;
+    if (stats == nullptr) {
+        return false;
+    }
+    std::ofstream file(path);
+    if (!file) {
+        return false;
+    }
+
+    MemoryAccessCounts total = {};
+    for (const MemoryAccessCounts& counts : stats->regions) {
+        total.reads += counts.reads;
+        total.writes += counts.writes;
+        total.bytes_read += counts.bytes_read;
+        total.bytes_written += counts.bytes_written;
+    }
+    file << "Bus statistics: " << total.reads << " reads (" << total.bytes_read << " bytes), " << total.writes
+         << " writes (" << total.bytes_written << " bytes)\n";
+
+    file << "\nBy region:\n  region              reads        writes    bytes read bytes written\n";
+    for (uint32_t region = 0; region < MEMORY_REGION_DEVICE + bus->device_count; ++region) {
+        const MemoryAccessCounts& counts = stats->regions[region];
+        file << "  " << std::left << std::setw(10) << memory_region_name(bus, region) << std::right << std::setw(14)
+             << counts.reads << std::setw(14) << counts.writes << std::setw(14) << counts.bytes_read << std::setw(14)
+             << counts.bytes_written << "\n";
+    }
+
+    std::vector<std::pair<uint64_t, MemoryAccessCounts>> registers(stats->registers.begin(), stats->registers.end());
+    std::sort(registers.begin(), registers.end(),
+              [](const std::pair<uint64_t, MemoryAccessCounts>& a, const std::pair<uint64_t, MemoryAccessCounts>& b) {
+                  uint64_t a_count = a.second.reads + a.second.writes;
+                  uint64_t b_count = b.second.reads + b.second.writes;
+                  return a_count != b_count ? a_count > b_count : a.first < b.first;
+              });
+    file << "\nHottest device registers:\n  device      offset         reads        writes\n";
+    for (size_t i = 0; i < registers.size() && i < top; ++i) {
+        uint32_t device = (uint32_t)(registers[i].first >> 32);
+        file << "  " << std::left << std::setw(10) << bus->devices[device].name << std::right << "  0x" << std::hex
+             << std::setw(6) << std::setfill('0') << (uint32_t)registers[i].first << std::dec << std::setfill(' ')
+             << std::setw(14) << registers[i].second.reads << std::setw(14) << registers[i].second.writes << "\n";
+    }
+
+    if (!stats->frames.empty()) {
+        uint64_t sum = 0;
+        for (uint64_t bytes : stats->frames) {
+            sum += bytes;
+        }
+        file << "\nBytes moved per frame over " << stats->frames.size() << " frames: min "
+             << *std::min_element(stats->frames.begin(), stats->frames.end()) << ", mean " << sum / stats->frames.size()
+             << ", max " << *std::max_element(stats->frames.begin(), stats->frames.end()) << "\n";
+        for (size_t i = 0; i < stats->frames.size(); ++i) {
+            file << "  frame " << i << ": " << stats->frames[i] << "\n";
+        }
+    }
+    return (bool)file;
+}
+
+BusSpan bus_span(MemoryBus* bus, uint32_t address, uint32_t length, uint8_t* scratch) {
+    BusSpan span = {nullptr, length, false};
+    const uint8_t* start = memory_page(bus, address)->host;
+    if (start != nullptr && (uint64_t)address + length <= (1ull << 32)) {
+        // In place when every page is host memory following on from the first
+        start += address & (MEMORY_PAGE_SIZE - 1);
+        uint32_t last = address + (length != 0 ? length - 1 : 0);
+        bool contiguous = true;
+        for (uint32_t page = address >> MEMORY_PAGE_SHIFT; page < last >> MEMORY_PAGE_SHIFT && contiguous; ++page) {
+            contiguous = bus->pages[page + 1].host == bus->pages[page].host + MEMORY_PAGE_SIZE;
+        }
+        if (contiguous) {
+            memory_stats_count(bus, address, length, false);
+            span.data = start;
+            span.direct = true;
+            return span;
+        }
+    }
+
+    // Copy a page at a time: host pages in one go, devices a word at a time
+    uint32_t done = 0;
+    while (done < length) {
+        uint32_t current = address + done;
+        uint32_t offset = current & (MEMORY_PAGE_SIZE - 1);
+        uint32_t chunk = std::min(length - done, MEMORY_PAGE_SIZE - offset);
+        const MemoryPage* page = memory_page(bus, current);
+        if (page->host != nullptr) {
+            memory_stats_count(bus, current, chunk, false);
+            memcpy(scratch + done, page->host + offset, chunk);
+        } else {
+            uint32_t i = 0;
+            for (; i + 4 <= chunk; i += 4) {
+                memory_store_le<uint32_t>(scratch + done + i, (uint32_t)memory_read_slow(bus, current + i, 4));
+            }
+            for (; i < chunk; ++i) {
+                scratch[done + i] = (uint8_t)memory_read_slow(bus, current + i, 1);
             }
         }
-        return;
+        done += chunk;
     }
+    span.data = scratch;
+    return span;
+}
 
-    memory_write_byte(bus, address + 0, (value >> 0) & 0xFF);
-    memory_write_byte(bus, address + 1, (value >> 8) & 0xFF);
-    memory_write_byte(bus, address + 2, (value >> 16) & 0xFF);
-    memory_write_byte(bus, address + 3, (value >> 24) & 0xFF);
+// --- TGP Registers ---
+
+const uint32_t TGP_REGISTER_SPACE = 0x1000;
+
+static uint32_t tgp_mmio_read(void* context, uint32_t offset) {
+    return tgp_read_register((TGP*)context, offset);
+}
+
+static void tgp_mmio_write(void* context, uint32_t offset, uint32_t value) {
+    tgp_write_register((TGP*)context, offset, value);
 }
 
 bool load_rom_from_file(MemoryBus* bus, const char* filepath, uint32_t offset) {
@@ -206,13 +1172,16 @@ bool load_rom_from_file(MemoryBus* bus, const char* filepath, uint32_t offset) {
         return false;
     }
 
-    if (file.read(reinterpret_cast<char*>(bus->ram + offset), size)) {
-        std::cout << "Successfully loaded " << size << " bytes from " << filepath << " into memory at offset 0x" << std::hex << offset << std::endl;
-        return true;
+    std::vector<uint8_t> data((size_t)size);
+    if (!file.read(reinterpret_cast<char*>(data.data()), size)) {
+        std::cerr << "Error: Could not read ROM file: " << filepath << std::endl;
+        return false;
     }
-    
-    std::cerr << "Error: Could not read ROM file: " << filepath << std::endl;
-    return false;
+    if (!memory_load_rom(bus, offset, data.data(), (uint32_t)size)) {
+        return false;
+    }
+    std::cout << "Successfully loaded " << size << " bytes from " << filepath << " into memory at offset 0x" << std::hex << offset << std::endl;
+    return true;
 }
 
 // Extract a file from ZIP archive using PowerShell and load it
@@ -249,12 +1218,7 @@ bool load_rom_from_zip(MemoryBus* bus, const char* zip_path, const char* filenam
         return false;
     }
 
-    // Write data to memory bus using a 32-bit index to avoid size_t->uint32_t conversion warnings
-    for (uint32_t i = 0; i < (uint32_t)file_data.size(); ++i) {
-        memory_write_byte(bus, offset + i, file_data[i]);
-    }
-
-    return true;
+    return memory_load_rom(bus, offset, file_data.data(), (uint32_t)file_data.size());
 }
 
 // Extract all files from ZIP archive to memory map
@@ -383,41 +1347,121 @@ bool extract_zip_to_memory(const std::string& zip_path, std::map<std::string, st
 
 void memory_connect_tgp(MemoryBus* bus, TGP* tgp) {
     bus->tgp = tgp;
+    MmioDevice device = {};
+    device.name = "tgp";
+    device.base = TGP_BASE_ADDRESS;
+    device.size = TGP_REGISTER_SPACE;
+    device.context = tgp;
+    device.read32 = tgp_mmio_read;
+    device.write32 = tgp_mmio_write;
+    memory_register_device(bus, &device);
     std::cout << "TGP connected to memory bus at address 0x" << std::hex << TGP_BASE_ADDRESS << std::endl;
 }
 
-void memory_connect_input(MemoryBus* bus, void* input_state) {
-    bus->input_state = input_state;
-    std::cout << "Input system connected to memory bus at address 0x" << std::hex << INPUT_BASE_ADDRESS << std::endl;
+// --- Board memory maps ---
+// Region placement is this emulator's: program ROM where the i960 boots,
+// the RAMs below the data ROM, which takes the top half of the window.
+// Sizes are the largest each board revision's games use.
+
+static const BoardMap boards[] = {
+    {"model2", {
+        {"program ROM", 0x00000000, 0x00200000, true},
+        {"data ROM", 0x02000000, 0x01000000, true},
+        {"work RAM", 0x00200000, 0x00020000, false},
+        {"polygon RAM", 0x00900000, 0x00080000, false},
+        {"texture RAM", 0x01000000, 0x00200000, false},
+    }},
+    {"model2a", {
+        {"program ROM", 0x00000000, 0x00200000, true},
+        {"data ROM", 0x02000000, 0x02000000, true},
+        {"work RAM", 0x00200000, 0x00040000, false},
+        {"polygon RAM", 0x00900000, 0x00080000, false},
+        {"texture RAM", 0x01000000, 0x00200000, false},
+    }},
+    {"model2b", {
+        {"program ROM", 0x00000000, 0x00200000, true},
+        {"data ROM", 0x02000000, 0x02000000, true},
+        {"work RAM", 0x00200000, 0x00040000, false},
+        {"polygon RAM", 0x00900000, 0x00080000, false},
+        {"texture RAM", 0x01000000, 0x00400000, false},
+    }},
+    {"model2c", {
+        {"program ROM", 0x00000000, 0x00200000, true},
+        {"data ROM", 0x02000000, 0x02000000, true},
+        {"work RAM", 0x00200000, 0x00040000, false},
+        {"polygon RAM", 0x00900000, 0x00080000, false},
+        {"texture RAM", 0x01000000, 0x00400000, false},
+    }},
+};
+
+const BoardMap* memory_find_board(const char* name) {
+    for (const BoardMap& board : boards) {
+        if (strcmp(board.name, name) == 0) {
+            return &board;
+        }
+    }
+    return nullptr;
+}
+
+bool memory_apply_board(MemoryBus* bus, const BoardMap* board) {
+    for (const BoardRegion& region : board->regions) {
+        if (region.base % MEMORY_PAGE_SIZE != 0 || region.size % MEMORY_PAGE_SIZE != 0 ||
+            (uint64_t)region.base + region.size > MEMORY_SIZE) {
+            std::cerr << "Board " << board->name << ": " << region.name << " is misaligned or outside RAM" << std::endl;
+            return false;
+        }
+    }
+    for (uint32_t page = 0; page < (MEMORY_SIZE >> MEMORY_PAGE_SHIFT); ++page) {
+        bus->pages[page] = MemoryPage();
+    }
+    for (const BoardRegion& region : board->regions) {
+        for (uint32_t offset = 0; offset < region.size; offset += MEMORY_PAGE_SIZE) {
+            MemoryPage* page = &bus->pages[(region.base + offset) >> MEMORY_PAGE_SHIFT];
+            page->host = bus->ram + region.base + offset;
+            page->read_only = region.read_only;
+        }
+    }
+    bus->board = board;
+    memory_pages_changed(bus, 0, MEMORY_SIZE);
+    return true;
 }
 
-void memory_connect_audio(MemoryBus* bus, void* audio_state) {
-    bus->audio_state = audio_state;
-    std::cout << "Audio system connected to memory bus at address 0x" << std::hex << AUDIO_BASE_ADDRESS << std::endl;
+const BoardRegion* memory_board_region(const MemoryBus* bus, uint32_t address) {
+    if (bus->board != nullptr) {
+        for (const BoardRegion& region : bus->board->regions) {
+            if (address - region.base < region.size) {
+                return &region;
+            }
+        }
+    }
+    return nullptr;
 }
 
 // --- Game ROM Configurations ---
 // Sega Model 2 games typically have multiple ROM files
-static RomFile daytona_roms[] = {
-    {"epr-16724a.6", 0x000000, 0x80000},  // Main program ROM (524288 bytes = 0x80000)
-    {"epr-16725a.7", 0x080000, 0x80000},  // Main program ROM
-    {"mpr-16491.32", 0x100000, 0x200000}, // Data ROM (2097152 bytes = 0x200000)
-    {"mpr-16492.33", 0x300000, 0x200000}, // Data ROM
-    {"mpr-16493.4", 0x500000, 0x200000},  // Data ROM
-    {"mpr-16494.5", 0x700000, 0x200000},  // Data ROM
+static const RomFile daytona_roms[] = {
+    {"epr-16724a.6", 0x000000, 0x80000},    // Main program ROM (524288 bytes = 0x80000)
+    {"epr-16725a.7", 0x080000, 0x80000},    // Main program ROM
+    {"mpr-16491.32", 0x2000000, 0x200000},  // Data ROM (2097152 bytes = 0x200000)
+    {"mpr-16492.33", 0x2200000, 0x200000},  // Data ROM
+    {"mpr-16493.4", 0x2400000, 0x200000},   // Data ROM
+    {"mpr-16494.5", 0x2600000, 0x200000},   // Data ROM
 };
 
-static RomFile vf3_roms[] = {
+static const RomFile vf3_roms[] = {
     {"epr-18518.14", 0x000000, 0x80000},  // Main program ROM (currently loaded)
 };
 
-static GameConfig available_games[] = {
-    {"daytona", daytona_roms, sizeof(daytona_roms) / sizeof(RomFile)},
-    {"vf3", vf3_roms, sizeof(vf3_roms) / sizeof(RomFile)},
+static const GameConfig available_games[] = {
+    {"daytona", daytona_roms, sizeof(daytona_roms) / sizeof(RomFile), &boards[0]},  // Model 2
+    {"vf3", vf3_roms, sizeof(vf3_roms) / sizeof(RomFile), &boards[1]},              // Loads vcop2.zip, a Model 2A set
 };
 
 bool load_game_roms(MemoryBus* bus, const GameConfig* config, const char* rom_directory) {
-    std::cout << "Loading game: " << config->name << std::endl;
+    std::cout << "Loading game: " << config->name << " (board " << config->board->name << ")" << std::endl;
+    if (!memory_apply_board(bus, config->board)) {
+        return false;
+    }
     
     // Map game names to ZIP filenames
     std::string zip_filename;
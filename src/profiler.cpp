@@ -0,0 +1,195 @@
+#include "profiler.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+
+// Root frame of every folded stack, and the width of each routine frame
+static const char PROFILE_ROOT[] = "guest";
+static const size_t PROFILE_FRAME_LENGTH = 11; // ";0x" + 8 hex digits
+
+void profiler_init(Profiler* profiler, ProfileMode mode, uint32_t interval) {
+    profiler->mode = mode;
+    profiler->interval = interval > 0 ? interval : 1;
+    profiler->countdown = mode == PROFILE_TIMER ? PROFILE_CLOCK_CHECK : profiler->interval;
+    profiler->next_tick = std::chrono::steady_clock::now() + std::chrono::microseconds(profiler->interval);
+    profiler->samples = 0;
+    profiler->ip_hits.clear();
+    profiler->stacks.clear();
+    profiler->call_stack.clear();
+    profiler->call_stack.reserve(PROFILE_MAX_DEPTH);
+    profiler->stack_key = PROFILE_ROOT;
+    profiler->overflow_depth = 0;
+}
+
+void profiler_destroy(Profiler* profiler) {
+    profiler->mode = PROFILE_OFF;
+    profiler->samples = 0;
+    profiler->ip_hits.clear();
+    profiler->stacks.clear();
+    profiler->call_stack.clear();
+    profiler->stack_key.clear();
+    profiler->overflow_depth = 0;
+}
+
+bool profiler_parse(const char* spec, ProfileMode* mode, uint32_t* interval) {
+    const char* value;
+    if (strncmp(spec, "insn:", 5) == 0) {
+        *mode = PROFILE_INSTRUCTIONS;
+        value = spec + 5;
+    } else if (strncmp(spec, "timer:", 6) == 0) {
+        *mode = PROFILE_TIMER;
+        value = spec + 6;
+    } else {
+        return false;
+    }
+    char* end;
+    unsigned long parsed = strtoul(value, &end, 10);
+    if (*value == '\0' || *end != '\0' || parsed == 0 || parsed > 0xFFFFFFFFul) {
+        return false;
+    }
+    *interval = (uint32_t)parsed;
+    return true;
+}
+
+static void profiler_record(Profiler* profiler, uint32_t ip, uint64_t weight) {
+    profiler->samples += weight;
+    profiler->ip_hits[ip] += weight;
+    profiler->stacks[profiler->stack_key] += weight;
+}
+
+void profiler_sample(Profiler* profiler, uint32_t ip) {
+    if (profiler->mode == PROFILE_INSTRUCTIONS) {
+        profiler_record(profiler, ip, 1);
+        profiler->countdown = profiler->interval;
+        return;
+    }
+
+    profiler->countdown = PROFILE_CLOCK_CHECK;
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    if (now >= profiler->next_tick) {
+        profiler_record(profiler, ip, 1);
+        // Periods missed while the host was busy elsewhere are not made up
+        profiler->next_tick = now + std::chrono::microseconds(profiler->interval);
+    }
+}
+
+static uint64_t gcd(uint64_t a, uint64_t b) {
+    while (b != 0) {
+        uint64_t t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+void profiler_block(Profiler* profiler, const i960_decoded* ops, uint32_t count, uint64_t repeat) {
+    uint64_t total = (uint64_t)count * repeat;
+    uint64_t first = (uint64_t)profiler->countdown; // 1-based position of the next due instruction
+    if (first > total) {
+        profiler->countdown -= total;
+        return;
+    }
+
+    if (profiler->mode == PROFILE_TIMER) {
+        // Host time does not move within one call: a single clock read covers it
+        profiler_sample(profiler, ops[(first - 1) % count].ip);
+        profiler->countdown = PROFILE_CLOCK_CHECK - (total - first) % PROFILE_CLOCK_CHECK;
+        return;
+    }
+
+    // Sample k lands on position first + k * interval. Its instruction index
+    // repeats with a period of count / gcd(interval, count) samples, so
+    // skipped idle iterations are accounted without visiting each one.
+    uint64_t interval = profiler->interval;
+    uint64_t due = (total - first) / interval + 1;
+    uint64_t period = count / gcd(interval % count, count);
+    uint64_t cycles = due / period;
+    uint64_t rest = due % period;
+    uint64_t visits = due < period ? due : period;
+    for (uint64_t k = 0; k < visits; ++k) {
+        uint64_t position = first + k * interval;
+        profiler_record(profiler, ops[(position - 1) % count].ip, cycles + (k < rest ? 1 : 0));
+    }
+    profiler->countdown = interval - (total - (first + (due - 1) * interval));
+}
+
+void profiler_call(Profiler* profiler, uint32_t target) {
+    if (profiler->call_stack.size() >= PROFILE_MAX_DEPTH) {
+        profiler->overflow_depth++;
+        return;
+    }
+    char frame[PROFILE_FRAME_LENGTH + 1];
+    snprintf(frame, sizeof(frame), ";0x%08x", target);
+    profiler->call_stack.push_back(target);
+    profiler->stack_key += frame;
+}
+
+void profiler_return(Profiler* profiler) {
+    if (profiler->overflow_depth > 0) {
+        profiler->overflow_depth--;
+        return;
+    }
+    // Returns from routines entered before profiling began are ignored
+    if (!profiler->call_stack.empty()) {
+        profiler->call_stack.pop_back();
+        profiler->stack_key.resize(profiler->stack_key.size() - PROFILE_FRAME_LENGTH);
+    }
+}
+
+static void write_percent(std::ofstream& file, uint64_t count, uint64_t total) {
+    file << std::setw(12) << count << "  " << std::fixed << std::setprecision(2) << std::setw(6)
+         << (total ? 100.0 * (double)count / (double)total : 0.0) << "%  ";
+}
+
+bool profiler_write_report(const Profiler* profiler, const char* path, uint32_t top) {
+    std::ofstream file(path);
+    if (!file) {
+        return false;
+    }
+
+    file << "Guest profile: " << profiler->samples << " samples, one every " << profiler->interval
+         << (profiler->mode == PROFILE_TIMER ? " us" : " instructions") << "\n";
+
+    std::vector<std::pair<uint32_t, uint64_t>> ips(profiler->ip_hits.begin(), profiler->ip_hits.end());
+    std::sort(ips.begin(), ips.end(), [](const std::pair<uint32_t, uint64_t>& a, const std::pair<uint32_t, uint64_t>& b) {
+        return a.second != b.second ? a.second > b.second : a.first < b.first;
+    });
+    file << "\nHottest instructions:\n     samples  percent  ip\n";
+    for (size_t i = 0; i < ips.size() && i < top; ++i) {
+        write_percent(file, ips[i].second, profiler->samples);
+        file << "0x" << std::hex << std::setw(8) << std::setfill('0') << ips[i].first << std::dec
+             << std::setfill(' ') << "\n";
+    }
+
+    // Self samples per routine: the innermost frame of each stack
+    std::map<std::string, uint64_t> routines;
+    for (const auto& stack : profiler->stacks) {
+        size_t separator = stack.first.rfind(';');
+        routines[separator == std::string::npos ? "(top level)" : stack.first.substr(separator + 1)] += stack.second;
+    }
+    std::vector<std::pair<std::string, uint64_t>> sorted(routines.begin(), routines.end());
+    std::sort(sorted.begin(), sorted.end(),
+              [](const std::pair<std::string, uint64_t>& a, const std::pair<std::string, uint64_t>& b) {
+                  return a.second != b.second ? a.second > b.second : a.first < b.first;
+              });
+    file << "\nHottest routines (self, by call target):\n     samples  percent  routine\n";
+    for (size_t i = 0; i < sorted.size() && i < top; ++i) {
+        write_percent(file, sorted[i].second, profiler->samples);
+        file << sorted[i].first << "\n";
+    }
+    return (bool)file;
+}
+
+bool profiler_write_folded(const Profiler* profiler, const char* path) {
+    std::ofstream file(path);
+    if (!file) {
+        return false;
+    }
+    for (const auto& stack : profiler->stacks) {
+        file << stack.first << " " << stack.second << "\n";
+    }
+    return (bool)file;
+}
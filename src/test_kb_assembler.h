@@ -0,0 +1,80 @@
+#ifndef TEST_KB_ASSEMBLER_H
+#define TEST_KB_ASSEMBLER_H
+
+#include <cstdint>
+#include <vector>
+#include "memory.h"
+
+// Minimal i960 KB/CA assembler shared by the tests: one emitter per
+// instruction format, words laid out from origin. Branch targets are
+// absolute; forward branches are emitted to themselves and patched once
+// the target is known.
+struct KBAssembler {
+    uint32_t origin;
+    std::vector<uint32_t> words;
+
+    explicit KBAssembler(uint32_t origin_address) : origin(origin_address) {}
+
+    uint32_t here() const { return origin + 4 * (uint32_t)words.size(); }
+
+    // REG: src1/src2 are literals when lit1/lit2 are set
+    static uint32_t reg_word(uint32_t opcode, uint32_t src1, uint32_t src2, uint32_t dst, bool lit1 = false,
+                             bool lit2 = false) {
+        return (opcode >> 4) << 24 | dst << 19 | src2 << 14 | (lit2 ? 1u : 0u) << 12 | (lit1 ? 1u : 0u) << 11 |
+               (opcode & 0xF) << 7 | src1;
+    }
+    void reg(uint32_t opcode, uint32_t src1, uint32_t src2, uint32_t dst, bool lit1 = false, bool lit2 = false) {
+        words.push_back(reg_word(opcode, src1, src2, dst, lit1, lit2));
+    }
+    void cobr(uint32_t opcode, uint32_t src1, uint32_t src2, uint32_t target, bool lit1 = false) {
+        uint32_t disp = target - here();
+        words.push_back(opcode << 24 | src1 << 19 | src2 << 14 | (lit1 ? 1u : 0u) << 13 | (disp & 0x1FFC));
+    }
+    void ctrl(uint32_t opcode, uint32_t target) {
+        uint32_t disp = target - here();
+        words.push_back(opcode << 24 | (disp & 0xFFFFFC));
+    }
+    // MEMA abase + offset
+    void mema(uint32_t opcode, uint32_t dst, uint32_t abase, uint32_t offset) {
+        words.push_back(opcode << 24 | dst << 19 | abase << 14 | 1u << 13 | (offset & 0xFFF));
+    }
+    // MEMB: mode 0x4 (abase), 0x7 (abase)[index*scale], 0xC disp
+    void memb(uint32_t opcode, uint32_t dst, uint32_t abase, uint32_t mode = 0x4, uint32_t index = 0,
+              uint32_t scale = 0) {
+        words.push_back(opcode << 24 | dst << 19 | abase << 14 | 1u << 12 | mode << 10 | scale << 7 | index);
+    }
+    void memb_disp(uint32_t opcode, uint32_t dst, uint32_t disp) {
+        memb(opcode, dst, 0, 0xC);
+        words.push_back(disp);
+    }
+    // lda value, dst
+    void lda(uint32_t value, uint32_t dst) { memb_disp(0x8C, dst, value); }
+
+    // Points the COBR or CTRL branch at `at` to target
+    void patch_cobr(uint32_t at, uint32_t target) { words[(at - origin) / 4] |= (target - at) & 0x1FFC; }
+    void patch_ctrl(uint32_t at, uint32_t target) { words[(at - origin) / 4] |= (target - at) & 0xFFFFFC; }
+};
+
+// Boot layout shared by the tests: the PRCB and the interrupt stack its
+// first frame lives on
+const uint32_t KB_TEST_PRCB_ADDRESS = 0x2000;
+const uint32_t KB_TEST_STACK_ADDRESS = 0x10000;
+
+// Writes the assembled words at their origin
+inline void load_kb_code(MemoryBus* bus, const KBAssembler& code) {
+    for (size_t i = 0; i < code.words.size(); ++i) {
+        memory_write_dword(bus, code.origin + 4 * (uint32_t)i, code.words[i]);
+    }
+}
+
+// Writes the initialization boot record and PRCB for a program starting at
+// the assembler's origin, then the program, ready for i960_boot
+inline void load_kb_image(MemoryBus* bus, const KBAssembler& program) {
+    memory_write_dword(bus, 0, 0x1000);  // SAT
+    memory_write_dword(bus, 4, KB_TEST_PRCB_ADDRESS);
+    memory_write_dword(bus, 12, program.origin);
+    memory_write_dword(bus, KB_TEST_PRCB_ADDRESS + 24, KB_TEST_STACK_ADDRESS);
+    load_kb_code(bus, program);
+}
+
+#endif // TEST_KB_ASSEMBLER_H
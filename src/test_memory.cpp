@@ -1,13 +1,261 @@
 #include <iostream>
+#include <cstring>
 #include "memory.h"
 
+// A device with a few word registers, for checking MMIO decoding
+struct TestDevice {
+    uint32_t registers[4];
+    uint32_t last_offset;
+};
+
+static uint32_t test_device_read(void* device, uint32_t offset) {
+    TestDevice* test = (TestDevice*)device;
+    test->last_offset = offset;
+    return offset < sizeof(test->registers) ? test->registers[offset / 4] : 0xDEAD;
+}
+
+static void test_device_write(void* device, uint32_t offset, uint32_t value) {
+    TestDevice* test = (TestDevice*)device;
+    test->last_offset = offset;
+    if (offset < sizeof(test->registers)) {
+        test->registers[offset / 4] = value;
+    }
+}
+
+static uint8_t test_device_read8(void* device, uint32_t offset) {
+    return (uint8_t)(test_device_read(device, offset & ~3u) >> (8 * (offset & 3)));
+}
+
+static bool check(bool condition, const char* what) {
+    std::cout << (condition ? "  ok: " : "  FAILED: ") << what << std::endl;
+    return condition;
+}
+
 int main() {
     std::cout << "Testing memory_init..." << std::endl;
     MemoryBus bus;
     memory_init(&bus);
     std::cout << "memory_init completed successfully" << std::endl;
+    bool ok = true;
+
+    // RAM is committed as it is written, not up front
+    uint64_t resident_at_init = memory_resident_bytes(&bus);
+    for (uint32_t i = 0; i < 4; ++i) {
+        memory_write_byte(&bus, i * (MEMORY_SIZE / 4) + 100, 1);
+    }
+    uint64_t resident_after_writes = memory_resident_bytes(&bus);
+    std::cout << "Resident RAM: " << resident_at_init / 1024 << " KB at init, " << resident_after_writes / 1024
+              << " KB after writing 4 bytes" << std::endl;
+    ok = check(resident_at_init < MEMORY_SIZE / 8 && resident_after_writes > resident_at_init &&
+               resident_after_writes < MEMORY_SIZE / 2, "RAM zero-filled lazily") && ok;
+    ok = check(memory_read_byte(&bus, MEMORY_SIZE / 2 + 100) == 1 && memory_read_dword(&bus, MEMORY_SIZE - 4) == 0,
+               "untouched RAM reads 0") && ok;
+
+    std::cout << "Testing page table decoding..." << std::endl;
+
+    // RAM, including a word straddling two pages
+    memory_write_dword(&bus, 0x1234, 0x11223344);
+    ok = check(memory_read_dword(&bus, 0x1234) == 0x11223344 && memory_read_byte(&bus, 0x1234) == 0x44, "RAM word") && ok;
+    memory_write_dword(&bus, MEMORY_PAGE_SIZE - 2, 0xAABBCCDD);
+    ok = check(memory_read_dword(&bus, MEMORY_PAGE_SIZE - 2) == 0xAABBCCDD &&
+               memory_read_byte(&bus, MEMORY_PAGE_SIZE + 1) == 0xAA, "RAM word across a page boundary") && ok;
+    ok = check(memory_host_pointer(&bus, MEMORY_SIZE - 1) == bus.ram + MEMORY_SIZE - 1 &&
+               memory_host_pointer(&bus, MEMORY_SIZE) == nullptr, "host pointers end with RAM") && ok;
+
+    // Every access width, within a page and across one
+    bus_write<uint16_t>(&bus, 0x2001, 0xBEEF);
+    bus_write<uint64_t>(&bus, 0x2003, 0x0102030405060708ull);
+    ok = check(bus_read<uint16_t>(&bus, 0x2001) == 0xBEEF && bus_read<int16_t>(&bus, 0x2001) == (int16_t)0xBEEF &&
+               bus_read<uint64_t>(&bus, 0x2003) == 0x0102030405060708ull && bus_read<uint8_t>(&bus, 0x2003) == 0x08 &&
+               bus_read<uint32_t>(&bus, 0x2000) == 0x08BEEF00, "16 and 64-bit RAM accesses") && ok;
+    bus_write<uint64_t>(&bus, 2 * MEMORY_PAGE_SIZE - 3, 0x1122334455667788ull);
+    bus_write<uint16_t>(&bus, 3 * MEMORY_PAGE_SIZE - 1, 0x99AA);
+    ok = check(bus_read<uint64_t>(&bus, 2 * MEMORY_PAGE_SIZE - 3) == 0x1122334455667788ull &&
+               bus_read<uint16_t>(&bus, 3 * MEMORY_PAGE_SIZE - 1) == 0x99AA &&
+               memory_read_byte(&bus, 3 * MEMORY_PAGE_SIZE) == 0x99, "16 and 64-bit accesses across a page boundary") && ok;
+    bus_write<uint64_t>(&bus, MEMORY_SIZE - 4, ~0ull);
+    ok = check(bus_read<uint64_t>(&bus, MEMORY_SIZE - 4) == 0xFFFFFFFFull, "64-bit access past the end of RAM") && ok;
+
+    // Dirty pages: every RAM write since the last snapshot
+    static uint64_t dirty[MEMORY_DIRTY_WORDS];
+    memory_take_dirty_pages(&bus, dirty);
+    bus_write<uint16_t>(&bus, 0x5FFF, 0x1234);
+    memory_write_byte(&bus, 0x9000, 1);
+    memory_invalidate_code(&bus, 0x20000, 0x2001);
+    uint32_t dirty_count = memory_take_dirty_pages(&bus, dirty);
+    ok = check(dirty_count == 6 && memory_dirty_page(dirty, 0x5000) && memory_dirty_page(dirty, 0x6000) &&
+               memory_dirty_page(dirty, 0x9FFF) && memory_dirty_page(dirty, 0x22000) && !memory_dirty_page(dirty, 0x8000) &&
+               !memory_dirty_page(dirty, 0x23000), "dirty pages") && ok;
+    ok = check(memory_take_dirty_pages(&bus, dirty) == 0 && !memory_dirty_page(dirty, 0x9000), "snapshot clears the bitmap") && ok;
+
+    // Watchpoints log accesses overlapping them, whatever their width
+    memory_write_dword(&bus, 0x30000, 0x01020304);
+    ok = check(memory_add_watchpoint(&bus, 0x30002, 2, MEMORY_WATCH_WRITE) &&
+               memory_add_watchpoint(&bus, 0x3FFFE, 4, MEMORY_WATCH_READ), "watchpoints set") && ok;
+    uint32_t guest_ip = 0x1234;
+    bus.cpu_ip = &guest_ip;
+    memory_write_dword(&bus, 0x30000, 0xAABBCCDD);      // Hit
+    bus_write<uint8_t>(&bus, 0x30001, 0x11);            // Miss: before the range
+    uint32_t watched_value = memory_read_dword(&bus, 0x30000); // Miss: writes only
+    bus_read<uint16_t>(&bus, 0x3FFFF);                  // Hit, across the page boundary
+    memory_write_dword(&bus, 0x31000, 5);               // Miss: watched page, outside the range
+    MemoryWatchHit hits[4];
+    uint32_t hit_count = memory_watch_hits(&bus, hits, 4);
+    ok = check(watched_value == 0xAABB11DD && memory_read_dword(&bus, 0x31000) == 5 && hit_count == 2 &&
+               hits[0].write && hits[0].ip == 0x1234 && hits[0].address == 0x30000 && hits[0].size == 4 &&
+               hits[0].old_value == 0x01020304 && hits[0].new_value == 0xAABBCCDD &&
+               !hits[1].write && hits[1].address == 0x3FFFF && hits[1].size == 2, "watchpoint hits") && ok;
+    ok = check(memory_host_pointer(&bus, 0x30000) == bus.ram + 0x30000 && bus.pages[3].host == nullptr,
+               "watched pages leave the fast path") && ok;
+    memory_clear_watchpoints(&bus);
+    memory_write_dword(&bus, 0x30000, 0);
+    ok = check(memory_watch_hits(&bus, hits, 4) == 2 && bus.pages[3].host == bus.ram + 0x30000 &&
+               bus.pages[4].host == bus.ram + 0x40000, "cleared watchpoints") && ok;
+    bus.cpu_ip = nullptr;
+
+    // Unmapped space
+    memory_write_dword(&bus, 0x80000000, 0x12345678);
+    ok = check(memory_read_dword(&bus, 0x80000000) == 0 && memory_read_byte(&bus, 0xFFFFFFFF) == 0, "unmapped space reads 0") && ok;
+
+    // A device spanning two pages sees offsets from its base, with a third
+    // page of host memory mapped directly
+    TestDevice device = {{1, 2, 3, 4}, 0};
+    static uint8_t direct[MEMORY_PAGE_SIZE];
+    const uint32_t base = 0xF0000000;
+    MmioDevice test = {};
+    test.name = "test";
+    test.base = base;
+    test.size = 2 * MEMORY_PAGE_SIZE + 0x10;
+    test.context = &device;
+    test.read32 = test_device_read;
+    test.write32 = test_device_write;
+    test.read8 = test_device_read8;
+    test.direct = direct;
+    test.direct_offset = 2 * MEMORY_PAGE_SIZE;
+    test.direct_size = MEMORY_PAGE_SIZE;
+    uint32_t generation = bus.map_generation;
+    const MmioDevice* registered = memory_register_device(&bus, &test);
+    ok = check(registered != nullptr && registered->context == &device && bus.map_generation != generation,
+               "registration bumps the map generation") && ok;
+    memory_write_dword(&bus, base + 8, 0x55);
+    ok = check(device.registers[2] == 0x55 && memory_read_dword(&bus, base + 4) == 2, "device registers") && ok;
+    ok = check(memory_read_dword(&bus, base + MEMORY_PAGE_SIZE + 4) == 0xDEAD && device.last_offset == MEMORY_PAGE_SIZE + 4,
+               "second device page") && ok;
+    memory_write_byte(&bus, base, 0x99);
+    ok = check(device.registers[0] == 1 && memory_read_byte(&bus, base + 9) == 0, "byte handlers where provided") && ok;
+    ok = check(bus_read<uint16_t>(&bus, base + 4) == 2 && bus_read<uint64_t>(&bus, base + 4) == 0x0000005500000002ull,
+               "halfwords and doublewords split over device handlers") && ok;
+    ok = check(memory_host_pointer(&bus, base) == nullptr, "no host pointer into device registers") && ok;
+    memory_write_dword(&bus, base + 2 * MEMORY_PAGE_SIZE + 8, 0xFEEDBEEF);
+    ok = check(memory_load_le32(direct + 8) == 0xFEEDBEEF && memory_host_pointer(&bus, base + 2 * MEMORY_PAGE_SIZE) == direct,
+               "direct region") && ok;
+
+    // Spans read in place over RAM and copy everything else
+    uint8_t scratch[16];
+    BusSpan span = bus_span(&bus, MEMORY_PAGE_SIZE - 2, 8, scratch);
+    ok = check(span.direct && span.data == bus.ram + MEMORY_PAGE_SIZE - 2 && memory_load_le32(span.data) == 0xAABBCCDD,
+               "span over RAM pages is in place") && ok;
+    span = bus_span(&bus, MEMORY_SIZE - 4, 8, scratch);
+    ok = check(!span.direct && span.data == scratch && memory_load_le32(scratch) == 0xFFFFFFFF &&
+               memory_load_le32(scratch + 4) == 0, "span past the end of RAM is copied") && ok;
+    memset(scratch, 0xCC, sizeof(scratch));
+    span = bus_span(&bus, base + 4, 6, scratch);
+    ok = check(!span.direct && memory_load_le32(scratch) == 2 && scratch[4] == 0x55 && scratch[6] == 0xCC,
+               "span over device registers is copied") && ok;
+    span = bus_span(&bus, 0xFFFFFFFE, 4, scratch);
+    ok = check(!span.direct && memory_load_le32(scratch) == 0x00000000, "span wrapping the address space") && ok;
+
+    // Mapped ROM drops writes
+    static uint8_t rom[MEMORY_PAGE_SIZE];
+    for (uint32_t i = 0; i < MEMORY_PAGE_SIZE; ++i) {
+        rom[i] = (uint8_t)(i * 7 + 3);
+    }
+    memory_map_rom(&bus, 0x100000, MEMORY_PAGE_SIZE, rom);
+    memory_take_dirty_pages(&bus, dirty);
+    uint32_t rom_word = memory_load_le32(rom + 0x40);
+    bus_write<uint32_t>(&bus, 0x100040, ~rom_word);
+    memory_write_byte(&bus, 0x100041, 0);
+    ok = check(bus_read<uint32_t>(&bus, 0x100040) == rom_word && memory_take_dirty_pages(&bus, dirty) == 0 &&
+               !memory_is_ram(&bus, 0x100000, 4) && memory_is_ram(&bus, 0xF0000, 4), "ROM writes dropped") && ok;
+
+    // Without a board, ROM images are RAM contents whatever their alignment
+    MemoryBus flat;
+    memory_init(&flat);
+    ok = check(memory_load_rom(&flat, 0x100000, rom, MEMORY_PAGE_SIZE) && memory_load_rom(&flat, 0x200010, rom, 0x100) &&
+               memory_read_byte(&flat, 0x200010 + 0x20) == rom[0x20] && memory_is_ram(&flat, 0x100000, MEMORY_PAGE_SIZE) &&
+               memory_is_ram(&flat, 0x200000, MEMORY_PAGE_SIZE), "ROM without a board copied into RAM") && ok;
+    memory_write_byte(&flat, 0x100000, (uint8_t)~rom[0]);
+    memory_write_byte(&flat, 0x200010, (uint8_t)~rom[0]);
+    ok = check(memory_read_byte(&flat, 0x100000) == (uint8_t)~rom[0] && memory_read_byte(&flat, 0x200010) == (uint8_t)~rom[0] &&
+               rom[0] == 3, "aligned and unaligned copies alike writable") && ok;
+    memory_destroy(&flat);
+
+    // On a board, page-aligned images are shared read-only between buses
+    MemoryBus first, second;
+    memory_init(&first);
+    memory_init(&second);
+    memory_apply_board(&first, memory_find_board("model2a"));
+    memory_apply_board(&second, memory_find_board("model2a"));
+    ok = check(memory_load_rom(&first, 0x02000000, rom, MEMORY_PAGE_SIZE) &&
+               memory_load_rom(&second, 0x02100000, rom, MEMORY_PAGE_SIZE) &&
+               memory_host_pointer(&first, 0x02000000) == memory_host_pointer(&second, 0x02100000) &&
+               memory_host_pointer(&first, 0x02000000) != first.ram + 0x02000000, "ROM image shared between buses") && ok;
+    memory_write_dword(&first, 0x02000040, ~rom_word);
+    ok = check(memory_read_dword(&first, 0x02000040) == rom_word && memory_read_dword(&second, 0x02100040) == rom_word,
+               "shared ROM writes dropped") && ok;
+    memory_destroy(&first);
+    memory_destroy(&second);
+
+    // A board map leaves only its regions mapped, with ROM read-only
+    MemoryBus board_bus;
+    memory_init(&board_bus);
+    const BoardMap* board = memory_find_board("model2b");
+    memory_write_dword(&board_bus, 0x00200010, 0x1234);
+    ok = check(board != nullptr && memory_find_board("model9") == nullptr && memory_apply_board(&board_bus, board) &&
+               memory_board_region(&board_bus, 0x00200000) == &board->regions[BOARD_WORK_RAM] &&
+               memory_board_region(&board_bus, 0x00300000) == nullptr, "board regions") && ok;
+    memory_write_dword(&board_bus, 0x00200020, 0x5678);       // Work RAM
+    memory_write_dword(&board_bus, 0x00000100, 0x9ABC);       // Program ROM
+    memory_write_dword(&board_bus, 0x00300000, 0xDEF0);       // Between regions
+    ok = check(memory_read_dword(&board_bus, 0x00200010) == 0x1234 && memory_read_dword(&board_bus, 0x00200020) == 0x5678 &&
+               memory_read_dword(&board_bus, 0x00000100) == 0 && memory_read_dword(&board_bus, 0x00300000) == 0 &&
+               memory_is_ram(&board_bus, 0x00900000, 0x80000) && !memory_is_ram(&board_bus, 0x02000000, 4) &&
+               !memory_is_ram(&board_bus, 0x00300000, 4), "ROM and unmapped writes dropped") && ok;
+    ok = check(memory_load_rom(&board_bus, 0x02000010, rom, 0x100) && memory_read_byte(&board_bus, 0x02000010) == rom[0] &&
+               !memory_is_ram(&board_bus, 0x02000000, 4) && memory_load_rom(&board_bus, 0x00000000, rom, MEMORY_PAGE_SIZE) &&
+               memory_read_byte(&board_bus, 0x40) == rom[0x40] && !memory_load_rom(&board_bus, 0x00200000, rom, MEMORY_PAGE_SIZE),
+               "ROM loads into ROM regions only") && ok;
+    memory_write_byte(&board_bus, 0x02000010, (uint8_t)~rom[0]);
+    ok = check(memory_read_byte(&board_bus, 0x02000010) == rom[0], "copied ROM stays read-only") && ok;
+    memory_destroy(&board_bus);
+
+    // Bus statistics count accesses per region and device register
+    if (memory_enable_stats(&bus)) {
+        memory_read_dword(&bus, 0x1234);
+        bus_write<uint16_t>(&bus, 0x1240, 1);
+        memory_read_byte(&bus, 0x100000);
+        memory_write_dword(&bus, base + 8, 0x66);
+        memory_read_dword(&bus, base + 8);
+        memory_read_dword(&bus, 0x80000000);
+        memory_stats_end_frame(&bus);
+        bus_span(&bus, 0x2000, 64, scratch);
+        memory_stats_end_frame(&bus);
+        const MemoryStats* stats = bus.stats;
+        uint32_t test_region = MEMORY_REGION_DEVICE + (uint32_t)(registered - bus.devices);
+        const MemoryAccessCounts& reg = stats->registers.at((uint64_t)(registered - bus.devices) << 32 | 8);
+        ok = check(stats->regions[MEMORY_REGION_RAM].reads == 2 && stats->regions[MEMORY_REGION_RAM].bytes_read == 68 &&
+                   stats->regions[MEMORY_REGION_RAM].writes == 1 && stats->regions[MEMORY_REGION_RAM].bytes_written == 2 &&
+                   stats->regions[MEMORY_REGION_ROM].reads == 1 && stats->regions[MEMORY_REGION_UNMAPPED].reads == 1 &&
+                   stats->regions[test_region].reads == 1 && stats->regions[test_region].writes == 1 &&
+                   reg.reads == 1 && reg.writes == 1 && stats->frames.size() == 2 && stats->frames[0] == 19 &&
+                   stats->frames[1] == 64, "bus statistics") && ok;
+    }
+
+    // Memory mapped a second time is visible through both ranges
+    memory_map_host(&bus, 0x90000000, MEMORY_PAGE_SIZE, bus.ram);
+    ok = check(memory_read_dword(&bus, 0x90001234) == 0x11223344, "mirrored RAM") && ok;
 
     memory_destroy(&bus);
-    std::cout << "Test completed successfully" << std::endl;
-    return 0;
-}
\ No newline at end of file
+    std::cout << (ok ? "Test completed successfully" : "Test FAILED") << std::endl;
+    return ok ? 0 : 1;
+}
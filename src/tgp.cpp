@@ -1,5 +1,6 @@
 #include "tgp.h"
 #include "memory.h"
+#include "trace.h"
 #include <iostream>
 #include <cstring>
 #include <cmath>
@@ -17,6 +18,11 @@
 #include <GL/gl.h>
 #endif
 
+// Trace buffer of the bus the TGP is attached to
+static TraceBuffer* tgp_trace(TGP* tgp) {
+    return tgp->bus ? tgp->bus->trace : nullptr;
+}
+
 void tgp_init(TGP* tgp, MemoryBus* bus) {
     std::cout << "Initializing TGP (Tile Generator Processor)..." << std::endl;
 
@@ -77,64 +83,63 @@ void tgp_step(TGP* tgp) {
         // For now, just mark as not busy after one cycle
         // In a real implementation, this would process actual 3D commands
         tgp->busy = false;
-        std::cout << "TGP command completed." << std::endl;
+        trace_record<TRACE_DEVICE>(tgp_trace(tgp), TRACE_EVENT_TGP_COMPLETE, 0, 0, 0, 0, 0, 0);
     }
 }
 
 void tgp_execute_command(TGP* tgp) {
     // Extract command from control register (bits 8-15 typically contain command)
     uint32_t command = (tgp->control_register >> 8) & 0xFF;
+    uint32_t operand = 0;  // Guest address the command reads its data from
+    uint8_t fault = 0;     // Matrix stack overflow or underflow
     
     switch (command) {
         case CMD_CLEAR:
-            std::cout << "TGP: Executing CLEAR command" << std::endl;
             tgp_clear_framebuffer(tgp);
             break;
         case CMD_DRAW_TRIANGLE:
-            std::cout << "TGP: Executing DRAW_TRIANGLE command" << std::endl;
             tgp_draw_triangles(tgp);
             break;
         case CMD_SET_MATRIX:
-            std::cout << "TGP: Executing SET_MATRIX command" << std::endl;
+            operand = tgp->vertex_buffer_addr;
             tgp_load_matrix_from_memory(tgp);
             break;
         case CMD_PUSH_MATRIX:
-            std::cout << "TGP: Executing PUSH_MATRIX command" << std::endl;
+            fault = tgp->matrix_sp >= 32;
             tgp_push_matrix(tgp);
             break;
         case CMD_POP_MATRIX:
-            std::cout << "TGP: Executing POP_MATRIX command" << std::endl;
+            fault = tgp->matrix_sp == 0;
             tgp_pop_matrix(tgp);
             break;
         case CMD_LOAD_IDENTITY:
-            std::cout << "TGP: Executing LOAD_IDENTITY command" << std::endl;
             tgp_matrix_identity(tgp->current_matrix);
             break;
         case CMD_MULTIPLY_MATRIX:
-            std::cout << "TGP: Executing MULTIPLY_MATRIX command" << std::endl;
             tgp_multiply_matrix(tgp);
             break;
         case CMD_TRANSLATE:
-            std::cout << "TGP: Executing TRANSLATE command" << std::endl;
+            operand = tgp->index_buffer_addr;
             tgp_translate_matrix(tgp);
             break;
         case CMD_ROTATE_X:
-            std::cout << "TGP: Executing ROTATE_X command" << std::endl;
+            operand = tgp->index_buffer_addr;
             tgp_rotate_matrix_x(tgp);
             break;
         case CMD_ROTATE_Y:
-            std::cout << "TGP: Executing ROTATE_Y command" << std::endl;
+            operand = tgp->index_buffer_addr;
             tgp_rotate_matrix_y(tgp);
             break;
         case CMD_ROTATE_Z:
-            std::cout << "TGP: Executing ROTATE_Z command" << std::endl;
+            operand = tgp->index_buffer_addr;
             tgp_rotate_matrix_z(tgp);
             break;
         default:
-            std::cout << "TGP: Unknown command 0x" << std::hex << command << std::endl;
             break;
     }
     
+    trace_record<TRACE_DEVICE>(tgp_trace(tgp), TRACE_EVENT_TGP_COMMAND, (uint8_t)command, fault, 0, operand, tgp->matrix_sp, 0);
+
     // Mark command as completed
     tgp->busy = false;
     tgp->control_register &= ~0x1; // Clear start bit
@@ -147,35 +152,30 @@ uint32_t tgp_read_register(TGP* tgp, uint32_t offset) {
         case 0x08: return tgp->index_buffer_addr;
         case 0x0C: return tgp->texture_base_addr;
         default:
-            std::cout << "TGP: Read from unknown register 0x" << std::hex << offset << std::endl;
+            trace_record<TRACE_DEVICE>(tgp_trace(tgp), TRACE_EVENT_TGP_READ, 0, 0, 0, offset, 0, 0);
             return 0;
     }
 }
 
 void tgp_write_register(TGP* tgp, uint32_t offset, uint32_t value) {
+    trace_record<TRACE_DEVICE>(tgp_trace(tgp), TRACE_EVENT_TGP_WRITE, 0, 0, 0, offset, value, 0);
     switch (offset) {
         case 0x00: // Control register
             tgp->control_register = value;
             if (value & 0x1) { // Start command bit
                 tgp->busy = true;
-                std::cout << "TGP: Starting command execution" << std::endl;
             }
             break;
         case 0x04: // Vertex buffer address
             tgp->vertex_buffer_addr = value;
-            std::cout << "TGP: Vertex buffer set to 0x" << std::hex << value << std::endl;
             break;
         case 0x08: // Index buffer address
             tgp->index_buffer_addr = value;
-            std::cout << "TGP: Index buffer set to 0x" << std::hex << value << std::endl;
             break;
         case 0x0C: // Texture base address
             tgp->texture_base_addr = value;
-            std::cout << "TGP: Texture base set to 0x" << std::hex << value << std::endl;
             break;
         default:
-            std::cout << "TGP: Write to unknown register 0x" << std::hex << offset
-                      << " = 0x" << value << std::endl;
             break;
     }
 }
@@ -188,31 +188,35 @@ void tgp_process_command(TGP* tgp, uint32_t command) {
 
 // New 3D Pipeline Functions
 
+// Reads count little-endian floats from guest memory in one span, straight
+// out of RAM when possible
+static void tgp_fetch_floats(TGP* tgp, uint32_t addr, float* out, uint32_t count) {
+    uint8_t scratch[32 * 4]; // The largest fetch is a triangle's 27 floats
+    uint32_t length = std::min<uint32_t>(count * 4, sizeof(scratch));
+    BusSpan span = bus_span(tgp->bus, addr, length, scratch);
+    for (uint32_t i = 0; i < length / 4; i++) {
+        uint32_t bits = memory_load_le32(span.data + i * 4);
+        memcpy(&out[i], &bits, sizeof(float));
+    }
+}
+
 void tgp_clear_framebuffer(TGP* tgp) {
     memset(tgp->framebuffer, 0, sizeof(tgp->framebuffer));
     for (int i = 0; i < 496 * 384; i++) {
         tgp->depth_buffer[i] = 1.0f; // Far plane
     }
-    std::cout << "TGP: Framebuffer cleared" << std::endl;
 }
 
 void tgp_load_matrix_from_memory(TGP* tgp) {
     // Load 4x4 matrix from memory address stored in vertex_buffer_addr
     uint32_t addr = tgp->vertex_buffer_addr;
-    for (int i = 0; i < 16; i++) {
-        uint32_t value = memory_read_dword(tgp->bus, addr + i * 4);
-        tgp->current_matrix[i] = *(float*)&value; // Convert uint32_t to float
-    }
-    std::cout << "TGP: Matrix loaded from memory address 0x" << std::hex << addr << std::endl;
+    tgp_fetch_floats(tgp, addr, tgp->current_matrix, 16);
 }
 
 void tgp_push_matrix(TGP* tgp) {
     if (tgp->matrix_sp < 32) {
         memcpy(&tgp->matrix_stack[tgp->matrix_sp * 16], tgp->current_matrix, sizeof(float) * 16);
         tgp->matrix_sp++;
-        std::cout << "TGP: Matrix pushed to stack (SP=" << tgp->matrix_sp << ")" << std::endl;
-    } else {
-        std::cout << "TGP: Matrix stack overflow!" << std::endl;
     }
 }
 
@@ -220,9 +224,6 @@ void tgp_pop_matrix(TGP* tgp) {
     if (tgp->matrix_sp > 0) {
         tgp->matrix_sp--;
         memcpy(tgp->current_matrix, &tgp->matrix_stack[tgp->matrix_sp * 16], sizeof(float) * 16);
-        std::cout << "TGP: Matrix popped from stack (SP=" << tgp->matrix_sp << ")" << std::endl;
-    } else {
-        std::cout << "TGP: Matrix stack underflow!" << std::endl;
     }
 }
 
@@ -230,49 +231,42 @@ void tgp_multiply_matrix(TGP* tgp) {
     float temp[16];
     memcpy(temp, tgp->current_matrix, sizeof(float) * 16);
     tgp_matrix_multiply(tgp->current_matrix, temp, tgp->modelview_matrix);
-    std::cout << "TGP: Matrix multiplied with modelview" << std::endl;
 }
 
 void tgp_translate_matrix(TGP* tgp) {
     // Get translation parameters from index_buffer_addr (x, y, z)
     uint32_t addr = tgp->index_buffer_addr;
-    uint32_t x_bits = memory_read_dword(tgp->bus, addr);
-    uint32_t y_bits = memory_read_dword(tgp->bus, addr + 4);
-    uint32_t z_bits = memory_read_dword(tgp->bus, addr + 8);
-    
-    float x = *(float*)&x_bits;
-    float y = *(float*)&y_bits;
-    float z = *(float*)&z_bits;
+    float xyz[3];
+    tgp_fetch_floats(tgp, addr, xyz, 3);
+    float x = xyz[0];
+    float y = xyz[1];
+    float z = xyz[2];
     
     tgp_matrix_translate(tgp->current_matrix, x, y, z);
-    std::cout << "TGP: Matrix translated by (" << x << ", " << y << ", " << z << ")" << std::endl;
 }
 
 void tgp_rotate_matrix_x(TGP* tgp) {
     uint32_t addr = tgp->index_buffer_addr;
-    uint32_t angle_bits = memory_read_dword(tgp->bus, addr);
+    uint32_t angle_bits = bus_read<uint32_t>(tgp->bus, addr);
     float angle = *(float*)&angle_bits;
     
     tgp_matrix_rotate_x(tgp->current_matrix, angle);
-    std::cout << "TGP: Matrix rotated X by " << angle << " radians" << std::endl;
 }
 
 void tgp_rotate_matrix_y(TGP* tgp) {
     uint32_t addr = tgp->index_buffer_addr;
-    uint32_t angle_bits = memory_read_dword(tgp->bus, addr);
+    uint32_t angle_bits = bus_read<uint32_t>(tgp->bus, addr);
     float angle = *(float*)&angle_bits;
     
     tgp_matrix_rotate_y(tgp->current_matrix, angle);
-    std::cout << "TGP: Matrix rotated Y by " << angle << " radians" << std::endl;
 }
 
 void tgp_rotate_matrix_z(TGP* tgp) {
     uint32_t addr = tgp->index_buffer_addr;
-    uint32_t angle_bits = memory_read_dword(tgp->bus, addr);
+    uint32_t angle_bits = bus_read<uint32_t>(tgp->bus, addr);
     float angle = *(float*)&angle_bits;
     
     tgp_matrix_rotate_z(tgp->current_matrix, angle);
-    std::cout << "TGP: Matrix rotated Z by " << angle << " radians" << std::endl;
 }
 
 void tgp_draw_triangles(TGP* tgp) {
@@ -291,8 +285,6 @@ void tgp_draw_triangles(TGP* tgp) {
     
     // Draw the triangle to framebuffer
     tgp_rasterize_triangle(tgp, v1, v2, v3);
-    
-    std::cout << "TGP: Test triangle drawn" << std::endl;
 }
 
 void tgp_transform_vertex(Vertex* v, const float matrix[16]) {
@@ -354,46 +346,15 @@ void tgp_rasterize_triangle(TGP* tgp, const Vertex& v1, const Vertex& v2, const
 // Matrix Operations
 
 void tgp_draw_triangle(TGP* tgp, uint32_t vertex_addr) {
-    std::cout << "TGP: Drawing triangle from vertices at 0x" << std::hex << vertex_addr << std::endl;
+    // Read vertex data from memory (assuming 3 vertices, each with x,y,z,r,g,b,a,u,v)
+    float data[3 * 9];
+    tgp_fetch_floats(tgp, vertex_addr, data, 3 * 9);
 
     Triangle triangle;
-
-    // Read vertex data from memory (assuming 3 vertices, each with x,y,z,r,g,b,a,u,v)
+    Vertex* vertices[3] = {&triangle.v1, &triangle.v2, &triangle.v3};
     for (int i = 0; i < 3; i++) {
-        uint32_t base_addr = vertex_addr + (i * 9 * 4); // 9 floats per vertex
-
-        // Read vertex data (simplified - in real Model 2 this would be more complex)
-        if (i == 0) {
-            triangle.v1.x = *reinterpret_cast<float*>(&tgp->bus->ram[base_addr]);
-            triangle.v1.y = *reinterpret_cast<float*>(&tgp->bus->ram[base_addr + 4]);
-            triangle.v1.z = *reinterpret_cast<float*>(&tgp->bus->ram[base_addr + 8]);
-            triangle.v1.r = *reinterpret_cast<float*>(&tgp->bus->ram[base_addr + 12]);
-            triangle.v1.g = *reinterpret_cast<float*>(&tgp->bus->ram[base_addr + 16]);
-            triangle.v1.b = *reinterpret_cast<float*>(&tgp->bus->ram[base_addr + 20]);
-            triangle.v1.a = *reinterpret_cast<float*>(&tgp->bus->ram[base_addr + 24]);
-            triangle.v1.u = *reinterpret_cast<float*>(&tgp->bus->ram[base_addr + 28]);
-            triangle.v1.v = *reinterpret_cast<float*>(&tgp->bus->ram[base_addr + 32]);
-        } else if (i == 1) {
-            triangle.v2.x = *reinterpret_cast<float*>(&tgp->bus->ram[base_addr]);
-            triangle.v2.y = *reinterpret_cast<float*>(&tgp->bus->ram[base_addr + 4]);
-            triangle.v2.z = *reinterpret_cast<float*>(&tgp->bus->ram[base_addr + 8]);
-            triangle.v2.r = *reinterpret_cast<float*>(&tgp->bus->ram[base_addr + 12]);
-            triangle.v2.g = *reinterpret_cast<float*>(&tgp->bus->ram[base_addr + 16]);
-            triangle.v2.b = *reinterpret_cast<float*>(&tgp->bus->ram[base_addr + 20]);
-            triangle.v2.a = *reinterpret_cast<float*>(&tgp->bus->ram[base_addr + 24]);
-            triangle.v2.u = *reinterpret_cast<float*>(&tgp->bus->ram[base_addr + 28]);
-            triangle.v2.v = *reinterpret_cast<float*>(&tgp->bus->ram[base_addr + 32]);
-        } else if (i == 2) {
-            triangle.v3.x = *reinterpret_cast<float*>(&tgp->bus->ram[base_addr]);
-            triangle.v3.y = *reinterpret_cast<float*>(&tgp->bus->ram[base_addr + 4]);
-            triangle.v3.z = *reinterpret_cast<float*>(&tgp->bus->ram[base_addr + 8]);
-            triangle.v3.r = *reinterpret_cast<float*>(&tgp->bus->ram[base_addr + 12]);
-            triangle.v3.g = *reinterpret_cast<float*>(&tgp->bus->ram[base_addr + 16]);
-            triangle.v3.b = *reinterpret_cast<float*>(&tgp->bus->ram[base_addr + 20]);
-            triangle.v3.a = *reinterpret_cast<float*>(&tgp->bus->ram[base_addr + 24]);
-            triangle.v3.u = *reinterpret_cast<float*>(&tgp->bus->ram[base_addr + 28]);
-            triangle.v3.v = *reinterpret_cast<float*>(&tgp->bus->ram[base_addr + 32]);
-        }
+        const float* f = &data[i * 9]; // 9 floats per vertex
+        *vertices[i] = {f[0], f[1], f[2], f[3], f[4], f[5], f[6], f[7], f[8]};
     }
 
     // Process the triangle through the 3D pipeline
@@ -401,12 +362,8 @@ void tgp_draw_triangle(TGP* tgp, uint32_t vertex_addr) {
 }
 
 void tgp_set_matrix(TGP* tgp, uint32_t matrix_addr) {
-    std::cout << "TGP: Setting matrix from 0x" << std::hex << matrix_addr << std::endl;
-
     // Read 4x4 matrix from memory
-    for (int i = 0; i < 16; i++) {
-        tgp->current_matrix[i] = *reinterpret_cast<float*>(&tgp->bus->ram[matrix_addr + (i * 4)]);
-    }
+    tgp_fetch_floats(tgp, matrix_addr, tgp->current_matrix, 16);
 }
 
 // Helper function: Check if point is inside triangle using barycentric coordinates
@@ -0,0 +1,94 @@
+#include "trace.h"
+#include <cstring>
+#include <fstream>
+
+// Trace file layout: header followed by records, oldest first, in host
+// (little-endian) byte order
+struct TraceFileHeader {
+    char magic[8];         // "PM2TRACE"
+    uint32_t version;
+    uint32_t record_size;  // sizeof(TraceRecord)
+    uint64_t total;        // Records traced, including any overwritten in the ring
+};
+
+static const char TRACE_MAGIC[8] = {'P', 'M', '2', 'T', 'R', 'A', 'C', 'E'};
+static const uint32_t TRACE_VERSION = 1;
+
+void trace_init(TraceBuffer* trace, TraceLevel level, uint32_t capacity) {
+    uint32_t size = 1;
+    while (size < capacity && size < 0x80000000u) {
+        size <<= 1;
+    }
+    trace->records = new TraceRecord[size];
+    trace->mask = size - 1;
+    trace->count = 0;
+    trace->level = level;
+}
+
+void trace_destroy(TraceBuffer* trace) {
+    delete[] trace->records;
+    trace->records = nullptr;
+    trace->mask = 0;
+    trace->count = 0;
+    trace->level = TRACE_OFF;
+}
+
+bool trace_parse_level(const char* name, TraceLevel* level) {
+    if (strcmp(name, "off") == 0) {
+        *level = TRACE_OFF;
+        return true;
+    }
+    if (strcmp(name, "device") == 0) {
+        *level = TRACE_DEVICE;
+        return true;
+    }
+    if (strcmp(name, "cpu") == 0) {
+        *level = TRACE_CPU;
+        return true;
+    }
+    return false;
+}
+
+bool trace_save(const TraceBuffer* trace, const char* path) {
+    std::ofstream file(path, std::ios::binary);
+    if (!file) {
+        return false;
+    }
+
+    TraceFileHeader header;
+    memcpy(header.magic, TRACE_MAGIC, sizeof(header.magic));
+    header.version = TRACE_VERSION;
+    header.record_size = sizeof(TraceRecord);
+    header.total = trace->count;
+    file.write((const char*)&header, sizeof(header));
+
+    // Once the ring has wrapped, the oldest record sits at the write position
+    uint64_t capacity = (uint64_t)trace->mask + 1;
+    uint64_t kept = trace->count < capacity ? trace->count : capacity;
+    uint64_t first = trace->count - kept;
+    for (uint64_t i = 0; i < kept; ++i) {
+        file.write((const char*)&trace->records[(first + i) & trace->mask], sizeof(TraceRecord));
+    }
+    return (bool)file;
+}
+
+bool trace_load(const char* path, std::vector<TraceRecord>* records, uint64_t* total) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        return false;
+    }
+
+    TraceFileHeader header;
+    if (!file.read((char*)&header, sizeof(header)) || memcmp(header.magic, TRACE_MAGIC, sizeof(header.magic)) != 0 ||
+        header.version != TRACE_VERSION || header.record_size != sizeof(TraceRecord)) {
+        return false;
+    }
+
+    records->clear();
+    TraceRecord record;
+    while (file.read((char*)&record, sizeof(record))) {
+        records->push_back(record);
+    }
+    *total = header.total;
+    return true;
+}